@@ -61,6 +61,23 @@ public:
         std::function<void(const QString&, bool)> responseCallback
     ) = 0;
     
+    /**
+     * Generate an AI response with parameters of its own, telling errors apart
+     * 
+     * @param query The user's question or instruction
+     * @param contextInfo Additional context information
+     * @param parameters Parameters for this request only, overriding those of setModelParameters()
+     * @param responseCallback Callback receiving response chunks and completion status
+     * @param errorCallback Callback receiving an error message instead, when the request failed
+     */
+    virtual void generateResponse(
+        const QString &query,
+        const QString &contextInfo,
+        const QVariantMap &parameters,
+        std::function<void(const QString&, bool)> responseCallback,
+        std::function<void(const QString&)> errorCallback
+    ) = 0;
+    
     /**
      * Set the API key for the service
      * @param apiKey The API key for authentication
@@ -6,18 +6,45 @@
 #include "aiservice.h"
 
 #include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
 #include <QStandardPaths>
 
+#include <utility>
+
+// Background requests queued within this long of the first one are
+// sent together (ms)
+static const int BATCH_DELAY = 500;
+
+// Most background requests merged into one call
+static const int MAX_BATCH_SIZE = 8;
+
+// Most query characters merged into one call, to stay well inside the
+// model's context window
+static const int MAX_BATCH_CHARS = 24000;
+
+// Ceiling for the response tokens of a batch, which gets the per-request
+// budget once per merged request
+static const int MAX_BATCH_TOKENS = 4000;
+
 // Constructor
 AIService::AIService(QObject *parent)
     : QObject(parent)
     , m_providerType(AIProviderType::Remote)  // Default to Remote (OpenAI)
     , m_model(QStringLiteral("gpt-3.5-turbo"))      // Default model
     , m_initialized(false)
+    , m_interactiveRequests(0)
+    , m_backgroundCalls(0)
+    , m_providerGeneration(0)
+    , m_nextRequestId(0)
 {
     // Initialize default parameters
     m_parameters[QStringLiteral("temperature")] = DEFAULT_TEMPERATURE;
     m_parameters[QStringLiteral("maxTokens")] = DEFAULT_MAX_TOKENS;
+    
+    m_batchTimer.setSingleShot(true);
+    m_batchTimer.setInterval(BATCH_DELAY);
+    connect(&m_batchTimer, &QTimer::timeout, this, &AIService::flushBackgroundRequests);
 }
 
 // Destructor
@@ -40,6 +67,12 @@ bool AIService::initialize(const KConfigGroup &config)
     m_parameters[QStringLiteral("temperature")] = config.readEntry(QStringLiteral("Temperature"), DEFAULT_TEMPERATURE);
     m_parameters[QStringLiteral("maxTokens")] = config.readEntry(QStringLiteral("MaxTokens"), DEFAULT_MAX_TOKENS);
     
+    // Endpoint override, e.g. for a local OpenAI-compatible server; no UI
+    QString endpoint = config.readEntry(QStringLiteral("APIEndpoint"), QString());
+    if (!endpoint.isEmpty()) {
+        m_parameters[QStringLiteral("endpoint")] = endpoint;
+    }
+    
     // Load API key (in a real implementation, this would use a secure storage mechanism)
     if (!loadApiKey()) {
         qWarning() << "Failed to load API key for provider:" << static_cast<int>(m_providerType);
@@ -55,9 +88,23 @@ bool AIService::initialize(const KConfigGroup &config)
 // Set up the provider based on current settings
 void AIService::setupProvider()
 {
+    // The old provider drops its calls in flight without answering them, so
+    // their background requests go back to the front of the queue
+    m_backgroundQueue = m_sentRequests.values() + m_backgroundQueue;
+    m_sentRequests.clear();
+    
     // Create the appropriate provider
     m_provider.reset(AIServiceProviderFactory::createProvider(m_providerType));
     
+    // Calls still in flight belong to the old provider and must not keep
+    // background work waiting
+    ++m_providerGeneration;
+    m_interactiveRequests = 0;
+    m_backgroundCalls = 0;
+    if (!m_backgroundQueue.isEmpty() && !m_batchTimer.isActive()) {
+        m_batchTimer.start();
+    }
+    
     if (m_provider) {
         // Configure the provider
         m_provider->setApiKey(m_apiKey);
@@ -101,8 +148,228 @@ void AIService::generateResponse(
         return;
     }
     
-    // Delegate to the provider
-    m_provider->generateResponse(query, contextInfo, responseCallback);
+    // Delegate to the provider; background batches wait until it answers
+    ++m_interactiveRequests;
+    const int generation = m_providerGeneration;
+    m_provider->generateResponse(query, contextInfo,
+        [this, responseCallback, generation](const QString &response, bool isFinal) {
+            if (isFinal && generation == m_providerGeneration && --m_interactiveRequests == 0
+                && !m_backgroundQueue.isEmpty() && !m_batchTimer.isActive()) {
+                m_batchTimer.start();
+            }
+            responseCallback(response, isFinal);
+        });
+}
+
+// Queue a background request
+void AIService::generateBackgroundResponse(
+    const QString &query,
+    const QString &contextInfo,
+    std::function<void(const QString&, bool)> responseCallback
+)
+{
+    if (!isReady()) {
+        responseCallback(QStringLiteral("AI service is not properly initialized. Please check your configuration."), true);
+        return;
+    }
+    
+    // The timer starts with the first request of a burst, so none waits
+    // longer than the batch delay for the others
+    m_backgroundQueue.append({query, contextInfo, responseCallback});
+    if (!m_batchTimer.isActive()) {
+        m_batchTimer.start();
+    }
+}
+
+// Send queued background requests
+void AIService::flushBackgroundRequests()
+{
+    // One batch at a time, and none while the user is waiting for an answer;
+    // whichever finishes last starts the timer again
+    if (m_backgroundQueue.isEmpty() || m_backgroundCalls > 0 || m_interactiveRequests > 0) {
+        return;
+    }
+    
+    if (!isReady()) {
+        const QList<BackgroundRequest> requests = std::exchange(m_backgroundQueue, {});
+        for (const BackgroundRequest &request : requests) {
+            request.callback(QStringLiteral("AI service is not properly initialized. Please check your configuration."), true);
+        }
+        return;
+    }
+    
+    // The oldest request and the ones queued after it with the same context
+    const QString contextInfo = m_backgroundQueue.first().contextInfo;
+    QList<BackgroundRequest> requests;
+    QStringList queries;
+    int chars = 0;
+    for (auto it = m_backgroundQueue.begin(); it != m_backgroundQueue.end() && requests.size() < MAX_BATCH_SIZE;) {
+        if (it->contextInfo != contextInfo || (!requests.isEmpty() && chars + it->query.size() > MAX_BATCH_CHARS)) {
+            ++it;
+            continue;
+        }
+        chars += it->query.size();
+        queries.append(it->query);
+        requests.append(*it);
+        it = m_backgroundQueue.erase(it);
+    }
+    
+    if (requests.size() == 1) {
+        sendIndividually(requests);
+        return;
+    }
+    
+    qDebug() << "Sending" << requests.size() << "background AI requests in one call";
+    
+    // Room for every answer, within reason; for this call only, the
+    // provider is shared with interactive requests
+    const int perRequestTokens = m_parameters.value(QStringLiteral("maxTokens"), DEFAULT_MAX_TOKENS).toInt();
+    QVariantMap batchParameters;
+    batchParameters[QStringLiteral("max_tokens")] = qMin(perRequestTokens * int(requests.size()), MAX_BATCH_TOKENS);
+    
+    const QList<quint64> ids = markSent(requests);
+    ++m_backgroundCalls;
+    const int generation = m_providerGeneration;
+    auto finishCall = [this, generation]() {
+        if (generation == m_providerGeneration && --m_backgroundCalls == 0 && !m_backgroundQueue.isEmpty()) {
+            m_batchTimer.start();
+        }
+    };
+    m_provider->generateResponse(batchPrompt(queries), contextInfo, batchParameters,
+        [this, ids, finishCall](const QString &response, bool isFinal) {
+            if (!isFinal) {
+                return;
+            }
+            
+            // Requests of a replaced provider are queued again
+            const QList<BackgroundRequest> requests = takeSent(ids);
+            if (requests.isEmpty()) {
+                return;
+            }
+            
+            QStringList answers;
+            if (splitBatchResponse(response, int(requests.size()), &answers)) {
+                for (int i = 0; i < requests.size(); ++i) {
+                    requests.at(i).callback(answers.at(i), true);
+                }
+            } else {
+                qDebug() << "Could not split the batched AI response, sending the requests one by one";
+                sendIndividually(requests);
+            }
+            finishCall();
+        },
+        [this, ids, finishCall](const QString &errorMessage) {
+            // Retrying one by one would turn a rejected call into many
+            const QList<BackgroundRequest> requests = takeSent(ids);
+            if (requests.isEmpty()) {
+                return;
+            }
+            for (const BackgroundRequest &request : requests) {
+                request.callback(errorMessage, true);
+            }
+            finishCall();
+        });
+}
+
+// Send background requests without batching
+void AIService::sendIndividually(const QList<BackgroundRequest> &requests)
+{
+    for (const BackgroundRequest &request : requests) {
+        if (!isReady()) {
+            request.callback(QStringLiteral("AI service is not properly initialized. Please check your configuration."), true);
+            continue;
+        }
+        
+        const quint64 id = markSent({request}).first();
+        ++m_backgroundCalls;
+        const int generation = m_providerGeneration;
+        m_provider->generateResponse(request.query, request.contextInfo,
+            [this, id, generation](const QString &response, bool isFinal) {
+                // Requests of a replaced provider are queued again; partial
+                // answers leave the request in flight
+                if (!m_sentRequests.contains(id)) {
+                    return;
+                }
+                const BackgroundRequest sent = isFinal ? m_sentRequests.take(id) : m_sentRequests.value(id);
+                sent.callback(response, isFinal);
+                if (isFinal && generation == m_providerGeneration && --m_backgroundCalls == 0
+                    && !m_backgroundQueue.isEmpty()) {
+                    m_batchTimer.start();
+                }
+            });
+    }
+}
+
+// Remember requests as sent
+QList<quint64> AIService::markSent(const QList<BackgroundRequest> &requests)
+{
+    QList<quint64> ids;
+    for (const BackgroundRequest &request : requests) {
+        const quint64 id = m_nextRequestId++;
+        m_sentRequests.insert(id, request);
+        ids.append(id);
+    }
+    return ids;
+}
+
+// Take requests that were answered
+QList<AIService::BackgroundRequest> AIService::takeSent(const QList<quint64> &ids)
+{
+    QList<BackgroundRequest> requests;
+    for (quint64 id : ids) {
+        auto it = m_sentRequests.find(id);
+        if (it != m_sentRequests.end()) {
+            requests.append(it.value());
+            m_sentRequests.erase(it);
+        }
+    }
+    return requests;
+}
+
+// Build a multi-part prompt
+QString AIService::batchPrompt(const QStringList &queries)
+{
+    QString prompt = QStringLiteral(
+        "Answer each of the following %1 independent requests. "
+        "Reply with nothing but a JSON array of %1 strings, "
+        "where string N is the complete answer to request N.\n"
+    ).arg(queries.size());
+    
+    for (int i = 0; i < queries.size(); ++i) {
+        prompt += QStringLiteral("\n### Request %1\n%2\n").arg(QString::number(i + 1), queries.at(i));
+    }
+    return prompt;
+}
+
+// Split a batched reply
+bool AIService::splitBatchResponse(const QString &response, int count, QStringList *answers)
+{
+    // Models tend to wrap the array in a code fence or a sentence
+    int start = response.indexOf(QLatin1Char('['));
+    int end = response.lastIndexOf(QLatin1Char(']'));
+    if (start < 0 || end <= start) {
+        return false;
+    }
+    
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(response.mid(start, end - start + 1).toUtf8(), &error);
+    if (error.error != QJsonParseError::NoError || !document.isArray()) {
+        return false;
+    }
+    
+    const QJsonArray array = document.array();
+    if (array.size() != count) {
+        return false;
+    }
+    
+    answers->clear();
+    for (const QJsonValue &value : array) {
+        if (!value.isString()) {
+            return false;
+        }
+        answers->append(value.toString());
+    }
+    return true;
 }
 
 // Check if ready
@@ -9,8 +9,12 @@
 #include "aiprovider.h"
 
 #include <KConfigGroup>
+#include <QList>
+#include <QMap>
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <QTimer>
 #include <QVariantMap>
 #include <functional>
 #include <memory>
@@ -22,6 +26,16 @@
  * handling provider selection, configuration, and response generation.
  * It serves as the interface between the UI components and the
  * underlying AI provider implementations.
+ * 
+ * Background requests, such as failure explanations nobody is waiting
+ * for, are queued and sent together: requests that share the same
+ * context are merged into one API call whose prompt numbers the parts
+ * and asks for a JSON array of answers. The answers are split back to
+ * the individual callbacks; if the reply can't be split, each request is
+ * sent on its own. A failed call, e.g. when rate limited, passes its
+ * error to every request instead. Background work waits while an
+ * interactive request is running, so it never delays one. Requests in
+ * flight when the provider is replaced are sent again with the new one.
  */
 class AIService : public QObject
 {
@@ -59,6 +73,19 @@ public:
         std::function<void(const QString&, bool)> responseCallback
     );
     
+    /**
+     * Queue a low-priority request, to be sent batched with others
+     * 
+     * @param query The question or instruction
+     * @param contextInfo Additional context; only requests with equal context are batched
+     * @param responseCallback Callback receiving the complete response, always final
+     */
+    void generateBackgroundResponse(
+        const QString &query,
+        const QString &contextInfo,
+        std::function<void(const QString&, bool)> responseCallback
+    );
+    
     /**
      * Check if the service is initialized and ready to use
      * @return True if ready, false otherwise
@@ -137,6 +164,56 @@ private:
      */
     bool loadApiKey();
     
+    /**
+     * Send the oldest queued background requests, batched where possible
+     */
+    void flushBackgroundRequests();
+    
+    /**
+     * A queued background request
+     */
+    struct BackgroundRequest {
+        QString query;
+        QString contextInfo;
+        std::function<void(const QString&, bool)> callback;
+    };
+    
+    /**
+     * Send background requests one by one
+     * @param requests Requests to send
+     */
+    void sendIndividually(const QList<BackgroundRequest> &requests);
+    
+    /**
+     * Keep requests until their call answers, so they survive a provider change
+     * @param requests Requests about to be sent
+     * @return ID of each request
+     */
+    QList<quint64> markSent(const QList<BackgroundRequest> &requests);
+    
+    /**
+     * Take answered requests out of the sent ones
+     * @param ids IDs from markSent()
+     * @return Requests still waiting, empty if they were queued again
+     */
+    QList<BackgroundRequest> takeSent(const QList<quint64> &ids);
+    
+    /**
+     * Build the prompt that asks for several answers at once
+     * @param queries Queries to merge
+     * @return Multi-part prompt
+     */
+    static QString batchPrompt(const QStringList &queries);
+    
+    /**
+     * Split the reply to a batch prompt into its answers
+     * @param response Reply text
+     * @param count Number of queries in the batch
+     * @param answers Receives one answer per query
+     * @return True if the reply held exactly one string per query
+     */
+    static bool splitBatchResponse(const QString &response, int count, QStringList *answers);
+    
     // Provider instance (owned by this service)
     std::unique_ptr<AIServiceProvider> m_provider;
     
@@ -147,6 +224,15 @@ private:
     QVariantMap m_parameters;
     bool m_initialized;
     
+    // Background scheduling
+    QList<BackgroundRequest> m_backgroundQueue;
+    QTimer m_batchTimer;
+    int m_interactiveRequests;
+    int m_backgroundCalls;
+    int m_providerGeneration;   // Bumped with each provider, calls of older ones no longer count
+    QMap<quint64, BackgroundRequest> m_sentRequests;    // Sent and unanswered, in send order
+    quint64 m_nextRequestId;
+    
     // Default parameter values
     static constexpr double DEFAULT_TEMPERATURE = 0.7;
     static constexpr int DEFAULT_MAX_TOKENS = 1000;
@@ -0,0 +1,306 @@
+/*
+ *  SPDX-FileCopyrightText: 2025 WarpKate Team <warpkate@example.com>
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "modelprobe.h"
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkReply>
+#include <QUrl>
+
+#include <algorithm>
+#include <memory>
+
+// Give up on a request that sends nothing for this long (ms)
+static const int PROBE_TIMEOUT = 15000;
+
+// Tokens requested from the probe completion; enough to time the stream
+static const int PROBE_MAX_TOKENS = 32;
+
+// Prompt with a short, predictable answer of many small tokens
+static const QString PROBE_PROMPT = QStringLiteral("Count from 1 to 30, separated by spaces.");
+
+ModelProbe::ModelProbe(QObject *parent)
+    : QObject(parent)
+    , m_endpoint(QStringLiteral("https://api.openai.com/v1/chat/completions"))
+    , m_samples(3)
+    , m_firstTokenAt(-1)
+    , m_lastTokenAt(-1)
+    , m_tokenChunks(0)
+{
+}
+
+ModelProbe::~ModelProbe()
+{
+    cancel();
+}
+
+void ModelProbe::setEndpoint(const QString &endpoint)
+{
+    m_endpoint = endpoint;
+}
+
+void ModelProbe::setApiKey(const QString &apiKey)
+{
+    m_apiKey = apiKey;
+}
+
+void ModelProbe::start(const QStringList &models, int samples)
+{
+    cancel();
+
+    m_models = models;
+    m_models.removeDuplicates();
+    m_samples = std::max(1, samples);
+    m_connectTimes.clear();
+    m_firstTokenTimes.clear();
+    m_tokenRates.clear();
+
+    if (m_models.isEmpty()) {
+        Q_EMIT finished();
+        return;
+    }
+    nextSample();
+}
+
+void ModelProbe::cancel()
+{
+    m_models.clear();
+    if (m_reply) {
+        // Aborting emits finished(), which must not start the next request
+        QNetworkReply *reply = m_reply;
+        m_reply = nullptr;
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+bool ModelProbe::isRunning() const
+{
+    return !m_models.isEmpty();
+}
+
+QString ModelProbe::modelsUrl(const QString &endpoint)
+{
+    QUrl url(endpoint);
+    QString path = url.path();
+    if (path.endsWith(QLatin1String("/chat/completions"))) {
+        path.chop(int(qstrlen("/chat/completions")));
+    } else if (path.endsWith(QLatin1String("/completions"))) {
+        path.chop(int(qstrlen("/completions")));
+    }
+    url.setPath(path + QStringLiteral("/models"));
+    return url.toString();
+}
+
+void ModelProbe::nextSample()
+{
+    if (m_models.isEmpty()) {
+        return;
+    }
+    if (m_connectTimes.size() >= m_samples) {
+        finishModel();
+        return;
+    }
+    measureConnect();
+}
+
+void ModelProbe::measureConnect()
+{
+    // Drop kept-alive connections so the sample pays for DNS, TCP and TLS again
+    m_networkManager.clearConnectionCache();
+
+    QNetworkReply *reply = m_networkManager.get(request(modelsUrl(m_endpoint)));
+    m_reply = reply;
+    m_timer.start();
+
+    // Headers arrived: the connection is up and the server answered
+    auto connectTime = std::make_shared<qint64>(-1);
+    connect(reply, &QNetworkReply::metaDataChanged, this, [this, reply, connectTime]() {
+        if (*connectTime < 0) {
+            *connectTime = m_timer.elapsed();
+        }
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, reply, connectTime]() {
+        reply->deleteLater();
+        if (reply != m_reply) {
+            return;
+        }
+        m_reply = nullptr;
+
+        // Any HTTP answer proves the connection, even if the server has no models list
+        if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).isNull()) {
+            finishModel(errorMessage(reply, QByteArray()));
+            return;
+        }
+        m_connectTimes.append(double(*connectTime >= 0 ? *connectTime : m_timer.elapsed()));
+        measureCompletion();
+    });
+}
+
+void ModelProbe::measureCompletion()
+{
+    QNetworkRequest completionRequest = request(m_endpoint);
+    completionRequest.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/json"));
+
+    QJsonObject message;
+    message[QStringLiteral("role")] = QStringLiteral("user");
+    message[QStringLiteral("content")] = PROBE_PROMPT;
+
+    QJsonObject payload;
+    payload[QStringLiteral("model")] = m_models.first();
+    payload[QStringLiteral("messages")] = QJsonArray{message};
+    payload[QStringLiteral("max_tokens")] = PROBE_MAX_TOKENS;
+    payload[QStringLiteral("temperature")] = 0;
+    payload[QStringLiteral("stream")] = true;
+
+    m_eventBuffer.clear();
+    m_firstTokenAt = -1;
+    m_lastTokenAt = -1;
+    m_tokenChunks = 0;
+
+    QNetworkReply *reply = m_networkManager.post(completionRequest, QJsonDocument(payload).toJson(QJsonDocument::Compact));
+    m_reply = reply;
+    m_timer.start();
+
+    connect(reply, &QNetworkReply::readyRead, this, [this, reply]() {
+        // Leave error bodies for the finished handler
+        if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() >= 400) {
+            return;
+        }
+        parseEvents(reply->readAll());
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        reply->deleteLater();
+        if (reply != m_reply) {
+            return;
+        }
+        m_reply = nullptr;
+
+        if (reply->error() != QNetworkReply::NoError) {
+            finishModel(errorMessage(reply, reply->readAll()));
+            return;
+        }
+        parseEvents(reply->readAll() + '\n');
+        if (m_firstTokenAt < 0) {
+            finishModel(QStringLiteral("No streamed content received"));
+            return;
+        }
+        finishSample();
+        nextSample();
+    });
+}
+
+void ModelProbe::parseEvents(const QByteArray &data)
+{
+    m_eventBuffer += data;
+
+    int lineEnd;
+    while ((lineEnd = m_eventBuffer.indexOf('\n')) >= 0) {
+        QByteArray line = m_eventBuffer.left(lineEnd).trimmed();
+        m_eventBuffer.remove(0, lineEnd + 1);
+
+        if (!line.startsWith("data:")) {
+            continue;
+        }
+        QByteArray event = line.mid(5).trimmed();
+        if (event == "[DONE]") {
+            continue;
+        }
+
+        // {"choices": [{"delta": {"content": "..."}}]}; role-only and empty deltas are no tokens
+        QJsonObject delta = QJsonDocument::fromJson(event).object()
+                                .value(QStringLiteral("choices")).toArray().at(0).toObject()
+                                .value(QStringLiteral("delta")).toObject();
+        if (delta.value(QStringLiteral("content")).toString().isEmpty()) {
+            continue;
+        }
+
+        m_lastTokenAt = m_timer.elapsed();
+        if (m_firstTokenAt < 0) {
+            m_firstTokenAt = m_lastTokenAt;
+        }
+        ++m_tokenChunks;
+    }
+}
+
+void ModelProbe::finishSample()
+{
+    m_firstTokenTimes.append(double(m_firstTokenAt));
+
+    // The rate only counts the chunks after the first, over the time they took
+    double rate = -1;
+    if (m_tokenChunks > 1 && m_lastTokenAt > m_firstTokenAt) {
+        rate = (m_tokenChunks - 1) * 1000.0 / double(m_lastTokenAt - m_firstTokenAt);
+    }
+    m_tokenRates.append(rate);
+}
+
+void ModelProbe::finishModel(const QString &error)
+{
+    Result result;
+    result.model = m_models.takeFirst();
+    result.error = error;
+    if (error.isEmpty()) {
+        result.connectMs = median(m_connectTimes);
+        result.firstTokenMs = median(m_firstTokenTimes);
+        result.tokensPerSecond = median(m_tokenRates);
+    } else {
+        qWarning() << "ModelProbe: Probing" << result.model << "failed:" << error;
+    }
+
+    m_connectTimes.clear();
+    m_firstTokenTimes.clear();
+    m_tokenRates.clear();
+
+    Q_EMIT resultReady(result);
+
+    if (m_models.isEmpty()) {
+        Q_EMIT finished();
+    } else {
+        nextSample();
+    }
+}
+
+QNetworkRequest ModelProbe::request(const QString &url) const
+{
+    QNetworkRequest networkRequest{QUrl(url)};
+    if (!m_apiKey.isEmpty()) {
+        networkRequest.setRawHeader(QByteArrayLiteral("Authorization"), QStringLiteral("Bearer %1").arg(m_apiKey).toUtf8());
+    }
+    networkRequest.setTransferTimeout(PROBE_TIMEOUT);
+    return networkRequest;
+}
+
+QString ModelProbe::errorMessage(QNetworkReply *reply, const QByteArray &body)
+{
+    // OpenAI-style {"error": {"message": "..."}}
+    QString message = QJsonDocument::fromJson(body).object()
+                          .value(QStringLiteral("error")).toObject()
+                          .value(QStringLiteral("message")).toString();
+    if (message.isEmpty()) {
+        message = reply->errorString();
+    }
+
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    return status > 0 ? QStringLiteral("HTTP %1: %2").arg(status).arg(message) : message;
+}
+
+double ModelProbe::median(QVector<double> values)
+{
+    values.erase(std::remove_if(values.begin(), values.end(), [](double value) { return value < 0; }), values.end());
+    if (values.isEmpty()) {
+        return -1;
+    }
+
+    std::sort(values.begin(), values.end());
+    int middle = values.size() / 2;
+    return values.size() % 2 ? values.at(middle) : (values.at(middle - 1) + values.at(middle)) / 2;
+}
+
+#include "moc_modelprobe.cpp"
@@ -0,0 +1,188 @@
+/*
+ *  SPDX-FileCopyrightText: 2025 WarpKate Team <warpkate@example.com>
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef WARPKATE_MODELPROBE_H
+#define WARPKATE_MODELPROBE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QNetworkReply;
+
+/**
+ * @brief Measures the latency of the models of an OpenAI-compatible endpoint
+ *
+ * Each sample of a model takes two requests:
+ *
+ * - a GET of the models list on a fresh connection, timing DNS, TCP and
+ *   TLS setup plus the first response byte (the connect time)
+ * - a tiny streamed completion on the now warm connection, timing the
+ *   first content chunk (time to first token) and the rate of the chunks
+ *   after it (tokens per second, one chunk being about one token)
+ *
+ * A few samples are taken per model and the medians reported, so a single
+ * slow request doesn't decide which model looks fastest. Models are
+ * probed one after another, never in parallel, so they don't compete for
+ * the same connection.
+ */
+class ModelProbe : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Medians measured for one model
+     */
+    struct Result {
+        QString model;                  ///< Model ID
+        double connectMs = -1;          ///< Connect time in ms, -1 if unknown
+        double firstTokenMs = -1;       ///< Time to first token in ms, -1 if unknown
+        double tokensPerSecond = -1;    ///< Streaming rate, -1 if unknown
+        QString error;                  ///< Why the probe failed, empty on success
+    };
+
+    /**
+     * Constructor
+     * @param parent QObject parent
+     */
+    explicit ModelProbe(QObject *parent = nullptr);
+
+    /**
+     * Destructor, aborts a running probe
+     */
+    ~ModelProbe() override;
+
+    /**
+     * Set the chat completions endpoint
+     * @param endpoint URL ending in /chat/completions
+     */
+    void setEndpoint(const QString &endpoint);
+
+    /**
+     * Set the API key sent as bearer token
+     * @param apiKey API key, may be empty for local servers
+     */
+    void setApiKey(const QString &apiKey);
+
+    /**
+     * Probe models one after another
+     *
+     * Emits resultReady() for every model and finished() after the last.
+     * A running probe is cancelled first.
+     *
+     * @param models Model IDs
+     * @param samples Samples per model
+     */
+    void start(const QStringList &models, int samples = 3);
+
+    /**
+     * Abort the running probe; finished() is not emitted
+     */
+    void cancel();
+
+    /**
+     * Check whether a probe is running
+     * @return True between start() and finished()
+     */
+    bool isRunning() const;
+
+    /**
+     * Derive the models list URL from a chat completions endpoint
+     * @param endpoint Chat completions endpoint
+     * @return URL of the models list
+     */
+    static QString modelsUrl(const QString &endpoint);
+
+Q_SIGNALS:
+    /**
+     * Emitted when all samples of a model are taken
+     * @param result Medians of the model
+     */
+    void resultReady(const ModelProbe::Result &result);
+
+    /**
+     * Emitted after the last model
+     */
+    void finished();
+
+private:
+    /**
+     * Start the next sample, or the next model when all samples are taken
+     */
+    void nextSample();
+
+    /**
+     * Time the models list request on a fresh connection
+     */
+    void measureConnect();
+
+    /**
+     * Time the streamed completion
+     */
+    void measureCompletion();
+
+    /**
+     * Count the content chunks of newly received server-sent events
+     * @param data Received bytes
+     */
+    void parseEvents(const QByteArray &data);
+
+    /**
+     * Record the streaming measurements of the current sample
+     */
+    void finishSample();
+
+    /**
+     * Report the current model, failed or with the medians of its samples
+     * @param error Why it failed, empty on success
+     */
+    void finishModel(const QString &error = QString());
+
+    /**
+     * Get a request with the authorization and timeout set
+     * @param url Request URL
+     * @return Network request
+     */
+    QNetworkRequest request(const QString &url) const;
+
+    /**
+     * Describe why a request failed
+     * @param reply Failed reply
+     * @param body Response body, may hold an API error message
+     * @return Error message
+     */
+    static QString errorMessage(QNetworkReply *reply, const QByteArray &body);
+
+    /**
+     * Get the median of measurements
+     * @param values Measurements, unknown ones (negative) are ignored
+     * @return Median, -1 if nothing was measured
+     */
+    static double median(QVector<double> values);
+
+    QNetworkAccessManager m_networkManager;  ///< Own manager, so clearing its connections affects nothing else
+    QString m_endpoint;                      ///< Chat completions endpoint
+    QString m_apiKey;                        ///< Bearer token
+    QStringList m_models;                    ///< Models still to probe, current first
+    int m_samples;                           ///< Samples per model
+    QPointer<QNetworkReply> m_reply;         ///< Request in flight
+    QElapsedTimer m_timer;                   ///< Started when the request in flight was sent
+    QByteArray m_eventBuffer;                ///< Incomplete event line
+    qint64 m_firstTokenAt;                   ///< ms until the first content chunk, -1 before it
+    qint64 m_lastTokenAt;                    ///< ms until the latest content chunk
+    int m_tokenChunks;                       ///< Content chunks of the current sample
+    QVector<double> m_connectTimes;          ///< Connect times of the current model
+    QVector<double> m_firstTokenTimes;       ///< Times to first token of the current model
+    QVector<double> m_tokenRates;            ///< Streaming rates of the current model
+};
+
+#endif // WARPKATE_MODELPROBE_H
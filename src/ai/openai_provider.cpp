@@ -65,15 +65,30 @@ bool OpenAIProvider::isInitialized() const
 {
     return m_initialized;
 }
-// Improved generateResponse method with better error handling and timeout
 void OpenAIProvider::generateResponse(
     const QString &query, 
     const QString &contextInfo,
     std::function<void(const QString&, bool)> responseCallback
 )
+{
+    // Errors are shown like answers
+    generateResponse(query, contextInfo, QVariantMap(), responseCallback,
+        [responseCallback](const QString &errorMessage) {
+            responseCallback(errorMessage, true);
+        });
+}
+
+// Improved generateResponse method with better error handling and timeout
+void OpenAIProvider::generateResponse(
+    const QString &query,
+    const QString &contextInfo,
+    const QVariantMap &parameters,
+    std::function<void(const QString&, bool)> responseCallback,
+    std::function<void(const QString&)> errorCallback
+)
 {
     if (!isInitialized()) {
-        responseCallback(QStringLiteral("Error: OpenAI provider not initialized. Please set API key."), true);
+        errorCallback(QStringLiteral("Error: OpenAI provider not initialized. Please set API key."));
         return;
     }
     
@@ -92,7 +107,7 @@ void OpenAIProvider::generateResponse(
     request.setSslConfiguration(sslConfig);
     
     // Create the JSON payload
-    QJsonObject payload = createRequestPayload(query, contextInfo);
+    QJsonObject payload = createRequestPayload(query, contextInfo, parameters);
     QJsonDocument doc(payload);
     QByteArray jsonData = doc.toJson();
     
@@ -132,19 +147,20 @@ void OpenAIProvider::generateResponse(
         timer.stop();
         
         // Handle the response
-        this->handleNetworkReply(reply, responseCallback);
+        this->handleNetworkReply(reply, responseCallback, errorCallback);
     } else {
         // Timer expired, meaning the request timed out
         reply->abort();
         QString errorMessage = QStringLiteral("Request to OpenAI API timed out after 15 seconds.");
         qWarning() << "OpenAI API request failed:" << errorMessage;
-        responseCallback(errorMessage, true);
+        errorCallback(errorMessage);
     }
     
     reply->deleteLater();
 }
 // Improved handleNetworkReply method with better error reporting
-void OpenAIProvider::handleNetworkReply(QNetworkReply *reply, std::function<void(const QString&, bool)> callback)
+void OpenAIProvider::handleNetworkReply(QNetworkReply *reply, std::function<void(const QString&, bool)> callback,
+                                        std::function<void(const QString&)> errorCallback)
 {
     if (reply->error() != QNetworkReply::NoError) {
         // Read the response data even in case of error, as it might contain useful information
@@ -182,7 +198,7 @@ void OpenAIProvider::handleNetworkReply(QNetworkReply *reply, std::function<void
         }
         
         qWarning() << "OpenAI API request failed:" << errorMessage;
-        callback(errorMessage, true);
+        errorCallback(errorMessage);
         return;
     }
     
@@ -201,7 +217,7 @@ void OpenAIProvider::handleNetworkReply(QNetworkReply *reply, std::function<void
             errorMessage += QStringLiteral(" Response: %1").arg(responseText);
         }
         qWarning() << errorMessage;
-        callback(errorMessage, true);
+        errorCallback(errorMessage);
         return;
     }
     
@@ -211,7 +227,7 @@ void OpenAIProvider::handleNetworkReply(QNetworkReply *reply, std::function<void
     if (jsonObject.contains(QStringLiteral("error"))) {
         QString errorMessage = formatErrorMessage(jsonObject[QStringLiteral("error")].toObject());
         qWarning() << "OpenAI API error:" << errorMessage;
-        callback(errorMessage, true);
+        errorCallback(errorMessage);
         return;
     }
     
@@ -222,7 +238,7 @@ void OpenAIProvider::handleNetworkReply(QNetworkReply *reply, std::function<void
     if (content.isEmpty()) {
         QString errorMessage = QStringLiteral("No response content found in OpenAI API response.");
         qWarning() << errorMessage;
-        callback(errorMessage, true);
+        errorCallback(errorMessage);
         return;
     }
     
@@ -230,7 +246,7 @@ void OpenAIProvider::handleNetworkReply(QNetworkReply *reply, std::function<void
     callback(content, true);
 }
 
-QJsonObject OpenAIProvider::createRequestPayload(const QString &query, const QString &contextInfo)
+QJsonObject OpenAIProvider::createRequestPayload(const QString &query, const QString &contextInfo, const QVariantMap &parameters)
 {
     QJsonObject payload;
     
@@ -238,8 +254,8 @@ QJsonObject OpenAIProvider::createRequestPayload(const QString &query, const QSt
     payload[QStringLiteral("model")] = m_model;
     
     // Set parameters
-    payload[QStringLiteral("temperature")] = m_temperature;
-    payload[QStringLiteral("max_tokens")] = m_maxTokens;
+    payload[QStringLiteral("temperature")] = parameters.value(QStringLiteral("temperature"), m_temperature).toDouble();
+    payload[QStringLiteral("max_tokens")] = parameters.value(QStringLiteral("max_tokens"), m_maxTokens).toInt();
     
     // Create messages array
     QJsonArray messages;
@@ -345,6 +361,17 @@ void OpenAIProvider::setModelParameters(const QVariantMap &parameters)
         }
     }
     
+    // Update the endpoint if present, for OpenAI-compatible servers
+    if (parameters.contains(QStringLiteral("endpoint"))) {
+        QUrl endpoint(parameters[QStringLiteral("endpoint")].toString());
+        if (endpoint.isValid() && (endpoint.scheme() == QLatin1String("http") || endpoint.scheme() == QLatin1String("https"))) {
+            m_apiEndpoint = endpoint.toString();
+            qDebug() << "Endpoint set to:" << m_apiEndpoint;
+        } else {
+            qWarning() << "Invalid endpoint:" << endpoint << "Using:" << m_apiEndpoint;
+        }
+    }
+    
     // Update temperature if present (should be between 0.0 and 2.0)
     if (parameters.contains(QStringLiteral("temperature"))) {
         double temp = parameters[QStringLiteral("temperature")].toDouble();
@@ -59,6 +59,23 @@ public:
         std::function<void(const QString&, bool)> responseCallback
     ) override;
     
+    /**
+     * Generate a response via the OpenAI API with parameters of its own
+     * 
+     * @param query User's query
+     * @param contextInfo Additional context
+     * @param parameters temperature and max_tokens for this request only
+     * @param responseCallback Callback for receiving response chunks
+     * @param errorCallback Callback for receiving an error message instead
+     */
+    void generateResponse(
+        const QString &query,
+        const QString &contextInfo,
+        const QVariantMap &parameters,
+        std::function<void(const QString&, bool)> responseCallback,
+        std::function<void(const QString&)> errorCallback
+    ) override;
+    
     /**
      * Set the API key for OpenAI
      * @param apiKey OpenAI API key
@@ -88,16 +105,19 @@ private:
      * Handle network reply from API request
      * @param reply Network reply object
      * @param callback Response callback
+     * @param errorCallback Error callback
      */
-    void handleNetworkReply(QNetworkReply *reply, std::function<void(const QString&, bool)> callback);
+    void handleNetworkReply(QNetworkReply *reply, std::function<void(const QString&, bool)> callback,
+                            std::function<void(const QString&)> errorCallback);
     
     /**
      * Create request payload in OpenAI format
      * @param query User query
      * @param contextInfo Context information
+     * @param parameters Overrides of temperature and max_tokens
      * @return JSON object with formatted request
      */
-    QJsonObject createRequestPayload(const QString &query, const QString &contextInfo);
+    QJsonObject createRequestPayload(const QString &query, const QString &contextInfo, const QVariantMap &parameters);
     
     /**
      * Extract content from OpenAI API response
@@ -0,0 +1,496 @@
+/*
+ *  SPDX-FileCopyrightText: 2025 WarpKate Team <warpkate@example.com>
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "semanticindex.h"
+
+#include <KConfigGroup>
+#include <KSharedConfig>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLockFile>
+#include <QMutex>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Defaults for the embedding endpoint, an OpenAI-compatible local server
+static const QString DEFAULT_ENDPOINT = QStringLiteral("http://localhost:11434/v1/embeddings");
+static const QString DEFAULT_MODEL = QStringLiteral("nomic-embed-text");
+
+// Embedding requests give up after this long (ms)
+static const int EMBEDDING_TIMEOUT = 10000;
+
+// Output embedded with a command and kept as its excerpt (characters)
+static const int MAX_EMBEDDED_OUTPUT = 2000;
+static const int MAX_EXCERPT = 300;
+
+// Commands finishing faster than they can be embedded are not indexed
+static const int MAX_PENDING_EMBEDDINGS = 8;
+
+// Vectors are zero padded to a multiple of the widest SIMD register (bytes)
+static const int VECTOR_ALIGNMENT = 32;
+
+// Matches less similar than this are not worth adding to the AI context
+static const float MIN_CONTEXT_SCORE = 0.5f;
+
+// How long an append waits for another one to finish (ms)
+static const int LOCK_TIMEOUT = 5000;
+
+// Vector file: a header, then one record per command
+struct VectorFileHeader {
+    char magic[4];              // "WKVI"
+    quint32 version;
+    quint32 dimension;          // Padded dimension
+    quint32 recordSize;         // sizeof(VectorRecordHeader) + dimension
+};
+
+struct VectorRecordHeader {
+    qint64 entryOffset;         // Offset of the entry in the entry file
+    float scale;                // Restores the normalized values
+    quint32 reserved;
+};
+
+static const char VECTOR_FILE_MAGIC[4] = {'W', 'K', 'V', 'I'};
+static const quint32 VECTOR_FILE_VERSION = 1;
+
+static SemanticIndex *s_instance = nullptr;
+
+/**
+ * Dot product of two int8 vectors
+ * @param a First vector
+ * @param b Second vector
+ * @param length Length, a multiple of VECTOR_ALIGNMENT
+ * @return Exact integer dot product
+ */
+static qint32 dotProduct(const qint8 *a, const qint8 *b, int length)
+{
+#if defined(__AVX2__)
+    // Widen 16 bytes at a time to 16 bits, multiply and add pairs into 32 bits
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < length; i += 16) {
+        __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+        __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(va, vb));
+    }
+    __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(1, 0, 3, 2)));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(total);
+#elif defined(__SSE2__)
+    // SSE2 has no sign extension: interleave each byte with its sign mask
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    for (int i = 0; i < length; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        __m128i signA = _mm_cmpgt_epi8(zero, va);
+        __m128i signB = _mm_cmpgt_epi8(zero, vb);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(va, signA), _mm_unpacklo_epi8(vb, signB)));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(va, signA), _mm_unpackhi_epi8(vb, signB)));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+#elif defined(__ARM_NEON)
+    // Products of int8 values fit in 16 bits; accumulate pairwise into 32
+    int32x4_t sum = vdupq_n_s32(0);
+    for (int i = 0; i < length; i += 16) {
+        int8x16_t va = vld1q_s8(a + i);
+        int8x16_t vb = vld1q_s8(b + i);
+        sum = vpadalq_s16(sum, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+        sum = vpadalq_s16(sum, vmull_s8(vget_high_s8(va), vget_high_s8(vb)));
+    }
+    return vgetq_lane_s32(sum, 0) + vgetq_lane_s32(sum, 1) + vgetq_lane_s32(sum, 2) + vgetq_lane_s32(sum, 3);
+#else
+    qint32 sum = 0;
+    for (int i = 0; i < length; ++i) {
+        sum += qint32(a[i]) * qint32(b[i]);
+    }
+    return sum;
+#endif
+}
+
+/**
+ * Get the WarpKate settings
+ * @return Config group
+ */
+static KConfigGroup settings()
+{
+    return KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+}
+
+/**
+ * Get a string setting, falling back to the default when left empty
+ * @param key Config key
+ * @param defaultValue Default value
+ * @return Value
+ */
+static QString stringSetting(const char *key, const QString &defaultValue)
+{
+    QString value = settings().readEntry(key, defaultValue).trimmed();
+    return value.isEmpty() ? defaultValue : value;
+}
+
+SemanticIndex &SemanticIndex::instance()
+{
+    if (!s_instance) {
+        s_instance = new SemanticIndex();
+    }
+    return *s_instance;
+}
+
+SemanticIndex::SemanticIndex(QObject *parent)
+    : QObject(parent)
+    , m_pendingEmbeddings(0)
+{
+}
+
+SemanticIndex::~SemanticIndex()
+{
+}
+
+bool SemanticIndex::isEnabled() const
+{
+    return settings().readEntry("SemanticHistorySearch", false);
+}
+
+void SemanticIndex::addCommand(const QString &command, const QString &output, const QString &directory, int exitCode)
+{
+    if (!isEnabled() || command.trimmed().isEmpty()) {
+        return;
+    }
+
+    // Repeated commands with the same output add nothing new
+    QString text = QStringLiteral("$ %1\n%2").arg(command, output.left(MAX_EMBEDDED_OUTPUT));
+    size_t hash = qHash(text);
+    if (m_indexedTexts.contains(hash)) {
+        return;
+    }
+
+    if (m_pendingEmbeddings >= MAX_PENDING_EMBEDDINGS) {
+        qDebug() << "SemanticIndex: Embedding endpoint is behind, not indexing" << command;
+        return;
+    }
+    m_indexedTexts.insert(hash);
+
+    Match match;
+    match.command = command;
+    match.directory = directory;
+    match.excerpt = output.left(MAX_EXCERPT).trimmed();
+    match.time = QDateTime::currentDateTime();
+    match.exitCode = exitCode;
+    match.score = 0.0f;
+
+    // The settings are only read here, the files are written off the GUI thread
+    QString vectorsPath = indexPath(QStringLiteral("vectors"));
+    QString entriesPath = indexPath(QStringLiteral("entries"));
+
+    ++m_pendingEmbeddings;
+    embed(text, [this, match, vectorsPath, entriesPath](const QVector<float> &embedding) {
+        --m_pendingEmbeddings;
+        if (!embedding.isEmpty()) {
+            // Nothing waits for the append; it only logs failures
+            (void)QtConcurrent::run(&SemanticIndex::append, vectorsPath, entriesPath, match, embedding);
+        }
+    });
+}
+
+void SemanticIndex::search(const QString &text, int count, QObject *context,
+                           std::function<void(const QList<Match> &)> callback)
+{
+    if (!isEnabled() || text.trimmed().isEmpty() || count <= 0) {
+        callback(QList<Match>());
+        return;
+    }
+
+    QPointer<QObject> guard(context);
+    QString vectorsPath = indexPath(QStringLiteral("vectors"));
+    QString entriesPath = indexPath(QStringLiteral("entries"));
+
+    embed(text, [this, guard, callback, count, vectorsPath, entriesPath](const QVector<float> &embedding) {
+        if (!guard) {
+            return;
+        }
+        if (embedding.isEmpty()) {
+            callback(QList<Match>());
+            return;
+        }
+
+        int paddedDimension = (embedding.size() + VECTOR_ALIGNMENT - 1) / VECTOR_ALIGNMENT * VECTOR_ALIGNMENT;
+        float queryScale = 1.0f;
+        QByteArray query = quantize(embedding, paddedDimension, &queryScale);
+
+        QFutureWatcher<QList<Match>> *watcher = new QFutureWatcher<QList<Match>>(this);
+        connect(watcher, &QFutureWatcher<QList<Match>>::finished, this, [watcher, guard, callback]() {
+            watcher->deleteLater();
+            if (guard) {
+                callback(watcher->result());
+            }
+        });
+        watcher->setFuture(QtConcurrent::run(&SemanticIndex::scoreIndex, vectorsPath, entriesPath, query, queryScale, count));
+    });
+}
+
+QString SemanticIndex::formatForContext(const QList<Match> &matches)
+{
+    QString context;
+    for (const Match &match : matches) {
+        if (match.score < MIN_CONTEXT_SCORE) {
+            continue;
+        }
+
+        if (context.isEmpty()) {
+            context = QStringLiteral("\nRelated commands from the terminal history:\n");
+        }
+        context += QStringLiteral("$ %1  (in %2, exit code %3)\n").arg(match.command, match.directory).arg(match.exitCode);
+        if (!match.excerpt.isEmpty()) {
+            context += match.excerpt + QLatin1Char('\n');
+        }
+    }
+    return context;
+}
+
+void SemanticIndex::embed(const QString &text, std::function<void(const QVector<float> &)> callback)
+{
+    QNetworkRequest request(QUrl(stringSetting("EmbeddingEndpoint", DEFAULT_ENDPOINT)));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/json"));
+    request.setTransferTimeout(EMBEDDING_TIMEOUT);
+
+    QJsonObject payload;
+    payload[QStringLiteral("model")] = stringSetting("EmbeddingModel", DEFAULT_MODEL);
+    payload[QStringLiteral("input")] = text;
+
+    QNetworkReply *reply = m_networkManager.post(request, QJsonDocument(payload).toJson(QJsonDocument::Compact));
+    connect(reply, &QNetworkReply::finished, this, [reply, callback]() {
+        reply->deleteLater();
+
+        QVector<float> embedding;
+        if (reply->error() != QNetworkReply::NoError) {
+            qWarning() << "SemanticIndex: Embedding request failed:" << reply->errorString();
+            callback(embedding);
+            return;
+        }
+
+        // OpenAI format {"data": [{"embedding": [...]}]}, or Ollama's native {"embedding": [...]}
+        QJsonObject response = QJsonDocument::fromJson(reply->readAll()).object();
+        QJsonArray values = response.value(QStringLiteral("data")).toArray().at(0).toObject().value(QStringLiteral("embedding")).toArray();
+        if (values.isEmpty()) {
+            values = response.value(QStringLiteral("embedding")).toArray();
+        }
+
+        embedding.reserve(values.size());
+        for (const QJsonValue &value : std::as_const(values)) {
+            embedding.append(float(value.toDouble()));
+        }
+        if (embedding.isEmpty()) {
+            qWarning() << "SemanticIndex: Embedding response contained no embedding";
+        }
+        callback(embedding);
+    });
+}
+
+void SemanticIndex::append(const QString &vectorsPath, const QString &entriesPath,
+                           const Match &match, const QVector<float> &embedding)
+{
+    QDir().mkpath(QFileInfo(vectorsPath).absolutePath());
+
+    // A record points into the entry file by offset, so appends must not
+    // interleave: the mutex orders this process' threads, the lock file
+    // other Kate instances
+    static QMutex mutex;
+    QMutexLocker locker(&mutex);
+    QLockFile lock(vectorsPath + QStringLiteral(".lock"));
+    if (!lock.tryLock(LOCK_TIMEOUT)) {
+        qWarning() << "SemanticIndex: Index is locked, not indexing" << match.command;
+        return;
+    }
+
+    int paddedDimension = (embedding.size() + VECTOR_ALIGNMENT - 1) / VECTOR_ALIGNMENT * VECTOR_ALIGNMENT;
+
+    QFile vectors(vectorsPath);
+    if (!vectors.open(QIODevice::ReadWrite)) {
+        qWarning() << "SemanticIndex: Could not open" << vectorsPath;
+        return;
+    }
+
+    VectorFileHeader header;
+    bool valid = vectors.read(reinterpret_cast<char *>(&header), sizeof(header)) == sizeof(header)
+                 && memcmp(header.magic, VECTOR_FILE_MAGIC, sizeof(header.magic)) == 0
+                 && header.version == VECTOR_FILE_VERSION
+                 && header.dimension == quint32(paddedDimension);
+    if (!valid) {
+        // New index, or the endpoint now serves a different model under the same name
+        if (vectors.size() > 0) {
+            qWarning() << "SemanticIndex: Index does not match the embeddings, starting a new one";
+        }
+        vectors.resize(0);
+        QFile::remove(entriesPath);
+
+        memcpy(header.magic, VECTOR_FILE_MAGIC, sizeof(header.magic));
+        header.version = VECTOR_FILE_VERSION;
+        header.dimension = quint32(paddedDimension);
+        header.recordSize = quint32(sizeof(VectorRecordHeader) + paddedDimension);
+        vectors.seek(0);
+        vectors.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    // The entry goes first, so a record never points past the entry file
+    QFile entries(entriesPath);
+    if (!entries.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "SemanticIndex: Could not open" << entriesPath;
+        return;
+    }
+    VectorRecordHeader record;
+    record.entryOffset = entries.size();
+    record.reserved = 0;
+
+    QDataStream stream(&entries);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << match.time << match.command << match.directory << qint32(match.exitCode) << match.excerpt;
+    entries.close();
+
+    // One write per record, so concurrent searches see whole records only
+    QByteArray values = quantize(embedding, paddedDimension, &record.scale);
+    QByteArray data(reinterpret_cast<const char *>(&record), sizeof(record));
+    data.append(values);
+    vectors.seek(vectors.size());
+    vectors.write(data);
+}
+
+QString SemanticIndex::indexPath(const QString &suffix) const
+{
+    // One index per model, their vectors are not comparable
+    QString model = stringSetting("EmbeddingModel", DEFAULT_MODEL);
+    QString key = QString::fromLatin1(QCryptographicHash::hash(model.toUtf8(), QCryptographicHash::Sha1).toHex().left(16));
+
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
+           + QStringLiteral("/warpkate/history-index/%1.%2").arg(key, suffix);
+}
+
+QByteArray SemanticIndex::quantize(const QVector<float> &embedding, int paddedDimension, float *scale)
+{
+    QByteArray values(paddedDimension, '\0');
+
+    // Normalized vectors make the dot product the cosine similarity
+    double norm = 0.0;
+    for (float value : embedding) {
+        norm += double(value) * value;
+    }
+    norm = std::sqrt(norm);
+    if (norm == 0.0) {
+        *scale = 1.0f;
+        return values;
+    }
+
+    float maximum = 0.0f;
+    for (float value : embedding) {
+        maximum = qMax(maximum, float(std::fabs(value / norm)));
+    }
+    *scale = maximum / 127.0f;
+
+    for (int i = 0; i < embedding.size(); ++i) {
+        values[i] = char(qRound(embedding.at(i) / norm / *scale));
+    }
+    return values;
+}
+
+QList<SemanticIndex::Match> SemanticIndex::scoreIndex(const QString &vectorsPath, const QString &entriesPath,
+                                                      const QByteArray &query, float queryScale, int count)
+{
+    QFile vectors(vectorsPath);
+    if (!vectors.open(QIODevice::ReadOnly) || vectors.size() < qint64(sizeof(VectorFileHeader))) {
+        return QList<Match>();
+    }
+
+    // Mapped, not read: only the page cache holds the vectors
+    qint64 fileSize = vectors.size();
+    const uchar *data = vectors.map(0, fileSize);
+    if (!data) {
+        qWarning() << "SemanticIndex: Could not map" << vectorsPath;
+        return QList<Match>();
+    }
+
+    VectorFileHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, VECTOR_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != VECTOR_FILE_VERSION
+        || header.dimension != quint32(query.size()) || header.recordSize != sizeof(VectorRecordHeader) + header.dimension) {
+        vectors.unmap(const_cast<uchar *>(data));
+        return QList<Match>();
+    }
+
+    // Min-heap of the best (score, entry offset) pairs so far
+    using Candidate = std::pair<float, qint64>;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> best;
+
+    const qint8 *queryValues = reinterpret_cast<const qint8 *>(query.constData());
+    qint64 records = (fileSize - qint64(sizeof(header))) / header.recordSize;
+    for (qint64 i = 0; i < records; ++i) {
+        const uchar *record = data + sizeof(header) + i * header.recordSize;
+        VectorRecordHeader recordHeader;
+        memcpy(&recordHeader, record, sizeof(recordHeader));
+
+        const qint8 *values = reinterpret_cast<const qint8 *>(record + sizeof(recordHeader));
+        float score = float(dotProduct(values, queryValues, int(header.dimension))) * recordHeader.scale * queryScale;
+
+        if (int(best.size()) < count) {
+            best.push(Candidate(score, recordHeader.entryOffset));
+        } else if (score > best.top().first) {
+            best.pop();
+            best.push(Candidate(score, recordHeader.entryOffset));
+        }
+    }
+    vectors.unmap(const_cast<uchar *>(data));
+
+    // Only the winners' entries are read
+    QFile entries(entriesPath);
+    if (!entries.open(QIODevice::ReadOnly)) {
+        return QList<Match>();
+    }
+    QDataStream stream(&entries);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    QList<Match> matches;
+    while (!best.empty()) {
+        Candidate candidate = best.top();
+        best.pop();
+
+        Match match;
+        qint32 exitCode = 0;
+        entries.seek(candidate.second);
+        stream >> match.time >> match.command >> match.directory >> exitCode >> match.excerpt;
+        if (stream.status() != QDataStream::Ok) {
+            stream.resetStatus();
+            continue;
+        }
+        match.exitCode = exitCode;
+        match.score = candidate.first;
+        matches.prepend(match);
+    }
+
+    return matches;
+}
@@ -0,0 +1,172 @@
+/*
+ *  SPDX-FileCopyrightText: 2025 WarpKate Team <warpkate@example.com>
+ *  SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef WARPKATE_SEMANTICINDEX_H
+#define WARPKATE_SEMANTICINDEX_H
+
+#include <QDateTime>
+#include <QList>
+#include <QNetworkAccessManager>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+/**
+ * @brief Semantic search over the command history
+ *
+ * Every finished command (with the start of its output) is embedded by a
+ * local, OpenAI-compatible embedding endpoint (e.g. Ollama or a
+ * llama.cpp server) and appended to an on-disk index:
+ *
+ * - a vector file of int8-quantized, normalized embeddings, one
+ *   fixed-size record each, memory-mapped when searching
+ * - an entry file with the command, directory and output excerpt, only
+ *   read for the top matches
+ *
+ * A search embeds the query, then scores every record with SIMD int8 dot
+ * products on a worker thread and keeps the top k. Brute force is fast
+ * enough here: a year of history is some 100k records, scanned in a few
+ * milliseconds, and nothing but the k results is kept in memory.
+ *
+ * Each embedding model gets its own index. The class follows the
+ * singleton pattern and should be accessed through the instance() method.
+ */
+class SemanticIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * A command found by a search
+     */
+    struct Match {
+        QString command;            ///< Command line
+        QString directory;          ///< Working directory it ran in
+        QString excerpt;            ///< Start of its output
+        QDateTime time;             ///< When it finished
+        int exitCode;               ///< Its exit code
+        float score;                ///< Cosine similarity to the query
+    };
+
+    /**
+     * Get the singleton instance of the semantic index
+     * @return Reference to the semantic index
+     */
+    static SemanticIndex &instance();
+
+    /**
+     * Check whether semantic history search is enabled in the settings
+     * @return True if commands are indexed and searches run
+     */
+    bool isEnabled() const;
+
+    /**
+     * Index a finished command in the background
+     *
+     * Does nothing when disabled, for empty commands and for commands with
+     * the same output already indexed in this session.
+     *
+     * @param command Command line
+     * @param output Command output
+     * @param directory Working directory
+     * @param exitCode Exit code
+     */
+    void addCommand(const QString &command, const QString &output, const QString &directory, int exitCode);
+
+    /**
+     * Find the commands most similar to a text
+     *
+     * The callback runs on the main thread, with an empty list if the
+     * search is disabled or the embedding endpoint is unreachable. It is
+     * not called if the context object was destroyed in the meantime.
+     *
+     * @param text Query, e.g. a command or a question
+     * @param count Number of matches wanted
+     * @param context Object the callback belongs to
+     * @param callback Receives the matches, best first
+     */
+    void search(const QString &text, int count, QObject *context,
+                std::function<void(const QList<Match> &)> callback);
+
+    /**
+     * Format matches for the AI context
+     * @param matches Matches of a search
+     * @return Context section, empty if there are no matches
+     */
+    static QString formatForContext(const QList<Match> &matches);
+
+private:
+    /**
+     * Private constructor (singleton pattern)
+     * @param parent QObject parent
+     */
+    explicit SemanticIndex(QObject *parent = nullptr);
+
+    /**
+     * Destructor
+     */
+    ~SemanticIndex() override;
+
+    /**
+     * Request an embedding from the configured endpoint
+     * @param text Text to embed
+     * @param callback Receives the embedding, empty on failure
+     */
+    void embed(const QString &text, std::function<void(const QVector<float> &)> callback);
+
+    /**
+     * Append an embedded command to the index files; runs on a worker thread
+     *
+     * Other threads and Kate instances appending to the same index wait
+     * for a lock file next to the vector file.
+     *
+     * @param vectorsPath Vector file
+     * @param entriesPath Entry file
+     * @param match Command to store (score unused)
+     * @param embedding Its embedding
+     */
+    static void append(const QString &vectorsPath, const QString &entriesPath,
+                       const Match &match, const QVector<float> &embedding);
+
+    /**
+     * Get the path of the index files for the configured model
+     * @param suffix File suffix, "vectors" or "entries"
+     * @return Absolute path
+     */
+    QString indexPath(const QString &suffix) const;
+
+    /**
+     * Normalize and quantize an embedding to int8
+     * @param embedding Embedding
+     * @param paddedDimension Length of the result, zero padded
+     * @param scale Receives the factor restoring the normalized values
+     * @return Quantized values
+     */
+    static QByteArray quantize(const QVector<float> &embedding, int paddedDimension, float *scale);
+
+    /**
+     * Score all records against a query and read the best entries; runs on a worker thread
+     * @param vectorsPath Vector file
+     * @param entriesPath Entry file
+     * @param query Quantized query
+     * @param queryScale Scale of the query
+     * @param count Number of matches wanted
+     * @return Matches, best first
+     */
+    static QList<Match> scoreIndex(const QString &vectorsPath, const QString &entriesPath,
+                                   const QByteArray &query, float queryScale, int count);
+
+    // Disable copy construction and assignment
+    SemanticIndex(const SemanticIndex &) = delete;
+    SemanticIndex &operator=(const SemanticIndex &) = delete;
+
+    QNetworkAccessManager m_networkManager;  ///< Talks to the embedding endpoint
+    QSet<size_t> m_indexedTexts;             ///< Hashes of texts indexed this session
+    int m_pendingEmbeddings;                 ///< Indexing requests in flight
+};
+
+#endif // WARPKATE_SEMANTICINDEX_H
@@ -4,6 +4,10 @@
  */
 
 #include "warpkatepreferencesdialog.h"
+#include "terminal/terminalbackend.h"
+#include "terminal/blockhistory.h"
+#include "ai/aiprovider.h"
+#include "ai/modelprobe.h"
 
 #include <KLocalizedString>
 #include <KConfigGroup>
@@ -13,14 +17,19 @@
 #include <QHBoxLayout>
 #include <QFormLayout>
 #include <QGroupBox>
+#include <QHeaderView>
+#include <QTableWidget>
 #include <QLabel>
 #include <QFileDialog>
 #include <QStandardPaths>
 #include <QDebug>
 
+#include <memory>
+
 WarpKatePreferencesDialog::WarpKatePreferencesDialog(QWidget *parent)
     : QDialog(parent)
     , m_changed(false)
+    , m_modelProbe(new ModelProbe(this))
 {
     setWindowTitle(i18n("WarpKate Preferences"));
     setMinimumSize(550, 450);
@@ -147,11 +156,147 @@ void WarpKatePreferencesDialog::setupUI()
     responseForm->addRow(creativityLabel, m_responseCreativitySlider);
     
     assistantLayout->addWidget(responseGroupBox);
+    
+    QGroupBox *historyGroupBox = new QGroupBox(i18n("History Search"));
+    QFormLayout *historyForm = new QFormLayout(historyGroupBox);
+    
+    m_semanticSearchCheck = new QCheckBox(i18n("Search command history by meaning"));
+    m_semanticSearchCheck->setToolTip(i18n("Embed finished commands with a local embedding server, "
+                                           "add similar past commands to AI queries and enable Find Similar Commands."));
+    historyForm->addRow(QString(), m_semanticSearchCheck);
+    
+    QLabel *embeddingEndpointLabel = new QLabel(i18n("Embedding Endpoint:"));
+    m_embeddingEndpointEdit = new QLineEdit();
+    m_embeddingEndpointEdit->setPlaceholderText(QStringLiteral("http://localhost:11434/v1/embeddings"));
+    m_embeddingEndpointEdit->setToolTip(i18n("OpenAI-compatible embeddings URL, e.g. of Ollama or a llama.cpp server"));
+    historyForm->addRow(embeddingEndpointLabel, m_embeddingEndpointEdit);
+    
+    QLabel *embeddingModelLabel = new QLabel(i18n("Embedding Model:"));
+    m_embeddingModelEdit = new QLineEdit();
+    m_embeddingModelEdit->setPlaceholderText(QStringLiteral("nomic-embed-text"));
+    historyForm->addRow(embeddingModelLabel, m_embeddingModelEdit);
+    
+    assistantLayout->addWidget(historyGroupBox);
+    
+    QGroupBox *backgroundGroupBox = new QGroupBox(i18n("Background Assistance"));
+    QFormLayout *backgroundForm = new QFormLayout(backgroundGroupBox);
+    
+    m_explainFailuresCheck = new QCheckBox(i18n("Explain failed commands"));
+    m_explainFailuresCheck->setToolTip(i18n("Ask the AI why a command failed without waiting for a question. "
+                                            "Explanations of several failures are sent in one request."));
+    backgroundForm->addRow(QString(), m_explainFailuresCheck);
+    
+    assistantLayout->addWidget(backgroundGroupBox);
+    
+    QGroupBox *latencyGroupBox = new QGroupBox(i18n("Model Latency"));
+    QVBoxLayout *latencyLayout = new QVBoxLayout(latencyGroupBox);
+    
+    QLabel *latencyNote = new QLabel(i18n("Measure the configured endpoint with a few tiny streamed requests per model "
+                                          "to find the fastest model for interactive use. Values are medians."));
+    latencyNote->setWordWrap(true);
+    latencyLayout->addWidget(latencyNote);
+    
+    m_latencyTable = new QTableWidget(0, 4);
+    m_latencyTable->setHorizontalHeaderLabels({i18n("Model"), i18n("Connect"), i18n("First Token"), i18n("Tokens/s")});
+    m_latencyTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_latencyTable->verticalHeader()->hide();
+    m_latencyTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_latencyTable->setSelectionMode(QAbstractItemView::NoSelection);
+    latencyLayout->addWidget(m_latencyTable);
+    
+    m_measureLatencyButton = new QPushButton(i18n("Measure"));
+    QHBoxLayout *latencyButtonLayout = new QHBoxLayout();
+    latencyButtonLayout->addStretch();
+    latencyButtonLayout->addWidget(m_measureLatencyButton);
+    latencyLayout->addLayout(latencyButtonLayout);
+    
+    assistantLayout->addWidget(latencyGroupBox);
     assistantLayout->addStretch();
     
+    // Create Terminal tab
+    QWidget *terminalTab = new QWidget();
+    QVBoxLayout *terminalLayout = new QVBoxLayout(terminalTab);
+    
+    QGroupBox *engineGroupBox = new QGroupBox(i18n("Terminal Engine"));
+    QFormLayout *engineForm = new QFormLayout(engineGroupBox);
+    
+    QLabel *backendLabel = new QLabel(i18n("Backend:"));
+    m_terminalBackendCombo = new QComboBox();
+    m_terminalBackendCombo->addItem(i18n("WarpKate (built-in)"), TerminalBackendFactory::backendName(TerminalBackendType::Internal));
+    m_terminalBackendCombo->addItem(i18n("QTermWidget"), TerminalBackendFactory::backendName(TerminalBackendType::QTermWidget));
+    engineForm->addRow(backendLabel, m_terminalBackendCombo);
+    
+    // Only offer engines that were compiled into this build
+    if (!TerminalBackendFactory::isAvailable(TerminalBackendType::QTermWidget)) {
+        m_terminalBackendCombo->setItemData(1, false, Qt::UserRole - 1); // Disable the item
+        m_terminalBackendCombo->setItemText(1, i18n("QTermWidget (not available in this build)"));
+    }
+    
+    QLabel *backendNote = new QLabel(i18n("Changing the backend takes effect for new terminal sessions."));
+    backendNote->setWordWrap(true);
+    engineForm->addRow(QString(), backendNote);
+    
+    QGroupBox *inputGroupBox = new QGroupBox(i18n("Input"));
+    QVBoxLayout *inputLayout = new QVBoxLayout(inputGroupBox);
+    
+    m_predictiveEchoCheck = new QCheckBox(i18n("Show typed characters before the shell echoes them"));
+    m_predictiveEchoCheck->setToolTip(i18n("Predicted characters are drawn underlined and dimmed when the shell is slow to echo, "
+                                           "and removed if the shell echoes something else. Used at shell prompts (recognised from the shell integration, "
+                                           "or from how the prompt looks) and in programs reading a line; never at password prompts or in full-screen programs."));
+    inputLayout->addWidget(m_predictiveEchoCheck);
+    
+    QGroupBox *shellGroupBox = new QGroupBox(i18n("Shell"));
+    QVBoxLayout *shellLayout = new QVBoxLayout(shellGroupBox);
+    
+    m_cacheEnvironmentCheck = new QCheckBox(i18n("Cache project environments (direnv, nix, conda, venv)"));
+    m_cacheEnvironmentCheck->setToolTip(i18n("Capture the changes a project's activation makes to the environment once and apply them "
+                                             "to new shells and jobs. The cache is refreshed in the background when activation files change. "
+                                             "This runs the activation of every project you open, so only enable it if you trust them."));
+    shellLayout->addWidget(m_cacheEnvironmentCheck);
+    
+    m_shellIntegrationCheck = new QCheckBox(i18n("Enable shell integration (bash, zsh)"));
+    m_shellIntegrationCheck->setToolTip(i18n("Start the shell with hooks that mark prompts and commands (OSC 133) and report "
+                                             "each command, its exit status and directory over a separate pipe. "
+                                             "Your own startup files are still read."));
+    shellLayout->addWidget(m_shellIntegrationCheck);
+    
+    m_profileStartupCheck = new QCheckBox(i18n("Profile shell startup files"));
+    m_profileStartupCheck->setToolTip(i18n("Trace the startup files of new shells and report the time spent in each one. "
+                                           "Slows startup down a little while enabled."));
+    shellLayout->addWidget(m_profileStartupCheck);
+    
+    m_showGitStatusCheck = new QCheckBox(i18n("Show git status in command headers"));
+    m_showGitStatusCheck->setToolTip(i18n("Show branch, changes and ahead/behind counts next to each command. "
+                                          "The status is computed in the background, so the git segment of your prompt can be removed."));
+    shellLayout->addWidget(m_showGitStatusCheck);
+    
+    m_persistHistoryCheck = new QCheckBox(i18n("Keep finished blocks on disk"));
+    m_persistHistoryCheck->setToolTip(i18n("Store commands and their output in the WarpKate data directory. "
+                                           "Repeated output is stored once, so re-running builds and tests adds little. "
+                                           "Switching this off deletes the stored blocks."));
+    shellLayout->addWidget(m_persistHistoryCheck);
+    
+    m_directoryJumpCheck = new QCheckBox(i18n("Jump to frequent directories with z"));
+    m_directoryJumpCheck->setToolTip(i18n("Rank the directories you cd into by frequency and recency. "
+                                          "\"z proj src\" changes to the best match, and directory arguments of cd complete from them. "
+                                          "Needs shell integration; a z alias or function of your own, e.g. zoxide's, takes precedence."));
+    shellLayout->addWidget(m_directoryJumpCheck);
+    
+    m_searchBlocksCheck = new QCheckBox(i18n("Show rg results in a search block"));
+    m_searchBlocksCheck->setToolTip(i18n("Run plain rg searches outside the terminal and list their matches by file as they are found. "
+                                         "Clicking a match opens it in the editor. Needs shell integration; "
+                                         "an rg alias or function in the shell is always left to the shell."));
+    shellLayout->addWidget(m_searchBlocksCheck);
+    
+    terminalLayout->addWidget(engineGroupBox);
+    terminalLayout->addWidget(inputGroupBox);
+    terminalLayout->addWidget(shellGroupBox);
+    terminalLayout->addStretch();
+    
     // Add tabs to tab widget
     m_tabWidget->addTab(obsidianTab, i18n("Obsidian Integration"));
     m_tabWidget->addTab(assistantTab, i18n("AI Assistant"));
+    m_tabWidget->addTab(terminalTab, i18n("Terminal"));
     
     // Create button box
     m_buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Apply | QDialogButtonBox::Cancel | QDialogButtonBox::Reset);
@@ -176,6 +321,57 @@ void WarpKatePreferencesDialog::setupUI()
     connect(m_customResponseStyleCheck, &QCheckBox::toggled, this, [this]() { m_changed = true; });
     connect(m_responseDetailSlider, &QSlider::valueChanged, this, [this]() { m_changed = true; });
     connect(m_responseCreativitySlider, &QSlider::valueChanged, this, [this]() { m_changed = true; });
+    connect(m_semanticSearchCheck, &QCheckBox::toggled, this, [this]() { m_changed = true; });
+    connect(m_embeddingEndpointEdit, &QLineEdit::textChanged, this, [this]() { m_changed = true; });
+    connect(m_embeddingModelEdit, &QLineEdit::textChanged, this, [this]() { m_changed = true; });
+    connect(m_explainFailuresCheck, &QCheckBox::toggled, this, [this]() { m_changed = true; });
+    connect(m_terminalBackendCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this]() { m_changed = true; });
+    connect(m_predictiveEchoCheck, &QCheckBox::toggled, this, [this]() { m_changed = true; });
+    connect(m_cacheEnvironmentCheck, &QCheckBox::toggled, this, [this]() { m_changed = true; });
+    connect(m_shellIntegrationCheck, &QCheckBox::toggled, this, [this]() { m_changed = true; });
+    connect(m_profileStartupCheck, &QCheckBox::toggled, this, [this]() { m_changed = true; });
+    connect(m_showGitStatusCheck, &QCheckBox::toggled, this, [this]() { m_changed = true; });
+    connect(m_persistHistoryCheck, &QCheckBox::toggled, this, [this]() { m_changed = true; });
+    connect(m_directoryJumpCheck, &QCheckBox::toggled, this, [this]() { m_changed = true; });
+    connect(m_searchBlocksCheck, &QCheckBox::toggled, this, [this]() { m_changed = true; });
+    
+    // The endpoint settings only matter when searching
+    connect(m_semanticSearchCheck, &QCheckBox::toggled, m_embeddingEndpointEdit, &QLineEdit::setEnabled);
+    connect(m_semanticSearchCheck, &QCheckBox::toggled, m_embeddingModelEdit, &QLineEdit::setEnabled);
+    
+    // Profiling relies on the integration scripts
+    connect(m_shellIntegrationCheck, &QCheckBox::toggled, m_profileStartupCheck, &QCheckBox::setEnabled);
+    
+    // Latency measurements, not settings; nothing to save
+    connect(m_measureLatencyButton, &QPushButton::clicked, this, &WarpKatePreferencesDialog::measureModelLatency);
+    connect(m_modelProbe, &ModelProbe::resultReady, this, [this](const ModelProbe::Result &result) {
+        const QList<QTableWidgetItem *> rows = m_latencyTable->findItems(result.model, Qt::MatchExactly);
+        if (rows.isEmpty()) {
+            return;
+        }
+        int row = rows.first()->row();
+        
+        auto format = [](double value, int precision, const QString &unit) {
+            if (value < 0) {
+                return i18nc("value not measured", "n/a");
+            }
+            QString number = QString::number(value, 'f', precision);
+            return unit.isEmpty() ? number : i18nc("value with unit", "%1 %2", number, unit);
+        };
+        if (result.error.isEmpty()) {
+            m_latencyTable->item(row, 1)->setText(format(result.connectMs, 0, i18nc("milliseconds", "ms")));
+            m_latencyTable->item(row, 2)->setText(format(result.firstTokenMs, 0, i18nc("milliseconds", "ms")));
+            m_latencyTable->item(row, 3)->setText(format(result.tokensPerSecond, 1, QString()));
+        } else {
+            for (int column = 1; column < m_latencyTable->columnCount(); ++column) {
+                m_latencyTable->item(row, column)->setText(i18n("failed"));
+                m_latencyTable->item(row, column)->setToolTip(result.error);
+            }
+        }
+    });
+    connect(m_modelProbe, &ModelProbe::finished, this, [this]() {
+        m_measureLatencyButton->setText(i18n("Measure"));
+    });
 }
 
 void WarpKatePreferencesDialog::browseObsidianVault()
@@ -206,6 +402,47 @@ void WarpKatePreferencesDialog::onCustomResponseStyleToggled(bool enabled)
     m_responseCreativitySlider->setEnabled(enabled);
 }
 
+void WarpKatePreferencesDialog::measureModelLatency()
+{
+    if (m_modelProbe->isRunning()) {
+        m_modelProbe->cancel();
+        m_measureLatencyButton->setText(i18n("Measure"));
+        return;
+    }
+    
+    // Probe what the assistant would use: the configured endpoint and key,
+    // the configured model first, then the others of the provider
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    QString endpoint = config.readEntry("APIEndpoint", QString());
+    if (!endpoint.isEmpty()) {
+        m_modelProbe->setEndpoint(endpoint);
+    }
+    m_modelProbe->setApiKey(config.readEntry("APIKey", QString()));
+    
+    QStringList models{config.readEntry("Model", QStringLiteral("gpt-3.5-turbo"))};
+    std::unique_ptr<AIServiceProvider> provider(
+        AIServiceProviderFactory::createProvider(static_cast<AIProviderType>(config.readEntry("AIModel", 1))));
+    if (provider) {
+        models += provider->availableModels();
+    }
+    models.removeDuplicates();
+    
+    m_latencyTable->setRowCount(0);
+    for (const QString &model : std::as_const(models)) {
+        int row = m_latencyTable->rowCount();
+        m_latencyTable->insertRow(row);
+        m_latencyTable->setItem(row, 0, new QTableWidgetItem(model));
+        for (int column = 1; column < m_latencyTable->columnCount(); ++column) {
+            QTableWidgetItem *item = new QTableWidgetItem(QStringLiteral("…"));
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            m_latencyTable->setItem(row, column, item);
+        }
+    }
+    
+    m_measureLatencyButton->setText(i18n("Cancel"));
+    m_modelProbe->start(models);
+}
+
 void WarpKatePreferencesDialog::apply()
 {
     if (m_changed) {
@@ -237,6 +474,25 @@ void WarpKatePreferencesDialog::defaults()
     m_responseCreativitySlider->setValue(3);
     m_aiIconCombo->setCurrentIndex(0); // Default icon
     
+    // History Search
+    m_semanticSearchCheck->setChecked(false);
+    m_embeddingEndpointEdit->setText(QStringLiteral("http://localhost:11434/v1/embeddings"));
+    m_embeddingModelEdit->setText(QStringLiteral("nomic-embed-text"));
+    
+    // Background Assistance
+    m_explainFailuresCheck->setChecked(false);
+    
+    // Terminal
+    m_terminalBackendCombo->setCurrentIndex(0); // Built-in backend
+    m_predictiveEchoCheck->setChecked(true);
+    m_cacheEnvironmentCheck->setChecked(false);
+    m_shellIntegrationCheck->setChecked(true);
+    m_profileStartupCheck->setChecked(false);
+    m_showGitStatusCheck->setChecked(true);
+    m_persistHistoryCheck->setChecked(false);
+    m_directoryJumpCheck->setChecked(true);
+    m_searchBlocksCheck->setChecked(true);
+    
     // Update dependent UI elements
     onCustomAssistantNameToggled(m_customAssistantNameCheck->isChecked());
     onCustomResponseStyleToggled(m_customResponseStyleCheck->isChecked());
@@ -273,6 +529,30 @@ void WarpKatePreferencesDialog::loadSettings()
     }
     m_aiIconCombo->setCurrentIndex(iconIndex);
     
+    // History Search
+    m_semanticSearchCheck->setChecked(config.readEntry("SemanticHistorySearch", false));
+    m_embeddingEndpointEdit->setText(config.readEntry("EmbeddingEndpoint", QStringLiteral("http://localhost:11434/v1/embeddings")));
+    m_embeddingModelEdit->setText(config.readEntry("EmbeddingModel", QStringLiteral("nomic-embed-text")));
+    m_embeddingEndpointEdit->setEnabled(m_semanticSearchCheck->isChecked());
+    m_embeddingModelEdit->setEnabled(m_semanticSearchCheck->isChecked());
+    
+    // Background Assistance
+    m_explainFailuresCheck->setChecked(config.readEntry("ExplainFailedCommands", false));
+    
+    // Terminal backend
+    QString backendName = TerminalBackendFactory::backendName(TerminalBackendFactory::configuredBackend());
+    int backendIndex = m_terminalBackendCombo->findData(backendName);
+    m_terminalBackendCombo->setCurrentIndex(backendIndex >= 0 ? backendIndex : 0);
+    m_predictiveEchoCheck->setChecked(config.readEntry("PredictiveLocalEcho", true));
+    m_cacheEnvironmentCheck->setChecked(config.readEntry("CacheShellEnvironment", false));
+    m_shellIntegrationCheck->setChecked(config.readEntry("ShellIntegration", true));
+    m_profileStartupCheck->setChecked(config.readEntry("ProfileShellStartup", false));
+    m_profileStartupCheck->setEnabled(m_shellIntegrationCheck->isChecked());
+    m_showGitStatusCheck->setChecked(config.readEntry("ShowGitStatus", true));
+    m_persistHistoryCheck->setChecked(config.readEntry("PersistBlockHistory", false));
+    m_directoryJumpCheck->setChecked(config.readEntry("DirectoryJump", true));
+    m_searchBlocksCheck->setChecked(config.readEntry("SearchBlocks", true));
+    
     // Update dependent UI elements
     onCustomAssistantNameToggled(m_customAssistantNameCheck->isChecked());
     onCustomResponseStyleToggled(m_customResponseStyleCheck->isChecked());
@@ -301,6 +581,29 @@ void WarpKatePreferencesDialog::saveSettings()
     // AI Icon
     config.writeEntry("AIButtonIcon", m_aiIconCombo->currentData().toString());
     
+    // History Search
+    config.writeEntry("SemanticHistorySearch", m_semanticSearchCheck->isChecked());
+    config.writeEntry("EmbeddingEndpoint", m_embeddingEndpointEdit->text());
+    config.writeEntry("EmbeddingModel", m_embeddingModelEdit->text());
+    
+    // Background Assistance
+    config.writeEntry("ExplainFailedCommands", m_explainFailuresCheck->isChecked());
+    
+    // Terminal
+    config.writeEntry("TerminalBackend", m_terminalBackendCombo->currentData().toString());
+    config.writeEntry("PredictiveLocalEcho", m_predictiveEchoCheck->isChecked());
+    config.writeEntry("CacheShellEnvironment", m_cacheEnvironmentCheck->isChecked());
+    config.writeEntry("ShellIntegration", m_shellIntegrationCheck->isChecked());
+    config.writeEntry("ProfileShellStartup", m_profileStartupCheck->isChecked());
+    config.writeEntry("ShowGitStatus", m_showGitStatusCheck->isChecked());
+    bool wasPersisting = config.readEntry("PersistBlockHistory", false);
+    config.writeEntry("PersistBlockHistory", m_persistHistoryCheck->isChecked());
+    if (wasPersisting && !m_persistHistoryCheck->isChecked()) {
+        BlockHistory::instance().clear();
+    }
+    config.writeEntry("DirectoryJump", m_directoryJumpCheck->isChecked());
+    config.writeEntry("SearchBlocks", m_searchBlocksCheck->isChecked());
+    
     // Sync changes to disk
     config.sync();
 }
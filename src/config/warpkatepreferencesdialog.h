@@ -16,6 +16,8 @@
 #include <QSlider>
 
 class QAbstractButton;
+class QTableWidget;
+class ModelProbe;
 
 /**
  * Preferences dialog for WarpKate plugin
@@ -66,6 +68,11 @@ private Q_SLOTS:
      */
     void onCustomResponseStyleToggled(bool enabled);
 
+    /**
+     * Start measuring the latency of the AI models, or cancel the measurement
+     */
+    void measureModelLatency();
+
 private:
     /**
      * Load settings from config
@@ -102,6 +109,30 @@ private:
     QSlider *m_responseDetailSlider;
     QSlider *m_responseCreativitySlider;
     QComboBox *m_aiIconCombo;
+
+    // History Search
+    QCheckBox *m_semanticSearchCheck;
+    QLineEdit *m_embeddingEndpointEdit;
+    QLineEdit *m_embeddingModelEdit;
+
+    // Background Assistance
+    QCheckBox *m_explainFailuresCheck;
+
+    // Model Latency
+    QPushButton *m_measureLatencyButton;
+    QTableWidget *m_latencyTable;
+    ModelProbe *m_modelProbe;
+
+    // Terminal
+    QComboBox *m_terminalBackendCombo;
+    QCheckBox *m_predictiveEchoCheck;
+    QCheckBox *m_cacheEnvironmentCheck;
+    QCheckBox *m_shellIntegrationCheck;
+    QCheckBox *m_profileStartupCheck;
+    QCheckBox *m_showGitStatusCheck;
+    QCheckBox *m_persistHistoryCheck;
+    QCheckBox *m_directoryJumpCheck;
+    QCheckBox *m_searchBlocksCheck;
 };
 
 #endif // WARPKATEPREFERENCESDIALOG_H
@@ -4,7 +4,22 @@
  */
 
 #include "warpkateview.h"
+#include "terminal/terminalbackend.h"
 #include "terminal/terminalemulator.h"
+#include "terminal/environmentcache.h"
+#include "terminal/fanoutrunner.h"
+#include "terminal/runbook.h"
+#include "terminal/blockhistory.h"
+#include "terminal/directoryindex.h"
+#include "terminal/ripgrepsearch.h"
+#include "terminal/gitstatuscache.h"
+#include "terminal/shellprofiler.h"
+#include "terminal/terminalgridwidget.h"
+#include "ai/semanticindex.h"
+#include "ui/conversationmodel.h"
+#include "ui/conversationtimeline.h"
+#include "ui/searchblockview.h"
+#include "ui/shelltokenizer.h"
 #include "warpkateplugin.h"
 #include "blockmodel.h"
 // Not using terminalblockview.h in simplified interface
@@ -15,6 +30,7 @@
 #include <KSharedConfig>
 #include <KConfigGroup>
 #include <KXMLGUIFactory>
+#include <KShell>
 
 #include <QAction>
 #include <QVBoxLayout>
@@ -30,12 +46,15 @@
 #include <QFontDatabase>
 #include <QEvent>
 #include <QKeyEvent>
-#include <QTextBlock>
 #include <QTextCharFormat>
 #include <QBrush>
 #include <QTimer>
+#include <QInputDialog>
 #include <QCoreApplication>
 #include <QFileInfo>
+#include <QSharedPointer>
+
+#include <algorithm>
 
 WarpKateView::WarpKateView(WarpKatePlugin *plugin, KTextEditor::MainWindow *mainWindow)
     : QObject(mainWindow)
@@ -44,11 +63,24 @@ WarpKateView::WarpKateView(WarpKatePlugin *plugin, KTextEditor::MainWindow *main
     , m_mainWindow(mainWindow)
     , m_toolView(nullptr)
     , m_terminalWidget(nullptr)
+    , m_conversation(nullptr)
     , m_conversationArea(nullptr)
+    , m_aiResponseRow(-1)
     , m_promptInput(nullptr)
     , m_toolbar(nullptr)
     , m_terminalEmulator(nullptr)
     , m_blockModel(nullptr)
+    , m_terminalDisplay(nullptr)
+    , m_promptPanel(nullptr)
+    , m_foregroundPollTimer(nullptr)
+    , m_rawInputMode(false)
+    , m_shellProfiler(nullptr)
+    , m_showGitStatus(true)
+    , m_fanOutRunner(nullptr)
+    , m_searchBlock(nullptr)
+    , m_searchBlockId(-1)
+    , m_searchRow(-1)
+    , m_runbookRunner(nullptr)
     , m_terminalVisible(false)
     , m_currentBlockId(-1)
     , m_aiService(nullptr)
@@ -57,13 +89,6 @@ WarpKateView::WarpKateView(WarpKatePlugin *plugin, KTextEditor::MainWindow *main
     setComponentName(QStringLiteral("warpkate"), i18n("WarpKate"));
     
     // Initialize UI components
-    // Create click feedback timer
-    m_clickFeedbackTimer = new QTimer(this);
-    m_clickFeedbackTimer->setSingleShot(true);
-    m_clickFeedbackTimer->setInterval(200); // 200ms flash
-    connect(m_clickFeedbackTimer, &QTimer::timeout, this, [this]() {
-        applyInteractiveElementStyles(); // Restore normal styles
-    });
     setupUI();
     
     // Initialize actions
@@ -172,17 +197,33 @@ void WarpKateView::setupUI()
     
     layout->addWidget(m_toolbar);
     
-    // Create conversation area (read-only text edit)
-    m_conversationArea = new QTextBrowser(m_terminalWidget);
-    m_conversationArea->setReadOnly(true);
-    m_conversationArea->setAcceptRichText(true);
-        m_conversationArea->setOpenExternalLinks(false);  // Now using QTextBrowser which supports this method (that's for QTextBrowser)
-    // Instead, we'll handle link clicks by connecting to the anchorClicked signal in onTerminalOutput
-    // Install event filter for keyboard navigation
-    m_conversationArea->installEventFilter(this);
+    // Create conversation area: an item model shown by a virtualized view,
+    // so long sessions only lay out and paint what is on screen
+    m_conversation = new ConversationModel(this);
+    m_conversationArea = new ConversationTimeline(m_terminalWidget);
+    m_conversationArea->setModel(m_conversation);
     m_conversationArea->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    connect(m_conversationArea, &ConversationTimeline::linkActivated, this, &WarpKateView::onLinkClicked);
+    connect(m_conversationArea, &ConversationTimeline::linkContextMenuRequested, this,
+            [this](const QUrl &url, const QPoint &globalPos) {
+        QFileInfo fileInfo(url.toLocalFile());
+        if (!url.isLocalFile() || !fileInfo.exists()) {
+            return;
+        }
+        QMenu *menu = createFileContextMenu(fileInfo.absoluteFilePath(), fileInfo.isDir());
+        menu->exec(globalPos);
+        delete menu;
+    });
     layout->addWidget(m_conversationArea, 1); // Takes most of the space
     
+    // Results of rg searches, shown below the conversation while there are any
+    m_searchBlock = new SearchBlockView(m_terminalWidget);
+    m_searchBlock->hide();
+    connect(m_searchBlock, &SearchBlockView::openRequested, this, &WarpKateView::openSearchResult);
+    connect(m_searchBlock, &SearchBlockView::closeRequested, m_searchBlock, &QWidget::hide);
+    connect(m_searchBlock->search(), &RipgrepSearch::finished, this, &WarpKateView::onSearchFinished);
+    layout->addWidget(m_searchBlock, 1);
+    
     // Create prompt input area - use QTextEdit for expandable area
     m_promptInput = new QTextEdit(m_terminalWidget);
     
@@ -221,6 +262,7 @@ void WarpKateView::setupUI()
     QWidget* promptPanel = new QWidget(m_terminalWidget);
     promptPanel->setStyleSheet(QStringLiteral("QWidget { background-color: black; }"));
     promptPanel->setLayout(promptLayout);
+    m_promptPanel = promptPanel;
     promptLayout->setContentsMargins(0, 0, 0, 0);
     promptLayout->setSpacing(4); // Set to consistent 4px spacing
 
@@ -318,22 +360,103 @@ void WarpKateView::setupActions()
     m_checkCodeAction->setText(i18n("Check Code"));
     m_checkCodeAction->setIcon(QIcon::fromTheme(QStringLiteral("dialog-ok-apply")));
     actions->setDefaultShortcut(m_checkCodeAction, Qt::CTRL | Qt::Key_K);
+    
+    // Shell profile action
+    m_shellProfileAction = actions->addAction(QStringLiteral("warpkate_shell_profile"), this, &WarpKateView::showShellProfile);
+    m_shellProfileAction->setText(i18n("Show Shell Startup Profile"));
+    m_shellProfileAction->setIcon(QIcon::fromTheme(QStringLiteral("chronometer")));
+    
+    // Semantic history search action
+    m_findSimilarAction = actions->addAction(QStringLiteral("warpkate_find_similar"), this, &WarpKateView::findSimilarCommands);
+    m_findSimilarAction->setText(i18n("Find Similar Commands"));
+    m_findSimilarAction->setIcon(QIcon::fromTheme(QStringLiteral("edit-find")));
+    
+    // Fan-out action
+    m_fanOutAction = actions->addAction(QStringLiteral("warpkate_fan_out"), this, &WarpKateView::fanOutCommand);
+    m_fanOutAction->setText(i18n("Run in Multiple Directories..."));
+    m_fanOutAction->setIcon(QIcon::fromTheme(QStringLiteral("folder-open")));
+    
+    // Runbook actions
+    m_saveRunbookAction = actions->addAction(QStringLiteral("warpkate_save_runbook"), this, &WarpKateView::saveBlocksAsRunbook);
+    m_saveRunbookAction->setText(i18n("Save Blocks as Runbook..."));
+    m_saveRunbookAction->setIcon(QIcon::fromTheme(QStringLiteral("document-save-as")));
+    
+    m_runRunbookAction = actions->addAction(QStringLiteral("warpkate_run_runbook"), this, &WarpKateView::runRunbook);
+    m_runRunbookAction->setText(i18n("Run Runbook..."));
+    m_runRunbookAction->setIcon(QIcon::fromTheme(QStringLiteral("system-run")));
 }
 
 void WarpKateView::setupTerminal()
 {
     qDebug() << "WarpKate: Setting up terminal components";
     
-    // Initialize terminal components
-    m_terminalEmulator = new TerminalEmulator(m_terminalWidget);
+    // Initialize terminal components with the configured engine
+    TerminalBackendType backendType = TerminalBackendFactory::configuredBackend();
+    qDebug() << "WarpKate: Using terminal backend" << TerminalBackendFactory::backendName(backendType);
+    m_terminalEmulator = TerminalBackendFactory::createBackend(backendType, m_terminalWidget);
     m_blockModel = new BlockModel(this);
     
+    // Keep finished blocks in the on-disk history (no-op when disabled)
+    connect(m_blockModel, &BlockModel::blockStateChanged, this, [this](int id, BlockState state) {
+        if ((state == Completed || state == Failed) && BlockHistory::isEnabled()) {
+            BlockHistory::instance().addBlock(m_blockModel->blockById(id));
+        }
+    });
+    
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    
+    // Predictive local echo and shell integration are features of the built-in engine only
+    bool profileStartup = config.readEntry("ProfileShellStartup", false);
+    if (TerminalEmulator *emulator = qobject_cast<TerminalEmulator *>(m_terminalEmulator)) {
+        emulator->setPredictiveEchoEnabled(config.readEntry("PredictiveLocalEcho", true));
+        emulator->setShellIntegrationEnabled(config.readEntry("ShellIntegration", true));
+        emulator->setProfileShellStartup(profileStartup);
+    }
+    
+    // Time to first prompt and prompt hook overhead, from OSC 133 marks
+    m_shellProfiler = new ShellProfiler(this);
+    connect(m_terminalEmulator, &TerminalBackend::semanticPromptMark, m_shellProfiler, &ShellProfiler::onSemanticPromptMark);
+    if (profileStartup) {
+        connect(m_shellProfiler, &ShellProfiler::startupMeasured, this, &WarpKateView::showShellProfile);
+    }
+    
+    // Git status in block headers, computed in the background
+    m_showGitStatus = config.readEntry("ShowGitStatus", true);
+    if (m_showGitStatus) {
+        connect(&GitStatusCache::instance(), &GitStatusCache::statusChanged, this, &WarpKateView::onGitStatusChanged);
+    }
+    
+    // Backends that render themselves bring their own grid; otherwise we
+    // render the cells. It sits below the conversation area, hidden until
+    // a full-screen program needs it
+    m_terminalDisplay = m_terminalEmulator->displayWidget();
+    if (!m_terminalDisplay) {
+        m_terminalDisplay = new TerminalGridWidget(m_terminalEmulator, m_terminalWidget);
+    }
+    if (QVBoxLayout *layout = qobject_cast<QVBoxLayout *>(m_terminalWidget->layout())) {
+        layout->insertWidget(layout->indexOf(m_conversationArea) + 1, m_terminalDisplay, 1);
+    }
+    m_terminalDisplay->hide();
+    
+    // Switch to raw input when a TUI takes over the screen, and poll the
+    // TTY mode while commands run (REPLs don't switch screens)
+    m_foregroundPollTimer = new QTimer(this);
+    m_foregroundPollTimer->setInterval(250);
+    connect(m_foregroundPollTimer, &QTimer::timeout, this, &WarpKateView::updateInputMode);
+    connect(m_terminalEmulator, &TerminalBackend::alternateScreenChanged, this, &WarpKateView::updateInputMode);
+    
     // Connect to terminal signals for real-time updates
-    connect(m_terminalEmulator, &TerminalEmulator::outputAvailable, this, &WarpKateView::onTerminalOutput);
-    connect(m_terminalEmulator, &TerminalEmulator::commandExecuted, this, &WarpKateView::onCommandExecuted);
-    connect(m_terminalEmulator, &TerminalEmulator::commandDetected, this, &WarpKateView::onCommandDetected);
-    connect(m_terminalEmulator, &TerminalEmulator::workingDirectoryChanged, this, &WarpKateView::onWorkingDirectoryChanged);
-    connect(m_terminalEmulator, &TerminalEmulator::shellFinished, this, &WarpKateView::onShellFinished);
+    connect(m_terminalEmulator, &TerminalBackend::outputAvailable, this, &WarpKateView::onTerminalOutput);
+    connect(m_terminalEmulator, &TerminalBackend::commandExecuted, this, &WarpKateView::onCommandExecuted);
+    connect(m_terminalEmulator, &TerminalBackend::commandDetected, this, &WarpKateView::onCommandDetected);
+    connect(m_terminalEmulator, &TerminalBackend::workingDirectoryChanged, this, &WarpKateView::onWorkingDirectoryChanged);
+    
+    // Only directories the shell reported rank for z and directory completion,
+    // never ones guessed from the output
+    connect(m_terminalEmulator, &TerminalBackend::workingDirectoryReported, this, [](const QString &directory) {
+        DirectoryIndex::instance().add(directory);
+    });
+    connect(m_terminalEmulator, &TerminalBackend::shellFinished, this, &WarpKateView::onShellFinished);
 
     // Connect block model to terminal
     m_blockModel->connectToTerminal(m_terminalEmulator);
@@ -356,7 +479,387 @@ void WarpKateView::setupTerminal()
         initialWorkingDir = QDir::homePath();
     }
     
+    // Start inside the project's cached direnv/nix/conda/venv environment;
+    // until it is cached, the shell runs the activation itself first
+    QString activation;
+    if (config.readEntry("CacheShellEnvironment", false)) {
+        QStringList changes = EnvironmentCache::instance().changesFor(initialWorkingDir);
+        if (changes.isEmpty()) {
+            QString shellName = QFileInfo(qEnvironmentVariable("SHELL", QStringLiteral("/bin/bash"))).fileName();
+            activation = EnvironmentCache::instance().activationCommand(initialWorkingDir, shellName);
+        }
+        m_terminalEmulator->setShellEnvironment(changes);
+    }
+    
+    // The activation is not the user's command: no block, transcript line or history entry
+    TerminalEmulator *emulator = qobject_cast<TerminalEmulator *>(m_terminalEmulator);
+    if (emulator) {
+        emulator->setStartupCommand(activation);
+    }
     m_terminalEmulator->startShell(QString(), initialWorkingDir);
+    if (!emulator && !activation.isEmpty()) {
+        m_terminalEmulator->processInput(QLatin1Char(' ') + activation + QLatin1Char('\r'));
+    }
+    
+    // Output (and so the first prompt mark) is only read once we are back
+    // in the event loop, so starting the clock right after the fork is exact enough
+    m_shellProfiler->shellStarting(emulator ? emulator->startupTracePath() : QString());
+}
+
+void WarpKateView::showShellProfile()
+{
+    if (!m_shellProfiler) {
+        return;
+    }
+    
+    showTerminal();
+    
+    // Informational, so muted
+    QTextCharFormat profileFormat;
+    profileFormat.setForeground(QBrush(QColor(100, 100, 100)));
+    
+    int row = m_conversation->appendItem(ConversationModel::Notice, m_shellProfiler->report(), profileFormat);
+    m_conversation->appendLine(row, QString());
+    
+    m_conversationArea->scrollToBottom();
+}
+
+void WarpKateView::findSimilarCommands()
+{
+    QString text = m_promptInput->toPlainText().trimmed();
+    if (text.isEmpty()) {
+        text = getCurrentText().trimmed();
+    }
+    if (text.isEmpty()) {
+        return;
+    }
+    
+    showTerminal();
+    
+    if (!SemanticIndex::instance().isEnabled()) {
+        QTextCharFormat infoFormat;
+        infoFormat.setForeground(QBrush(QColor(100, 100, 100)));
+        m_conversation->appendItem(ConversationModel::Notice,
+                                   i18n("Semantic history search is disabled. Enable it in the AI Assistant preferences."),
+                                   infoFormat);
+        m_conversationArea->scrollToBottom();
+        return;
+    }
+    
+    SemanticIndex::instance().search(text, 10, this, [this, text](const QList<SemanticIndex::Match> &matches) {
+        // Informational, so muted
+        QTextCharFormat infoFormat;
+        infoFormat.setForeground(QBrush(QColor(100, 100, 100)));
+        
+        int row;
+        if (matches.isEmpty()) {
+            row = m_conversation->appendItem(ConversationModel::Notice, i18n("No similar commands found for \"%1\"", text), infoFormat);
+        } else {
+            row = m_conversation->appendItem(ConversationModel::Notice, i18n("Commands similar to \"%1\":", text), infoFormat);
+            for (const SemanticIndex::Match &match : matches) {
+                m_conversation->appendLine(row, QStringLiteral("  %1  $ %2  (%3, %4)")
+                                                    .arg(QString::number(match.score, 'f', 2), match.command, match.directory,
+                                                         match.time.toString(Qt::ISODate)),
+                                           infoFormat);
+            }
+        }
+        m_conversation->appendLine(row, QString());
+        
+        m_conversationArea->scrollToBottom();
+    });
+}
+
+// Append a sub-block of a fan-out or runbook run: title, result in the
+// result colors, then the output
+static void appendSubBlock(ConversationModel *conversation, const QString &title, const QString &result, bool success, const QString &output)
+{
+    QTextCharFormat headerFormat;
+    headerFormat.setFontWeight(QFont::Bold);
+    int row = conversation->appendItem(ConversationModel::Output, QStringLiteral("  └ %1").arg(title), headerFormat);
+    
+    QTextCharFormat resultFormat;
+    resultFormat.setForeground(QBrush(success ? QColor(0, 150, 0) : QColor(200, 0, 0)));
+    conversation->appendText(row, QStringLiteral("  (%1)").arg(result), resultFormat);
+    
+    if (!output.trimmed().isEmpty()) {
+        QTextCharFormat outputFormat;
+        outputFormat.setFontFamily(QStringLiteral("Monospace"));
+        conversation->appendLine(row, output.trimmed(), outputFormat);
+    }
+}
+
+void WarpKateView::fanOutCommand()
+{
+    if (!m_fanOutRunner) {
+        m_fanOutRunner = new FanOutRunner(this);
+        connect(m_fanOutRunner, &FanOutRunner::jobFinished, this, &WarpKateView::onFanOutJobFinished);
+        connect(m_fanOutRunner, &FanOutRunner::finished, this, &WarpKateView::onFanOutFinished);
+    }
+    
+    // A second trigger while running stops the run
+    if (m_fanOutRunner->isRunning()) {
+        m_fanOutRunner->cancel();
+        return;
+    }
+    
+    QString command = m_promptInput->toPlainText().trimmed();
+    if (command.isEmpty()) {
+        command = getCurrentText().trimmed();
+    }
+    bool ok = false;
+    command = QInputDialog::getText(m_toolView, i18n("Run in Multiple Directories"), i18n("Command:"),
+                                    QLineEdit::Normal, command, &ok).trimmed();
+    if (!ok || command.isEmpty()) {
+        return;
+    }
+    
+    QString baseDirectory = m_terminalEmulator->currentWorkingDirectory();
+    QString pattern = QInputDialog::getText(m_toolView, i18n("Run in Multiple Directories"),
+                                            i18n("Directories in %1 (glob such as services/*, or \"submodules\"):", baseDirectory),
+                                            QLineEdit::Normal, m_fanOutPattern.isEmpty() ? QStringLiteral("*") : m_fanOutPattern, &ok).trimmed();
+    if (!ok || pattern.isEmpty()) {
+        return;
+    }
+    m_fanOutPattern = pattern;
+    
+    showTerminal();
+    
+    QStringList directories = FanOutRunner::resolveDirectories(baseDirectory, pattern);
+    if (directories.isEmpty()) {
+        QTextCharFormat infoFormat;
+        infoFormat.setForeground(QBrush(QColor(100, 100, 100)));
+        m_conversation->appendItem(ConversationModel::Notice, i18n("No directories match \"%1\"", pattern), infoFormat);
+        m_conversationArea->scrollToBottom();
+        return;
+    }
+    
+    // Header for the whole run, the jobs follow as sub-blocks
+    QTextCharFormat commandFormat;
+    commandFormat.setFontWeight(QFont::Bold);
+    commandFormat.setForeground(QBrush(QColor(0, 128, 255)));
+    int row = m_conversation->appendItem(ConversationModel::Command, QStringLiteral("$ %1").arg(command), commandFormat);
+    QTextCharFormat infoFormat;
+    infoFormat.setForeground(QBrush(QColor(100, 100, 100)));
+    m_conversation->appendText(row, i18np("  [%2, 1 directory]", "  [%2, %1 directories]", directories.size(), pattern), infoFormat);
+    m_conversationArea->scrollToBottom();
+    
+    m_fanOutBlockIds.clear();
+    for (const QString &directory : std::as_const(directories)) {
+        int blockId = m_blockModel->createBlock(command, directory);
+        m_blockModel->setBlockState(blockId, Executing);
+        m_blockModel->setBlockStartTime(blockId, QDateTime::currentDateTime());
+        m_fanOutBlockIds.append(blockId);
+    }
+    
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    m_fanOutRunner->setUseEnvironmentCache(config.readEntry("CacheShellEnvironment", false));
+    m_fanOutRunner->setEnvironment(shellEnvironment());
+    m_fanOutRunner->start(command, directories);
+}
+
+void WarpKateView::onFanOutJobFinished(int index)
+{
+    const FanOutRunner::Job &job = m_fanOutRunner->job(index);
+    QString output = QString::fromUtf8(job.output);
+    
+    if (index < m_fanOutBlockIds.size()) {
+        int blockId = m_fanOutBlockIds.at(index);
+        m_blockModel->setBlockOutput(blockId, output);
+        m_blockModel->setBlockExitCode(blockId, job.exitCode);
+        m_blockModel->setBlockStartTime(blockId, job.startTime);
+        m_blockModel->setBlockEndTime(blockId, job.endTime);
+        m_blockModel->setBlockState(blockId, job.exitCode == 0 ? Completed : Failed);
+    }
+    
+    QString seconds = QString::number(job.duration / 1000.0, 'f', 1);
+    appendSubBlock(m_conversation,
+                   QDir(m_terminalEmulator->currentWorkingDirectory()).relativeFilePath(job.directory),
+                   job.exitCode < 0 ? i18n("did not complete, %1 s", seconds) : i18n("exit %1, %2 s", job.exitCode, seconds),
+                   job.exitCode == 0,
+                   output);
+    
+    m_conversationArea->scrollToBottom();
+    
+    // Killed or timed out jobs have nothing to explain
+    if (job.exitCode > 0) {
+        explainFailure(m_fanOutRunner->command(), job.directory, output, job.exitCode);
+    }
+}
+
+void WarpKateView::onFanOutFinished()
+{
+    QTextCharFormat matrixFormat;
+    matrixFormat.setFontFamily(QStringLiteral("Monospace"));
+    matrixFormat.setForeground(QBrush(QColor(100, 100, 100)));
+    int row = m_conversation->appendItem(ConversationModel::Notice, m_fanOutRunner->resultMatrix(), matrixFormat);
+    m_conversation->appendLine(row, QString());
+    
+    m_conversationArea->scrollToBottom();
+}
+
+void WarpKateView::saveBlocksAsRunbook()
+{
+    // Commands of the session, most recent last
+    QList<CommandBlock> blocks;
+    const QList<CommandBlock> allBlocks = m_blockModel->blocks();
+    for (const CommandBlock &block : allBlocks) {
+        if (block.isValid()) {
+            blocks.append(block);
+        }
+    }
+    if (blocks.isEmpty()) {
+        return;
+    }
+    
+    bool ok = false;
+    QString name = QInputDialog::getText(m_toolView, i18n("Save Blocks as Runbook"), i18n("Runbook name:"),
+                                         QLineEdit::Normal, QString(), &ok).trimmed();
+    if (!ok || name.isEmpty()) {
+        return;
+    }
+    int count = QInputDialog::getInt(m_toolView, i18n("Save Blocks as Runbook"), i18n("Number of recent blocks:"),
+                                     qMin(5, int(blocks.size())), 1, int(blocks.size()), 1, &ok);
+    if (!ok) {
+        return;
+    }
+    
+    // Saved in order, each step after the previous; editing the "needs"
+    // lists in the file lets independent steps run in parallel
+    Runbook runbook;
+    runbook.name = name;
+    QString previous;
+    for (int i = blocks.size() - count; i < blocks.size(); ++i) {
+        Runbook::Step step;
+        step.name = QStringLiteral("step%1").arg(runbook.steps.size() + 1);
+        step.command = blocks.at(i).command;
+        step.directory = blocks.at(i).workingDirectory;
+        if (!previous.isEmpty()) {
+            step.needs.append(previous);
+        }
+        previous = step.name;
+        runbook.steps.append(step);
+    }
+    
+    QTextCharFormat infoFormat;
+    infoFormat.setForeground(QBrush(QColor(100, 100, 100)));
+    if (runbook.save()) {
+        m_conversation->appendItem(ConversationModel::Notice,
+                                   i18n("Saved runbook %1. Edit the \"needs\" of its steps to run independent steps in parallel.", name),
+                                   infoFormat);
+        m_mainWindow->openUrl(QUrl::fromLocalFile(Runbook::filePath(name)));
+    } else {
+        m_conversation->appendItem(ConversationModel::Notice, i18n("Could not save runbook %1", name), infoFormat);
+    }
+    m_conversationArea->scrollToBottom();
+}
+
+void WarpKateView::runRunbook()
+{
+    if (!m_runbookRunner) {
+        m_runbookRunner = new RunbookRunner(this);
+        connect(m_runbookRunner, &RunbookRunner::stepStarted, this, &WarpKateView::onRunbookStepStarted);
+        connect(m_runbookRunner, &RunbookRunner::stepFinished, this, &WarpKateView::onRunbookStepFinished);
+        connect(m_runbookRunner, &RunbookRunner::finished, this, &WarpKateView::onRunbookFinished);
+    }
+    
+    // A second trigger while running stops the run
+    if (m_runbookRunner->isRunning()) {
+        m_runbookRunner->cancel();
+        return;
+    }
+    
+    showTerminal();
+    
+    QStringList names = Runbook::available();
+    if (names.isEmpty()) {
+        QTextCharFormat infoFormat;
+        infoFormat.setForeground(QBrush(QColor(100, 100, 100)));
+        m_conversation->appendItem(ConversationModel::Notice, i18n("No runbooks saved yet. Use Save Blocks as Runbook first."), infoFormat);
+        m_conversationArea->scrollToBottom();
+        return;
+    }
+    
+    bool ok = false;
+    QString name = QInputDialog::getItem(m_toolView, i18n("Run Runbook"), i18n("Runbook:"), names, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+    
+    Runbook runbook;
+    QString errorMessage;
+    if (!Runbook::load(name, &runbook, &errorMessage)) {
+        QTextCharFormat errorFormat;
+        errorFormat.setForeground(QBrush(QColor(200, 0, 0)));
+        m_conversation->appendItem(ConversationModel::Notice, errorMessage, errorFormat);
+        m_conversationArea->scrollToBottom();
+        return;
+    }
+    
+    QTextCharFormat commandFormat;
+    commandFormat.setFontWeight(QFont::Bold);
+    commandFormat.setForeground(QBrush(QColor(0, 128, 255)));
+    int row = m_conversation->appendItem(ConversationModel::Command, QStringLiteral("▶ %1").arg(name), commandFormat);
+    QTextCharFormat infoFormat;
+    infoFormat.setForeground(QBrush(QColor(100, 100, 100)));
+    m_conversation->appendText(row, i18np("  [1 step]", "  [%1 steps]", runbook.steps.size()), infoFormat);
+    m_conversationArea->scrollToBottom();
+    
+    m_runbookBlockIds = QList<int>(runbook.steps.size(), -1);
+    
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    m_runbookRunner->setUseEnvironmentCache(config.readEntry("CacheShellEnvironment", false));
+    m_runbookRunner->setEnvironment(shellEnvironment());
+    m_runbookRunner->start(runbook, m_terminalEmulator->currentWorkingDirectory());
+}
+
+void WarpKateView::onRunbookStepStarted(int index)
+{
+    const Runbook::Step &step = m_runbookRunner->runbook().steps.at(index);
+    int blockId = m_blockModel->createBlock(step.command, m_runbookRunner->stepDirectory(index));
+    m_blockModel->setBlockState(blockId, Executing);
+    m_blockModel->setBlockStartTime(blockId, m_runbookRunner->result(index).startTime);
+    m_runbookBlockIds[index] = blockId;
+}
+
+void WarpKateView::onRunbookStepFinished(int index)
+{
+    const RunbookRunner::StepResult &result = m_runbookRunner->result(index);
+    QString output = QString::fromUtf8(result.output);
+    
+    int blockId = m_runbookBlockIds.value(index, -1);
+    if (blockId >= 0) {
+        m_blockModel->setBlockOutput(blockId, output);
+        m_blockModel->setBlockExitCode(blockId, result.exitCode);
+        m_blockModel->setBlockEndTime(blockId, result.endTime);
+        m_blockModel->setBlockState(blockId, result.state == RunbookRunner::Succeeded ? Completed : Failed);
+    }
+    
+    QString status;
+    QString seconds = QString::number(result.duration() / 1000.0, 'f', 1);
+    if (result.state == RunbookRunner::Skipped) {
+        status = i18n("skipped");
+    } else if (result.exitCode < 0) {
+        status = i18n("did not complete, %1 s", seconds);
+    } else {
+        status = i18n("exit %1, %2 s", result.exitCode, seconds);
+    }
+    
+    const Runbook::Step &step = m_runbookRunner->runbook().steps.at(index);
+    appendSubBlock(m_conversation, QStringLiteral("%1: %2").arg(step.name, step.command), status,
+                   result.state == RunbookRunner::Succeeded, output);
+    
+    m_conversationArea->scrollToBottom();
+}
+
+void WarpKateView::onRunbookFinished()
+{
+    QTextCharFormat summaryFormat;
+    summaryFormat.setFontFamily(QStringLiteral("Monospace"));
+    summaryFormat.setForeground(QBrush(QColor(100, 100, 100)));
+    int row = m_conversation->appendItem(ConversationModel::Notice, m_runbookRunner->summary(), summaryFormat);
+    m_conversation->appendLine(row, QString());
+    
+    m_conversationArea->scrollToBottom();
 }
 
 void WarpKateView::showTerminal()
@@ -405,6 +908,14 @@ QString WarpKateView::getCurrentText()
     return text;
 }
 
+// Append a git status summary to a block header
+static void appendGitStatus(ConversationModel *conversation, int row, const GitStatus &status)
+{
+    QTextCharFormat gitFormat;
+    gitFormat.setForeground(QBrush(QColor(100, 100, 100))); // Gray for info
+    conversation->appendText(row, QStringLiteral("  [%1]").arg(status.summary()), gitFormat);
+}
+
 void WarpKateView::executeCommand(const QString &command)
 {
     if (command.isEmpty()) {
@@ -425,13 +936,22 @@ void WarpKateView::executeCommand(const QString &command)
     commandFormat.setForeground(QBrush(QColor(0, 128, 255)));
     
     // Add command to conversation area with formatting
-    QTextCursor cursor = m_conversationArea->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    m_conversationArea->setTextCursor(cursor);
-    cursor.insertBlock();
-    cursor.setCharFormat(commandFormat);
-    cursor.insertText(promptText);
-    cursor.setCharFormat(QTextCharFormat());
+    int row = m_conversation->appendItem(ConversationModel::Command, promptText, commandFormat);
+    
+    // Annotate the header with the git status; the first status of a
+    // repository is filled in when git status finished
+    if (m_showGitStatus) {
+        QString directory = m_terminalEmulator->currentWorkingDirectory();
+        GitStatus status = GitStatusCache::instance().statusFor(directory);
+        if (status.valid) {
+            appendGitStatus(m_conversation, row, status);
+        } else {
+            QString root = GitStatusCache::instance().repositoryRootFor(directory);
+            if (!root.isEmpty()) {
+                m_pendingGitHeaders.insert(root, row);
+            }
+        }
+    }
     
     // Create a block for this command in the model
     int blockId = m_blockModel->executeCommand(command);
@@ -444,7 +964,7 @@ void WarpKateView::executeCommand(const QString &command)
     
     // Output will be handled by the outputAvailable and commandExecuted signals
     // Make sure the view scrolls to show the new command
-    m_conversationArea->ensureCursorVisible();
+    m_conversationArea->scrollToBottom();
 }
 
 void WarpKateView::executeCurrentText()
@@ -456,7 +976,9 @@ void WarpKateView::executeCurrentText()
 void WarpKateView::clearTerminal()
 {
     qDebug() << "WarpKate: Clearing terminal";
-    m_conversationArea->clear();
+    m_conversation->clear();
+    m_pendingGitHeaders.clear();
+    m_aiResponseRow = -1;
 }
 
 void WarpKateView::previousBlock()
@@ -492,6 +1014,10 @@ void WarpKateView::onDocumentChanged(KTextEditor::Document *document)
     }
 }
 
+// Time the query waits for related commands from the history (ms); a slow
+// embedding endpoint must not hold up interactive answers
+static const int HISTORY_CONTEXT_BUDGET = 200;
+
 // Add missing method implementations
 void WarpKateView::handleAIQuery(const QString &query)
 {
@@ -510,31 +1036,42 @@ void WarpKateView::handleAIQuery(const QString &query)
     queryFormat.setForeground(QBrush(QColor(75, 0, 130))); // Indigo for AI queries
     
     // Add query to conversation area with formatting
-    QTextCursor cursor = m_conversationArea->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    m_conversationArea->setTextCursor(cursor);
-    cursor.insertBlock();
-    cursor.setCharFormat(queryFormat);
-    cursor.insertText(QStringLiteral("? %1").arg(query));
-    cursor.setCharFormat(QTextCharFormat());
+    m_conversation->appendItem(ConversationModel::AIQuery, QStringLiteral("? %1").arg(query), queryFormat);
     
     // Get context information to enhance AI response
     QString contextInfo = getContextInformation();
     
-    // Simulate an AI response (in a real implementation, this would call an AI service)
-    QTimer::singleShot(500, this, [this, query, contextInfo]() {
-        generateAIResponse(query, contextInfo);
-    });
+    // Add related commands from the history when semantic search is on and
+    // answers in time; otherwise the query goes out without them
+    if (SemanticIndex::instance().isEnabled()) {
+        QSharedPointer<bool> sent(new bool(false));
+        SemanticIndex::instance().search(query, 3, this, [this, query, contextInfo, sent](const QList<SemanticIndex::Match> &matches) {
+            if (!*sent) {
+                *sent = true;
+                generateAIResponse(query, contextInfo + SemanticIndex::formatForContext(matches));
+            }
+        });
+        QTimer::singleShot(HISTORY_CONTEXT_BUDGET, this, [this, query, contextInfo, sent]() {
+            if (!*sent) {
+                *sent = true;
+                generateAIResponse(query, contextInfo);
+            }
+        });
+    } else {
+        // Simulate an AI response (in a real implementation, this would call an AI service)
+        QTimer::singleShot(500, this, [this, query, contextInfo]() {
+            generateAIResponse(query, contextInfo);
+        });
+    }
     
     // Make sure the view scrolls to show the query
-    m_conversationArea->ensureCursorVisible();
+    m_conversationArea->scrollToBottom();
 }
 
 void WarpKateView::insertToEditor()
 {
     // Get the current text from the conversation area
-    QTextCursor cursor = m_conversationArea->textCursor();
-    QString selectedText = cursor.selectedText();
+    QString selectedText = m_conversationArea->selectedText();
     
     if (selectedText.isEmpty()) {
         qDebug() << "WarpKate: No text selected to insert";
@@ -558,7 +1095,7 @@ void WarpKateView::saveToObsidian()
     qDebug() << "WarpKate: Save to Obsidian requested";
     
     // Get the conversation content
-    QString content = m_conversationArea->toPlainText();
+    QString content = m_conversation->toPlainText();
     if (content.isEmpty()) {
         qDebug() << "WarpKate: No content to save";
         return;
@@ -570,14 +1107,10 @@ void WarpKateView::saveToObsidian()
     
     if (vaultPath.isEmpty()) {
         // No vault path configured, show a message and open preferences
-        QTextCursor cursor = m_conversationArea->textCursor();
-        cursor.movePosition(QTextCursor::End);
-        m_conversationArea->setTextCursor(cursor);
-        
-        cursor.insertBlock();
-        cursor.insertText(QStringLiteral("To save to Obsidian, you need to configure your vault path in Preferences."));
-        cursor.insertBlock();
-        cursor.insertText(QStringLiteral("Would you like to configure it now?"));
+        int row = m_conversation->appendItem(ConversationModel::Notice,
+                                             QStringLiteral("To save to Obsidian, you need to configure your vault path in Preferences."));
+        m_conversation->appendLine(row, QStringLiteral("Would you like to configure it now?"));
+        m_conversationArea->scrollToBottom();
         
         // Create a simulated AI response with options
         QTimer::singleShot(500, this, [this]() {
@@ -587,37 +1120,33 @@ void WarpKateView::saveToObsidian()
         return;
     }
     
-    // Analyze the conversation to find meaningful content to save
+    // Analyze the conversation to find meaningful content to save: each
+    // command, query or response starts an exchange, output and notices
+    // after it belong to that exchange
     QStringList conversations;
-    QTextDocument *doc = m_conversationArea->document();
-    
-    for (QTextBlock block = doc->begin(); block != doc->end(); block = block.next()) {
-        QString line = block.text().trimmed();
-        if (line.startsWith(QStringLiteral("? ")) || line.startsWith(QStringLiteral("AI Response:")) || 
-            line.startsWith(QStringLiteral("> ")) || line.startsWith(QStringLiteral("Code Check"))) {
-            
-            // Start of a new conversation
-            conversations.append(line);
-            
-            // Get following blocks until next conversation marker
-            QTextBlock nextBlock = block.next();
-            while (nextBlock.isValid()) {
-                QString nextLine = nextBlock.text().trimmed();
-                
-                // If we hit another conversation marker, break
-                if (nextLine.startsWith(QStringLiteral("? ")) || nextLine.startsWith(QStringLiteral("AI Response:")) ||
-                    nextLine.startsWith(QStringLiteral("> ")) || nextLine.startsWith(QStringLiteral("Code Check"))) {
-                    break;
-                }
-                
-                // Add this line to the current conversation
-                if (!nextLine.isEmpty()) {
-                    conversations.last().append(QStringLiteral("\n") + nextLine);
-                }
-                
-                nextBlock = nextBlock.next();
+    for (int row = 0; row < m_conversation->rowCount(); ++row) {
+        const ConversationModel::Item item = m_conversation->item(row);
+        bool startsExchange = item.kind != ConversationModel::Output && item.kind != ConversationModel::Notice;
+        if (!startsExchange && conversations.isEmpty()) {
+            continue;
+        }
+        
+        QStringList lines;
+        const QStringList itemLines = item.text.split(QLatin1Char('\n'));
+        for (const QString &line : itemLines) {
+            if (!line.trimmed().isEmpty()) {
+                lines.append(line.trimmed());
             }
         }
+        if (lines.isEmpty()) {
+            continue;
+        }
+        
+        if (startsExchange) {
+            conversations.append(lines.join(QLatin1Char('\n')));
+        } else {
+            conversations.last().append(QLatin1Char('\n') + lines.join(QLatin1Char('\n')));
+        }
     }
     
     // Get file pattern from settings
@@ -628,29 +1157,17 @@ void WarpKateView::saveToObsidian()
     filePattern.replace(QStringLiteral("{date}"), now.toString(QStringLiteral("yyyy-MM-dd")));
     
     // Display suggestions in the conversation area
-    QTextCursor cursor = m_conversationArea->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    m_conversationArea->setTextCursor(cursor);
-    
-    cursor.insertBlock();
-    cursor.insertBlock();
-    
     QTextCharFormat headerFormat;
     headerFormat.setFontWeight(QFont::Bold);
     headerFormat.setForeground(QBrush(QColor(0, 128, 0)));
     
-    cursor.setCharFormat(headerFormat);
-    cursor.insertText(QStringLiteral("Obsidian Save Analysis:"));
-    cursor.setCharFormat(QTextCharFormat());
-    
-    cursor.insertBlock();
-    cursor.insertText(QStringLiteral("I found %1 conversation exchanges in this session.").arg(conversations.size()));
-    cursor.insertBlock();
+    int row = m_conversation->appendItem(ConversationModel::Notice, QStringLiteral("Obsidian Save Analysis:"), headerFormat);
+    m_conversation->appendLine(row, QStringLiteral("I found %1 conversation exchanges in this session.").arg(conversations.size()));
     
     if (conversations.size() <= 3) {
-        cursor.insertText(QStringLiteral("Recommended: Save the entire conversation to Obsidian."));
+        m_conversation->appendLine(row, QStringLiteral("Recommended: Save the entire conversation to Obsidian."));
     } else {
-        cursor.insertText(QStringLiteral("Recommended: Save the following key exchanges to Obsidian:"));
+        m_conversation->appendLine(row, QStringLiteral("Recommended: Save the following key exchanges to Obsidian:"));
         
         // Find the most important conversations (for demo, just take first, last, and one in middle)
         QStringList important;
@@ -662,7 +1179,6 @@ void WarpKateView::saveToObsidian()
         
         important << conversations.last();
         
-        cursor.insertBlock();
         for (int i = 0; i < important.size(); ++i) {
             // Truncate if too long
             QString snippet = important[i].left(100);
@@ -670,24 +1186,19 @@ void WarpKateView::saveToObsidian()
                 snippet += QStringLiteral("...");
             }
             
-            cursor.insertText(QStringLiteral("%1. %2").arg(i+1).arg(snippet));
-            cursor.insertBlock();
+            m_conversation->appendLine(row, QStringLiteral("%1. %2").arg(i+1).arg(snippet));
         }
     }
     
-    cursor.insertBlock();
-    cursor.insertText(QStringLiteral("Proposed filename: %1.md").arg(filePattern));
-    cursor.insertBlock();
-    cursor.insertText(QStringLiteral("Location: %1").arg(vaultPath));
-    cursor.insertBlock();
-    
-    cursor.insertText(QStringLiteral("(In a full implementation, this would save the file to your Obsidian vault)"));
-    cursor.insertBlock();
+    m_conversation->appendLine(row, QString());
+    m_conversation->appendLine(row, QStringLiteral("Proposed filename: %1.md").arg(filePattern));
+    m_conversation->appendLine(row, QStringLiteral("Location: %1").arg(vaultPath));
+    m_conversation->appendLine(row, QStringLiteral("(In a full implementation, this would save the file to your Obsidian vault)"));
     
     // TODO: Implement actual file writing
     // This would create a markdown file in the Obsidian vault with the conversation
     
-    m_conversationArea->ensureCursorVisible();
+    m_conversationArea->scrollToBottom();
 }
 
 void WarpKateView::checkCode()
@@ -709,48 +1220,29 @@ void WarpKateView::checkCode()
     requestFormat.setFontWeight(QFont::Bold);
     requestFormat.setForeground(QBrush(QColor(0, 100, 0))); // Dark green
     
-    QTextCursor cursor = m_conversationArea->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    m_conversationArea->setTextCursor(cursor);
-    cursor.insertBlock();
-    cursor.setCharFormat(requestFormat);
-    cursor.insertText(QStringLiteral("Code Check requested:"));
-    cursor.setCharFormat(QTextCharFormat());
+    int row = m_conversation->appendItem(ConversationModel::AIQuery, QStringLiteral("Code Check requested:"), requestFormat);
     
     // Format and display the code
     QTextCharFormat codeFormat;
     codeFormat.setFontFamily(QStringLiteral("Monospace"));
     codeFormat.setBackground(QBrush(QColor(240, 240, 240))); // Light gray
     
-    cursor.insertBlock();
-    cursor.insertText(QStringLiteral("```"));
-    cursor.insertBlock();
-    cursor.setCharFormat(codeFormat);
-    cursor.insertText(code);
-    cursor.setCharFormat(QTextCharFormat());
-    cursor.insertBlock();
-    cursor.insertText(QStringLiteral("```"));
+    m_conversation->appendLine(row, QStringLiteral("```"));
+    m_conversation->appendLine(row, code, codeFormat);
+    m_conversation->appendLine(row, QStringLiteral("```"));
+    m_conversationArea->scrollToBottom();
     
     // In a real implementation, this would analyze the code
     // For now, just create a simulated response after a short delay
     QTimer::singleShot(800, this, [this, code]() {
         // Create a simulated code analysis response
-        QTextCursor cursor = m_conversationArea->textCursor();
-        cursor.movePosition(QTextCursor::End);
-        m_conversationArea->setTextCursor(cursor);
-        
         // Format for analysis header
         QTextCharFormat analysisHeaderFormat;
         analysisHeaderFormat.setFontWeight(QFont::Bold);
         analysisHeaderFormat.setForeground(QBrush(QColor(0, 100, 0))); // Dark green
         
-        cursor.insertBlock();
-        cursor.setCharFormat(analysisHeaderFormat);
-        cursor.insertText(QStringLiteral("Code Analysis:"));
-        cursor.setCharFormat(QTextCharFormat());
+        int row = m_conversation->appendItem(ConversationModel::AIResponse, QStringLiteral("Code Analysis:"), analysisHeaderFormat);
         
-        // Format for analysis results
-        cursor.insertBlock();
         
         // Detect language (simple detection)
         QString language = QStringLiteral("unknown");
@@ -767,11 +1259,8 @@ void WarpKateView::checkCode()
         bulletFormat.setFontWeight(QFont::Bold);
         
         // Add language detection result
-        cursor.insertText(QStringLiteral("Detected language: "));
-        cursor.setCharFormat(bulletFormat);
-        cursor.insertText(language);
-        cursor.setCharFormat(QTextCharFormat());
-        cursor.insertBlock();
+        m_conversation->appendLine(row, QStringLiteral("Detected language: "));
+        m_conversation->appendText(row, language, bulletFormat);
         
         // Add analysis points
         QStringList analysisPoints;
@@ -793,16 +1282,14 @@ void WarpKateView::checkCode()
         
         // Format each analysis point
         for (const QString &point : analysisPoints) {
-            cursor.insertText(QStringLiteral("• "));
-            cursor.insertText(point);
-            cursor.insertBlock();
+            m_conversation->appendLine(row, QStringLiteral("• ") + point);
         }
         
         // Add a blank line
-        cursor.insertBlock();
+        m_conversation->appendLine(row, QString());
         
         // Ensure visible
-        m_conversationArea->ensureCursorVisible();
+        m_conversationArea->scrollToBottom();
     });
 }
 
@@ -870,8 +1357,9 @@ void WarpKateView::submitInput()
             handleAIQuery(query);
         } else {
             // Terminal mode
-            // Terminal mode
-            executeCommand(input);
+            if (!runSearchBlock(input)) {
+                executeCommand(resolveDirectoryJump(input));
+            }
         }
     }
     
@@ -883,32 +1371,161 @@ void WarpKateView::submitInput()
     m_promptInput->setMaximumHeight(80); // Doubled maximum height to 80px
 }
 
-bool WarpKateView::eventFilter(QObject *obj, QEvent *event)
+// Characters the shell would expand or unquote in a z keyword
+static const QString DIRECTORY_JUMP_SPECIAL = QStringLiteral("\\'\"$`*?[{~");
+
+QString WarpKateView::resolveDirectoryJump(const QString &command) const
 {
-    // Only process events from the prompt input
-    // Handle events for conversation area (Tab navigation)
-    if (obj == m_conversationArea && event->type() == QEvent::KeyPress) {
-        QKeyEvent *keyEvent = static_cast<QKeyEvent*>(event);
-        
-        if (keyEvent->key() == Qt::Key_Tab) {
-            if (keyEvent->modifiers() & Qt::ShiftModifier) {
-                // Shift+Tab moves to previous element
-                focusPreviousInteractiveElement();
-            } else {
-                // Tab moves to next element
-                focusNextInteractiveElement();
-            }
-            return true; // Event handled
-        } else if (keyEvent->key() == Qt::Key_Return || keyEvent->key() == Qt::Key_Enter) {
-            // Enter key activates the focused element
-            if (m_currentFocusIndex >= 0 && m_currentFocusIndex < m_interactiveElements.size()) {
-                QString href = m_interactiveElements[m_currentFocusIndex].format.anchorHref();
-                flashClickFeedback(m_currentFocusIndex);
-                onLinkClicked(QUrl(href));
-                return true; // Event handled
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    if (!config.readEntry("DirectoryJump", true)) {
+        return command;
+    }
+    
+    // A z the shell defines itself, e.g. zoxide's or z.sh, is the user's
+    TerminalEmulator *emulator = qobject_cast<TerminalEmulator *>(m_terminalEmulator);
+    if (!emulator || !emulator->runsAsProgram(QStringLiteral("z"))) {
+        return command;
+    }
+    
+    // Only a plain "z word..." is a jump; operators, options, quoting and
+    // expansions all go to the shell as typed
+    if (command.contains(QLatin1Char('\n'))) {
+        return command;
+    }
+    ShellLine line;
+    ShellTokenizer::relex(command, ShellLexState(), &line);
+    if (line.endState != ShellLexState() || line.tokens.size() < 2) {
+        return command;
+    }
+    
+    const ShellToken &first = line.tokens.first();
+    if (first.kind != ShellTokenKind::Command || command.mid(first.start, first.length) != QLatin1String("z")) {
+        return command;
+    }
+    
+    QStringList words;
+    for (int i = 1; i < line.tokens.size(); ++i) {
+        const ShellToken &token = line.tokens.at(i);
+        if (token.kind != ShellTokenKind::Argument && token.kind != ShellTokenKind::Path) {
+            return command;
+        }
+        const QString word = command.mid(token.start, token.length);
+        for (QChar c : word) {
+            if (DIRECTORY_JUMP_SPECIAL.contains(c)) {
+                return command;
             }
         }
+        words.append(word);
+    }
+    
+    // Without a match the command goes to the shell as typed
+    QStringList matches = DirectoryIndex::instance().query(words, 1, m_terminalEmulator->currentWorkingDirectory());
+    if (matches.isEmpty()) {
+        return command;
+    }
+    return QStringLiteral("cd -- %1").arg(KShell::quoteArg(matches.first()));
+}
+
+bool WarpKateView::runSearchBlock(const QString &command)
+{
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    if (!config.readEntry("SearchBlocks", true)) {
+        return false;
+    }
+    
+    // Anything the shell would have to interpret goes to the terminal
+    KShell::Errors error = KShell::NoError;
+    QStringList arguments = KShell::splitArgs(command, KShell::AbortOnMeta | KShell::TildeExpand, &error);
+    if (error != KShell::NoError || arguments.isEmpty() || arguments.first() != QLatin1String("rg")) {
+        return false;
+    }
+    arguments.removeFirst();
+    if (!RipgrepSearch::isSearch(arguments) || !RipgrepSearch::isAvailable()) {
+        return false;
+    }
+    
+    // Only when the shell would run rg itself, not an alias or function of the
+    // user's; without the integration that is not known and the shell runs it
+    TerminalEmulator *emulator = qobject_cast<TerminalEmulator *>(m_terminalEmulator);
+    if (!emulator || !emulator->runsAsProgram(QStringLiteral("rg"))) {
+        return false;
+    }
+    
+    // A search still running is replaced, its block ends as not completed
+    if (m_searchBlockId >= 0) {
+        onSearchFinished(-1);
+    }
+    
+    // rg sees what the user exported in the shell, RIPGREP_CONFIG_PATH included
+    QString directory = m_terminalEmulator->currentWorkingDirectory();
+    m_searchBlock->search()->setEnvironment(shellEnvironment());
+    if (!m_searchBlock->start(arguments, directory)) {
+        return false;
+    }
+    
+    showTerminal();
+    m_searchBlock->show();
+    
+    QTextCharFormat commandFormat;
+    commandFormat.setFontWeight(QFont::Bold);
+    commandFormat.setForeground(QBrush(QColor(0, 128, 255)));
+    m_searchRow = m_conversation->appendItem(ConversationModel::Command, QStringLiteral("$ %1").arg(command), commandFormat);
+    m_conversationArea->scrollToBottom();
+    
+    m_searchBlockId = m_blockModel->createBlock(command, directory);
+    m_blockModel->setBlockState(m_searchBlockId, Executing);
+    m_blockModel->setBlockStartTime(m_searchBlockId, QDateTime::currentDateTime());
+    return true;
+}
+
+void WarpKateView::onSearchFinished(int exitCode)
+{
+    if (m_searchBlockId < 0) {
+        return;
     }
+    
+    // The results stay in the search block; the conversation and block get a summary
+    const RipgrepSearch *search = m_searchBlock->search();
+    QString seconds = QString::number(search->elapsed() / 1000.0, 'f', 1);
+    QString summary = i18n("%1 matches in %2 files", search->matchCount(), search->fileCount());
+    if (exitCode < 0) {
+        summary = i18n("%1, stopped after %2 s", summary, seconds);
+    } else {
+        summary = i18n("%1, %2 s", summary, seconds);
+    }
+    
+    QTextCharFormat infoFormat;
+    infoFormat.setForeground(QBrush(QColor(100, 100, 100)));
+    m_conversation->appendText(m_searchRow, QStringLiteral("  [%1]").arg(summary), infoFormat);
+    if (!search->errorOutput().trimmed().isEmpty()) {
+        QTextCharFormat errorFormat;
+        errorFormat.setForeground(QBrush(QColor(200, 0, 0)));
+        m_conversation->appendLine(m_searchRow, search->errorOutput().trimmed(), errorFormat);
+    }
+    m_conversationArea->scrollToBottom();
+    
+    // rg exits with 1 when nothing matched, which is no failure
+    m_blockModel->setBlockOutput(m_searchBlockId, summary);
+    m_blockModel->setBlockExitCode(m_searchBlockId, exitCode);
+    m_blockModel->setBlockEndTime(m_searchBlockId, QDateTime::currentDateTime());
+    m_blockModel->setBlockState(m_searchBlockId, exitCode == 0 || exitCode == 1 ? Completed : Failed);
+    m_searchBlockId = -1;
+    m_searchRow = -1;
+}
+
+void WarpKateView::openSearchResult(const QString &filePath, int line, int column)
+{
+    KTextEditor::View *view = m_mainWindow->openUrl(QUrl::fromLocalFile(filePath));
+    if (!view) {
+        openFileInKate(filePath);
+        return;
+    }
+    view->setCursorPosition(KTextEditor::Cursor(line - 1, column));
+}
+
+bool WarpKateView::eventFilter(QObject *obj, QEvent *event)
+{
+    // Only process events from the prompt input
     if (obj != m_promptInput) {
         return QObject::eventFilter(obj, event);
     }
@@ -1008,57 +1625,35 @@ void WarpKateView::generateAIResponse(const QString &query, const QString &conte
 {
     if (!m_aiService || !m_aiService->isReady()) {
         // If AI service is not available, format an error message
-        QTextCursor cursor = m_conversationArea->textCursor();
-        cursor.movePosition(QTextCursor::End);
-        m_conversationArea->setTextCursor(cursor);
-        
         // Format for AI response
         QTextCharFormat aiHeaderFormat;
         aiHeaderFormat.setFontWeight(QFont::Bold);
         aiHeaderFormat.setForeground(QBrush(QColor(75, 0, 130))); // Indigo
         
-        cursor.insertBlock();
-        cursor.setCharFormat(aiHeaderFormat);
-        cursor.insertText(i18n("AI Service Error:"));
-        cursor.setCharFormat(QTextCharFormat());
-        
-        cursor.insertBlock();
-        cursor.insertText(i18n("The AI service is not properly configured. Please check your API key and settings in Preferences."));
-        cursor.insertBlock();
+        int row = m_conversation->appendItem(ConversationModel::AIResponse, i18n("AI Service Error:"), aiHeaderFormat);
+        m_conversation->appendLine(row, i18n("The AI service is not properly configured. Please check your API key and settings in Preferences."));
+        m_conversation->appendLine(row, QString());
         
         // Ensure visible
-        m_conversationArea->ensureCursorVisible();
+        m_conversationArea->scrollToBottom();
         return;
     }
     
     // Format the header for AI response
-    QTextCursor cursor = m_conversationArea->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    m_conversationArea->setTextCursor(cursor);
-    
-    // Format for AI response
     QTextCharFormat aiHeaderFormat;
     aiHeaderFormat.setFontWeight(QFont::Bold);
     aiHeaderFormat.setForeground(QBrush(QColor(75, 0, 130))); // Indigo
     
-    cursor.insertBlock();
-    cursor.setCharFormat(aiHeaderFormat);
-    cursor.insertText(i18n("AI Response:"));
-    cursor.setCharFormat(QTextCharFormat());
-    
-    cursor.insertBlock();
+    m_conversation->appendItem(ConversationModel::AIResponse, i18n("AI Response:"), aiHeaderFormat);
     
-    // Show a "Thinking..." message that will be replaced by the response
+    // Show a "Thinking..." message in its own item; the response replaces it
     QTextCharFormat thinkingFormat;
     thinkingFormat.setFontItalic(true);
     thinkingFormat.setForeground(QBrush(QColor(100, 100, 100))); // Gray
-    cursor.setCharFormat(thinkingFormat);
-    cursor.insertText(i18n("Thinking..."));
-    cursor.setCharFormat(QTextCharFormat());
-    cursor.insertBlock();
+    m_aiResponseRow = m_conversation->appendItem(ConversationModel::AIResponse, i18n("Thinking..."), thinkingFormat);
     
     // Ensure visible
-    m_conversationArea->ensureCursorVisible();
+    m_conversationArea->scrollToBottom();
     
     // Call the AI service to generate a response
     // Pass a callback to handle the response (will replace the "Thinking..." message)
@@ -1071,6 +1666,52 @@ void WarpKateView::generateAIResponse(const QString &query, const QString &conte
     );
 }
 
+// Characters of output sent along with a failure; errors are at the end
+static const int FAILURE_OUTPUT_TAIL = 2000;
+
+QProcessEnvironment WarpKateView::shellEnvironment() const
+{
+    // Only the built-in engine runs the shell integration
+    if (TerminalEmulator *emulator = qobject_cast<TerminalEmulator *>(m_terminalEmulator)) {
+        return emulator->exportedEnvironment();
+    }
+    return QProcessEnvironment();
+}
+
+void WarpKateView::explainFailure(const QString &command, const QString &directory, const QString &output, int exitCode)
+{
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    if (!config.readEntry("ExplainFailedCommands", false) || !m_aiService || !m_aiService->isReady()) {
+        return;
+    }
+    
+    // No shared context, so failures of a fan-out run all go in one call
+    QString query = QStringLiteral(
+        "The shell command `%1` run in %2 exited with code %3. The end of its output was:\n"
+        "```\n%4\n```\n"
+        "In at most two sentences, explain the likely cause and how to fix it."
+    ).arg(command, directory, QString::number(exitCode), output.right(FAILURE_OUTPUT_TAIL));
+    
+    m_aiService->generateBackgroundResponse(query, QString(),
+        [this, command, directory](const QString &response, bool isFinal) {
+            if (!isFinal || response.trimmed().isEmpty()) {
+                return;
+            }
+            
+            QTextCharFormat headerFormat;
+            headerFormat.setFontWeight(QFont::Bold);
+            headerFormat.setForeground(QBrush(QColor(75, 0, 130))); // Indigo
+            
+            QString where = QDir(m_terminalEmulator->currentWorkingDirectory()).relativeFilePath(directory);
+            QString title = where == QLatin1String(".") ? i18n("Why %1 failed:", command)
+                                                        : i18n("Why %1 failed in %2:", command, where);
+            int row = m_conversation->appendItem(ConversationModel::AIResponse, title, headerFormat);
+            m_conversation->appendLine(row, response.trimmed());
+            m_conversation->appendLine(row, QString());
+            m_conversationArea->scrollToBottom();
+        });
+}
+
 
 void WarpKateView::onTerminalOutput(const QString &output)
 {
@@ -1078,6 +1719,11 @@ void WarpKateView::onTerminalOutput(const QString &output)
         return;
     }
     
+    // Full-screen programs are shown on the grid, not in the transcript
+    if (m_rawInputMode) {
+        return;
+    }
+    
     // Clean the terminal output - remove escape sequences and control characters
     QString cleanedOutput = cleanTerminalOutput(output);
     
@@ -1098,82 +1744,88 @@ void WarpKateView::onTerminalOutput(const QString &output)
     QTextCharFormat outputFormat;
     outputFormat.setFontFamily(QStringLiteral("Monospace"));
     
-    // Add to conversation area
-    QTextCursor cursor = m_conversationArea->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    m_conversationArea->setTextCursor(cursor);
-    
-    // Only insert a block if we're not at the beginning of a block already
-    if (!cursor.atBlockStart()) {
-        cursor.insertBlock();
-    }
-    
-    // For simple text output, use the basic approach
+    // Each chunk of output is an item of its own, so long outputs never
+    // make an existing item grow; the item boundary is the line break
     if (!processedOutput.contains(QStringLiteral("<"))) {
-        cursor.setCharFormat(outputFormat);
-        cursor.insertText(processedOutput);
+        // For simple text output, use the basic approach
+        if (processedOutput.endsWith(QLatin1Char('\n'))) {
+            processedOutput.chop(1);
+        }
+        m_conversation->appendItem(ConversationModel::Output, processedOutput, outputFormat);
     } else {
-        // If we have HTML/rich text formatting, insert as HTML
-        cursor.insertHtml(processedOutput);
+        // If we have HTML/rich text formatting, keep its formats and links
+        int row = m_conversation->appendItem(ConversationModel::Output);
+        m_conversation->appendHtml(row, processedOutput);
     }
-    // Connect to the anchorClicked signal to handle clicks on links
-    connect(m_conversationArea, &QTextBrowser::anchorClicked, this, &WarpKateView::onLinkClicked, Qt::UniqueConnection);
-
-    // Ensure cursor is visible
-    // Connect to the anchorClicked signal to handle clicks on links
-    connect(m_conversationArea, &QTextBrowser::anchorClicked, 
-            this, &WarpKateView::onLinkClicked,
-            Qt::UniqueConnection);
-
-    // Ensure cursor is visible
-    // If the output contains HTML links, update interactive elements
-    if (processedOutput.contains(QStringLiteral("<a "))) {
-        QTimer::singleShot(100, this, &WarpKateView::updateInteractiveElements);
-    }
-    m_conversationArea->ensureCursorVisible();
-    m_conversationArea->ensureCursorVisible();
+    
+    m_conversationArea->scrollToBottom();
 }
 void WarpKateView::onCommandExecuted(const QString &command, const QString &output, int exitCode)
 {
     qDebug() << "WarpKate: Command executed:" << command << "with exit code:" << exitCode;
     
-    // Format and display the command completion info
-    QTextCursor cursor = m_conversationArea->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    m_conversationArea->setTextCursor(cursor);
+    // The shell is back at its prompt
+    if (!m_rawInputMode && m_foregroundPollTimer) {
+        m_foregroundPollTimer->stop();
+    }
     
-    // Add separator
-    cursor.insertBlock();
+    // The command may have changed the repository (commit, checkout, ...)
+    if (m_showGitStatus) {
+        GitStatusCache::instance().invalidate(m_terminalEmulator->currentWorkingDirectory());
+    }
     
-    // Format output based on exit code
+    // Index the command for semantic history search (no-op when disabled)
+    SemanticIndex::instance().addCommand(command, output, m_terminalEmulator->currentWorkingDirectory(), exitCode);
+    
+    // Format and display the command completion info
     QTextCharFormat resultFormat;
     resultFormat.setFontFamily(QStringLiteral("Monospace"));
     
+    // With shell integration the status of every pipeline stage is known
+    QString pipeline;
+    if (TerminalEmulator *emulator = qobject_cast<TerminalEmulator *>(m_terminalEmulator)) {
+        const QVector<int> stages = emulator->lastCommandRecord().pipeStatus;
+        if (stages.size() > 1 && std::any_of(stages.begin(), stages.end(), [](int status) { return status != 0; })) {
+            QStringList statuses;
+            for (int status : stages) {
+                statuses.append(QString::number(status));
+            }
+            pipeline = statuses.join(QLatin1Char(' '));
+        }
+    }
+    
+    int row;
     if (exitCode != 0) {
         // Command failed, use error formatting
         resultFormat.setForeground(QBrush(QColor(200, 0, 0))); // Red for errors
-        cursor.setCharFormat(resultFormat);
-        cursor.insertText(i18n("Command exited with code %1").arg(exitCode));
+        QString message = pipeline.isEmpty() ? i18n("Command exited with code %1").arg(exitCode)
+                                             : i18n("Command exited with code %1 (pipeline: %2)").arg(exitCode).arg(pipeline);
+        row = m_conversation->appendItem(ConversationModel::Notice, message, resultFormat);
     } else {
         // Show a subtle completed message
         resultFormat.setForeground(QBrush(QColor(0, 150, 0))); // Green for success
         resultFormat.setFontItalic(true);
-        cursor.setCharFormat(resultFormat);
-        cursor.insertText(i18n("Command completed successfully"));
+        QString message = pipeline.isEmpty() ? i18n("Command completed successfully")
+                                             : i18n("Command completed, but a pipeline stage failed (%1)").arg(pipeline);
+        row = m_conversation->appendItem(ConversationModel::Notice, message, resultFormat);
     }
     
-    cursor.setCharFormat(QTextCharFormat());
-    cursor.insertBlock();
+    // Add separator
+    m_conversation->appendLine(row, QString());
     
     // Make sure the view scrolls to show the completion status
-    m_conversationArea->ensureCursorVisible();
+    m_conversationArea->scrollToBottom();
+    
+    if (exitCode != 0) {
+        explainFailure(command, m_terminalEmulator->currentWorkingDirectory(), output, exitCode);
+    }
     
     // Update the block model with the complete output
     if (m_currentBlockId >= 0) {
         m_blockModel->setBlockOutput(m_currentBlockId, output);
         m_blockModel->setBlockExitCode(m_currentBlockId, exitCode);
-        m_blockModel->setBlockState(m_currentBlockId, exitCode == 0 ? Completed : Failed);
         m_blockModel->setBlockEndTime(m_currentBlockId, QDateTime::currentDateTime());
+        m_blockModel->setBlockState(m_currentBlockId, exitCode == 0 ? Completed : Failed);
     }
 }
 
@@ -1181,30 +1833,72 @@ void WarpKateView::onCommandDetected(const QString &command)
 {
     qDebug() << "WarpKate: Command detected:" << command;
     
-    // In a more complete implementation, we might update UI elements to show
-    // that a command is being executed, update a status bar, etc.
-    // For now, we'll just log it
+    // Watch for the command taking over the terminal
+    if (m_foregroundPollTimer) {
+        m_foregroundPollTimer->start();
+    }
+}
+
+void WarpKateView::updateInputMode()
+{
+    if (!m_terminalEmulator || !m_terminalDisplay) {
+        return;
+    }
+    
+    // Programs that only print (make, test runners) stay in the transcript
+    bool raw = m_terminalEmulator->isAlternateScreenActive() || m_terminalEmulator->isRawModeActive();
+    if (raw != m_rawInputMode) {
+        setRawInputMode(raw);
+    }
+}
+
+void WarpKateView::setRawInputMode(bool raw)
+{
+    qDebug() << "WarpKate: Raw input mode" << (raw ? "enabled" : "disabled");
+    
+    m_rawInputMode = raw;
+    
+    // The grid replaces the transcript and prompt while a program owns the terminal
+    m_conversationArea->setVisible(!raw);
+    m_promptPanel->setVisible(!raw);
+    m_terminalDisplay->setVisible(raw);
+    
+    if (raw) {
+        // Keep polling so we notice when the program exits
+        m_foregroundPollTimer->start();
+        m_terminalDisplay->setFocus(Qt::OtherFocusReason);
+    } else {
+        m_foregroundPollTimer->stop();
+        m_promptInput->setFocus(Qt::OtherFocusReason);
+        m_conversationArea->scrollToBottom();
+    }
+}
+
+void WarpKateView::onGitStatusChanged(const QString &repositoryRoot)
+{
+    const QList<int> rows = m_pendingGitHeaders.values(repositoryRoot);
+    if (rows.isEmpty()) {
+        return;
+    }
+    m_pendingGitHeaders.remove(repositoryRoot);
+    
+    GitStatus status = GitStatusCache::instance().statusFor(repositoryRoot);
+    for (int row : rows) {
+        appendGitStatus(m_conversation, row, status);
+    }
 }
 
 void WarpKateView::onWorkingDirectoryChanged(const QString &directory)
 {
     qDebug() << "WarpKate: Working directory changed:" << directory;
     
-    // Update the conversation area with the directory change information
-    QTextCursor cursor = m_conversationArea->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    m_conversationArea->setTextCursor(cursor);
-    
     // Format for directory change notification
     QTextCharFormat dirFormat;
     dirFormat.setFontItalic(true);
     dirFormat.setForeground(QBrush(QColor(100, 100, 100))); // Gray for info messages
     
-    // Add notification text
-    cursor.insertBlock();
-    cursor.setCharFormat(dirFormat);
-    cursor.insertText(i18n("Directory changed to: %1").arg(directory));
-    cursor.setCharFormat(QTextCharFormat());
+    // Update the conversation area with the directory change information
+    m_conversation->appendItem(ConversationModel::Notice, i18n("Directory changed to: %1").arg(directory), dirFormat);
     
     // Update the block model with the directory information
     if (m_currentBlockId >= 0) {
@@ -1213,43 +1907,32 @@ void WarpKateView::onWorkingDirectoryChanged(const QString &directory)
     }
     
     // Make sure the view scrolls to show the notification
-    m_conversationArea->ensureCursorVisible();
+    m_conversationArea->scrollToBottom();
 }
 
 void WarpKateView::onShellFinished(int exitCode)
 {
     qDebug() << "WarpKate: Shell process finished with exit code:" << exitCode;
     
-    // Format and display the shell termination message
-    QTextCursor cursor = m_conversationArea->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    m_conversationArea->setTextCursor(cursor);
-    
     // Format for shell termination message
     QTextCharFormat shellExitFormat;
     shellExitFormat.setFontWeight(QFont::Bold);
     
+    // Format and display the shell termination message
+    int row;
     if (exitCode != 0) {
         // Shell terminated abnormally
         shellExitFormat.setForeground(QBrush(QColor(200, 0, 0))); // Red for errors
-        
-        cursor.insertBlock();
-        cursor.setCharFormat(shellExitFormat);
-        cursor.insertText(i18n("Shell process terminated with exit code %1").arg(exitCode));
+        row = m_conversation->appendItem(ConversationModel::Notice, i18n("Shell process terminated with exit code %1").arg(exitCode), shellExitFormat);
     } else {
         // Shell terminated normally
         shellExitFormat.setForeground(QBrush(QColor(0, 100, 0))); // Green for success
-        
-        cursor.insertBlock();
-        cursor.setCharFormat(shellExitFormat);
-        cursor.insertText(i18n("Shell session ended"));
+        row = m_conversation->appendItem(ConversationModel::Notice, i18n("Shell session ended"), shellExitFormat);
     }
-    
-    cursor.setCharFormat(QTextCharFormat());
-    cursor.insertBlock();
+    m_conversation->appendLine(row, QString());
     
     // Make sure the view scrolls to show the termination message
-    m_conversationArea->ensureCursorVisible();
+    m_conversationArea->scrollToBottom();
     
     // Optionally, we could prompt the user to start a new shell session here
     // For now, we'll just log the event
@@ -1273,35 +1956,16 @@ void WarpKateView::setupAIService()
 
 void WarpKateView::handleAIResponse(const QString &response, bool isFinal)
 {
-    // Get the conversation area and position cursor at the end
-    QTextCursor cursor = m_conversationArea->textCursor();
+    // The conversation was cleared while waiting for the response
+    if (m_aiResponseRow < 0) {
+        return;
+    }
+    int row = m_aiResponseRow;
     
-    // If this is the first response chunk, remove the "Thinking..." text
+    // The final response replaces the "Thinking..." text completely,
+    // streamed chunks are appended to it
     if (isFinal) {
-        // For the final response, replace the "Thinking..." text completely
-        // Find the last occurrence of "AI Response:" and navigate to it
-        QTextDocument *doc = m_conversationArea->document();
-        QTextCursor findCursor(doc);
-        findCursor.movePosition(QTextCursor::End);
-        
-        // Search backward for the last "Thinking..." text
-        while(findCursor.movePosition(QTextCursor::PreviousBlock, QTextCursor::MoveAnchor)) {
-            if (findCursor.block().text().contains(QStringLiteral("Thinking..."))) {
-                // Found the "Thinking..." text, select the block
-                findCursor.select(QTextCursor::BlockUnderCursor);
-                findCursor.removeSelectedText();
-                
-                // Position cursor here to insert the response
-                m_conversationArea->setTextCursor(findCursor);
-                cursor = findCursor;
-                break;
-            }
-        }
-    } else {
-        // For streaming responses, find where we need to append
-        // Look for last AI Response block or last response chunk
-        cursor.movePosition(QTextCursor::End);
-        m_conversationArea->setTextCursor(cursor);
+        m_conversation->setText(row, QString());
     }
     
     // Format for code blocks in responses
@@ -1316,65 +1980,41 @@ void WarpKateView::handleAIResponse(const QString &response, bool isFinal)
     static bool inCodeBlock = false;
     
     // Process and format the response text
-    QStringList lines = response.split(QStringLiteral("\n"));
-    for (int i = 0; i < lines.size(); ++i) {
-        QString line = lines[i];
-        
+    const QStringList lines = response.split(QStringLiteral("\n"));
+    for (const QString &line : lines) {
         // Check for code block delimiters (```), commonly used in markdown
         if (line.trimmed().startsWith(QStringLiteral("```"))) {
             inCodeBlock = !inCodeBlock;
-            
-            // Insert a new block if not at start
-            if (cursor.position() > 0 && !cursor.atBlockStart()) {
-                cursor.insertBlock();
-            }
-            
-            // Insert the code block delimiter
-            cursor.insertText(line);
-            cursor.insertBlock();
+            m_conversation->appendLine(row, line);
             continue;
         }
         
-        // If not already at the start of a block, insert a new one
-        if (i > 0 || (!cursor.atBlockStart() && !cursor.atStart())) {
-            cursor.insertBlock();
-        }
-        
         // Apply appropriate format based on whether in code block
-        if (inCodeBlock) {
-            cursor.setCharFormat(codeFormat);
-        } else {
-            cursor.setCharFormat(regularFormat);
-        }
-        
-        // Insert the line
-        cursor.insertText(line);
+        m_conversation->appendLine(row, line, inCodeBlock ? codeFormat : regularFormat);
     }
     
     // If this is the final response, add any finishing touches
     if (isFinal) {
         // Reset code block state for next response
         inCodeBlock = false;
+        m_aiResponseRow = -1;
         
         // Add a blank line after the response
-        cursor.insertBlock();
+        m_conversation->appendLine(row, QString());
         
         // Add usage hint for first-time users
         static bool firstResponse = true;
         if (firstResponse) {
-            cursor.insertBlock();
             QTextCharFormat hintFormat;
             hintFormat.setFontItalic(true);
             hintFormat.setForeground(QBrush(QColor(100, 100, 100))); // Gray
-            cursor.setCharFormat(hintFormat);
-            cursor.insertText(QStringLiteral("Tip: Select text in the response and use 'Insert to Editor' to paste it into your document."));
-            cursor.setCharFormat(QTextCharFormat());
+            m_conversation->appendLine(row, QStringLiteral("Tip: Select text in the response and use 'Insert to Editor' to paste it into your document."), hintFormat);
             firstResponse = false;
         }
     }
     
     // Ensure visible
-    m_conversationArea->ensureCursorVisible();
+    m_conversationArea->scrollToBottom();
 }
 
 void WarpKateView::refreshUIFromSettings()
@@ -1940,19 +2580,12 @@ void WarpKateView::openFile(const QString &filePath)
         qWarning() << "WarpKate: Failed to open file:" << filePath;
         
         // Add a notification to the conversation area
-        QTextCursor cursor = m_conversationArea->textCursor();
-        cursor.movePosition(QTextCursor::End);
-        m_conversationArea->setTextCursor(cursor);
-        
         QTextCharFormat errorFormat;
         errorFormat.setForeground(QBrush(QColor(200, 0, 0))); // Red
         
-        cursor.insertBlock();
-        cursor.setCharFormat(errorFormat);
-        cursor.insertText(i18n("Error: Failed to open file: %1", filePath));
-        cursor.setCharFormat(QTextCharFormat());
+        m_conversation->appendItem(ConversationModel::Notice, i18n("Error: Failed to open file: %1", filePath), errorFormat);
         
-        m_conversationArea->ensureCursorVisible();
+        m_conversationArea->scrollToBottom();
     }
 }
 
@@ -1971,19 +2604,12 @@ void WarpKateView::openDirectory(const QString &dirPath)
         qWarning() << "WarpKate: Failed to open directory:" << dirPath;
         
         // Add a notification to the conversation area
-        QTextCursor cursor = m_conversationArea->textCursor();
-        cursor.movePosition(QTextCursor::End);
-        m_conversationArea->setTextCursor(cursor);
-        
         QTextCharFormat errorFormat;
         errorFormat.setForeground(QBrush(QColor(200, 0, 0))); // Red
         
-        cursor.insertBlock();
-        cursor.setCharFormat(errorFormat);
-        cursor.insertText(i18n("Error: Failed to open directory: %1", dirPath));
-        cursor.setCharFormat(QTextCharFormat());
+        m_conversation->appendItem(ConversationModel::Notice, i18n("Error: Failed to open directory: %1", dirPath), errorFormat);
         
-        m_conversationArea->ensureCursorVisible();
+        m_conversationArea->scrollToBottom();
     }
 }
 
@@ -1998,19 +2624,12 @@ void WarpKateView::openFileInKate(const QString &filePath)
         qWarning() << "WarpKate: File does not exist:" << filePath;
         
         // Add a notification to the conversation area
-        QTextCursor cursor = m_conversationArea->textCursor();
-        cursor.movePosition(QTextCursor::End);
-        m_conversationArea->setTextCursor(cursor);
-        
         QTextCharFormat errorFormat;
         errorFormat.setForeground(QBrush(QColor(200, 0, 0))); // Red
         
-        cursor.insertBlock();
-        cursor.setCharFormat(errorFormat);
-        cursor.insertText(i18n("Error: File does not exist: %1", filePath));
-        cursor.setCharFormat(QTextCharFormat());
+        m_conversation->appendItem(ConversationModel::Notice, i18n("Error: File does not exist: %1", filePath), errorFormat);
         
-        m_conversationArea->ensureCursorVisible();
+        m_conversationArea->scrollToBottom();
         return;
     }
     
@@ -2027,20 +2646,13 @@ void WarpKateView::copyPathToClipboard(const QString &filePath)
     qDebug() << "WarpKate: Copied path to clipboard:" << filePath;
     
     // Add a confirmation to the conversation area
-    QTextCursor cursor = m_conversationArea->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    m_conversationArea->setTextCursor(cursor);
-    
     QTextCharFormat infoFormat;
     infoFormat.setFontItalic(true);
     infoFormat.setForeground(QBrush(QColor(0, 100, 0))); // Green
     
-    cursor.insertBlock();
-    cursor.setCharFormat(infoFormat);
-    cursor.insertText(i18n("Copied to clipboard: %1", filePath));
-    cursor.setCharFormat(QTextCharFormat());
+    m_conversation->appendItem(ConversationModel::Notice, i18n("Copied to clipboard: %1", filePath), infoFormat);
     
-    m_conversationArea->ensureCursorVisible();
+    m_conversationArea->scrollToBottom();
 }
 
 void WarpKateView::handleFileItemClicked(const QString &filePath, bool isDirectory)
@@ -2083,37 +2695,18 @@ void WarpKateView::onLinkClicked(const QUrl &url)
     if (url.scheme() == QStringLiteral("file")) {
         QString filePath = url.toLocalFile();
         QFileInfo fileInfo(filePath);
-        // Find which element was clicked for feedback
-        int clickedIndex = -1;
-        for (int i = 0; i < m_interactiveElements.size(); ++i) {
-            QString href = m_interactiveElements[i].format.anchorHref();
-            if (href == url.toString()) {
-                clickedIndex = i;
-                break;
-            }
-        }
-        
-        // Show click feedback
-        flashClickFeedback(clickedIndex);
         
         // Check if the path exists
         if (!fileInfo.exists()) {
             qWarning() << "WarpKate: File does not exist:" << filePath;
             
             // Add a notification to the conversation area
-            QTextCursor cursor = m_conversationArea->textCursor();
-            cursor.movePosition(QTextCursor::End);
-            m_conversationArea->setTextCursor(cursor);
-            
             QTextCharFormat errorFormat;
             errorFormat.setForeground(QBrush(QColor(200, 0, 0))); // Red
             
-            cursor.insertBlock();
-            cursor.setCharFormat(errorFormat);
-            cursor.insertText(i18n("Error: File does not exist: %1", filePath));
-            cursor.setCharFormat(QTextCharFormat());
+            m_conversation->appendItem(ConversationModel::Notice, i18n("Error: File does not exist: %1", filePath), errorFormat);
             
-            m_conversationArea->ensureCursorVisible();
+            m_conversationArea->scrollToBottom();
             return;
         }
         
@@ -2175,19 +2768,12 @@ void WarpKateView::executeFile(const QString &filePath)
         qWarning() << "WarpKate: Cannot execute file (not found):" << filePath;
         
         // Add a notification to the conversation area
-        QTextCursor cursor = m_conversationArea->textCursor();
-        cursor.movePosition(QTextCursor::End);
-        m_conversationArea->setTextCursor(cursor);
-        
         QTextCharFormat errorFormat;
         errorFormat.setForeground(QBrush(QColor(200, 0, 0))); // Red
         
-        cursor.insertBlock();
-        cursor.setCharFormat(errorFormat);
-        cursor.insertText(i18n("Error: File does not exist: %1", filePath));
-        cursor.setCharFormat(QTextCharFormat());
+        m_conversation->appendItem(ConversationModel::Notice, i18n("Error: File does not exist: %1", filePath), errorFormat);
         
-        m_conversationArea->ensureCursorVisible();
+        m_conversationArea->scrollToBottom();
         return;
     }
     
@@ -2195,19 +2781,12 @@ void WarpKateView::executeFile(const QString &filePath)
         qWarning() << "WarpKate: Cannot execute file (not executable):" << filePath;
         
         // Add a notification to the conversation area
-        QTextCursor cursor = m_conversationArea->textCursor();
-        cursor.movePosition(QTextCursor::End);
-        m_conversationArea->setTextCursor(cursor);
-        
         QTextCharFormat errorFormat;
         errorFormat.setForeground(QBrush(QColor(200, 0, 0))); // Red
         
-        cursor.insertBlock();
-        cursor.setCharFormat(errorFormat);
-        cursor.insertText(i18n("Error: File is not executable: %1", filePath));
-        cursor.setCharFormat(QTextCharFormat());
+        m_conversation->appendItem(ConversationModel::Notice, i18n("Error: File is not executable: %1", filePath), errorFormat);
         
-        m_conversationArea->ensureCursorVisible();
+        m_conversationArea->scrollToBottom();
         return;
     }
     
@@ -2298,19 +2877,12 @@ void WarpKateView::executeFile(const QString &filePath)
     // Execute the command through our terminal
     if (m_terminalEmulator) {
         // Add a notification to the conversation area
-        QTextCursor cursor = m_conversationArea->textCursor();
-        cursor.movePosition(QTextCursor::End);
-        m_conversationArea->setTextCursor(cursor);
-        
         QTextCharFormat infoFormat;
         infoFormat.setForeground(QBrush(QColor(0, 150, 0))); // Green
         
-        cursor.insertBlock();
-        cursor.setCharFormat(infoFormat);
-        cursor.insertText(i18n("Executing: %1", command));
-        cursor.setCharFormat(QTextCharFormat());
+        m_conversation->appendItem(ConversationModel::Notice, i18n("Executing: %1", command), infoFormat);
         
-        m_conversationArea->ensureCursorVisible();
+        m_conversationArea->scrollToBottom();
         
         // Execute the command
         executeCommand(command);
@@ -2329,180 +2901,12 @@ void WarpKateView::executeFile(const QString &filePath)
         process->start(QStringLiteral("/bin/bash"), QStringList() << QStringLiteral("-c") << command);
         
         // Add a notification to the conversation area
-        QTextCursor cursor = m_conversationArea->textCursor();
-        cursor.movePosition(QTextCursor::End);
-        m_conversationArea->setTextCursor(cursor);
-        
         QTextCharFormat infoFormat;
         infoFormat.setForeground(QBrush(QColor(0, 150, 0))); // Green
         
-        cursor.insertBlock();
-        cursor.setCharFormat(infoFormat);
-        cursor.insertText(i18n("Executing (external): %1", command));
-        cursor.setCharFormat(QTextCharFormat());
-        
-        m_conversationArea->ensureCursorVisible();
-    }
-}
-// ==== Add these methods to warpkateview.cpp ====
-
-/**
- * Update the list of interactive elements in the conversation area
- */
-void WarpKateView::updateInteractiveElements()
-{
-    m_interactiveElements.clear();
-    
-    QTextDocument *doc = m_conversationArea->document();
-    
-    // Scan document for links (a href tags)
-    for (QTextBlock block = doc->begin(); block.isValid(); block = block.next()) {
-        for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it) {
-            QTextFragment fragment = it.fragment();
-            
-            if (fragment.isValid()) {
-                QTextCharFormat format = fragment.charFormat();
-                
-                if (format.isAnchor()) {
-                    // Found a link - create an ExtraSelection for it
-                    QString href = format.anchorHref();
-                    
-                    // Only include file:// URLs
-                    if (href.startsWith(QStringLiteral("file://"))) {
-                        QTextEdit::ExtraSelection selection;
-                        
-                        // Normal style (will be modified when focused)
-                        selection.format.setForeground(QBrush(QColor(0, 0, 200))); // Dark blue
-                        selection.format.setBackground(QBrush(QColor(240, 240, 255))); // Light blue background
-                        selection.format.setProperty(QTextFormat::AnchorHref, href);
-                        
-                        // Get the cursor for this fragment
-                        QTextCursor cursor(doc);
-                        cursor.setPosition(fragment.position());
-                        cursor.setPosition(fragment.position() + fragment.length(), QTextCursor::KeepAnchor);
-                        selection.cursor = cursor;
-                        
-                        m_interactiveElements.append(selection);
-                    }
-                }
-            }
-        }
-    }
-    
-    // Reset focus index if needed
-    if (m_currentFocusIndex >= m_interactiveElements.size()) {
-        m_currentFocusIndex = -1;
-    }
-    
-    // Apply styles
-    applyInteractiveElementStyles();
-}
-
-/**
- * Focus the next interactive element (when Tab is pressed)
- */
-void WarpKateView::focusNextInteractiveElement()
-{
-    // Update the list first in case content has changed
-    updateInteractiveElements();
-    
-    if (m_interactiveElements.isEmpty()) {
-        return;
-    }
-    
-    // Move to next item or wrap around
-    m_currentFocusIndex++;
-    if (m_currentFocusIndex >= m_interactiveElements.size()) {
-        m_currentFocusIndex = 0;
-    }
-    
-    // Apply styles and scroll to the focused element
-    applyInteractiveElementStyles();
-    
-    // Scroll to make the focused element visible
-    if (m_currentFocusIndex >= 0 && m_currentFocusIndex < m_interactiveElements.size()) {
-        m_conversationArea->setTextCursor(m_interactiveElements[m_currentFocusIndex].cursor);
-        m_conversationArea->ensureCursorVisible();
-    }
-}
-
-/**
- * Focus the previous interactive element (when Shift+Tab is pressed)
- */
-void WarpKateView::focusPreviousInteractiveElement()
-{
-    // Update the list first in case content has changed
-    updateInteractiveElements();
-    
-    if (m_interactiveElements.isEmpty()) {
-        return;
-    }
-    
-    // Move to previous item or wrap around
-    m_currentFocusIndex--;
-    if (m_currentFocusIndex < 0) {
-        m_currentFocusIndex = m_interactiveElements.size() - 1;
-    }
-    
-    // Apply styles and scroll to the focused element
-    applyInteractiveElementStyles();
-    
-    // Scroll to make the focused element visible
-    if (m_currentFocusIndex >= 0 && m_currentFocusIndex < m_interactiveElements.size()) {
-        m_conversationArea->setTextCursor(m_interactiveElements[m_currentFocusIndex].cursor);
-        m_conversationArea->ensureCursorVisible();
-    }
-}
-
-/**
- * Apply highlighting styles to interactive elements based on current focus
- */
-void WarpKateView::applyInteractiveElementStyles()
-{
-    // Create a new list of extra selections
-    QList<QTextEdit::ExtraSelection> extraSelections;
-    
-    // Add each interactive element with appropriate style
-    for (int i = 0; i < m_interactiveElements.size(); ++i) {
-        QTextEdit::ExtraSelection selection = m_interactiveElements[i];
-        
-        if (i == m_currentFocusIndex) {
-            // Focused item - highlight more intensely
-            selection.format.setForeground(QBrush(QColor(0, 0, 200))); // Dark blue text
-            selection.format.setBackground(QBrush(QColor(200, 220, 255))); // Stronger blue background
-            selection.format.setFontWeight(QFont::Bold);
-        } else if (i == m_lastClickedIndex && m_clickFeedbackTimer->isActive()) {
-            // Clicked item during feedback flash - red highlight
-            selection.format.setForeground(QBrush(QColor(200, 0, 0))); // Red text
-            selection.format.setBackground(QBrush(QColor(255, 220, 220))); // Light red background
-            selection.format.setFontWeight(QFont::Bold);
-        } else {
-            // Normal item (not focused) - subtle styling
-            selection.format.setForeground(QBrush(QColor(0, 0, 150))); // Blue text
-            selection.format.setBackground(QBrush(Qt::transparent)); // No background
-            selection.format.setFontWeight(QFont::Normal);
-        }
-        
-        extraSelections.append(selection);
-    }
-    
-    // Apply the extra selections to the text edit
-    m_conversationArea->setExtraSelections(extraSelections);
-}
-
-/**
- * Flash a click feedback effect on the clicked element
- */
-void WarpKateView::flashClickFeedback(int elementIndex)
-{
-    if (elementIndex >= 0 && elementIndex < m_interactiveElements.size()) {
-        m_lastClickedIndex = elementIndex;
-        
-        // Apply styles with click feedback
-        applyInteractiveElementStyles();
+        m_conversation->appendItem(ConversationModel::Notice, i18n("Executing (external): %1", command), infoFormat);
         
-        // Start timer to remove feedback after a short delay
-        m_clickFeedbackTimer->start();
+        m_conversationArea->scrollToBottom();
     }
 }
 
@@ -13,9 +13,10 @@
 
 #include <QObject>
 #include <QWidget>
+#include <QMultiHash>
+#include <QProcessEnvironment>
 #include <QDockWidget>
 #include <QTextEdit>
-#include <QTextBrowser>
 #include <QLineEdit>
 #include <QToolBar>
 #include <QLabel>
@@ -28,9 +29,14 @@
 #include "aiservice.h"
 
 class WarpKatePlugin;
-class TerminalEmulator;
-class TerminalEmulator;
+class TerminalBackend;
 class BlockModel;
+class ShellProfiler;
+class FanOutRunner;
+class RunbookRunner;
+class ConversationModel;
+class ConversationTimeline;
+class SearchBlockView;
 // We don't use TerminalBlockView in the simplified interface
 class QAction;
 
@@ -142,11 +148,56 @@ private:
      */
     void showPreferences();
     
+    /**
+     * Show shell startup and prompt latency measurements in the conversation
+     */
+    void showShellProfile();
+    
+    /**
+     * Search the command history for commands similar to the prompt input,
+     * or the current editor line if the input is empty
+     */
+    void findSimilarCommands();
+    
+    /**
+     * Run the prompt input, or the current editor line, in each directory
+     * of a set chosen by glob or git submodules; cancels a run in progress
+     */
+    void fanOutCommand();
+    
+    /**
+     * Save the most recent blocks as a runbook and open it for editing
+     */
+    void saveBlocksAsRunbook();
+    
+    /**
+     * Pick a saved runbook and run it; cancels a run in progress
+     */
+    void runRunbook();
+    
     /**
      * Handle input text submission
      */
     void submitInput();
     
+    /**
+     * Turn "z keywords" into a cd to the best matching indexed directory
+     * @param command Command line as typed
+     * @return The cd command, or the command unchanged if it is no jump or nothing matches
+     */
+    QString resolveDirectoryJump(const QString &command) const;
+    
+    /**
+     * Run a plain rg search in the search block instead of the terminal
+     *
+     * Only a single rg command without pipes, redirections or other shell
+     * syntax, and without listing options like --files or -l, is taken.
+     *
+     * @param command Command line as typed
+     * @return True if the search block took the command
+     */
+    bool runSearchBlock(const QString &command);
+    
     /**
      * Get the current text from the editor (current line or selection)
      * @return Current text
@@ -173,6 +224,22 @@ private:
      */
     void handleAIResponse(const QString &response, bool isFinal);
     
+    /**
+     * Ask the AI in the background why a command failed, if enabled, and
+     * add the answer to the conversation when it arrives
+     * @param command The command that failed
+     * @param directory Directory it ran in
+     * @param output Its output
+     * @param exitCode Its exit code
+     */
+    void explainFailure(const QString &command, const QString &directory, const QString &output, int exitCode);
+    
+    /**
+     * Get the environment the user exported in the terminal's shell
+     * @return Environment at the last prompt, empty if the shell does not report it
+     */
+    QProcessEnvironment shellEnvironment() const;
+    
     /**
      * Set up the AI service
      */
@@ -312,6 +379,48 @@ private Q_SLOTS:
      */
     void onCommandExecuted(const QString &command, const QString &output, int exitCode);
     
+    /**
+     * Show a finished fan-out job as a sub-block
+     * @param index Job index
+     */
+    void onFanOutJobFinished(int index);
+    
+    /**
+     * Show the results matrix of a finished fan-out run
+     */
+    void onFanOutFinished();
+    
+    /**
+     * Record the outcome of a finished search block
+     * @param exitCode rg's exit code, -1 if it was killed
+     */
+    void onSearchFinished(int exitCode);
+    
+    /**
+     * Open a search result in Kate at its match
+     * @param filePath Absolute path of the file
+     * @param line Line number, 1-based
+     * @param column Column, 0-based
+     */
+    void openSearchResult(const QString &filePath, int line, int column);
+    
+    /**
+     * Create the block of a started runbook step
+     * @param index Step index
+     */
+    void onRunbookStepStarted(int index);
+    
+    /**
+     * Show a finished or skipped runbook step as a sub-block
+     * @param index Step index
+     */
+    void onRunbookStepFinished(int index);
+    
+    /**
+     * Show the summary of a finished runbook run
+     */
+    void onRunbookFinished();
+    
     /**
      * Handle command detection
      * @param command Detected command text
@@ -324,12 +433,26 @@ private Q_SLOTS:
      */
     void onWorkingDirectoryChanged(const QString &directory);
     
+    /**
+     * Fill in block headers waiting for a repository's git status
+     * @param repositoryRoot Worktree root of the repository
+     */
+    void onGitStatusChanged(const QString &repositoryRoot);
+    
     /**
      * Handle shell process termination
      * @param exitCode Shell exit code
      */
     void onShellFinished(int exitCode);
     
+    /**
+     * Switch between line-edited and raw passthrough input as needed
+     *
+     * Raw mode is used while the terminal shows the alternate screen or
+     * a program other than the shell owns the foreground.
+     */
+    void updateInputMode();
+    
 protected:
     /**
      * Event filter for handling keyboard events in the input area
@@ -337,26 +460,22 @@ protected:
     bool eventFilter(QObject *obj, QEvent *event) override;
 
 private:
-    // For interactive element highlighting
-    int m_currentFocusIndex = -1;
-    QList<QTextEdit::ExtraSelection> m_interactiveElements;
-    QTimer *m_clickFeedbackTimer = nullptr;
-    int m_lastClickedIndex = -1;
-    
-    // Methods for interactive element handling
-    void updateInteractiveElements();
-    void focusNextInteractiveElement();
-    void focusPreviousInteractiveElement();
-    void applyInteractiveElementStyles();
-    void flashClickFeedback(int elementIndex);
     void navigateCommandHistory(int direction);
+    
+    /**
+     * Enter or leave raw passthrough input mode
+     * @param raw Whether keys should go straight to the terminal grid
+     */
+    void setRawInputMode(bool raw);
     WarpKatePlugin *m_plugin;
     KTextEditor::MainWindow *m_mainWindow;
     
     // UI components
     QWidget *m_toolView;
     QWidget *m_terminalWidget;
-    QTextBrowser *m_conversationArea;
+    ConversationModel *m_conversation;         // Items of the conversation
+    ConversationTimeline *m_conversationArea;  // Virtualized view of m_conversation
+    int m_aiResponseRow;                       // Item of the AI response being waited for, -1 if none
     QTextEdit *m_promptInput;
     QToolBar *m_toolbar;
     QLabel *m_inputModeLabel;
@@ -367,8 +486,23 @@ private:
     QIcon m_aiIcon;          // AI mode icon
     
     // Terminal components
-    TerminalEmulator *m_terminalEmulator;
+    TerminalBackend *m_terminalEmulator;
     BlockModel *m_blockModel;
+    QWidget *m_terminalDisplay;      // Grid shown for full-screen programs
+    QWidget *m_promptPanel;          // Prompt input and mode buttons
+    QTimer *m_foregroundPollTimer;   // Polls the PTY foreground while commands run
+    bool m_rawInputMode;             // Keys bypass the prompt and go to the grid
+    ShellProfiler *m_shellProfiler;  // Startup and prompt latency measurements
+    bool m_showGitStatus;            // Annotate block headers with the git status
+    QMultiHash<QString, int> m_pendingGitHeaders; // Header item rows by repository root
+    FanOutRunner *m_fanOutRunner;    // Runs a command across many directories
+    QList<int> m_fanOutBlockIds;     // Block per fan-out job
+    QString m_fanOutPattern;         // Directory set of the last fan-out
+    SearchBlockView *m_searchBlock;  // Streaming results of rg searches
+    int m_searchBlockId;             // Block of the running search, -1 if none
+    int m_searchRow;                 // Conversation item of the running search
+    RunbookRunner *m_runbookRunner;  // Runs saved runbooks as dependency graphs
+    QList<int> m_runbookBlockIds;    // Block per runbook step, -1 until started
     
     // Actions
     QAction *m_showTerminalAction;
@@ -377,6 +511,11 @@ private:
     QAction *m_insertToEditorAction;
     QAction *m_saveToObsidianAction;
     QAction *m_checkCodeAction;
+    QAction *m_shellProfileAction;
+    QAction *m_findSimilarAction;
+    QAction *m_fanOutAction;
+    QAction *m_saveRunbookAction;
+    QAction *m_runRunbookAction;
     
     // State variables
     int m_currentBlockId;
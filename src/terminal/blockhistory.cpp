@@ -0,0 +1,574 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "blockhistory.h"
+#include "blockmodel.h"
+
+#include <KConfigGroup>
+#include <KSharedConfig>
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QLockFile>
+#include <QRandomGenerator>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <array>
+
+// Chunk size limits (bytes); the masks below aim for AVERAGE_CHUNK
+static const qsizetype MIN_CHUNK = 2 * 1024;
+static const qsizetype AVERAGE_CHUNK = 8 * 1024;
+static const qsizetype MAX_CHUNK = 64 * 1024;
+
+// FastCDC normalized chunking: a harder mask before the average size and
+// an easier one after it pull chunk sizes towards the average
+static const quint64 MASK_HARD = 0x0003590703530000ULL;
+static const quint64 MASK_EASY = 0x0000d90003530000ULL;
+
+// Oldest entries are removed beyond this many
+static const int MAX_ENTRIES = 2000;
+
+// Index writes are batched for this long (ms)
+static const int SAVE_DELAY = 2000;
+
+// Bumped when the index file layout changes; version 1 had sequential ids
+static const quint32 INDEX_FILE_VERSION = 2;
+
+// How long to wait for another instance to finish with the index (ms)
+static const int LOCK_TIMEOUT = 5000;
+
+// Chunks written or reused this recently are kept even when unreferenced,
+// they may belong to an entry another instance has not indexed yet (ms)
+static const qint64 CHUNK_GRACE = 10 * 60 * 1000;
+
+static BlockHistory *s_instance = nullptr;
+
+/**
+ * Get the gear table of the rolling hash
+ *
+ * Generated with splitmix64 from a fixed seed, so chunk boundaries, and
+ * with them the deduplication, are stable across runs.
+ *
+ * @return 256 pseudo-random 64 bit values
+ */
+static const quint64 *gearTable()
+{
+    static const std::array<quint64, 256> table = []() {
+        std::array<quint64, 256> values;
+        quint64 state = 0x5741524b4b415445ULL;
+        for (quint64 &value : values) {
+            state += 0x9e3779b97f4a7c15ULL;
+            quint64 z = state;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            value = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+/**
+ * Find the end of the chunk starting at some data
+ * @param data Start of the chunk
+ * @param size Bytes left
+ * @return Length of the chunk
+ */
+static qsizetype cutPoint(const uchar *data, qsizetype size)
+{
+    if (size <= MIN_CHUNK) {
+        return size;
+    }
+
+    const quint64 *gear = gearTable();
+    qsizetype normal = qMin(size, AVERAGE_CHUNK);
+    qsizetype maximum = qMin(size, MAX_CHUNK);
+    quint64 hash = 0;
+
+    // Bytes before the minimum size never end a chunk, so skip hashing them
+    qsizetype i = MIN_CHUNK;
+    for (; i < normal; ++i) {
+        hash = (hash << 1) + gear[data[i]];
+        if (!(hash & MASK_HARD)) {
+            return i;
+        }
+    }
+    for (; i < maximum; ++i) {
+        hash = (hash << 1) + gear[data[i]];
+        if (!(hash & MASK_EASY)) {
+            return i;
+        }
+    }
+    return maximum;
+}
+
+/**
+ * Write an entry to the index
+ * @param stream Index stream
+ * @param entry Entry
+ * @return The stream
+ */
+static QDataStream &operator<<(QDataStream &stream, const BlockHistory::Entry &entry)
+{
+    return stream << entry.id << entry.command << entry.directory << entry.startTime << entry.endTime
+                  << qint32(entry.exitCode) << entry.outputSize << entry.chunks;
+}
+
+/**
+ * Read an entry from the index
+ * @param stream Index stream
+ * @param entry Receives the entry
+ * @return The stream
+ */
+static QDataStream &operator>>(QDataStream &stream, BlockHistory::Entry &entry)
+{
+    qint32 exitCode = 0;
+    stream >> entry.id >> entry.command >> entry.directory >> entry.startTime >> entry.endTime
+           >> exitCode >> entry.outputSize >> entry.chunks;
+    entry.exitCode = exitCode;
+    return stream;
+}
+
+// Orders entries by when they finished, oldest first
+static bool finishedBefore(const BlockHistory::Entry &a, const BlockHistory::Entry &b)
+{
+    return a.endTime < b.endTime;
+}
+
+BlockHistory &BlockHistory::instance()
+{
+    if (!s_instance) {
+        s_instance = new BlockHistory();
+    }
+    return *s_instance;
+}
+
+BlockHistory::BlockHistory(QObject *parent)
+    : QObject(parent)
+    , m_pendingWrites(0)
+    , m_loading(false)
+    , m_loaded(false)
+{
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(SAVE_DELAY);
+    connect(&m_saveTimer, &QTimer::timeout, this, &BlockHistory::save);
+
+    // The instance lives until exit, so write pending changes on the way out
+    connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, [this]() {
+        if (m_saveTimer.isActive()) {
+            m_saveTimer.stop();
+            save();
+        }
+    });
+
+    // Nothing to read while the history is off; addBlock() loads it once enabled
+    if (isEnabled()) {
+        load();
+    }
+}
+
+BlockHistory::~BlockHistory()
+{
+    if (m_saveTimer.isActive()) {
+        save();
+    }
+}
+
+bool BlockHistory::isEnabled()
+{
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    return config.readEntry("PersistBlockHistory", false);
+}
+
+bool BlockHistory::isLoaded() const
+{
+    return m_loaded;
+}
+
+void BlockHistory::addBlock(const CommandBlock &block)
+{
+    if (!isEnabled() || !block.isValid()) {
+        return;
+    }
+    if (!m_loaded && !m_loading) {
+        load();
+    }
+
+    Entry entry;
+    entry.command = block.command;
+    entry.directory = block.workingDirectory;
+    entry.startTime = block.startTime;
+    entry.endTime = block.endTime.isValid() ? block.endTime : QDateTime::currentDateTime();
+    entry.exitCode = block.exitCode;
+
+    QByteArray data = block.output.toUtf8();
+    entry.outputSize = data.size();
+
+    ++m_pendingWrites;
+    QFutureWatcher<QList<QByteArray>> *watcher = new QFutureWatcher<QList<QByteArray>>(this);
+    connect(watcher, &QFutureWatcher<QList<QByteArray>>::finished, this, [this, watcher, entry]() mutable {
+        watcher->deleteLater();
+        --m_pendingWrites;
+
+        // Switched off while the chunks were written; a later load sweeps them
+        entry.chunks = watcher->result();
+        if (entry.outputSize > 0 && entry.chunks.isEmpty()) {
+            qWarning() << "BlockHistory: Could not store the output of" << entry.command;
+        } else if (isEnabled()) {
+            addEntry(entry);
+        }
+    });
+    watcher->setFuture(QtConcurrent::run(&BlockHistory::storeChunks, chunkDirectory(), data));
+}
+
+QList<BlockHistory::Entry> BlockHistory::entries() const
+{
+    return m_entries;
+}
+
+void BlockHistory::clear()
+{
+    QLockFile lock(lockPath());
+    if (!lock.tryLock(LOCK_TIMEOUT)) {
+        qWarning() << "BlockHistory: Index is locked, could not delete the history";
+        return;
+    }
+
+    // Other instances drop the entries they had indexed when they next
+    // find the index gone
+    m_saveTimer.stop();
+    m_entries.clear();
+    m_references.clear();
+    m_deadChunks.clear();
+    m_indexedIds.clear();
+    m_removedIds.clear();
+    m_loaded = false;
+    if (!QDir(historyDirectory()).removeRecursively()) {
+        qWarning() << "BlockHistory: Could not delete" << historyDirectory();
+    }
+    Q_EMIT changed();
+}
+
+QList<qsizetype> BlockHistory::chunkLengths(const QByteArray &data)
+{
+    QList<qsizetype> lengths;
+    const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+    qsizetype position = 0;
+    while (position < data.size()) {
+        qsizetype length = cutPoint(bytes + position, data.size() - position);
+        lengths.append(length);
+        position += length;
+    }
+    return lengths;
+}
+
+QString BlockHistory::historyDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QStringLiteral("/warpkate/block-history");
+}
+
+QString BlockHistory::lockPath()
+{
+    // Outside the history directory, so clear() can delete that while locked
+    return historyDirectory() + QStringLiteral(".lock");
+}
+
+QString BlockHistory::chunkDirectory()
+{
+    return historyDirectory() + QStringLiteral("/chunks");
+}
+
+QString BlockHistory::chunkPath(const QString &directory, const QByteArray &hash)
+{
+    // Fan out over 256 subdirectories to keep directories small
+    QString name = QString::fromLatin1(hash.toHex());
+    return directory + QLatin1Char('/') + name.left(2) + QLatin1Char('/') + name;
+}
+
+QList<QByteArray> BlockHistory::storeChunks(const QString &directory, const QByteArray &data)
+{
+    QList<QByteArray> hashes;
+    qsizetype position = 0;
+    const QList<qsizetype> lengths = chunkLengths(data);
+    for (qsizetype length : lengths) {
+        QByteArray chunk = QByteArray::fromRawData(data.constData() + position, length);
+        position += length;
+
+        QByteArray hash = QCryptographicHash::hash(chunk, QCryptographicHash::Sha256);
+        hashes.append(hash);
+
+        // Stored before, by this or an earlier run; touching it keeps it
+        // from being deleted as dead before this entry is indexed
+        QString path = chunkPath(directory, hash);
+        QFile existing(path);
+        if (existing.open(QIODevice::ReadOnly)
+            && existing.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime)) {
+            continue;
+        }
+
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << "BlockHistory: Could not write" << path;
+            return QList<QByteArray>();
+        }
+        file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+        file.write(qCompress(chunk));
+        if (!file.commit()) {
+            qWarning() << "BlockHistory: Could not write" << path;
+            return QList<QByteArray>();
+        }
+    }
+    return hashes;
+}
+
+bool BlockHistory::readIndex(QList<Entry> *entries)
+{
+    entries->clear();
+    QFile file(historyDirectory() + QStringLiteral("/index"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return true;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 version = 0;
+    stream >> version;
+    if (version == 1) {
+        // The id counter is gone, the ids stay valid
+        quint64 nextId = 0;
+        stream >> nextId;
+    } else if (version != INDEX_FILE_VERSION) {
+        return true;
+    }
+    stream >> *entries;
+    if (stream.status() != QDataStream::Ok) {
+        entries->clear();
+        return false;
+    }
+    return true;
+}
+
+void BlockHistory::load()
+{
+    m_loading = true;
+    QFutureWatcher<QList<Entry>> *watcher = new QFutureWatcher<QList<Entry>>(this);
+    connect(watcher, &QFutureWatcher<QList<Entry>>::finished, this, [this, watcher]() {
+        watcher->deleteLater();
+        m_loading = false;
+
+        // Switched off meanwhile, which deleted the history
+        if (!isEnabled()) {
+            return;
+        }
+
+        // Blocks added meanwhile were merged with the index by a save, if
+        // one ran; the entries known here win, as in merge()
+        QSet<quint64> knownIds = m_removedIds;
+        for (const Entry &entry : std::as_const(m_entries)) {
+            knownIds.insert(entry.id);
+        }
+        const QList<Entry> entries = watcher->result();
+        for (const Entry &entry : entries) {
+            if (!knownIds.contains(entry.id)) {
+                addEntry(entry);
+            }
+            m_indexedIds.insert(entry.id);
+        }
+        m_loaded = true;
+        Q_EMIT loaded();
+    });
+    watcher->setFuture(QtConcurrent::run(&BlockHistory::readAndSweep));
+}
+
+QList<BlockHistory::Entry> BlockHistory::readAndSweep()
+{
+    QList<Entry> entries;
+    {
+        QLockFile lock(lockPath());
+        if (!lock.tryLock(LOCK_TIMEOUT)) {
+            // The next save merges the index instead
+            qWarning() << "BlockHistory: Index is locked, loading it later";
+            return entries;
+        }
+        if (!readIndex(&entries)) {
+            qWarning() << "BlockHistory: Index is damaged, starting a new history";
+        }
+    }
+
+    // Sweep chunks written for entries that never made it into the index.
+    // Chunks written or reused for an entry not indexed yet are recent, so
+    // the sweep needs no lock and saves don't wait for it
+    QSet<QByteArray> referenced;
+    for (const Entry &entry : std::as_const(entries)) {
+        for (const QByteArray &hash : entry.chunks) {
+            referenced.insert(hash);
+        }
+    }
+    QDateTime cutoff = QDateTime::currentDateTime().addMSecs(-CHUNK_GRACE);
+    QDirIterator it(chunkDirectory(), QDir::Files, QDirIterator::Subdirectories);
+    int swept = 0;
+    while (it.hasNext()) {
+        QString path = it.next();
+        QByteArray hash = QByteArray::fromHex(it.fileName().toLatin1());
+        if (!referenced.contains(hash) && it.fileInfo().lastModified() < cutoff && QFile::remove(path)) {
+            ++swept;
+        }
+    }
+    if (swept > 0) {
+        qDebug() << "BlockHistory: Removed" << swept << "unreferenced chunks";
+    }
+    return entries;
+}
+
+void BlockHistory::save()
+{
+    QDir().mkpath(historyDirectory());
+    QLockFile lock(lockPath());
+    if (!lock.tryLock(LOCK_TIMEOUT)) {
+        qWarning() << "BlockHistory: Index is locked, saving it later";
+        m_saveTimer.start();
+        return;
+    }
+
+    // A damaged index is replaced by the entries known here
+    QList<Entry> onDisk;
+    readIndex(&onDisk);
+    merge(onDisk);
+
+    QSaveFile file(historyDirectory() + QStringLiteral("/index"));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "BlockHistory: Could not write" << file.fileName();
+        return;
+    }
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << INDEX_FILE_VERSION << m_entries;
+    if (!file.commit()) {
+        qWarning() << "BlockHistory: Could not write" << file.fileName();
+        return;
+    }
+
+    m_indexedIds.clear();
+    for (const Entry &entry : std::as_const(m_entries)) {
+        m_indexedIds.insert(entry.id);
+    }
+    m_removedIds.clear();
+    deleteDeadChunks();
+}
+
+void BlockHistory::merge(const QList<Entry> &onDisk)
+{
+    QSet<quint64> diskIds;
+    for (const Entry &entry : onDisk) {
+        diskIds.insert(entry.id);
+    }
+
+    // Indexed before but gone now: another instance dropped it
+    bool removed = false;
+    for (int i = m_entries.size() - 1; i >= 0; --i) {
+        quint64 id = m_entries.at(i).id;
+        if (m_indexedIds.contains(id) && !diskIds.contains(id)) {
+            releaseChunks(m_entries.takeAt(i));
+            removed = true;
+        }
+    }
+    if (removed) {
+        Q_EMIT changed();
+    }
+
+    // Indexed by another instance meanwhile
+    QSet<quint64> knownIds = m_removedIds;
+    for (const Entry &entry : std::as_const(m_entries)) {
+        knownIds.insert(entry.id);
+    }
+    for (const Entry &entry : onDisk) {
+        if (!knownIds.contains(entry.id)) {
+            addEntry(entry);
+        }
+    }
+}
+
+void BlockHistory::addEntry(const Entry &entry)
+{
+    Entry stored = entry;
+    if (stored.id == 0) {
+        // Random, so instances never hand out the same id
+        do {
+            stored.id = QRandomGenerator::global()->generate64();
+        } while (stored.id == 0);
+        m_saveTimer.start();
+    }
+
+    for (const QByteArray &hash : std::as_const(stored.chunks)) {
+        ++m_references[hash];
+    }
+    m_entries.insert(std::upper_bound(m_entries.begin(), m_entries.end(), stored, finishedBefore), stored);
+
+    // Make room by dropping the oldest entries
+    while (m_entries.size() > MAX_ENTRIES) {
+        Entry oldest = m_entries.takeFirst();
+        m_removedIds.insert(oldest.id);
+        releaseChunks(oldest);
+        m_saveTimer.start();
+    }
+
+    Q_EMIT changed();
+}
+
+void BlockHistory::releaseChunks(const Entry &entry)
+{
+    for (const QByteArray &hash : entry.chunks) {
+        auto it = m_references.find(hash);
+        if (it == m_references.end()) {
+            continue;
+        }
+        if (--it.value() == 0) {
+            m_references.erase(it);
+            m_deadChunks.append(hash);
+        }
+    }
+}
+
+void BlockHistory::deleteDeadChunks()
+{
+    // A write in progress may be about to reference a dead chunk again,
+    // relying on its file being there
+    if (m_pendingWrites > 0 || m_deadChunks.isEmpty()) {
+        return;
+    }
+
+    // Recent chunks are tried again on the next save
+    QString directory = chunkDirectory();
+    QDateTime cutoff = QDateTime::currentDateTime().addMSecs(-CHUNK_GRACE);
+    QSet<QByteArray> seen;
+    QList<QByteArray> recent;
+    for (const QByteArray &hash : std::as_const(m_deadChunks)) {
+        if (m_references.contains(hash) || seen.contains(hash)) {
+            continue;
+        }
+        seen.insert(hash);
+        QString path = chunkPath(directory, hash);
+        if (QFileInfo(path).lastModified() >= cutoff) {
+            recent.append(hash);
+        } else {
+            QFile::remove(path);
+        }
+    }
+    m_deadChunks = recent;
+}
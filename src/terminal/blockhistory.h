@@ -0,0 +1,238 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef BLOCKHISTORY_H
+#define BLOCKHISTORY_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
+struct CommandBlock;
+
+/**
+ * On-disk history of finished blocks with deduplicated outputs
+ *
+ * Outputs are split into chunks with content-defined chunking (FastCDC:
+ * a gear rolling hash with normalized chunk sizes between 2 and 64 KiB,
+ * 8 KiB on average), so an edit in one place of an output only changes
+ * the chunks around it. Each distinct chunk is stored once, zlib
+ * compressed, in a file named after its SHA-256. Re-running the same
+ * build or test suite therefore mostly adds references to chunks already
+ * stored, and the history grows with distinct content rather than with
+ * the number of runs.
+ *
+ * Chunks are reference counted by the entries using them. When entries
+ * are removed because the history is full, chunks no longer referenced
+ * are deleted. Unreferenced chunk files left behind by a crash are swept
+ * when the history is loaded. Loading and the sweep run on the thread
+ * pool, and only once persisting is enabled.
+ *
+ * Several Kate instances share the history. The index is read, merged
+ * with the entries of this instance and written under a lock file, and
+ * chunks are only deleted under that lock, once no merged entry
+ * references them and they have not been written or reused for a while:
+ * another instance may be about to index an entry using them.
+ *
+ * The class follows the singleton pattern and should be accessed
+ * through the instance() method.
+ */
+class BlockHistory : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * A stored block
+     */
+    struct Entry {
+        quint64 id;                 ///< Random entry id, unique across instances
+        QString command;            ///< Command line
+        QString directory;          ///< Working directory
+        QDateTime startTime;        ///< When the command started
+        QDateTime endTime;          ///< When it finished
+        int exitCode;               ///< Exit code
+        qint64 outputSize;          ///< Size of the UTF-8 output in bytes
+        QList<QByteArray> chunks;   ///< SHA-256 of the output's chunks, in order
+
+        Entry() : id(0), exitCode(0), outputSize(0) {}
+    };
+
+    /**
+     * Get the singleton instance of the block history
+     * @return Reference to the block history
+     */
+    static BlockHistory &instance();
+
+    /**
+     * Check whether blocks are persisted, per the settings
+     *
+     * Static, so callers can check it without creating the instance.
+     *
+     * @return True if finished blocks are stored
+     */
+    static bool isEnabled();
+
+    /**
+     * Check whether the stored blocks were read
+     * @return True once entries() includes the blocks stored before
+     */
+    bool isLoaded() const;
+
+    /**
+     * Store a finished block in the background
+     *
+     * Does nothing when disabled or for blocks without a command.
+     *
+     * @param block Block with its output expanded
+     */
+    void addBlock(const CommandBlock &block);
+
+    /**
+     * Get the stored blocks
+     * @return Entries, oldest first
+     */
+    QList<Entry> entries() const;
+
+    /**
+     * Delete all stored blocks and chunks, of every instance
+     *
+     * Used when persisting is switched off.
+     */
+    void clear();
+
+    /**
+     * Split data into content-defined chunks
+     * @param data Data to split
+     * @return Chunk lengths, summing up to the data's size
+     */
+    static QList<qsizetype> chunkLengths(const QByteArray &data);
+
+Q_SIGNALS:
+    /**
+     * Emitted when entries were added or removed
+     */
+    void changed();
+
+    /**
+     * Emitted once the stored blocks were read
+     */
+    void loaded();
+
+private:
+    /**
+     * Private constructor (singleton pattern)
+     * @param parent QObject parent
+     */
+    explicit BlockHistory(QObject *parent = nullptr);
+
+    /**
+     * Destructor, writes pending index changes
+     */
+    ~BlockHistory() override;
+
+    /**
+     * Get the directory the history is stored in
+     * @return Absolute path
+     */
+    static QString historyDirectory();
+
+    /**
+     * Get the lock file guarding the index and chunk deletion
+     * @return Absolute path, outside the history directory
+     */
+    static QString lockPath();
+
+    /**
+     * Get the directory chunks are stored in
+     * @return Absolute path
+     */
+    static QString chunkDirectory();
+
+    /**
+     * Get the file a chunk is stored in
+     * @param directory Chunk directory
+     * @param hash SHA-256 of the chunk
+     * @return Absolute path
+     */
+    static QString chunkPath(const QString &directory, const QByteArray &hash);
+
+    /**
+     * Chunk data and write the chunks not stored yet; runs on the thread pool
+     * @param directory Chunk directory
+     * @param data Output as UTF-8
+     * @return SHA-256 of each chunk in order, empty on write errors
+     */
+    static QList<QByteArray> storeChunks(const QString &directory, const QByteArray &data);
+
+    /**
+     * Read the index as written by any instance
+     * @param entries Receives the entries
+     * @return False if the index is damaged
+     */
+    static bool readIndex(QList<Entry> *entries);
+
+    /**
+     * Load the index and sweep unreferenced chunks in the background
+     */
+    void load();
+
+    /**
+     * Read the index and delete chunk files no entry references; runs on the thread pool
+     * @return Entries of the index, empty if it is locked or damaged
+     */
+    static QList<Entry> readAndSweep();
+
+    /**
+     * Merge the index on disk, write it and delete dead chunks, under the lock
+     */
+    void save();
+
+    /**
+     * Take over the index changes of other instances
+     * @param onDisk Entries of the index on disk
+     */
+    void merge(const QList<Entry> &onDisk);
+
+    /**
+     * Add a stored entry, referencing its chunks
+     * @param entry Entry with its chunks, a new one if its id is 0
+     */
+    void addEntry(const Entry &entry);
+
+    /**
+     * Drop an entry's chunk references
+     * @param entry Entry being removed
+     */
+    void releaseChunks(const Entry &entry);
+
+    /**
+     * Delete unreferenced chunks, unless chunks are being written; the
+     * caller holds the lock
+     */
+    void deleteDeadChunks();
+
+    // Disable copy construction and assignment
+    BlockHistory(const BlockHistory &) = delete;
+    BlockHistory &operator=(const BlockHistory &) = delete;
+
+private:
+    QList<Entry> m_entries;                 ///< Stored blocks, oldest first
+    QHash<QByteArray, int> m_references;    ///< Reference count per chunk hash
+    QList<QByteArray> m_deadChunks;         ///< Chunks whose count dropped to zero
+    QSet<quint64> m_indexedIds;             ///< Entries in the index as last read or written
+    QSet<quint64> m_removedIds;             ///< Entries dropped here since the index was written
+    int m_pendingWrites;                    ///< Blocks being chunked and written
+    bool m_loading;                         ///< Whether the index is being read
+    bool m_loaded;                          ///< Whether the index was read
+    QTimer m_saveTimer;                     ///< Batches index writes
+};
+
+#endif // BLOCKHISTORY_H
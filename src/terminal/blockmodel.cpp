@@ -4,24 +4,40 @@
  */
 
 #include "blockmodel.h"
-#include "terminalemulator.h"
+#include "terminalbackend.h"
 
 #include <QDebug>
 
+#include <utility>
+
+// Finished blocks keep their output uncompressed for this long (ms)
+static const int COMPRESSION_DELAY = 60 * 1000;
+
+// Outputs shorter than this (characters) are not worth compressing
+static const int MIN_COMPRESSED_OUTPUT = 4096;
+
+// Number of compressed outputs kept expanded after being read
+static const int EXPANDED_CACHE_SIZE = 8;
+
 BlockModel::BlockModel(QObject *parent)
     : QAbstractListModel(parent)
     , m_currentBlockId(-1)
+    , m_runningBlockId(-1)
     , m_nextBlockId(1)
     , m_terminal(nullptr)
     , m_isCommandExecuting(false)
+    , m_compressor(EXPANDED_CACHE_SIZE)
 {
+    m_compressionTimer.setSingleShot(true);
+    m_compressionTimer.setInterval(COMPRESSION_DELAY);
+    connect(&m_compressionTimer, &QTimer::timeout, this, &BlockModel::compressIdleOutputs);
 }
 
 BlockModel::~BlockModel()
 {
 }
 
-void BlockModel::connectToTerminal(TerminalEmulator *terminal)
+void BlockModel::connectToTerminal(TerminalBackend *terminal)
 {
     if (m_terminal == terminal) {
         return;
@@ -36,11 +52,11 @@ void BlockModel::connectToTerminal(TerminalEmulator *terminal)
     
     if (m_terminal) {
         // Connect signals from terminal to this model
-        connect(m_terminal, &TerminalEmulator::commandDetected, this, &BlockModel::onCommandDetected);
-        connect(m_terminal, &TerminalEmulator::commandExecuted, this, &BlockModel::onCommandExecuted);
-        connect(m_terminal, &TerminalEmulator::outputAvailable, this, &BlockModel::onOutputAvailable);
-        connect(m_terminal, &TerminalEmulator::workingDirectoryChanged, this, &BlockModel::onWorkingDirectoryChanged);
-        connect(m_terminal, &TerminalEmulator::shellFinished, this, &BlockModel::onShellFinished);
+        connect(m_terminal, &TerminalBackend::commandDetected, this, &BlockModel::onCommandDetected);
+        connect(m_terminal, &TerminalBackend::commandExecuted, this, &BlockModel::onCommandExecuted);
+        connect(m_terminal, &TerminalBackend::outputAvailable, this, &BlockModel::onOutputAvailable);
+        connect(m_terminal, &TerminalBackend::workingDirectoryChanged, this, &BlockModel::onWorkingDirectoryChanged);
+        connect(m_terminal, &TerminalBackend::shellFinished, this, &BlockModel::onShellFinished);
     }
 }
 
@@ -63,7 +79,7 @@ QVariant BlockModel::data(const QModelIndex &index, int role) const
             return block.command;
             
         case OutputRole:
-            return block.output;
+            return outputAt(index.row(), true);
             
         case StateRole:
             return block.state;
@@ -144,13 +160,27 @@ CommandBlock BlockModel::blockById(int id) const
 {
     int index = findBlockIndex(id);
     if (index >= 0) {
-        return m_blocks[index];
+        CommandBlock block = m_blocks[index];
+        if (block.isOutputCompressed()) {
+            block.output = outputAt(index, true);
+            block.compressedOutput.clear();
+        }
+        return block;
     }
     
     // Return an invalid block
     return CommandBlock();
 }
 
+QString BlockModel::blockOutput(int id) const
+{
+    int index = findBlockIndex(id);
+    if (index < 0) {
+        return QString();
+    }
+    return outputAt(index, true);
+}
+
 int BlockModel::currentBlockId() const
 {
     return m_currentBlockId;
@@ -230,9 +260,10 @@ int BlockModel::executeCommand(const QString &command, const QString &workingDir
     // Create a new block for the command
     int blockId = createBlock(command, workingDirectory);
     
-    // Start execution
+    // Start execution; the terminal's start of the command is this block's
     setBlockState(blockId, Executing);
     setBlockStartTime(blockId, QDateTime::currentDateTime());
+    m_runningBlockId = blockId;
     
     // Execute in terminal
     m_terminal->executeCommand(command);
@@ -266,6 +297,7 @@ bool BlockModel::appendBlockOutput(int id, const QString &output)
     }
     
     // Append output
+    expandForWrite(index);
     m_blocks[index].output.append(output);
     
     // Notify views
@@ -283,9 +315,20 @@ bool BlockModel::setBlockState(int id, BlockState state)
         return false;
     }
     
+    // The model and the view both finish a command; listeners such as
+    // the block history must see each transition once
+    if (m_blocks[index].state == state) {
+        return true;
+    }
+    
     // Update state
     m_blocks[index].state = state;
     
+    // Finished output becomes a candidate for compression
+    if ((state == Completed || state == Failed) && !m_compressionTimer.isActive()) {
+        m_compressionTimer.start();
+    }
+    
     // Notify views
     QModelIndex modelIndex = this->index(index, 0);
     Q_EMIT dataChanged(modelIndex, modelIndex, {StateRole});
@@ -364,9 +407,11 @@ void BlockModel::clear()
     beginRemoveRows(QModelIndex(), 0, m_blocks.size() - 1);
     m_blocks.clear();
     endRemoveRows();
+    m_compressor.clear();
     
     // Reset current block
     m_currentBlockId = -1;
+    m_runningBlockId = -1;
     
     // Reset next ID
     m_nextBlockId = 1;
@@ -404,7 +449,7 @@ int BlockModel::findText(const QString &text, int startFrom, bool searchForward)
         // Search forward from start index
         for (int i = startIndex; i < m_blocks.size(); ++i) {
             if (m_blocks[i].command.contains(text, Qt::CaseInsensitive) ||
-                m_blocks[i].output.contains(text, Qt::CaseInsensitive)) {
+                outputAt(i, false).contains(text, Qt::CaseInsensitive)) {
                 return m_blocks[i].id;
             }
         }
@@ -413,7 +458,7 @@ int BlockModel::findText(const QString &text, int startFrom, bool searchForward)
         if (startIndex > 0) {
             for (int i = 0; i < startIndex; ++i) {
                 if (m_blocks[i].command.contains(text, Qt::CaseInsensitive) ||
-                    m_blocks[i].output.contains(text, Qt::CaseInsensitive)) {
+                    outputAt(i, false).contains(text, Qt::CaseInsensitive)) {
                     return m_blocks[i].id;
                 }
             }
@@ -422,7 +467,7 @@ int BlockModel::findText(const QString &text, int startFrom, bool searchForward)
         // Search backward from start index
         for (int i = startIndex; i >= 0; --i) {
             if (m_blocks[i].command.contains(text, Qt::CaseInsensitive) ||
-                m_blocks[i].output.contains(text, Qt::CaseInsensitive)) {
+                outputAt(i, false).contains(text, Qt::CaseInsensitive)) {
                 return m_blocks[i].id;
             }
         }
@@ -431,7 +476,7 @@ int BlockModel::findText(const QString &text, int startFrom, bool searchForward)
         if (startIndex < m_blocks.size() - 1) {
             for (int i = m_blocks.size() - 1; i > startIndex; --i) {
                 if (m_blocks[i].command.contains(text, Qt::CaseInsensitive) ||
-                    m_blocks[i].output.contains(text, Qt::CaseInsensitive)) {
+                    outputAt(i, false).contains(text, Qt::CaseInsensitive)) {
                     return m_blocks[i].id;
                 }
             }
@@ -444,11 +489,19 @@ int BlockModel::findText(const QString &text, int startFrom, bool searchForward)
 
 void BlockModel::onCommandDetected(const QString &command)
 {
+    // A command started through executeCommand() has its block already
+    int running = findBlockIndex(m_runningBlockId);
+    if (running >= 0 && m_blocks[running].state == Executing) {
+        m_isCommandExecuting = true;
+        return;
+    }
+    
     // Create a new block if command is valid
     if (!command.trimmed().isEmpty()) {
         int blockId = createBlock(command);
         setBlockState(blockId, Executing);
         setBlockStartTime(blockId, QDateTime::currentDateTime());
+        m_runningBlockId = blockId;
         
         // Update state
         m_isCommandExecuting = true;
@@ -458,18 +511,19 @@ void BlockModel::onCommandDetected(const QString &command)
 
 void BlockModel::onCommandExecuted(const QString &command, const QString &output, int exitCode)
 {
-    // Find the most recent executing block
-    int blockId = -1;
-    for (int i = m_blocks.size() - 1; i >= 0; --i) {
-        if (m_blocks[i].state == Executing && m_blocks[i].command == command) {
-            blockId = m_blocks[i].id;
-            break;
-        }
-    }
+    // The block started with this command, not one that merely has the
+    // same text: "make" twice is two blocks
+    int blockId = std::exchange(m_runningBlockId, -1);
+    int index = findBlockIndex(blockId);
     
-    if (blockId < 0) {
-        // If no matching block found, create one
+    if (index < 0) {
+        // No start was seen, e.g. the command began before the model connected
         blockId = createBlock(command);
+    } else if (m_blocks[index].state != Executing) {
+        // The view finishes the blocks it runs itself, possibly first
+        m_isCommandExecuting = false;
+        m_currentOutput.clear();
+        return;
     }
     
     // Update block with execution results
@@ -534,6 +588,7 @@ void BlockModel::onShellFinished(int exitCode)
     }
     
     // Reset command execution state
+    m_runningBlockId = -1;
     m_isCommandExecuting = false;
     m_currentOutput.clear();
 }
@@ -546,6 +601,7 @@ bool BlockModel::setBlockOutput(int id, const QString &output)
     }
     
     // Set output (replacing any existing output)
+    expandForWrite(index);
     m_blocks[index].output = output;
     
     // Notify views
@@ -592,4 +648,60 @@ void BlockModel::updateBlockMetadata(const QModelIndex &index)
     Q_EMIT blockChanged(block.id);
 }
 
+QString BlockModel::outputAt(int index, bool cache) const
+{
+    const CommandBlock &block = m_blocks[index];
+    return m_compressor.text(block.id, block.output, block.compressedOutput, cache);
+}
+
+void BlockModel::expandForWrite(int index)
+{
+    CommandBlock &block = m_blocks[index];
+    if (block.isOutputCompressed()) {
+        block.output = outputAt(index, false);
+        block.compressedOutput.clear();
+    }
+    m_compressor.forget(block.id);
+}
+
+void BlockModel::compressIdleOutputs()
+{
+    QDateTime now = QDateTime::currentDateTime();
+    bool waiting = false;
+    
+    QHash<int, QString> outputs;
+    for (const CommandBlock &block : std::as_const(m_blocks)) {
+        if ((block.state != Completed && block.state != Failed) || block.isOutputCompressed()
+            || block.output.size() < MIN_COMPRESSED_OUTPUT || m_compressor.isCompressing(block.id)) {
+            continue;
+        }
+        
+        // Recent blocks and the current block are likely to be read again
+        if (block.id == m_currentBlockId || !block.endTime.isValid()
+            || block.endTime.msecsTo(now) < COMPRESSION_DELAY) {
+            waiting = true;
+            continue;
+        }
+        outputs.insert(block.id, block.output);
+    }
+    
+    m_compressor.compress(outputs, [this](int id, const QString &output, const QByteArray &compressed) {
+        // Only swap in the result if the output did not change meanwhile
+        int index = findBlockIndex(id);
+        if (index < 0 || m_blocks[index].output.constData() != output.constData()
+            || m_blocks[index].output.size() != output.size()) {
+            return;
+        }
+        qDebug() << "BlockModel: Compressed output of block" << id << "from"
+                 << output.size() * int(sizeof(QChar)) << "to" << compressed.size() << "bytes";
+        m_blocks[index].compressedOutput = compressed;
+        m_blocks[index].output = QString();
+    });
+    
+    // Check again once the remaining blocks are old enough
+    if (waiting) {
+        m_compressionTimer.start();
+    }
+}
+
 #include "moc_blockmodel.cpp"
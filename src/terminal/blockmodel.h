@@ -6,13 +6,17 @@
 #ifndef BLOCKMODEL_H
 #define BLOCKMODEL_H
 
+#include "util/textcompressor.h"
+
 #include <QAbstractListModel>
+#include <QByteArray>
 #include <QDateTime>
 #include <QList>
 #include <QObject>
 #include <QString>
+#include <QTimer>
 
-class TerminalEmulator;
+class TerminalBackend;
 
 /**
  * Block execution state
@@ -31,7 +35,8 @@ enum BlockState {
 struct CommandBlock {
     int id;                             ///< Unique block identifier
     QString command;                    ///< The executed command
-    QString output;                     ///< Command output
+    QString output;                     ///< Command output, empty while compressed
+    QByteArray compressedOutput;        ///< zlib compressed UTF-8 output, empty unless compressed
     QDateTime startTime;                ///< Command execution start time
     QDateTime endTime;                  ///< Command execution end time
     int exitCode;                       ///< Command exit code
@@ -71,6 +76,14 @@ struct CommandBlock {
         return startTime.msecsTo(end);
     }
     
+    /**
+     * Check whether the output is held compressed
+     * @return True if the output has to be expanded with BlockModel::blockOutput()
+     */
+    bool isOutputCompressed() const {
+        return !compressedOutput.isEmpty();
+    }
+    
     /**
      * Check if this block contains a valid command
      * @return true if the block has a non-empty command
@@ -102,6 +115,13 @@ enum BlockModelRoles {
  * This class manages command blocks and their states. It implements the
  * Qt model/view framework to make it easy to display blocks in views.
  * It integrates with the terminal emulator to capture commands and output.
+ * 
+ * The output of blocks that finished a while ago is compressed in the
+ * background (UTF-8, then zlib), which shrinks typical build logs 5-10
+ * times compared to the UTF-16 QString. The output role, blockById(),
+ * blockOutput() and findText() expand it transparently; a small LRU cache
+ * keeps the most recently read blocks expanded. TextCompressor does the
+ * work, shared with ConversationModel.
  */
 class BlockModel : public QAbstractListModel
 {
@@ -123,7 +143,7 @@ public:
      * Connect to a terminal emulator
      * @param terminal The terminal emulator to connect to
      */
-    void connectToTerminal(TerminalEmulator *terminal);
+    void connectToTerminal(TerminalBackend *terminal);
     
     /**
      * Get data for a model index
@@ -161,6 +181,13 @@ public:
      */
     CommandBlock blockById(int id) const;
     
+    /**
+     * Get a block's output, expanding it if it is compressed
+     * @param id Block ID
+     * @return The output, empty if the block was not found
+     */
+    QString blockOutput(int id) const;
+    
     /**
      * Get the current block ID
      * @return ID of the currently active block
@@ -252,6 +279,10 @@ public:
     
     /**
      * Get all blocks
+     * 
+     * Compressed outputs are not expanded here; use blockById() or
+     * blockOutput() for blocks whose output is needed.
+     * 
      * @return List of all command blocks
      */
     QList<CommandBlock> blocks() const;
@@ -324,7 +355,7 @@ Q_SIGNALS:
     void blockCreated(int id);
     
     /**
-     * Emitted when a block's state changes
+     * Emitted when a block's state changes, not when it is set again
      * @param id Block ID
      * @param state New state
      */
@@ -356,14 +387,36 @@ private:
      */
     void updateBlockMetadata(const QModelIndex &index);
     
+    /**
+     * Get the output of the block at an index
+     * @param index Index in the blocks list
+     * @param cache Whether to keep an expanded output in the LRU cache
+     * @return The output
+     */
+    QString outputAt(int index, bool cache) const;
+    
+    /**
+     * Drop the compressed form of a block's output before it changes
+     * @param index Index in the blocks list
+     */
+    void expandForWrite(int index);
+    
+    /**
+     * Compress the outputs of blocks that finished long enough ago
+     */
+    void compressIdleOutputs();
+    
 private:
     QList<CommandBlock> m_blocks;                   ///< List of all blocks
     int m_currentBlockId;                           ///< ID of the current block
+    int m_runningBlockId;                           ///< ID of the block of the command running in the terminal, -1 if none
     int m_nextBlockId;                              ///< Next ID to use
-    TerminalEmulator *m_terminal;                   ///< Connected terminal emulator
+    TerminalBackend *m_terminal;                    ///< Connected terminal backend
     QString m_currentWorkingDirectory;              ///< Current working directory
     bool m_isCommandExecuting;                      ///< Whether a command is currently executing
     QString m_currentOutput;                        ///< Current accumulated output
+    TextCompressor m_compressor;                    ///< Compresses idle outputs, keeps recently read ones expanded
+    QTimer m_compressionTimer;                      ///< Schedules compressIdleOutputs()
 };
 
 #endif // BLOCKMODEL_H
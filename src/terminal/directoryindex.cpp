@@ -0,0 +1,384 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "directoryindex.h"
+#include "blockhistory.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+// Ranks are scaled down when they add up to more than this
+static const double MAX_TOTAL_RANK = 10000.0;
+
+// Visits of missing directories older than this are forgotten (s)
+static const qint64 STALE_AGE = 90 * 24 * 3600;
+
+// Candidates sorted beyond the limit, to make up for missing directories
+static const int STALE_SLACK = 8;
+
+// Index writes are batched for this long (ms)
+static const int SAVE_DELAY = 2000;
+
+// Bumped when the index file layout changes
+static const quint32 INDEX_FILE_VERSION = 1;
+
+static DirectoryIndex *s_instance = nullptr;
+
+/**
+ * Check whether a directory is worth indexing
+ * @param path Cleaned path
+ * @return False for relative paths, / and the home directory
+ */
+static bool isIndexable(const QString &path)
+{
+    return QDir::isAbsolutePath(path) && path != QDir::rootPath() && path != QDir::homePath();
+}
+
+DirectoryIndex &DirectoryIndex::instance()
+{
+    if (!s_instance) {
+        s_instance = new DirectoryIndex();
+    }
+    return *s_instance;
+}
+
+DirectoryIndex::DirectoryIndex(QObject *parent)
+    : QObject(parent)
+    , m_totalRank(0.0)
+{
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(SAVE_DELAY);
+    connect(&m_saveTimer, &QTimer::timeout, this, &DirectoryIndex::save);
+
+    // The instance lives until exit, so write pending changes on the way out
+    connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, [this]() {
+        if (m_saveTimer.isActive()) {
+            m_saveTimer.stop();
+            save();
+        }
+    });
+
+    load();
+}
+
+DirectoryIndex::~DirectoryIndex()
+{
+    if (m_saveTimer.isActive()) {
+        save();
+    }
+}
+
+void DirectoryIndex::add(const QString &directory)
+{
+    QString path = QDir::cleanPath(directory);
+    if (!isIndexable(path)) {
+        return;
+    }
+
+    insert(path, 1.0f, QDateTime::currentSecsSinceEpoch());
+    age();
+    m_saveTimer.start();
+    Q_EMIT changed();
+}
+
+void DirectoryIndex::remove(const QString &directory)
+{
+    int position = m_positions.value(QDir::cleanPath(directory), -1);
+    if (position < 0) {
+        return;
+    }
+
+    m_totalRank -= m_entries.at(position).rank;
+    m_entries.remove(position);
+    reindex();
+    m_saveTimer.start();
+    Q_EMIT changed();
+}
+
+QStringList DirectoryIndex::query(const QStringList &keywords, int limit, const QString &exclude)
+{
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    const int excluded = exclude.isEmpty() ? -1 : m_positions.value(QDir::cleanPath(exclude), -1);
+
+    QStringList lowered;
+    for (const QString &keyword : keywords) {
+        if (!keyword.isEmpty()) {
+            lowered.append(keyword.toLower());
+        }
+    }
+
+    QVector<QPair<double, int>> candidates;
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (i != excluded && (lowered.isEmpty() || matches(m_entries.at(i), lowered))) {
+            candidates.append({frecency(m_entries.at(i), now), i});
+        }
+    }
+
+    // Nothing matched as words, try as a subsequence
+    if (candidates.isEmpty() && !lowered.isEmpty()) {
+        for (int i = 0; i < m_entries.size(); ++i) {
+            if (i != excluded && fuzzyMatches(m_entries.at(i), lowered)) {
+                candidates.append({frecency(m_entries.at(i), now), i});
+            }
+        }
+    }
+
+    return best(candidates, limit, now);
+}
+
+QStringList DirectoryIndex::complete(const QString &prefix, int limit)
+{
+    QString argument = prefix;
+    if (argument.startsWith(QLatin1Char('\'')) || argument.startsWith(QLatin1Char('"'))) {
+        argument.remove(0, 1);
+    }
+    if (argument == QLatin1String("~") || argument.startsWith(QLatin1String("~/"))) {
+        argument.replace(0, 1, QDir::homePath());
+    }
+
+    // A path so far: directories under it
+    if (argument.startsWith(QLatin1Char('/'))) {
+        const qint64 now = QDateTime::currentSecsSinceEpoch();
+        const QString lowered = argument.toLower();
+        QVector<QPair<double, int>> candidates;
+        for (int i = 0; i < m_entries.size(); ++i) {
+            if (m_entries.at(i).key.startsWith(lowered)) {
+                candidates.append({frecency(m_entries.at(i), now), i});
+            }
+        }
+        return best(candidates, limit, now);
+    }
+
+    return query(argument.split(QLatin1Char('/'), Qt::SkipEmptyParts), limit);
+}
+
+int DirectoryIndex::count() const
+{
+    return m_entries.size();
+}
+
+QString DirectoryIndex::indexPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QStringLiteral("/warpkate/directories");
+}
+
+void DirectoryIndex::load()
+{
+    QFile file(indexPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        // First run: start from where past blocks ran, once they are read;
+        // without a stored history there is nothing to start from
+        if (BlockHistory::isEnabled()) {
+            BlockHistory &history = BlockHistory::instance();
+            if (history.isLoaded()) {
+                seed();
+            } else {
+                connect(&history, &BlockHistory::loaded, this, &DirectoryIndex::seed, Qt::SingleShotConnection);
+            }
+        }
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    quint32 version = 0;
+    quint32 count = 0;
+    stream >> version >> count;
+    if (version != INDEX_FILE_VERSION) {
+        return;
+    }
+
+    m_entries.reserve(int(qMin(count, quint32(MAX_TOTAL_RANK))));
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QByteArray path;
+        float rank = 0.0f;
+        qint64 lastAccess = 0;
+        stream >> path >> rank >> lastAccess;
+        if (stream.status() == QDataStream::Ok) {
+            insert(QString::fromUtf8(path), rank, lastAccess);
+        }
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "DirectoryIndex: Index is damaged, keeping" << m_entries.size() << "directories";
+    }
+}
+
+void DirectoryIndex::seed()
+{
+    const QList<BlockHistory::Entry> history = BlockHistory::instance().entries();
+    int count = 0;
+    for (const BlockHistory::Entry &entry : history) {
+        QString path = QDir::cleanPath(entry.directory);
+        if (!entry.directory.isEmpty() && isIndexable(path)) {
+            insert(path, 1.0f, entry.endTime.toSecsSinceEpoch());
+            ++count;
+        }
+    }
+    age();
+    if (count > 0) {
+        qDebug() << "DirectoryIndex: Seeded from" << count << "blocks of the block history";
+        m_saveTimer.start();
+        Q_EMIT changed();
+    }
+}
+
+void DirectoryIndex::save()
+{
+    QString path = indexPath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "DirectoryIndex: Could not write" << path;
+        return;
+    }
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+
+    // Single precision ranks and UTF-8 paths, about 16 bytes plus the path per entry
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    stream << INDEX_FILE_VERSION << quint32(m_entries.size());
+    for (const Entry &entry : std::as_const(m_entries)) {
+        stream << entry.path.toUtf8() << entry.rank << entry.lastAccess;
+    }
+    file.commit();
+}
+
+void DirectoryIndex::insert(const QString &path, float rank, qint64 lastAccess)
+{
+    int position = m_positions.value(path, -1);
+    if (position >= 0) {
+        Entry &entry = m_entries[position];
+        entry.rank += rank;
+        entry.lastAccess = qMax(entry.lastAccess, lastAccess);
+    } else {
+        Entry entry;
+        entry.path = path;
+        entry.key = path.toLower();
+        entry.nameStart = entry.key.lastIndexOf(QLatin1Char('/')) + 1;
+        entry.rank = rank;
+        entry.lastAccess = lastAccess;
+        m_positions.insert(path, m_entries.size());
+        m_entries.append(entry);
+    }
+    m_totalRank += rank;
+}
+
+void DirectoryIndex::age()
+{
+    if (m_totalRank <= MAX_TOTAL_RANK) {
+        return;
+    }
+
+    // Scale to 90% of the limit and forget what drops below one visit
+    const float factor = float(0.9 * MAX_TOTAL_RANK / m_totalRank);
+    m_totalRank = 0.0;
+    for (Entry &entry : m_entries) {
+        entry.rank *= factor;
+    }
+    m_entries.removeIf([](const Entry &entry) {
+        return entry.rank < 1.0f;
+    });
+    for (const Entry &entry : std::as_const(m_entries)) {
+        m_totalRank += entry.rank;
+    }
+    reindex();
+}
+
+void DirectoryIndex::reindex()
+{
+    m_positions.clear();
+    m_positions.reserve(m_entries.size());
+    for (int i = 0; i < m_entries.size(); ++i) {
+        m_positions.insert(m_entries.at(i).path, i);
+    }
+}
+
+double DirectoryIndex::frecency(const Entry &entry, qint64 now)
+{
+    const qint64 age = now - entry.lastAccess;
+    if (age < 3600) {
+        return entry.rank * 4.0;
+    }
+    if (age < 24 * 3600) {
+        return entry.rank * 2.0;
+    }
+    if (age < 7 * 24 * 3600) {
+        return entry.rank * 0.5;
+    }
+    return entry.rank * 0.25;
+}
+
+bool DirectoryIndex::matches(const Entry &entry, const QStringList &keywords)
+{
+    int position = 0;
+    for (int i = 0; i < keywords.size() - 1; ++i) {
+        int found = entry.key.indexOf(keywords.at(i), position);
+        if (found < 0) {
+            return false;
+        }
+        position = found + keywords.at(i).size();
+    }
+    return entry.key.indexOf(keywords.last(), qMax(position, entry.nameStart)) >= 0;
+}
+
+bool DirectoryIndex::fuzzyMatches(const Entry &entry, const QStringList &keywords)
+{
+    const QString pattern = keywords.join(QString());
+    int position = 0;
+    for (int i = 0; i < pattern.size() - 1; ++i) {
+        position = entry.key.indexOf(pattern.at(i), position);
+        if (position < 0) {
+            return false;
+        }
+        ++position;
+    }
+    return entry.key.indexOf(pattern.back(), qMax(position, entry.nameStart)) >= 0;
+}
+
+QStringList DirectoryIndex::best(QVector<QPair<double, int>> &candidates, int limit, qint64 now)
+{
+    auto better = [](const QPair<double, int> &a, const QPair<double, int> &b) {
+        return a.first > b.first;
+    };
+
+    // Only the head needs ordering; the rest only if missing directories eat into it
+    int sorted = qMin(int(candidates.size()), limit + STALE_SLACK);
+    std::partial_sort(candidates.begin(), candidates.begin() + sorted, candidates.end(), better);
+
+    QStringList results;
+    QStringList stale;
+    for (int i = 0; i < candidates.size() && results.size() < limit; ++i) {
+        if (i == sorted) {
+            std::sort(candidates.begin() + sorted, candidates.end(), better);
+            sorted = candidates.size();
+        }
+
+        const Entry &entry = m_entries.at(candidates.at(i).second);
+        if (QFileInfo(entry.path).isDir()) {
+            results.append(entry.path);
+        } else if (now - entry.lastAccess > STALE_AGE) {
+            stale.append(entry.path);
+        }
+    }
+
+    for (const QString &path : std::as_const(stale)) {
+        remove(path);
+    }
+    return results;
+}
@@ -0,0 +1,210 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef DIRECTORYINDEX_H
+#define DIRECTORYINDEX_H
+
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+/**
+ * Frecency-ranked index of the directories the shell visited
+ *
+ * Every directory change of a terminal adds one to the directory's rank.
+ * Results are ordered by rank weighted with how long ago the directory
+ * was last visited (four times within the hour, twice within the day,
+ * half within the week, a quarter beyond), like zoxide. When the ranks
+ * add up to more than a limit, all of them are scaled down and entries
+ * falling below one are forgotten, which keeps the index small and lets
+ * old habits fade.
+ *
+ * A query is a list of keywords matched case-insensitively, in order,
+ * against the path, the last one against the last path component; so
+ * "wk src" finds ~/projects/warpkate/src. When nothing matches that
+ * way, the keywords are matched as a subsequence instead. Queries scan
+ * an in-memory array of lowercased paths, well under a millisecond for
+ * the few thousand entries aging leaves, and no process is spawned.
+ *
+ * The first index is seeded from the working directories of the blocks
+ * in the block history. The index is saved in a compact binary file.
+ *
+ * The class follows the singleton pattern and should be accessed
+ * through the instance() method.
+ */
+class DirectoryIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Get the singleton instance of the directory index
+     * @return Reference to the directory index
+     */
+    static DirectoryIndex &instance();
+
+    /**
+     * Record a visit to a directory
+     *
+     * The home and root directories are not recorded.
+     *
+     * @param directory Absolute path
+     */
+    void add(const QString &directory);
+
+    /**
+     * Forget a directory
+     * @param directory Absolute path
+     */
+    void remove(const QString &directory);
+
+    /**
+     * Find the best directories for keywords
+     *
+     * Directories that no longer exist are skipped, and forgotten once
+     * they have not been visited for a while.
+     *
+     * @param keywords Keywords, all directories if empty
+     * @param limit Maximum number of results
+     * @param exclude Directory to leave out, e.g. the current one
+     * @return Absolute paths, best first
+     */
+    QStringList query(const QStringList &keywords, int limit, const QString &exclude = QString());
+
+    /**
+     * Find completions for a directory argument being typed
+     *
+     * Arguments starting with / or ~ complete directories under that
+     * path; anything else is a keyword.
+     *
+     * @param prefix The argument up to the cursor
+     * @param limit Maximum number of results
+     * @return Absolute paths, best first
+     */
+    QStringList complete(const QString &prefix, int limit);
+
+    /**
+     * Get the number of indexed directories
+     * @return Entry count
+     */
+    int count() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted when directories were added or removed
+     */
+    void changed();
+
+private:
+    /**
+     * An indexed directory
+     */
+    struct Entry {
+        QString path;           ///< Absolute path
+        QString key;            ///< Lowercased path, matched against
+        int nameStart;          ///< Start of the last component in key
+        float rank;             ///< Visits, scaled down by aging
+        qint64 lastAccess;      ///< Last visit (seconds since the epoch)
+    };
+
+    /**
+     * Private constructor (singleton pattern)
+     * @param parent QObject parent
+     */
+    explicit DirectoryIndex(QObject *parent = nullptr);
+
+    /**
+     * Destructor, writes pending changes
+     */
+    ~DirectoryIndex() override;
+
+    /**
+     * Get the file the index is stored in
+     * @return Absolute path
+     */
+    static QString indexPath();
+
+    /**
+     * Load the index, or seed it from the block history
+     */
+    void load();
+
+    /**
+     * Add the working directories of the blocks in the block history
+     */
+    void seed();
+
+    /**
+     * Write the index
+     */
+    void save();
+
+    /**
+     * Add an entry without aging or saving
+     * @param path Absolute path
+     * @param rank Rank to add
+     * @param lastAccess Visit time (seconds since the epoch)
+     */
+    void insert(const QString &path, float rank, qint64 lastAccess);
+
+    /**
+     * Scale ranks down once they add up to too much
+     */
+    void age();
+
+    /**
+     * Rebuild the path to position lookup after entries were removed
+     */
+    void reindex();
+
+    /**
+     * Weigh an entry's rank by how recent its last visit is
+     * @param entry The entry
+     * @param now Current time (seconds since the epoch)
+     * @return Score, higher is better
+     */
+    static double frecency(const Entry &entry, qint64 now);
+
+    /**
+     * Match keywords in order, the last one in the last component
+     * @param entry The entry
+     * @param keywords Lowercased keywords
+     * @return True if all keywords match
+     */
+    static bool matches(const Entry &entry, const QStringList &keywords);
+
+    /**
+     * Match the characters of keywords as a subsequence
+     * @param entry The entry
+     * @param keywords Lowercased keywords
+     * @return True if all characters appear in order, the last one in the last component
+     */
+    static bool fuzzyMatches(const Entry &entry, const QStringList &keywords);
+
+    /**
+     * Take the best existing directories of scored candidates
+     * @param candidates Score and entry index pairs
+     * @param limit Maximum number of results
+     * @param now Current time (seconds since the epoch)
+     * @return Absolute paths, best first
+     */
+    QStringList best(QVector<QPair<double, int>> &candidates, int limit, qint64 now);
+
+    // Disable copy construction and assignment
+    DirectoryIndex(const DirectoryIndex &) = delete;
+    DirectoryIndex &operator=(const DirectoryIndex &) = delete;
+
+private:
+    QVector<Entry> m_entries;           ///< Indexed directories
+    QHash<QString, int> m_positions;    ///< Position in m_entries by path
+    double m_totalRank;                 ///< Sum of all ranks
+    QTimer m_saveTimer;                 ///< Batches writes
+};
+
+#endif // DIRECTORYINDEX_H
@@ -0,0 +1,410 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "environmentcache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTimer>
+
+// Files whose presence marks a project root and whose contents decide
+// whether a cached environment is still valid
+static const char *const ACTIVATION_FILES[] = {
+    ".envrc",
+    "flake.nix",
+    "flake.lock",
+    "shell.nix",
+    "environment.yml",
+    ".venv/bin/activate",
+    "venv/bin/activate",
+};
+
+// Cached environments older than this are refreshed in the background (s)
+static const qint64 REVALIDATE_AGE = 60 * 60;
+
+// Activation that takes longer than this is given up (ms); the first
+// nix develop of a project can take minutes
+static const int CAPTURE_TIMEOUT = 5 * 60 * 1000;
+
+// Variables that describe the capturing process rather than the project
+static const char *const VOLATILE_VARIABLES[] = {
+    "PWD",
+    "OLDPWD",
+    "SHLVL",
+    "_",
+    "TERM",
+};
+
+// Bumped when the cache file layout changes
+static const quint32 CACHE_FILE_VERSION = 2;
+
+static EnvironmentCache *s_instance = nullptr;
+
+/**
+ * Quote a string for a POSIX shell
+ * @param text Text to quote
+ * @return Single-quoted text
+ */
+static QString shellQuote(const QString &text)
+{
+    QString quoted = text;
+    quoted.replace(QLatin1Char('\''), QLatin1String("'\\''"));
+    return QLatin1Char('\'') + quoted + QLatin1Char('\'');
+}
+
+/**
+ * Check whether a variable describes the capturing shell rather than the project
+ * @param name Variable name
+ * @return True for variables left out of the changes
+ */
+static bool isVolatile(const QByteArray &name)
+{
+    for (const char *variable : VOLATILE_VARIABLES) {
+        if (name == variable) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Split env -0 output into variables
+ * @param output NUL-separated KEY=VALUE entries
+ * @return Values by name
+ */
+static QHash<QByteArray, QByteArray> parseEnvironment(const QByteArray &output)
+{
+    QHash<QByteArray, QByteArray> variables;
+    for (const QByteArray &variable : output.split('\0')) {
+        int separator = variable.indexOf('=');
+        if (separator > 0) {
+            variables.insert(variable.left(separator), variable.mid(separator + 1));
+        }
+    }
+    return variables;
+}
+
+EnvironmentCache &EnvironmentCache::instance()
+{
+    if (!s_instance) {
+        s_instance = new EnvironmentCache();
+    }
+    return *s_instance;
+}
+
+EnvironmentCache::EnvironmentCache(QObject *parent)
+    : QObject(parent)
+{
+}
+
+EnvironmentCache::~EnvironmentCache()
+{
+}
+
+QString EnvironmentCache::projectRootFor(const QString &directory) const
+{
+    if (directory.isEmpty()) {
+        return QString();
+    }
+
+    // Walk up to the nearest directory with an activation file
+    QDir dir(directory);
+    do {
+        for (const char *file : ACTIVATION_FILES) {
+            if (QFileInfo::exists(dir.filePath(QLatin1String(file)))) {
+                return dir.absolutePath();
+            }
+        }
+    } while (dir.cdUp());
+
+    return QString();
+}
+
+QStringList EnvironmentCache::changesFor(const QString &directory)
+{
+    QString projectRoot = projectRootFor(directory);
+    if (projectRoot.isEmpty()) {
+        return QStringList();
+    }
+
+    QByteArray currentFingerprint = fingerprint(projectRoot);
+
+    // Fall back to the copy on disk from an earlier session
+    auto it = m_entries.find(projectRoot);
+    if (it == m_entries.end()) {
+        Entry entry;
+        if (loadEntry(projectRoot, &entry)) {
+            it = m_entries.insert(projectRoot, entry);
+        }
+    }
+
+    if (it != m_entries.end() && it->fingerprint == currentFingerprint) {
+        // Still valid; refresh old entries for things the files don't capture
+        if (it->capturedAt.secsTo(QDateTime::currentDateTimeUtc()) > REVALIDATE_AGE) {
+            capture(projectRoot, currentFingerprint);
+        }
+        return it->changes;
+    }
+
+    // Nothing usable yet, this shell activates the slow way
+    capture(projectRoot, currentFingerprint);
+    return QStringList();
+}
+
+QString EnvironmentCache::activationCommand(const QString &directory, const QString &shell) const
+{
+    QString projectRoot = projectRootFor(directory);
+    if (projectRoot.isEmpty() || (shell != QLatin1String("bash") && shell != QLatin1String("zsh"))) {
+        return QString();
+    }
+    QDir dir(projectRoot);
+
+    // direnv first, .envrc files usually wrap nix or layout python themselves
+    if (dir.exists(QStringLiteral(".envrc"))) {
+        return QStringLiteral("eval \"$(direnv export %1 2>/dev/null)\"").arg(shell);
+    }
+
+    // print-dev-env writes bash, zsh can't be trusted to read it
+    if (dir.exists(QStringLiteral("flake.nix"))) {
+        return shell == QLatin1String("bash") ? QStringLiteral("eval \"$(nix print-dev-env %1)\"").arg(shellQuote(projectRoot)) : QString();
+    }
+
+    if (dir.exists(QStringLiteral("shell.nix"))) {
+        return shell == QLatin1String("bash")
+            ? QStringLiteral("eval \"$(nix print-dev-env -f %1)\"").arg(shellQuote(dir.filePath(QStringLiteral("shell.nix"))))
+            : QString();
+    }
+
+    if (dir.exists(QStringLiteral("environment.yml"))) {
+        // The environment name comes from the file
+        QFile file(dir.filePath(QStringLiteral("environment.yml")));
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            static const QRegularExpression nameRegex(QStringLiteral("^name:\\s*([\\w.\\-]+)\\s*$"),
+                                                      QRegularExpression::MultilineOption);
+            QRegularExpressionMatch match = nameRegex.match(QString::fromUtf8(file.readAll()));
+            if (match.hasMatch()) {
+                return QStringLiteral("eval \"$(conda shell.%1 hook)\" && conda activate %2").arg(shell, shellQuote(match.captured(1)));
+            }
+        }
+        return QString();
+    }
+
+    for (const QString &venv : {QStringLiteral(".venv"), QStringLiteral("venv")}) {
+        if (dir.exists(venv + QStringLiteral("/bin/activate"))) {
+            return QStringLiteral(". %1").arg(shellQuote(dir.filePath(venv + QStringLiteral("/bin/activate"))));
+        }
+    }
+
+    return QString();
+}
+
+void EnvironmentCache::prepareCommand(QProcess *process, const QString &command, const QString &directory)
+{
+    QString shell = qEnvironmentVariable("SHELL", QStringLiteral("/bin/sh"));
+    QStringList changes = changesFor(directory);
+    if (!changes.isEmpty()) {
+        QProcessEnvironment environment = process->processEnvironment();
+        if (environment.isEmpty()) {
+            environment = QProcessEnvironment::systemEnvironment();
+        }
+        process->setProcessEnvironment(applyChanges(environment, changes));
+        process->setProgram(shell);
+        process->setArguments({QStringLiteral("-c"), command});
+        return;
+    }
+
+    // Not cached yet: activate in a bash that then runs the command in the user's shell
+    QString activation = activationCommand(directory, QStringLiteral("bash"));
+    if (activation.isEmpty()) {
+        process->setProgram(shell);
+        process->setArguments({QStringLiteral("-c"), command});
+        return;
+    }
+    process->setProgram(QStringLiteral("bash"));
+    process->setArguments({QStringLiteral("-c"),
+                           QStringLiteral("{ %1; } >/dev/null && exec \"$0\" -c \"$1\"").arg(activation),
+                           shell, command});
+}
+
+QProcessEnvironment EnvironmentCache::applyChanges(QProcessEnvironment environment, const QStringList &changes)
+{
+    for (const QString &change : changes) {
+        int separator = change.indexOf(QLatin1Char('='));
+        if (separator > 0) {
+            environment.insert(change.left(separator), change.mid(separator + 1));
+        } else {
+            environment.remove(change);
+        }
+    }
+    return environment;
+}
+
+void EnvironmentCache::clear()
+{
+    m_entries.clear();
+
+    QDir cacheDir(QFileInfo(cacheFilePath(QString())).absolutePath());
+    if (cacheDir.exists()) {
+        cacheDir.removeRecursively();
+    }
+}
+
+QByteArray EnvironmentCache::fingerprint(const QString &projectRoot) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QDir dir(projectRoot);
+
+    for (const char *file : ACTIVATION_FILES) {
+        QFile activationFile(dir.filePath(QLatin1String(file)));
+        if (!activationFile.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+
+        // Name and contents, so adding or removing a file also invalidates
+        hash.addData(QByteArray(file));
+        hash.addData(QByteArray(1, '\0'));
+        hash.addData(&activationFile);
+    }
+
+    return hash.result();
+}
+
+QString EnvironmentCache::captureScript(const QString &projectRoot) const
+{
+    QString activation = activationCommand(projectRoot, QStringLiteral("bash"));
+    if (activation.isEmpty()) {
+        return QString();
+    }
+
+    // Environment before and after, separated by an empty entry; the
+    // activation's own output goes to stderr to keep them apart
+    return QStringLiteral("env -0 && printf '\\0' && { %1; } >&2 && env -0").arg(activation);
+}
+
+void EnvironmentCache::capture(const QString &projectRoot, const QByteArray &fingerprint)
+{
+    if (m_capturing.contains(projectRoot)) {
+        return;
+    }
+
+    QString script = captureScript(projectRoot);
+    if (script.isEmpty()) {
+        return;
+    }
+
+    qDebug() << "EnvironmentCache: Capturing environment for" << projectRoot;
+    m_capturing.insert(projectRoot);
+
+    QProcess *process = new QProcess(this);
+    process->setWorkingDirectory(projectRoot);
+    process->setProcessChannelMode(QProcess::SeparateChannels);
+    process->setStandardInputFile(QProcess::nullDevice());
+
+    // Give up on activations that hang, e.g. waiting for a prompt
+    QTimer::singleShot(CAPTURE_TIMEOUT, process, [process]() {
+        qWarning() << "EnvironmentCache: Activation timed out";
+        process->kill();
+    });
+
+    connect(process, &QProcess::finished, this, [this, process, projectRoot, fingerprint](int exitCode, QProcess::ExitStatus exitStatus) {
+        m_capturing.remove(projectRoot);
+        process->deleteLater();
+
+        QByteArray output = process->readAllStandardOutput();
+        if (exitStatus != QProcess::NormalExit || exitCode != 0 || output.isEmpty()) {
+            qWarning() << "EnvironmentCache: Activation failed for" << projectRoot << ":"
+                       << process->readAllStandardError().trimmed();
+            return;
+        }
+
+        // env -0 separates entries with NUL, values may contain newlines;
+        // the two snapshots are separated by an empty entry
+        int separator = output.indexOf(QByteArrayLiteral("\0\0"));
+        if (separator < 0) {
+            qWarning() << "EnvironmentCache: Unexpected activation output for" << projectRoot;
+            return;
+        }
+        const QHash<QByteArray, QByteArray> before = parseEnvironment(output.left(separator));
+        const QHash<QByteArray, QByteArray> after = parseEnvironment(output.mid(separator + 2));
+
+        // Keep only what the activation changed
+        Entry entry;
+        entry.fingerprint = fingerprint;
+        entry.capturedAt = QDateTime::currentDateTimeUtc();
+        for (auto it = after.cbegin(); it != after.cend(); ++it) {
+            auto previous = before.constFind(it.key());
+            if (!isVolatile(it.key()) && (previous == before.cend() || previous.value() != it.value())) {
+                entry.changes.append(QString::fromUtf8(it.key() + '=' + it.value()));
+            }
+        }
+        for (auto it = before.cbegin(); it != before.cend(); ++it) {
+            if (!isVolatile(it.key()) && !after.contains(it.key())) {
+                entry.changes.append(QString::fromUtf8(it.key()));
+            }
+        }
+
+        m_entries.insert(projectRoot, entry);
+        saveEntry(projectRoot, entry);
+
+        qDebug() << "EnvironmentCache: Captured" << entry.changes.size() << "changed variables for" << projectRoot;
+        Q_EMIT environmentCaptured(projectRoot);
+    });
+
+    process->start(QStringLiteral("bash"), {QStringLiteral("-c"), script});
+}
+
+QString EnvironmentCache::cacheFilePath(const QString &projectRoot) const
+{
+    QString hash = QString::fromLatin1(QCryptographicHash::hash(projectRoot.toUtf8(), QCryptographicHash::Sha1).toHex());
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+           + QStringLiteral("/warpkate/environments/") + hash;
+}
+
+bool EnvironmentCache::loadEntry(const QString &projectRoot, Entry *entry) const
+{
+    QFile file(cacheFilePath(projectRoot));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    quint32 version = 0;
+    QString storedRoot;
+    stream >> version;
+    if (version != CACHE_FILE_VERSION) {
+        return false;
+    }
+
+    stream >> storedRoot >> entry->fingerprint >> entry->capturedAt >> entry->changes;
+
+    // Guard against hash collisions and truncated files
+    return stream.status() == QDataStream::Ok && storedRoot == projectRoot;
+}
+
+void EnvironmentCache::saveEntry(const QString &projectRoot, const Entry &entry) const
+{
+    QString path = cacheFilePath(projectRoot);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    // Environments can hold tokens, keep them private
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "EnvironmentCache: Could not write" << path;
+        return;
+    }
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+
+    QDataStream stream(&file);
+    stream << CACHE_FILE_VERSION << projectRoot << entry.fingerprint << entry.capturedAt << entry.changes;
+    file.commit();
+}
@@ -0,0 +1,176 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef ENVIRONMENTCACHE_H
+#define ENVIRONMENTCACHE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QObject>
+#include <QProcess>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Cache of project environments produced by activation tools
+ *
+ * Projects using direnv (.envrc), nix (flake.nix, shell.nix), conda
+ * (environment.yml) or a Python venv take seconds to activate in every new
+ * shell. This class runs the activation once in the background and keeps
+ * the changes it made to the environment, in memory and on disk, keyed by
+ * a hash of the activation files. New shells and jobs get the changes
+ * applied on top of the environment they inherit, so session variables
+ * like SSH_AUTH_SOCK or DISPLAY stay current.
+ *
+ * Until the changes are cached, the activation runs in the shell or job
+ * itself, so a project is activated the same way on a hit and a miss.
+ *
+ * The class follows the singleton pattern and should be accessed
+ * through the instance() method.
+ */
+class EnvironmentCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Get the singleton instance of the environment cache
+     * @return Reference to the environment cache
+     */
+    static EnvironmentCache &instance();
+
+    /**
+     * Find the project directory whose activation applies to a directory
+     * @param directory Directory a shell or job starts in
+     * @return Nearest directory (the given one or an ancestor) with an activation file, or empty
+     */
+    QString projectRootFor(const QString &directory) const;
+
+    /**
+     * Get the cached activation changes for a directory
+     *
+     * Never blocks on activation. On a miss, or when the activation files
+     * changed, an empty list is returned and a capture starts in the
+     * background. Hits older than an hour are returned and refreshed in
+     * the background.
+     *
+     * @param directory Directory a shell or job starts in
+     * @return KEY=VALUE entries to set and KEY entries to unset, or empty if nothing usable is cached
+     */
+    QStringList changesFor(const QString &directory);
+
+    /**
+     * Get the command that activates a directory's project in a running shell
+     * @param directory Directory the shell is in
+     * @param shell Shell name, "bash" or "zsh"
+     * @return Command to run, or empty if the project can't be activated in that shell
+     */
+    QString activationCommand(const QString &directory, const QString &shell) const;
+
+    /**
+     * Set up a process to run a shell command in its project's environment
+     *
+     * On a hit the cached changes are applied on top of the process
+     * environment, Kate's unless one was set; on a miss the command runs
+     * behind the activation.
+     *
+     * @param process Process to set the program, arguments and environment of
+     * @param command Command for $SHELL -c
+     * @param directory Directory the command runs in
+     */
+    void prepareCommand(QProcess *process, const QString &command, const QString &directory);
+
+    /**
+     * Apply activation changes to an environment
+     * @param environment Environment to start from
+     * @param changes KEY=VALUE entries to set and KEY entries to unset
+     * @return The changed environment
+     */
+    static QProcessEnvironment applyChanges(QProcessEnvironment environment, const QStringList &changes);
+
+    /**
+     * Drop all cached environments, in memory and on disk
+     */
+    void clear();
+
+Q_SIGNALS:
+    /**
+     * Emitted when a background capture stored a new environment
+     * @param projectRoot Project directory the environment belongs to
+     */
+    void environmentCaptured(const QString &projectRoot);
+
+private:
+    /**
+     * A captured environment
+     */
+    struct Entry {
+        QByteArray fingerprint;         ///< Hash of the activation files it was captured from
+        QDateTime capturedAt;           ///< When it was captured
+        QStringList changes;            ///< KEY=VALUE entries set and KEY entries unset by the activation
+    };
+
+    /**
+     * Private constructor (singleton pattern)
+     * @param parent QObject parent
+     */
+    explicit EnvironmentCache(QObject *parent = nullptr);
+
+    /**
+     * Destructor
+     */
+    ~EnvironmentCache() override;
+
+    /**
+     * Hash the names and contents of a project's activation files
+     * @param projectRoot Project directory
+     * @return Fingerprint of the activation state
+     */
+    QByteArray fingerprint(const QString &projectRoot) const;
+
+    /**
+     * Build the bash script that prints the environment before and after activation
+     * @param projectRoot Project directory
+     * @return Script, or empty if nothing can be activated
+     */
+    QString captureScript(const QString &projectRoot) const;
+
+    /**
+     * Run the activation for a project in the background
+     * @param projectRoot Project directory
+     * @param fingerprint Fingerprint the captured environment will be stored under
+     */
+    void capture(const QString &projectRoot, const QByteArray &fingerprint);
+
+    /**
+     * Get the file an entry is persisted in
+     * @param projectRoot Project directory
+     * @return Path of the cache file
+     */
+    QString cacheFilePath(const QString &projectRoot) const;
+
+    /**
+     * Read a persisted entry
+     * @param projectRoot Project directory
+     * @param entry Filled with the entry on success
+     * @return True if a valid entry was read
+     */
+    bool loadEntry(const QString &projectRoot, Entry *entry) const;
+
+    /**
+     * Persist an entry
+     * @param projectRoot Project directory
+     * @param entry Entry to write
+     */
+    void saveEntry(const QString &projectRoot, const Entry &entry) const;
+
+private:
+    QHash<QString, Entry> m_entries;    ///< Captured environments by project directory
+    QSet<QString> m_capturing;          ///< Projects with a capture in progress
+};
+
+#endif // ENVIRONMENTCACHE_H
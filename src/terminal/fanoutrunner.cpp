@@ -0,0 +1,284 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "fanoutrunner.h"
+#include "shelljob.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QThread>
+
+// Upper bound for the default parallelism, jobs are often I/O bound
+static const int MAX_DEFAULT_PARALLEL = 16;
+
+// Pattern selecting the git submodules instead of a glob
+static const QString SUBMODULES_PATTERN = QStringLiteral("submodules");
+
+FanOutRunner::FanOutRunner(QObject *parent)
+    : QObject(parent)
+    , m_wallTimeMsecs(0)
+    , m_nextJob(0)
+    , m_running(0)
+    , m_maxParallel(qBound(2, QThread::idealThreadCount(), MAX_DEFAULT_PARALLEL))
+    , m_useEnvironmentCache(false)
+{
+}
+
+FanOutRunner::~FanOutRunner()
+{
+    // The shell jobs are children and kill their process groups when
+    // deleted; nobody is left to receive the results
+    blockSignals(true);
+}
+
+QStringList FanOutRunner::resolveDirectories(const QString &baseDirectory, const QString &pattern)
+{
+    QStringList directories;
+    QDir base(baseDirectory);
+
+    if (pattern.trimmed() == SUBMODULES_PATTERN) {
+        // Submodule paths from .gitmodules: "path = some/dir" lines
+        QFile file(base.filePath(QStringLiteral(".gitmodules")));
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            return directories;
+        }
+        while (!file.atEnd()) {
+            QString line = QString::fromUtf8(file.readLine()).trimmed();
+            int equals = line.indexOf(QLatin1Char('='));
+            if (equals > 0 && line.left(equals).trimmed() == QLatin1String("path")) {
+                QString path = base.absoluteFilePath(line.mid(equals + 1).trimmed());
+                if (QFileInfo(path).isDir()) {
+                    directories.append(QDir::cleanPath(path));
+                }
+            }
+        }
+        directories.sort();
+        return directories;
+    }
+
+    // Expand the glob one path segment at a time
+    QStringList candidates = {base.absolutePath()};
+    const QStringList segments = pattern.trimmed().split(QLatin1Char('/'), Qt::SkipEmptyParts);
+    for (const QString &segment : segments) {
+        QStringList next;
+        for (const QString &candidate : std::as_const(candidates)) {
+            QDir dir(candidate);
+            if (segment == QLatin1String(".") || segment == QLatin1String("..")) {
+                next.append(QDir::cleanPath(dir.filePath(segment)));
+                continue;
+            }
+            const QStringList entries = dir.entryList({segment}, QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+            for (const QString &entry : entries) {
+                next.append(dir.filePath(entry));
+            }
+        }
+        candidates = next;
+    }
+
+    for (const QString &candidate : std::as_const(candidates)) {
+        if (QFileInfo(candidate).isDir()) {
+            directories.append(candidate);
+        }
+    }
+    directories.removeDuplicates();
+    directories.sort();
+    return directories;
+}
+
+void FanOutRunner::setMaxParallel(int count)
+{
+    m_maxParallel = qMax(1, count);
+}
+
+int FanOutRunner::maxParallel() const
+{
+    return m_maxParallel;
+}
+
+void FanOutRunner::setUseEnvironmentCache(bool enabled)
+{
+    m_useEnvironmentCache = enabled;
+}
+
+void FanOutRunner::setEnvironment(const QProcessEnvironment &environment)
+{
+    m_environment = environment;
+}
+
+bool FanOutRunner::start(const QString &command, const QStringList &directories)
+{
+    if (isRunning() || command.trimmed().isEmpty() || directories.isEmpty()) {
+        return false;
+    }
+
+    m_command = command;
+    m_jobs.clear();
+    qDeleteAll(m_shellJobs);
+    m_shellJobs.clear();
+    for (const QString &directory : directories) {
+        Job job;
+        job.directory = directory;
+        m_jobs.append(job);
+        m_shellJobs.append(nullptr);
+    }
+
+    m_nextJob = 0;
+    m_running = 0;
+    m_wallTimeMsecs = 0;
+    m_wallTime.start();
+
+    qDebug() << "FanOutRunner: Running" << command << "in" << directories.size() << "directories," << m_maxParallel << "at a time";
+    startQueued();
+    return true;
+}
+
+void FanOutRunner::cancel()
+{
+    if (!isRunning()) {
+        return;
+    }
+
+    // Queued jobs never start, running ones finish as they exit
+    m_nextJob = m_jobs.size();
+
+    for (ShellJob *shellJob : std::as_const(m_shellJobs)) {
+        if (shellJob) {
+            shellJob->stop();
+        }
+    }
+}
+
+bool FanOutRunner::isRunning() const
+{
+    return m_running > 0 || m_nextJob < m_jobs.size();
+}
+
+QString FanOutRunner::command() const
+{
+    return m_command;
+}
+
+QList<FanOutRunner::Job> FanOutRunner::jobs() const
+{
+    return m_jobs;
+}
+
+const FanOutRunner::Job &FanOutRunner::job(int index) const
+{
+    return m_jobs.at(index);
+}
+
+QString FanOutRunner::resultMatrix() const
+{
+    if (m_jobs.isEmpty()) {
+        return QString();
+    }
+
+    // Directories relative to their common parent keep the table narrow
+    QString parent = QFileInfo(m_jobs.first().directory).absolutePath();
+    for (const Job &job : m_jobs) {
+        while (!parent.isEmpty() && !job.directory.startsWith(parent + QLatin1Char('/')) && parent != QLatin1String("/")) {
+            parent = QFileInfo(parent).absolutePath();
+        }
+    }
+    QDir parentDir(parent);
+
+    QStringList names;
+    int nameWidth = 9;
+    for (const Job &job : m_jobs) {
+        names.append(parentDir.relativeFilePath(job.directory));
+        nameWidth = qMax(nameWidth, int(names.last().size()));
+    }
+
+    QLocale locale;
+    QString matrix = QStringLiteral("%1  %2  %3  %4\n")
+                         .arg(QStringLiteral("Directory"), -nameWidth)
+                         .arg(QStringLiteral("Exit"), 4)
+                         .arg(QStringLiteral("Duration"), 9)
+                         .arg(QStringLiteral("Output"), 9);
+
+    int failed = 0;
+    qint64 totalMsecs = 0;
+    for (int i = 0; i < m_jobs.size(); ++i) {
+        const Job &job = m_jobs.at(i);
+        QString exit;
+        QString duration;
+        if (!job.finished) {
+            exit = QStringLiteral("…");
+        } else if (job.exitCode < 0) {
+            exit = QStringLiteral("✗");
+        } else {
+            exit = QString::number(job.exitCode);
+        }
+        if (job.duration >= 0) {
+            duration = QStringLiteral("%1 s").arg(job.duration / 1000.0, 0, 'f', 1);
+            totalMsecs += job.duration;
+        }
+        if (job.finished && job.exitCode != 0) {
+            ++failed;
+        }
+
+        matrix += QStringLiteral("%1  %2  %3  %4\n")
+                      .arg(names.at(i), -nameWidth)
+                      .arg(exit, 4)
+                      .arg(duration, 9)
+                      .arg(locale.formattedDataSize(job.outputSize, 0), 9);
+    }
+
+    qint64 wallMsecs = isRunning() ? m_wallTime.elapsed() : m_wallTimeMsecs;
+    matrix += QStringLiteral("%1 of %2 failed, wall time %3 s (%4 s sequentially)")
+                  .arg(failed)
+                  .arg(m_jobs.size())
+                  .arg(wallMsecs / 1000.0, 0, 'f', 1)
+                  .arg(totalMsecs / 1000.0, 0, 'f', 1);
+    return matrix;
+}
+
+void FanOutRunner::startQueued()
+{
+    while (m_running < m_maxParallel && m_nextJob < m_jobs.size()) {
+        int index = m_nextJob++;
+        Job &job = m_jobs[index];
+
+        // Kept until the next run, a stopped job still reaps what its
+        // shell left behind
+        ShellJob *shellJob = new ShellJob(this);
+        shellJob->setUseEnvironmentCache(m_useEnvironmentCache);
+        shellJob->setEnvironment(m_environment);
+        connect(shellJob, &ShellJob::finished, this, [this, index](int exitCode) {
+            finishJob(index, exitCode);
+        });
+
+        job.startTime = QDateTime::currentDateTime();
+        m_shellJobs[index] = shellJob;
+        ++m_running;
+        Q_EMIT jobStarted(index);
+        shellJob->start(m_command, job.directory);
+    }
+}
+
+void FanOutRunner::finishJob(int index, int exitCode)
+{
+    Job &job = m_jobs[index];
+    const ShellJob *shellJob = m_shellJobs.at(index);
+    job.output = shellJob->output();
+    job.outputSize = shellJob->outputSize();
+    job.endTime = QDateTime::currentDateTime();
+    job.duration = job.startTime.msecsTo(job.endTime);
+    job.exitCode = exitCode;
+    job.finished = true;
+    --m_running;
+
+    Q_EMIT jobFinished(index);
+
+    startQueued();
+    if (!isRunning()) {
+        m_wallTimeMsecs = m_wallTime.elapsed();
+        Q_EMIT finished();
+    }
+}
@@ -0,0 +1,192 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef FANOUTRUNNER_H
+#define FANOUTRUNNER_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QProcessEnvironment>
+#include <QString>
+#include <QStringList>
+
+class ShellJob;
+
+/**
+ * Runs one command in many directories in parallel
+ *
+ * Each directory gets its own ShellJob, a non-interactive shell in a
+ * process group of its own, so runs neither share nor block the
+ * terminal's shell and cancelling also stops what the command started. At most maxParallel() jobs run at once; the rest
+ * wait in order. The total wall time is roughly that of the slowest job
+ * rather than the sum of all of them.
+ */
+class FanOutRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * One directory's run
+     */
+    struct Job {
+        QString directory;          ///< Directory the command runs in
+        QDateTime startTime;        ///< When it started, invalid while queued
+        QDateTime endTime;          ///< When it finished, invalid until then
+        qint64 duration;            ///< Run time in milliseconds, -1 until finished
+        int exitCode;               ///< Exit code, -1 if it crashed or did not start
+        qint64 outputSize;          ///< Bytes of output produced
+        QByteArray output;          ///< End of the output, as kept by ShellJob
+        bool finished;              ///< Whether the job is done
+
+        Job() : duration(-1), exitCode(-1), outputSize(0), finished(false) {}
+    };
+
+    /**
+     * Constructor
+     * @param parent Parent object
+     */
+    explicit FanOutRunner(QObject *parent = nullptr);
+
+    /**
+     * Destructor, kills jobs still running without waiting for them
+     */
+    ~FanOutRunner() override;
+
+    /**
+     * Resolve a directory set
+     *
+     * The pattern is either "submodules", for the paths listed in
+     * .gitmodules, or a glob relative to the base directory whose path
+     * segments may contain wildcards, e.g. "services/svc-*" or "packages/lib-*".
+     *
+     * @param baseDirectory Directory the pattern is relative to
+     * @param pattern Glob or "submodules"
+     * @return Absolute paths of existing directories, sorted
+     */
+    static QStringList resolveDirectories(const QString &baseDirectory, const QString &pattern);
+
+    /**
+     * Set how many jobs may run at once
+     * @param count Maximum number of parallel jobs, at least 1
+     */
+    void setMaxParallel(int count);
+
+    /**
+     * Get how many jobs may run at once
+     * @return Maximum number of parallel jobs
+     */
+    int maxParallel() const;
+
+    /**
+     * Give each job the cached project environment of its directory
+     * @param enabled Whether to use the environment cache
+     */
+    void setUseEnvironmentCache(bool enabled);
+
+    /**
+     * Set the environment each job runs in
+     * @param environment Environment, e.g. the shell's exported one; empty for Kate's
+     */
+    void setEnvironment(const QProcessEnvironment &environment);
+
+    /**
+     * Start running a command in every directory
+     *
+     * Does nothing if a run is still in progress.
+     *
+     * @param command Shell command
+     * @param directories Directories to run it in
+     * @return True if the run started
+     */
+    bool start(const QString &command, const QStringList &directories);
+
+    /**
+     * Stop running jobs and drop queued ones
+     *
+     * Returns at once; finished() is emitted when the stopped jobs exited.
+     */
+    void cancel();
+
+    /**
+     * Check whether a run is in progress
+     * @return True if jobs are queued or running
+     */
+    bool isRunning() const;
+
+    /**
+     * Get the command of the current or last run
+     * @return Command
+     */
+    QString command() const;
+
+    /**
+     * Get the jobs of the current or last run
+     * @return Jobs in directory order
+     */
+    QList<Job> jobs() const;
+
+    /**
+     * Get a job
+     * @param index Job index
+     * @return The job
+     */
+    const Job &job(int index) const;
+
+    /**
+     * Format the results as a table of exit code, duration and output
+     * size per directory, followed by the wall time
+     * @return Plain text table
+     */
+    QString resultMatrix() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted when a job started
+     * @param index Job index
+     */
+    void jobStarted(int index);
+
+    /**
+     * Emitted when a job finished
+     * @param index Job index
+     */
+    void jobFinished(int index);
+
+    /**
+     * Emitted when all jobs finished or the run was cancelled
+     */
+    void finished();
+
+private:
+    /**
+     * Start queued jobs while below the parallelism limit
+     */
+    void startQueued();
+
+    /**
+     * Record the end of a job and continue with the queue
+     * @param index Job index
+     * @param exitCode Exit code, -1 if it crashed or did not start
+     */
+    void finishJob(int index, int exitCode);
+
+private:
+    QString m_command;                  ///< Command of the current or last run
+    QList<Job> m_jobs;                  ///< Jobs of the current or last run
+    QList<ShellJob *> m_shellJobs;      ///< Shell per job, nullptr while queued
+    QElapsedTimer m_wallTime;           ///< Measures the whole run
+    qint64 m_wallTimeMsecs;             ///< Duration of the last finished run
+    int m_nextJob;                      ///< Index of the next queued job
+    int m_running;                      ///< Number of running jobs
+    int m_maxParallel;                  ///< Parallelism limit
+    bool m_useEnvironmentCache;         ///< Whether jobs get cached project environments
+    QProcessEnvironment m_environment;  ///< Environment of the jobs, empty for Kate's
+};
+
+#endif // FANOUTRUNNER_H
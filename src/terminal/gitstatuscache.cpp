@@ -0,0 +1,283 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "gitstatuscache.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QProcess>
+
+// File system changes are collected this long before git runs again (ms);
+// a single git command touches .git many times
+static const int CHANGE_BATCH_DELAY = 200;
+
+// A status older than this is recomputed when asked for (ms); edits in
+// subdirectories of the worktree are not watched
+static const qint64 STATUS_MAX_AGE = 5000;
+
+static GitStatusCache *s_instance = nullptr;
+
+QString GitStatus::summary() const
+{
+    if (!valid) {
+        return QString();
+    }
+
+    QString text = branch;
+    if (ahead > 0) {
+        text += QStringLiteral(" ↑%1").arg(ahead);
+    }
+    if (behind > 0) {
+        text += QStringLiteral(" ↓%1").arg(behind);
+    }
+    if (staged > 0) {
+        text += QStringLiteral(" +%1").arg(staged);
+    }
+    if (modified > 0) {
+        text += QStringLiteral(" ~%1").arg(modified);
+    }
+    if (untracked > 0) {
+        text += QStringLiteral(" ?%1").arg(untracked);
+    }
+
+    return text;
+}
+
+GitStatusCache &GitStatusCache::instance()
+{
+    if (!s_instance) {
+        s_instance = new GitStatusCache();
+    }
+    return *s_instance;
+}
+
+GitStatusCache::GitStatusCache(QObject *parent)
+    : QObject(parent)
+    , m_watcher(new QFileSystemWatcher(this))
+{
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &GitStatusCache::onPathChanged);
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &GitStatusCache::onPathChanged);
+
+    m_changeTimer.setSingleShot(true);
+    m_changeTimer.setInterval(CHANGE_BATCH_DELAY);
+    connect(&m_changeTimer, &QTimer::timeout, this, &GitStatusCache::refreshChanged);
+}
+
+GitStatusCache::~GitStatusCache()
+{
+}
+
+QString GitStatusCache::repositoryRootFor(const QString &directory) const
+{
+    if (directory.isEmpty()) {
+        return QString();
+    }
+
+    // .git is a directory in normal clones and a file in worktrees and submodules
+    QDir dir(directory);
+    do {
+        if (QFileInfo::exists(dir.filePath(QStringLiteral(".git")))) {
+            return dir.absolutePath();
+        }
+    } while (dir.cdUp());
+
+    return QString();
+}
+
+GitStatus GitStatusCache::statusFor(const QString &directory)
+{
+    QString root = repositoryRootFor(directory);
+    if (root.isEmpty()) {
+        return GitStatus();
+    }
+
+    Repository &repo = repository(root);
+    GitStatus status = repo.status;
+    if (repo.age.isValid() && repo.age.elapsed() > STATUS_MAX_AGE) {
+        repo.stale = true;
+    }
+    if (repo.stale && !repo.process) {
+        refresh(root);
+    }
+
+    return status;
+}
+
+void GitStatusCache::invalidate(const QString &directory)
+{
+    QString root = repositoryRootFor(directory);
+
+    // Nothing to recompute for repositories nobody asked about
+    if (root.isEmpty() || !m_repositories.contains(root)) {
+        return;
+    }
+
+    refresh(root);
+}
+
+GitStatusCache::Repository &GitStatusCache::repository(const QString &root)
+{
+    auto it = m_repositories.find(root);
+    if (it != m_repositories.end()) {
+        return *it;
+    }
+
+    Repository repo;
+    repo.gitDirectory = root + QStringLiteral("/.git");
+
+    // Worktrees and submodules point to their git directory
+    QFileInfo gitInfo(repo.gitDirectory);
+    if (gitInfo.isFile()) {
+        QFile file(repo.gitDirectory);
+        if (file.open(QIODevice::ReadOnly)) {
+            QString line = QString::fromUtf8(file.readLine()).trimmed();
+            if (line.startsWith(QLatin1String("gitdir: "))) {
+                repo.gitDirectory = QDir(root).absoluteFilePath(line.mid(8));
+            }
+        }
+    }
+
+    // HEAD, index and ref updates are renames inside these directories;
+    // the worktree root catches files created and deleted at the top level
+    m_watcher->addPaths({repo.gitDirectory, repo.gitDirectory + QStringLiteral("/refs/heads"), root});
+
+    return *m_repositories.insert(root, repo);
+}
+
+void GitStatusCache::refresh(const QString &root)
+{
+    Repository &repo = repository(root);
+
+    // Run again once the current run finished
+    repo.stale = true;
+    if (repo.process) {
+        return;
+    }
+    repo.stale = false;
+
+    QProcess *process = new QProcess(this);
+    repo.process = process;
+    process->setWorkingDirectory(root);
+    process->setStandardInputFile(QProcess::nullDevice());
+
+    connect(process, &QProcess::finished, this, [this, process, root](int exitCode, QProcess::ExitStatus exitStatus) {
+        process->deleteLater();
+
+        auto it = m_repositories.find(root);
+        if (it == m_repositories.end()) {
+            return;
+        }
+        it->process = nullptr;
+
+        if (exitStatus == QProcess::NormalExit && exitCode == 0) {
+            it->status = parseStatus(process->readAllStandardOutput());
+            it->age.start();
+            Q_EMIT statusChanged(root);
+        } else {
+            qWarning() << "GitStatusCache: git status failed in" << root << ":" << process->readAllStandardError().trimmed();
+        }
+
+        if (it->stale) {
+            refresh(root);
+        }
+    });
+
+    connect(process, &QProcess::errorOccurred, this, [this, process, root](QProcess::ProcessError error) {
+        // finished() is not emitted when git can't be started at all
+        if (error != QProcess::FailedToStart) {
+            return;
+        }
+
+        qWarning() << "GitStatusCache: Could not run git";
+        process->deleteLater();
+        auto it = m_repositories.find(root);
+        if (it != m_repositories.end()) {
+            it->process = nullptr;
+        }
+    });
+
+    // No optional locks: never write the index, so we neither contend with
+    // the user's git commands nor trigger our own watcher. That also means
+    // the untracked cache is never updated, so it is left as configured
+    process->start(QStringLiteral("git"),
+                   {QStringLiteral("--no-optional-locks"),
+                    QStringLiteral("status"), QStringLiteral("--porcelain=v2"), QStringLiteral("--branch"), QStringLiteral("-z")});
+}
+
+GitStatus GitStatusCache::parseStatus(const QByteArray &output)
+{
+    GitStatus status;
+    status.valid = true;
+    QString oid;
+
+    const QList<QByteArray> entries = output.split('\0');
+    for (int i = 0; i < entries.size(); ++i) {
+        const QByteArray &entry = entries.at(i);
+
+        if (entry.startsWith("# branch.oid ")) {
+            oid = QString::fromLatin1(entry.mid(13));
+        } else if (entry.startsWith("# branch.head ")) {
+            status.branch = QString::fromUtf8(entry.mid(14));
+            status.detached = status.branch == QLatin1String("(detached)");
+        } else if (entry.startsWith("# branch.ab ")) {
+            // "# branch.ab +<ahead> -<behind>"
+            QList<QByteArray> counts = entry.mid(12).split(' ');
+            if (counts.size() == 2) {
+                status.ahead = counts.at(0).mid(1).toInt();
+                status.behind = counts.at(1).mid(1).toInt();
+            }
+        } else if (entry.startsWith("1 ") || entry.startsWith("2 ")) {
+            // "<type> <XY> ...", X is the index, Y the worktree
+            if (entry.size() > 3) {
+                if (entry.at(2) != '.') {
+                    status.staged++;
+                }
+                if (entry.at(3) != '.') {
+                    status.modified++;
+                }
+            }
+
+            // Renames and copies carry the original path as an extra entry
+            if (entry.startsWith("2 ")) {
+                ++i;
+            }
+        } else if (entry.startsWith("u ")) {
+            status.modified++;
+        } else if (entry.startsWith("? ")) {
+            status.untracked++;
+        }
+    }
+
+    if (status.detached) {
+        status.branch = oid.left(7);
+    }
+
+    return status;
+}
+
+void GitStatusCache::onPathChanged(const QString &path)
+{
+    for (auto it = m_repositories.begin(); it != m_repositories.end(); ++it) {
+        if (path == it.key() || path.startsWith(it->gitDirectory)) {
+            it->stale = true;
+        }
+    }
+
+    m_changeTimer.start();
+}
+
+void GitStatusCache::refreshChanged()
+{
+    const QStringList roots = m_repositories.keys();
+    for (const QString &root : roots) {
+        const Repository &repo = m_repositories[root];
+        if (repo.stale && !repo.process) {
+            refresh(root);
+        }
+    }
+}
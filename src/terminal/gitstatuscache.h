@@ -0,0 +1,168 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef GITSTATUSCACHE_H
+#define GITSTATUSCACHE_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class QFileSystemWatcher;
+class QProcess;
+
+/**
+ * Summary of a repository's git status
+ */
+struct GitStatus {
+    bool valid;                 ///< Whether a status has been computed
+    QString branch;             ///< Branch name, or short commit id when detached
+    bool detached;              ///< Whether HEAD is detached
+    int ahead;                  ///< Commits ahead of upstream
+    int behind;                 ///< Commits behind upstream
+    int staged;                 ///< Entries with staged changes
+    int modified;               ///< Entries with unstaged changes (including conflicts)
+    int untracked;              ///< Untracked entries
+
+    GitStatus() : valid(false), detached(false), ahead(0), behind(0), staged(0), modified(0), untracked(0) {}
+
+    /**
+     * Check whether the worktree differs from HEAD
+     * @return True if anything is staged, modified or untracked
+     */
+    bool isDirty() const {
+        return staged > 0 || modified > 0 || untracked > 0;
+    }
+
+    /**
+     * Get a compact one-line summary, e.g. "main ↑1 ↓2 +1 ~3 ?2"
+     * @return Summary, empty if not valid
+     */
+    QString summary() const;
+};
+
+/**
+ * Asynchronous, cached git status per repository
+ *
+ * Replaces the git segment of shell prompts: instead of running git status
+ * before every prompt, WarpKate runs
+ * `git status --porcelain=v2 --branch` in a separate process, keeps the
+ * result per repository and only recomputes it when the file system
+ * watcher reports changes in the .git directory or the worktree root,
+ * when a command finished in the repository, or when a status older than
+ * a few seconds is asked for. The watcher doesn't see edits in
+ * subdirectories; the age limit bounds how long those go unnoticed.
+ *
+ * The class follows the singleton pattern and should be accessed
+ * through the instance() method.
+ */
+class GitStatusCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Get the singleton instance of the git status cache
+     * @return Reference to the git status cache
+     */
+    static GitStatusCache &instance();
+
+    /**
+     * Find the repository a directory belongs to
+     * @param directory Any directory
+     * @return Worktree root, or empty if the directory is not in a repository
+     */
+    QString repositoryRootFor(const QString &directory) const;
+
+    /**
+     * Get the status of the repository containing a directory
+     *
+     * Never blocks. Returns the cached status, which is invalid until the
+     * first computation finished; statusChanged() announces new results.
+     * A status older than a few seconds is recomputed in the background.
+     *
+     * @param directory Any directory in the repository
+     * @return Cached status
+     */
+    GitStatus statusFor(const QString &directory);
+
+    /**
+     * Mark the status of a repository as stale and recompute it
+     * @param directory Any directory in the repository
+     */
+    void invalidate(const QString &directory);
+
+Q_SIGNALS:
+    /**
+     * Emitted when a repository's status was recomputed
+     * @param repositoryRoot Worktree root of the repository
+     */
+    void statusChanged(const QString &repositoryRoot);
+
+private:
+    /**
+     * Per repository state
+     */
+    struct Repository {
+        QString gitDirectory;       ///< The repository's .git directory
+        GitStatus status;           ///< Last computed status
+        QProcess *process;          ///< Running git status, or nullptr
+        bool stale;                 ///< Whether the status needs recomputing
+        QElapsedTimer age;          ///< Runs since the status was last computed
+
+        Repository() : process(nullptr), stale(true) {}
+    };
+
+    /**
+     * Private constructor (singleton pattern)
+     * @param parent QObject parent
+     */
+    explicit GitStatusCache(QObject *parent = nullptr);
+
+    /**
+     * Destructor
+     */
+    ~GitStatusCache() override;
+
+    /**
+     * Get or create the state for a repository and watch it
+     * @param root Worktree root
+     * @return Repository state
+     */
+    Repository &repository(const QString &root);
+
+    /**
+     * Start git status for a repository unless one is running
+     * @param root Worktree root
+     */
+    void refresh(const QString &root);
+
+    /**
+     * Parse `git status --porcelain=v2 --branch -z` output
+     * @param output Raw output
+     * @return Parsed status
+     */
+    static GitStatus parseStatus(const QByteArray &output);
+
+    /**
+     * Handle a change reported by the file system watcher
+     * @param path Changed path
+     */
+    void onPathChanged(const QString &path);
+
+    /**
+     * Recompute the repositories changed since the last run
+     */
+    void refreshChanged();
+
+private:
+    QHash<QString, Repository> m_repositories;  ///< State by worktree root
+    QFileSystemWatcher *m_watcher;              ///< Watches .git directories and worktree roots
+    QTimer m_changeTimer;                       ///< Batches bursts of file system changes
+};
+
+#endif // GITSTATUSCACHE_H
@@ -0,0 +1,746 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "kittygraphics.h"
+
+#include <QBuffer>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QImageReader>
+#include <QSet>
+#include <QSharedPointer>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+// Decoded images kept per session (bytes), kitty's default storage quota
+static const qint64 MAX_IMAGE_MEMORY = 320 * 1024 * 1024;
+
+// Encoded data accepted for one image (bytes)
+static const qint64 MAX_TRANSFER_SIZE = 256 * 1024 * 1024;
+
+// Largest image side accepted (pixels)
+static const int MAX_IMAGE_DIMENSION = 8192;
+
+// A chunked transmission is dropped when no chunk arrived for this long (ms)
+static const int CHUNK_TIMEOUT = 10000;
+
+// Cell size assumed until the grid widget reports the real one
+static const QSize DEFAULT_CELL_SIZE(8, 16);
+
+KittyGraphics::KittyGraphics(QObject *parent)
+    : QObject(parent)
+    , m_cellSize(DEFAULT_CELL_SIZE)
+    , m_memoryUsed(0)
+    , m_nextImageId(1)
+    , m_useCounter(0)
+    , m_generation(0)
+{
+    m_chunkTimeout.setSingleShot(true);
+    m_chunkTimeout.setInterval(CHUNK_TIMEOUT);
+    connect(&m_chunkTimeout, &QTimer::timeout, this, [this]() {
+        m_chunkKeys.clear();
+        m_chunkData.clear();
+    });
+}
+
+KittyGraphics::~KittyGraphics()
+{
+}
+
+void KittyGraphics::setCellSize(const QSize &size)
+{
+    if (size.isEmpty() || size == m_cellSize) {
+        return;
+    }
+
+    m_cellSize = size;
+    for (Placement &placement : m_placements) {
+        updateFootprint(placement, m_images.value(placement.imageId).size);
+    }
+    Q_EMIT changed();
+}
+
+void KittyGraphics::processCommand(const QByteArray &command, QPoint *cursor, bool alternateScreen)
+{
+    int separator = command.indexOf(';');
+    Keys keys = parseKeys(separator < 0 ? command : command.left(separator));
+    QByteArray payload = separator < 0 ? QByteArray() : command.mid(separator + 1);
+
+    // Follow-up chunks of a transmission only carry m (and q); any other
+    // key starts a new command and the unfinished transmission is dropped
+    if (!m_chunkKeys.isEmpty()) {
+        for (auto it = keys.constBegin(); it != keys.constEnd(); ++it) {
+            if (it.key() != 'm' && it.key() != 'q') {
+                m_chunkTimeout.stop();
+                m_chunkKeys.clear();
+                m_chunkData.clear();
+                break;
+            }
+        }
+    }
+    if (!m_chunkKeys.isEmpty()) {
+        m_chunkTimeout.start();
+        m_chunkData += QByteArray::fromBase64(payload);
+        if (m_chunkData.size() > MAX_TRANSFER_SIZE) {
+            m_chunkTimeout.stop();
+            Keys first = m_chunkKeys;
+            m_chunkKeys.clear();
+            m_chunkData.clear();
+            respond(first, quint32(numberValue(first, 'i')), "EFBIG:image data too large");
+            return;
+        }
+        if (numberValue(keys, 'm') == 1) {
+            return;
+        }
+
+        m_chunkTimeout.stop();
+        Keys first = m_chunkKeys;
+        QByteArray data = m_chunkData;
+        m_chunkKeys.clear();
+        m_chunkData.clear();
+        transmit(first, data, cursor, alternateScreen);
+        return;
+    }
+
+    switch (charValue(keys, 'a', 't')) {
+        case 't': // Transmit
+        case 'T': // Transmit and display
+        case 'q': // Query support, decode without storing
+        {
+            // Out-of-band data is read along with the decoding, off this thread
+            QByteArray data = payload;
+            if (charValue(keys, 't', 'd') == 'd') {
+                data = QByteArray::fromBase64(payload);
+                if (numberValue(keys, 'm') == 1) {
+                    m_chunkKeys = keys;
+                    m_chunkData = data;
+                    m_chunkTimeout.start();
+                    return;
+                }
+            }
+            transmit(keys, data, cursor, alternateScreen);
+            break;
+        }
+
+        case 'p': // Display a transmitted image
+        {
+            quint32 imageId = quint32(numberValue(keys, 'i'));
+            QByteArray error = place(keys, imageId, cursor, alternateScreen);
+            respond(keys, imageId, error.isEmpty() ? QByteArray("OK") : error);
+            break;
+        }
+
+        case 'd': // Delete
+            remove(keys, *cursor, alternateScreen);
+            break;
+
+        default:
+            respond(keys, quint32(numberValue(keys, 'i')), "EINVAL:unsupported action");
+            break;
+    }
+}
+
+void KittyGraphics::scroll(int top, int bottom, int lines, bool alternateScreen)
+{
+    for (auto it = m_placements.begin(); it != m_placements.end();) {
+        // Placements overlapping the region move with its text
+        if (it->alternateScreen == alternateScreen && it->cell.y() + it->rows > top && it->cell.y() <= bottom) {
+            it->cell.ry() -= lines;
+
+            // Gone once completely scrolled out of the region
+            if (it->cell.y() + it->rows <= top || it->cell.y() > bottom) {
+                it = m_placements.erase(it);
+                continue;
+            }
+        }
+        ++it;
+    }
+}
+
+void KittyGraphics::clearPlacements(bool alternateScreen)
+{
+    int removed = m_placements.removeIf([alternateScreen](const Placement &placement) {
+        return placement.alternateScreen == alternateScreen;
+    });
+
+    if (removed > 0) {
+        Q_EMIT changed();
+    }
+}
+
+void KittyGraphics::reset()
+{
+    // Decodes still running are ignored when they finish
+    m_images.clear();
+    m_placements.clear();
+    m_chunkKeys.clear();
+    m_chunkData.clear();
+    m_chunkTimeout.stop();
+    m_memoryUsed = 0;
+    Q_EMIT changed();
+}
+
+QList<KittyGraphics::Placement> KittyGraphics::placements(bool alternateScreen) const
+{
+    QList<Placement> result;
+    for (const Placement &placement : m_placements) {
+        if (placement.alternateScreen == alternateScreen) {
+            result.append(placement);
+        }
+    }
+    return result;
+}
+
+QImage KittyGraphics::image(quint32 imageId) const
+{
+    return m_images.value(imageId).image;
+}
+
+qint64 KittyGraphics::memoryUsed() const
+{
+    return m_memoryUsed;
+}
+
+KittyGraphics::Keys KittyGraphics::parseKeys(const QByteArray &control)
+{
+    Keys keys;
+    const QList<QByteArray> pairs = control.split(',');
+    for (const QByteArray &pair : pairs) {
+        if (pair.size() >= 3 && pair.at(1) == '=') {
+            keys.insert(pair.at(0), pair.mid(2));
+        }
+    }
+    return keys;
+}
+
+qint64 KittyGraphics::numberValue(const Keys &keys, char key, qint64 defaultValue)
+{
+    bool ok = false;
+    qint64 value = keys.value(key).toLongLong(&ok);
+    return ok ? value : defaultValue;
+}
+
+char KittyGraphics::charValue(const Keys &keys, char key, char defaultValue)
+{
+    QByteArray value = keys.value(key);
+    return value.isEmpty() ? defaultValue : value.at(0);
+}
+
+QByteArray KittyGraphics::readExternalData(const Keys &keys, const QByteArray &payload, QByteArray *data)
+{
+    char medium = charValue(keys, 't', 'd');
+    qint64 offset = numberValue(keys, 'O');
+    qint64 size = numberValue(keys, 'S');
+    QByteArray name = QByteArray::fromBase64(payload);
+
+    if (offset < 0 || size < 0 || name.isEmpty()) {
+        return "EINVAL:bad offset, size or name";
+    }
+    if (size > MAX_TRANSFER_SIZE) {
+        return "EFBIG:image data too large";
+    }
+
+    if (medium == 's') {
+        int fd = shm_open(name.constData(), O_RDONLY, 0);
+        if (fd < 0) {
+            return "ENOENT:" + QByteArray(strerror(errno));
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > offset) {
+            qint64 length = size > 0 ? qMin<qint64>(size, info.st_size - offset) : info.st_size - offset;
+            if (length <= MAX_TRANSFER_SIZE) {
+                void *memory = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (memory != MAP_FAILED) {
+                    *data = QByteArray(static_cast<const char *>(memory) + offset, length);
+                    munmap(memory, info.st_size);
+                }
+            }
+        }
+        ::close(fd);
+
+        // The object belongs to the terminal once it was sent
+        shm_unlink(name.constData());
+
+        return data->isEmpty() ? QByteArray("ENODATA:could not read shared memory") : QByteArray();
+    }
+
+    if (medium != 'f' && medium != 't') {
+        return "EINVAL:unsupported transmission medium";
+    }
+
+    QFileInfo info(QFile::decodeName(name));
+    QString path = info.canonicalFilePath();
+    if (path.isEmpty() || !info.isFile()) {
+        return "EBADF:not a regular file";
+    }
+
+    // Never read kernel interfaces on behalf of a program
+    if (path.startsWith(QLatin1String("/proc/")) || path.startsWith(QLatin1String("/sys/"))
+        || (path.startsWith(QLatin1String("/dev/")) && !path.startsWith(QLatin1String("/dev/shm/")))) {
+        return "EPERM:file not allowed";
+    }
+
+    // Temporary files are deleted after reading, so only accept what the
+    // protocol allows: files in a temporary directory with the marker name
+    if (medium == 't') {
+        QString tempDirectory = QFileInfo(QDir::tempPath()).canonicalFilePath() + QLatin1Char('/');
+        bool inTempDirectory = path.startsWith(tempDirectory) || path.startsWith(QLatin1String("/tmp/"))
+                               || path.startsWith(QLatin1String("/dev/shm/"));
+        if (!inTempDirectory || !path.contains(QLatin1String("tty-graphics-protocol"))) {
+            return "EPERM:not a temporary file";
+        }
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || (offset > 0 && !file.seek(offset))) {
+        return "EBADF:" + file.errorString().toUtf8();
+    }
+    *data = file.read(size > 0 ? size : MAX_TRANSFER_SIZE + 1);
+    file.close();
+
+    if (medium == 't') {
+        QFile::remove(path);
+    }
+
+    if (data->size() > MAX_TRANSFER_SIZE) {
+        data->clear();
+        return "EFBIG:image data too large";
+    }
+
+    return data->isEmpty() ? QByteArray("ENODATA:file is empty") : QByteArray();
+}
+
+void KittyGraphics::transmit(const Keys &keys, const QByteArray &data, QPoint *cursor, bool alternateScreen)
+{
+    char action = charValue(keys, 'a', 't');
+    int format = int(numberValue(keys, 'f', 32));
+    bool compressed = charValue(keys, 'o', 0) == 'z';
+    bool direct = charValue(keys, 't', 'd') == 'd';
+    quint32 imageId = quint32(numberValue(keys, 'i'));
+
+    if (format != 24 && format != 32 && format != 100) {
+        respond(keys, imageId, "EINVAL:unsupported format");
+        return;
+    }
+
+    // Raw pixels need their size; PNG carries it in the header
+    QSize size;
+    if (format == 100) {
+        if (direct && !compressed && data.size() >= 24 && data.startsWith("\x89PNG\r\n\x1a\n")) {
+            size = QSize(int(qFromBigEndian<quint32>(data.constData() + 16)),
+                         int(qFromBigEndian<quint32>(data.constData() + 20)));
+        }
+    } else {
+        size = QSize(int(numberValue(keys, 's')), int(numberValue(keys, 'v')));
+        if (size.isEmpty()) {
+            respond(keys, imageId, "EINVAL:missing image size");
+            return;
+        }
+    }
+    if (size.width() > MAX_IMAGE_DIMENSION || size.height() > MAX_IMAGE_DIMENSION) {
+        respond(keys, imageId, "EFBIG:image too large");
+        return;
+    }
+
+    // Images sent without an id still need one internally
+    if (imageId == 0 && action != 'q') {
+        do {
+            imageId = m_nextImageId++;
+        } while (imageId == 0 || m_images.contains(imageId));
+    }
+
+    quint64 generation = ++m_generation;
+    if (action != 'q') {
+        // Retransmitting an id replaces the image and its placements
+        freeImage(imageId);
+
+        Image image;
+        image.size = size;
+        image.lastUsed = ++m_useCounter;
+        image.generation = generation;
+        m_images.insert(imageId, image);
+    }
+
+    // The error is written by the worker before the future finishes
+    QSharedPointer<QByteArray> error(new QByteArray);
+    QFutureWatcher<QImage> *watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, this, [this, watcher, imageId, generation, keys, action, error]() {
+        watcher->deleteLater();
+        QImage decoded = watcher->result();
+
+        if (action == 'q') {
+            respond(keys, imageId, decoded.isNull() ? *error : QByteArray("OK"));
+        } else {
+            imageDecoded(imageId, generation, decoded, *error, keys);
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([keys, data, size, error]() {
+        return load(keys, data, size, error.data());
+    }));
+
+    // Placed right away so the cursor moves in order with the text; the
+    // image shows up once decoded
+    if (action == 'T') {
+        QByteArray error = place(keys, imageId, cursor, alternateScreen);
+        if (!error.isEmpty()) {
+            respond(keys, imageId, error);
+        }
+    }
+}
+
+QByteArray KittyGraphics::place(const Keys &keys, quint32 imageId, QPoint *cursor, bool alternateScreen)
+{
+    auto it = m_images.find(imageId);
+    if (it == m_images.end()) {
+        return "ENOENT:image not found";
+    }
+    it->lastUsed = ++m_useCounter;
+
+    Placement placement;
+    placement.imageId = imageId;
+    placement.placementId = quint32(numberValue(keys, 'p'));
+    placement.cell = *cursor;
+    placement.columns = 1;
+    placement.rows = 1;
+    placement.requestedColumns = int(qMax<qint64>(0, numberValue(keys, 'c')));
+    placement.requestedRows = int(qMax<qint64>(0, numberValue(keys, 'r')));
+    placement.sourceRect = QRect(int(numberValue(keys, 'x')), int(numberValue(keys, 'y')),
+                                 int(numberValue(keys, 'w')), int(numberValue(keys, 'h')));
+    placement.pixelOffset = QPoint(int(numberValue(keys, 'X')), int(numberValue(keys, 'Y')));
+    placement.zIndex = int(numberValue(keys, 'z'));
+    placement.alternateScreen = alternateScreen;
+    updateFootprint(placement, it->size);
+
+    // Placing an image with an existing placement id moves that placement
+    if (placement.placementId != 0) {
+        m_placements.removeIf([&placement](const Placement &other) {
+            return other.imageId == placement.imageId && other.placementId == placement.placementId;
+        });
+    }
+    m_placements.append(placement);
+
+    // The cursor ends up after the image's last column, on its last row
+    if (numberValue(keys, 'C') != 1) {
+        cursor->rx() += placement.columns;
+        cursor->ry() += placement.rows - 1;
+    }
+
+    Q_EMIT changed();
+    return QByteArray();
+}
+
+void KittyGraphics::remove(const Keys &keys, const QPoint &cursor, bool alternateScreen)
+{
+    // Lower case removes placements, upper case also frees the image data
+    char what = charValue(keys, 'd', 'a');
+    bool freeData = what >= 'A' && what <= 'Z';
+    char target = what | 0x20;
+
+    quint32 imageId = quint32(numberValue(keys, 'i'));
+    quint32 placementId = quint32(numberValue(keys, 'p'));
+    int zIndex = int(numberValue(keys, 'z'));
+    QPoint cell = target == 'p' ? QPoint(int(numberValue(keys, 'x')) - 1, int(numberValue(keys, 'y')) - 1) : cursor;
+
+    QSet<quint32> affected;
+    for (auto it = m_placements.begin(); it != m_placements.end();) {
+        bool matches = false;
+        if (target == 'i') {
+            matches = it->imageId == imageId && (placementId == 0 || it->placementId == placementId);
+        } else if (it->alternateScreen == alternateScreen) {
+            switch (target) {
+                case 'a':
+                    matches = true;
+                    break;
+                case 'c':
+                case 'p':
+                    matches = QRect(it->cell, QSize(it->columns, it->rows)).contains(cell);
+                    break;
+                case 'z':
+                    matches = it->zIndex == zIndex;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if (matches) {
+            affected.insert(it->imageId);
+            it = m_placements.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (freeData) {
+        if (target == 'i') {
+            affected.insert(imageId);
+        }
+        for (quint32 id : std::as_const(affected)) {
+            bool stillPlaced = std::any_of(m_placements.cbegin(), m_placements.cend(), [id](const Placement &placement) {
+                return placement.imageId == id;
+            });
+            if (!stillPlaced) {
+                freeImage(id);
+            }
+        }
+    }
+
+    Q_EMIT changed();
+}
+
+void KittyGraphics::updateFootprint(Placement &placement, const QSize &imageSize) const
+{
+    // Width and height 0 extend the source rectangle to the image's edges
+    QSize visible;
+    if (imageSize.isValid()) {
+        QRect source = placement.sourceRect;
+        if (source.width() <= 0) {
+            source.setWidth(imageSize.width() - source.x());
+        }
+        if (source.height() <= 0) {
+            source.setHeight(imageSize.height() - source.y());
+        }
+        placement.sourceRect = source.intersected(QRect(QPoint(0, 0), imageSize));
+        visible = placement.sourceRect.size();
+    }
+
+    const int cellWidth = m_cellSize.width();
+    const int cellHeight = m_cellSize.height();
+    int columns = placement.requestedColumns;
+    int rows = placement.requestedRows;
+
+    if (visible.isEmpty()) {
+        // Size unknown until decoded
+    } else if (columns > 0 && rows == 0) {
+        // Keep the aspect ratio
+        rows = int(std::ceil(double(columns) * cellWidth * visible.height() / visible.width() / cellHeight));
+    } else if (rows > 0 && columns == 0) {
+        columns = int(std::ceil(double(rows) * cellHeight * visible.width() / visible.height() / cellWidth));
+    } else if (columns == 0 && rows == 0) {
+        columns = (visible.width() + placement.pixelOffset.x() + cellWidth - 1) / cellWidth;
+        rows = (visible.height() + placement.pixelOffset.y() + cellHeight - 1) / cellHeight;
+    }
+
+    placement.columns = qMax(1, columns);
+    placement.rows = qMax(1, rows);
+}
+
+QImage KittyGraphics::decode(const QByteArray &data, int format, bool compressed, const QSize &size)
+{
+    QByteArray bytes = data;
+    if (compressed) {
+        // Raw pixels have a known size; a PNG is held to the transfer limit
+        qint64 limit = format == 100 ? MAX_TRANSFER_SIZE : qint64(size.width()) * size.height() * (format / 8);
+        bytes = inflate(data, qMin(limit, MAX_TRANSFER_SIZE));
+        if (bytes.isEmpty()) {
+            return QImage();
+        }
+    }
+
+    if (format == 100) {
+        // Check the size before allocating anything
+        QBuffer buffer(&bytes);
+        QImageReader reader(&buffer, "png");
+        QSize imageSize = reader.size();
+        if (!imageSize.isValid() || imageSize.width() > MAX_IMAGE_DIMENSION || imageSize.height() > MAX_IMAGE_DIMENSION) {
+            return QImage();
+        }
+        return reader.read().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    int bytesPerPixel = format / 8;
+    if (bytes.size() < qint64(size.width()) * size.height() * bytesPerPixel) {
+        return QImage();
+    }
+
+    // Wraps the data; the conversion makes the deep copy
+    QImage raw(reinterpret_cast<const uchar *>(bytes.constData()), size.width(), size.height(),
+               size.width() * bytesPerPixel, format == 24 ? QImage::Format_RGB888 : QImage::Format_RGBA8888);
+    return raw.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+QByteArray KittyGraphics::inflate(const QByteArray &data, qint64 limit)
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        return QByteArray();
+    }
+
+    // Grown as the output comes, so a small bomb can't allocate the limit up
+    // front; one byte past the limit tells a stream that is too large
+    QByteArray output;
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = uInt(data.size());
+
+    int result = Z_OK;
+    while (result == Z_OK && qint64(stream.total_out) <= limit) {
+        qint64 capacity = qMin<qint64>(limit + 1, qMax<qint64>(output.size() * 2, 64 * 1024));
+        output.resize(capacity);
+        stream.next_out = reinterpret_cast<Bytef *>(output.data() + stream.total_out);
+        stream.avail_out = uInt(capacity - qint64(stream.total_out));
+        result = ::inflate(&stream, Z_NO_FLUSH);
+    }
+
+    const bool complete = result == Z_STREAM_END && qint64(stream.total_out) <= limit;
+    output.resize(qint64(stream.total_out));
+    inflateEnd(&stream);
+    return complete ? output : QByteArray();
+}
+
+QImage KittyGraphics::load(const Keys &keys, const QByteArray &data, const QSize &size, QByteArray *error)
+{
+    QByteArray bytes = data;
+    if (charValue(keys, 't', 'd') != 'd') {
+        bytes.clear();
+        *error = readExternalData(keys, data, &bytes);
+        if (!error->isEmpty()) {
+            return QImage();
+        }
+    }
+
+    QImage image = decode(bytes, int(numberValue(keys, 'f', 32)), charValue(keys, 'o', 0) == 'z', size);
+    if (image.isNull()) {
+        *error = "EINVAL:could not decode image";
+    }
+    return image;
+}
+
+void KittyGraphics::imageDecoded(quint32 imageId, quint64 generation, const QImage &image, const QByteArray &error, const Keys &keys)
+{
+    // Replaced or deleted while decoding
+    auto it = m_images.find(imageId);
+    if (it == m_images.end() || it->generation != generation) {
+        return;
+    }
+
+    if (image.isNull()) {
+        freeImage(imageId);
+        respond(keys, imageId, error);
+        return;
+    }
+
+    bool sizeKnown = it->size.isValid();
+    it->image = image;
+    it->size = image.size();
+    m_memoryUsed += image.sizeInBytes();
+
+    if (!sizeKnown) {
+        for (Placement &placement : m_placements) {
+            if (placement.imageId == imageId) {
+                updateFootprint(placement, image.size());
+            }
+        }
+    }
+
+    enforceMemoryLimit(imageId);
+    respond(keys, imageId, "OK");
+    Q_EMIT changed();
+}
+
+void KittyGraphics::enforceMemoryLimit(quint32 keepId)
+{
+    while (m_memoryUsed > MAX_IMAGE_MEMORY) {
+        // Images nobody sees go first, then the least recently used
+        quint32 victim = 0;
+        bool victimPlaced = true;
+        quint64 victimUse = std::numeric_limits<quint64>::max();
+
+        for (auto it = m_images.cbegin(); it != m_images.cend(); ++it) {
+            if (it.key() == keepId || it->image.isNull()) {
+                continue;
+            }
+
+            quint32 id = it.key();
+            bool placed = std::any_of(m_placements.cbegin(), m_placements.cend(), [id](const Placement &placement) {
+                return placement.imageId == id;
+            });
+            if ((victimPlaced && !placed) || (placed == victimPlaced && it->lastUsed < victimUse)) {
+                victim = id;
+                victimPlaced = placed;
+                victimUse = it->lastUsed;
+            }
+        }
+
+        if (victimUse == std::numeric_limits<quint64>::max()) {
+            // Only the new image is left
+            break;
+        }
+
+        qDebug() << "KittyGraphics: Evicting image" << victim << "to stay within the memory budget";
+        freeImage(victim);
+    }
+}
+
+void KittyGraphics::freeImage(quint32 imageId)
+{
+    auto it = m_images.find(imageId);
+    if (it == m_images.end()) {
+        return;
+    }
+
+    m_memoryUsed -= it->image.sizeInBytes();
+    m_images.erase(it);
+
+    int removed = m_placements.removeIf([imageId](const Placement &placement) {
+        return placement.imageId == imageId;
+    });
+    if (removed > 0) {
+        Q_EMIT changed();
+    }
+}
+
+void KittyGraphics::respond(const Keys &keys, quint32 imageId, const QByteArray &message)
+{
+    // Clients only get answers for commands that carry an id
+    if (!keys.contains('i') && !keys.contains('I')) {
+        return;
+    }
+
+    // q=1 suppresses OK, q=2 errors as well
+    int quiet = int(numberValue(keys, 'q'));
+    if (quiet >= 2 || (quiet == 1 && message == "OK")) {
+        return;
+    }
+
+    // Anything but a number could smuggle input into whatever reads the PTY
+    QByteArray response = "\033_Gi=" + QByteArray::number(imageId);
+    bool ok = false;
+    quint32 number = keys.value('I').toUInt(&ok);
+    if (ok) {
+        response += ",I=" + QByteArray::number(number);
+    }
+    number = keys.value('p').toUInt(&ok);
+    if (ok) {
+        response += ",p=" + QByteArray::number(number);
+    }
+
+    QByteArray text = message;
+    for (char &c : text) {
+        if (uchar(c) < 0x20 || uchar(c) == 0x7f) {
+            c = ' ';
+        }
+    }
+    response += ';' + text + "\033\\";
+
+    Q_EMIT responseReady(response);
+}
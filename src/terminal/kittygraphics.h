@@ -0,0 +1,289 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef KITTYGRAPHICS_H
+#define KITTYGRAPHICS_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QPoint>
+#include <QRect>
+#include <QSize>
+#include <QTimer>
+
+/**
+ * Kitty graphics protocol (APC G commands) for the built-in terminal
+ *
+ * Image data arrives either directly, base64 encoded through the PTY and
+ * possibly split into chunks, or out of band: from a file (t=f), from a
+ * temporary file deleted after reading (t=t) or from a POSIX shared
+ * memory object (t=s). The out-of-band modes keep large pixel data away
+ * from the PTY and the VT parser entirely.
+ *
+ * Reading out-of-band data and decoding (zlib, PNG, raw RGB/RGBA) run on
+ * the thread pool. Decoded
+ * images are kept per session within a memory budget, evicting the least
+ * recently used images first. Placements are anchored to screen cells
+ * and move with the text when the screen scrolls.
+ */
+class KittyGraphics : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * An image shown on the grid
+     */
+    struct Placement {
+        quint32 imageId;            ///< Image shown
+        quint32 placementId;        ///< Client's placement id, 0 if none
+        QPoint cell;                ///< Top left cell
+        int columns;                ///< Width in cells
+        int rows;                   ///< Height in cells
+        int requestedColumns;       ///< Width asked for by the client, 0 for the image's
+        int requestedRows;          ///< Height asked for by the client, 0 for the image's
+        QRect sourceRect;           ///< Part of the image shown, null for all of it
+        QPoint pixelOffset;         ///< Offset inside the top left cell
+        int zIndex;                 ///< Drawn below the text if negative
+        bool alternateScreen;       ///< Screen the placement belongs to
+    };
+
+    /**
+     * Constructor
+     * @param parent Parent object
+     */
+    explicit KittyGraphics(QObject *parent = nullptr);
+
+    /**
+     * Destructor
+     */
+    ~KittyGraphics() override;
+
+    /**
+     * Set the size of one cell, used to size placements
+     * @param size Cell size in pixels
+     */
+    void setCellSize(const QSize &size);
+
+    /**
+     * Process a graphics command
+     * @param command APC payload after the leading 'G', without terminator
+     * @param cursor Cursor cell, moved past displayed images
+     * @param alternateScreen Whether the alternate screen is active
+     */
+    void processCommand(const QByteArray &command, QPoint *cursor, bool alternateScreen);
+
+    /**
+     * Move placements with scrolled text
+     * @param top First row of the scroll region
+     * @param bottom Last row of the scroll region
+     * @param lines Lines scrolled up, negative for down
+     * @param alternateScreen Screen that scrolled
+     */
+    void scroll(int top, int bottom, int lines, bool alternateScreen);
+
+    /**
+     * Remove all placements of a screen, keeping the images
+     * @param alternateScreen Screen to clear
+     */
+    void clearPlacements(bool alternateScreen);
+
+    /**
+     * Drop all images, placements and partial transmissions
+     */
+    void reset();
+
+    /**
+     * Get the placements of a screen
+     * @param alternateScreen Screen to query
+     * @return Placements in the order they were made
+     */
+    QList<Placement> placements(bool alternateScreen) const;
+
+    /**
+     * Get a decoded image
+     * @param imageId Image id
+     * @return The image, null if unknown or still decoding
+     */
+    QImage image(quint32 imageId) const;
+
+    /**
+     * Get the memory used by decoded images
+     * @return Bytes
+     */
+    qint64 memoryUsed() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted when the client must be answered
+     * @param response APC response to write to the PTY
+     */
+    void responseReady(const QByteArray &response);
+
+    /**
+     * Emitted when images or placements changed and the grid needs repainting
+     */
+    void changed();
+
+private:
+    using Keys = QHash<char, QByteArray>;
+
+    /**
+     * A transmitted image
+     */
+    struct Image {
+        QImage image;               ///< Decoded pixels, null while decoding
+        QSize size;                 ///< Size in pixels, invalid until known
+        quint64 lastUsed;           ///< Use counter value of the last placement
+        quint64 generation;         ///< Distinguishes retransmissions of the same id
+    };
+
+    /**
+     * Parse the comma separated key=value control data
+     * @param control Control data
+     * @return Values by key
+     */
+    static Keys parseKeys(const QByteArray &control);
+
+    /**
+     * Get a numeric key
+     * @param keys Parsed keys
+     * @param key Key
+     * @param defaultValue Value if the key is missing
+     * @return Value
+     */
+    static qint64 numberValue(const Keys &keys, char key, qint64 defaultValue = 0);
+
+    /**
+     * Get a single character key
+     * @param keys Parsed keys
+     * @param key Key
+     * @param defaultValue Value if the key is missing
+     * @return Value
+     */
+    static char charValue(const Keys &keys, char key, char defaultValue);
+
+    /**
+     * Read out-of-band image data from a file or shared memory; runs on the thread pool
+     * @param keys Parsed keys
+     * @param payload Base64 encoded path or shared memory name
+     * @param data Receives the data
+     * @return Error response, empty on success
+     */
+    static QByteArray readExternalData(const Keys &keys, const QByteArray &payload, QByteArray *data);
+
+    /**
+     * Store an image and start loading it, then display it for a=T
+     * @param keys Parsed keys
+     * @param data Encoded image data for t=d, the base64 encoded name for the other media
+     * @param cursor Cursor cell
+     * @param alternateScreen Whether the alternate screen is active
+     */
+    void transmit(const Keys &keys, const QByteArray &data, QPoint *cursor, bool alternateScreen);
+
+    /**
+     * Display a stored image at the cursor
+     * @param keys Parsed keys
+     * @param imageId Image to display
+     * @param cursor Cursor cell, moved past the image unless C=1
+     * @param alternateScreen Whether the alternate screen is active
+     * @return Error response, empty on success
+     */
+    QByteArray place(const Keys &keys, quint32 imageId, QPoint *cursor, bool alternateScreen);
+
+    /**
+     * Delete placements and possibly images (a=d)
+     * @param keys Parsed keys
+     * @param cursor Cursor cell
+     * @param alternateScreen Whether the alternate screen is active
+     */
+    void remove(const Keys &keys, const QPoint &cursor, bool alternateScreen);
+
+    /**
+     * Compute the cells a placement covers
+     * @param placement Placement to update
+     * @param imageSize Size of the image, invalid if not known yet
+     */
+    void updateFootprint(Placement &placement, const QSize &imageSize) const;
+
+    /**
+     * Decode image data; runs on the thread pool
+     * @param data Encoded data
+     * @param format 24 (RGB), 32 (RGBA) or 100 (PNG)
+     * @param compressed Whether the data is zlib compressed
+     * @param size Size in pixels, required for raw formats
+     * @return Decoded image, null on failure
+     */
+    static QImage decode(const QByteArray &data, int format, bool compressed, const QSize &size);
+
+    /**
+     * Inflate zlib data, giving up beyond a size
+     * @param data zlib stream (RFC 1950)
+     * @param limit Largest inflated size accepted (bytes)
+     * @return Inflated data, empty if it is corrupt or larger than the limit
+     */
+    static QByteArray inflate(const QByteArray &data, qint64 limit);
+
+    /**
+     * Read out-of-band data if needed and decode it; runs on the thread pool
+     * @param keys Parsed keys
+     * @param data Encoded data for t=d, the base64 encoded name for the other media
+     * @param size Size in pixels, required for raw formats
+     * @param error Receives the error response on failure
+     * @return Decoded image, null on failure
+     */
+    static QImage load(const Keys &keys, const QByteArray &data, const QSize &size, QByteArray *error);
+
+    /**
+     * Take a decoded image into the cache
+     * @param imageId Image id
+     * @param generation Generation the decode was started for
+     * @param image Decoded image, null on failure
+     * @param error Error response if the image is null
+     * @param keys Keys of the transmission, for the response
+     */
+    void imageDecoded(quint32 imageId, quint64 generation, const QImage &image, const QByteArray &error, const Keys &keys);
+
+    /**
+     * Evict least recently used images until within the memory budget
+     * @param keepId Image never to evict
+     */
+    void enforceMemoryLimit(quint32 keepId);
+
+    /**
+     * Drop an image and its placements
+     * @param imageId Image id
+     */
+    void freeImage(quint32 imageId);
+
+    /**
+     * Answer the client unless it asked for quiet
+     *
+     * The reply is written to the PTY, so only numeric ids are echoed
+     * and the message is stripped of control characters.
+     *
+     * @param keys Keys of the command
+     * @param imageId Image the command refers to
+     * @param message "OK" or an error such as "ENOENT:..."
+     */
+    void respond(const Keys &keys, quint32 imageId, const QByteArray &message);
+
+private:
+    QHash<quint32, Image> m_images;     ///< Transmitted images by id
+    QList<Placement> m_placements;      ///< Placements on both screens
+    Keys m_chunkKeys;                   ///< Keys of a chunked transmission in progress
+    QByteArray m_chunkData;             ///< Data received so far for it
+    QTimer m_chunkTimeout;              ///< Drops a chunked transmission that stopped arriving
+    QSize m_cellSize;                   ///< Cell size in pixels
+    qint64 m_memoryUsed;                ///< Bytes of decoded images
+    quint32 m_nextImageId;              ///< Next id for images sent without one
+    quint64 m_useCounter;               ///< Orders images by last use
+    quint64 m_generation;               ///< Incremented for every transmission
+};
+
+#endif // KITTYGRAPHICS_H
@@ -5,34 +5,34 @@
 
 #include "qtermwidgetemulator.h"
 
-#include <QApplication>
-#include <QClipboard>
+#include <QBuffer>
 #include <QDebug>
 #include <QDir>
-#include <QRegularExpression>
-#include <QTimer>
-#include <QTemporaryFile>
-#include <QTextStream>
-#include <QTextCodec>
+#include <QFont>
+#include <QKeyEvent>
 
 // Include QTermWidget
 #include <qtermwidget.h>
 
+#include <termios.h>
+
 QTermWidgetEmulator::QTermWidgetEmulator(QWidget *parent)
-    : TerminalEmulator(parent)
-    , m_termWidget(new QTermWidget(parent))
-    , m_lastExitCode(0)
-    , m_commandExecuting(false)
+    : TerminalBackend(parent)
+    , m_termWidget(new QTermWidget(0, parent))
+    , m_termSize(80, 24)
     , m_initialized(false)
     , m_busy(false)
-    , m_blockModeEnabled(true)
-    , m_currentBlockId(0)
+    , m_lastExitCode(0)
+    , m_commandExecuting(false)
+    , m_screenDirty(true)
+    , m_damaged(false)
+    , m_alternateScreenActive(false)
 {
     // Set up the QTermWidget with sensible defaults
     m_termWidget->setScrollBarPosition(QTermWidget::ScrollBarRight);
-    m_termWidget->setColorScheme("Linux");
+    m_termWidget->setColorScheme(QStringLiteral("Linux"));
     m_termWidget->setBlinkingCursor(true);
-    m_termWidget->setTerminalFont(QFont("Monospace", 10));
+    m_termWidget->setTerminalFont(QFont(QStringLiteral("Monospace"), 10));
     m_termWidget->setHistorySize(5000);
     m_termWidget->setMotionAfterPasting(2); // Paste and move cursor to end
 
@@ -40,16 +40,18 @@ QTermWidgetEmulator::QTermWidgetEmulator(QWidget *parent)
     m_workingDirectory = QDir::homePath();
 
     // Connect QTermWidget signals to our slots
-    connect(m_termWidget, &QTermWidget::receivedData, this, &QTermWidgetEmulator::processTerminalOutput);
-    connect(m_termWidget, &QTermWidget::titleChanged, this, &QTermWidgetEmulator::handleTitleChanged);
-    connect(m_termWidget, &QTermWidget::finished, this, &QTermWidgetEmulator::handleFinished);
-    connect(m_termWidget, &QTermWidget::bellSignal, this, &QTermWidgetEmulator::handleBell);
-
-    // Set up a timer to periodically check for commands and working directory
-    QTimer *detectionTimer = new QTimer(this);
-    connect(detectionTimer, &QTimer::timeout, this, &QTermWidgetEmulator::detectCommand);
-    connect(detectionTimer, &QTimer::timeout, this, &QTermWidgetEmulator::detectWorkingDirectory);
-    detectionTimer->start(1000); // Check every second
+    connect(m_termWidget, &QTermWidget::receivedData, this, &QTermWidgetEmulator::onReceivedData);
+    connect(m_termWidget, &QTermWidget::titleChanged, this, &QTermWidgetEmulator::onTitleChanged);
+    connect(m_termWidget, &QTermWidget::finished, this, &QTermWidgetEmulator::onFinished);
+    connect(m_termWidget, &QTermWidget::bell, this, &QTermWidgetEmulator::bellTriggered);
+
+    // Same prompt heuristic as the internal emulator
+    m_promptRegex = QRegularExpression(QLatin1String(R"(^\s*[\w\-]+(:\s*[\w~/\-.]+)?\s*[\$#%>](\s+|$))"));
+    m_alternateScreenRegex = QRegularExpression(QLatin1String(R"(\x1b\[\?(?:47|1047|1049)([hl]))"));
+    m_semanticPromptRegex = QRegularExpression(QLatin1String(R"(\x1b\]133;([A-D])(?:;([^\x07\x1b]*))?(?:\x07|\x1b\\))"));
+
+    m_commandDetectionTimer.setSingleShot(true);
+    connect(&m_commandDetectionTimer, &QTimer::timeout, this, &QTermWidgetEmulator::detectCommand);
 }
 
 QTermWidgetEmulator::~QTermWidgetEmulator()
@@ -57,6 +59,16 @@ QTermWidgetEmulator::~QTermWidgetEmulator()
     // QTermWidget will be destroyed by its parent
 }
 
+TerminalBackendType QTermWidgetEmulator::backendType() const
+{
+    return TerminalBackendType::QTermWidget;
+}
+
+QWidget *QTermWidgetEmulator::displayWidget() const
+{
+    return m_termWidget;
+}
+
 bool QTermWidgetEmulator::initialize(int rows, int cols)
 {
     if (m_initialized) {
@@ -64,14 +76,20 @@ bool QTermWidgetEmulator::initialize(int rows, int cols)
     }
 
     // Set initial size
-    m_termWidget->setSize(QSize(cols, rows));
-    
+    m_termSize = QSize(cols, rows);
+    m_termWidget->setSize(m_termSize);
+
     m_initialized = true;
     return true;
 }
 
 bool QTermWidgetEmulator::startShell(const QString &shellCommand, const QString &initialWorkingDirectory)
 {
+    if (m_busy) {
+        // Shell already running
+        return true;
+    }
+
     // Set working directory if provided
     if (!initialWorkingDirectory.isEmpty()) {
         m_workingDirectory = initialWorkingDirectory;
@@ -86,37 +104,53 @@ bool QTermWidgetEmulator::startShell(const QString &shellCommand, const QString
         }
     }
 
+    // Split program and arguments the same way the internal emulator does
+    QStringList shellParts = shell.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    m_termWidget->setShellProgram(shellParts.takeFirst());
+    m_termWidget->setArgs(shellParts);
+    m_termWidget->setWorkingDirectory(m_workingDirectory);
+
     // Start the terminal with the specified shell
     m_termWidget->startShellProgram();
-    
+
     // Flag as busy once shell is started
     m_busy = true;
-    
+
     return true;
 }
 
 void QTermWidgetEmulator::resize(int rows, int cols)
 {
-    // QTermWidget handles resizing internally, just update the size
-    m_termWidget->setSize(QSize(cols, rows));
-    Q_EMIT sizeChanged(QSize(cols, rows));
+    // QTermWidget forwards the size to its PTY itself
+    m_termSize = QSize(cols, rows);
+    m_termWidget->setSize(m_termSize);
+
+    m_screenDirty = true;
+    m_damaged = true;
+    Q_EMIT sizeChanged(m_termSize);
+    Q_EMIT redrawRequired();
 }
 
 void QTermWidgetEmulator::processInput(const QString &text)
 {
-    // Send the text to the terminal
-    if (m_busy) {
-        m_termWidget->sendText(text);
+    if (!m_busy) {
+        return;
     }
+
+    // QTermWidget applies bracketed paste on its own paste path only, so
+    // plain text goes straight to the PTY
+    m_termWidget->sendText(text);
 }
 
 void QTermWidgetEmulator::processKeyPress(int key, Qt::KeyboardModifiers modifiers, const QString &text)
 {
-    // For this implementation, we'll rely on QTermWidget's own key event handling
-    // by letting the parent widget send the key events directly to the QTermWidget
-    Q_UNUSED(key);
-    Q_UNUSED(modifiers);
-    Q_UNUSED(text);
+    if (!m_busy) {
+        return;
+    }
+
+    // Let QTermWidget's own keyboard translator encode the key
+    QKeyEvent event(QEvent::KeyPress, key, modifiers, text);
+    m_termWidget->sendKeyEvent(&event);
 }
 
 void QTermWidgetEmulator::executeCommand(const QString &command, bool addNewline)
@@ -132,34 +166,134 @@ void QTermWidgetEmulator::executeCommand(const QString &command, bool addNewline
     m_currentOutput.clear();
 
     // Send the command to the terminal
-    m_termWidget->sendText(command);
-    
-    // Add newline if requested
-    if (addNewline) {
-        m_termWidget->sendText("\r");
-    }
+    m_termWidget->sendText(addNewline ? command + QLatin1Char('\r') : command);
+
+    // Notify that a new command was started
+    Q_EMIT commandDetected(command);
+}
 
-    // Update block if block mode is enabled
-    if (m_blockModeEnabled) {
-        m_currentBlockId++;
-        // Notify that a new command was started
-        Q_EMIT commandDetected(command);
+void QTermWidgetEmulator::setShellEnvironment(const QStringList &environment)
+{
+    // QTermWidget adds its entries to the inherited environment; it has no
+    // way to unset a variable, so those changes are left out
+    QStringList variables;
+    for (const QString &variable : environment) {
+        if (variable.contains(QLatin1Char('='))) {
+            variables.append(variable);
+        }
     }
+    m_termWidget->setEnvironment(variables);
+}
+
+bool QTermWidgetEmulator::isMouseTrackingActive() const
+{
+    return false;
+}
+
+void QTermWidgetEmulator::processMouseEvent(TerminalMouseAction action, Qt::MouseButton button,
+                                            Qt::KeyboardModifiers modifiers, const QPoint &cell)
+{
+    Q_UNUSED(action);
+    Q_UNUSED(button);
+    Q_UNUSED(modifiers);
+    Q_UNUSED(cell);
 }
 
 void QTermWidgetEmulator::clear()
 {
     m_termWidget->clear();
+    m_screenDirty = true;
+    m_damaged = true;
+    Q_EMIT redrawRequired();
 }
 
 QSize QTermWidgetEmulator::size() const
 {
-    return m_termWidget->size();
+    return QSize(m_termWidget->screenColumnsCount(), m_termWidget->screenLinesCount());
+}
+
+QChar QTermWidgetEmulator::characterAt(int x, int y) const
+{
+    updateScreenSnapshot();
+
+    if (y < 0 || y >= m_screenLines.size() || x < 0) {
+        return QChar();
+    }
+
+    const QString &line = m_screenLines.at(y);
+    return x < line.size() ? line.at(x) : QChar(QLatin1Char(' '));
+}
+
+TerminalCharFormat QTermWidgetEmulator::formatAt(int x, int y) const
+{
+    Q_UNUSED(x);
+    Q_UNUSED(y);
+    return TerminalCharFormat();
+}
+
+QPoint QTermWidgetEmulator::cursorPosition() const
+{
+    updateScreenSnapshot();
+
+    // Approximate the cursor as the end of the last non-empty line
+    for (int y = m_screenLines.size() - 1; y >= 0; --y) {
+        QString line = m_screenLines.at(y);
+        while (line.endsWith(QLatin1Char(' '))) {
+            line.chop(1);
+        }
+        if (!line.isEmpty()) {
+            return QPoint(line.size(), y);
+        }
+    }
+
+    return QPoint(0, 0);
+}
+
+bool QTermWidgetEmulator::isCursorVisible() const
+{
+    return true;
+}
+
+bool QTermWidgetEmulator::isAlternateScreenActive() const
+{
+    return m_alternateScreenActive;
+}
+
+QString QTermWidgetEmulator::getText(bool stripFormatting) const
+{
+    Q_UNUSED(stripFormatting);
+    updateScreenSnapshot();
+    return m_screenLines.join(QLatin1Char('\n'));
+}
+
+QString QTermWidgetEmulator::getLine(int line, bool stripFormatting) const
+{
+    Q_UNUSED(stripFormatting);
+    updateScreenSnapshot();
+
+    if (line < 0 || line >= m_screenLines.size()) {
+        return QString();
+    }
+
+    return m_screenLines.at(line);
+}
+
+QRect QTermWidgetEmulator::takeDamage()
+{
+    // QTermWidget does its own partial repaints; report whole-screen damage
+    if (!m_damaged) {
+        return QRect();
+    }
+
+    m_damaged = false;
+    return QRect(QPoint(0, 0), size());
 }
 
 QString QTermWidgetEmulator::currentWorkingDirectory() const
 {
-    return m_workingDirectory;
+    // QTermWidget reads the cwd of the shell from /proc
+    QString directory = m_termWidget->workingDirectory();
+    return directory.isEmpty() ? m_workingDirectory : directory;
 }
 
 bool QTermWidgetEmulator::isBusy() const
@@ -167,6 +301,28 @@ bool QTermWidgetEmulator::isBusy() const
     return m_busy;
 }
 
+bool QTermWidgetEmulator::isShellInForeground() const
+{
+    if (!m_busy) {
+        return true;
+    }
+
+    int foreground = m_termWidget->getForegroundProcessId();
+    return foreground <= 0 || foreground == m_termWidget->getShellPID();
+}
+
+bool QTermWidgetEmulator::isRawModeActive() const
+{
+    // The shell's line editor runs non-canonical too, so it doesn't count
+    int slave = m_termWidget->getPtySlaveFd();
+    if (slave < 0 || isShellInForeground()) {
+        return false;
+    }
+
+    struct termios attributes;
+    return tcgetattr(slave, &attributes) == 0 && !(attributes.c_lflag & ICANON);
+}
+
 int QTermWidgetEmulator::lastExitCode() const
 {
     return m_lastExitCode;
@@ -182,7 +338,7 @@ QStringList QTermWidgetEmulator::commandHistory() const
     return m_commandHistory;
 }
 
-QTermWidget* QTermWidgetEmulator::termWidget() const
+QTermWidget *QTermWidgetEmulator::termWidget() const
 {
     return m_termWidget;
 }
@@ -199,147 +355,135 @@ void QTermWidgetEmulator::pasteFromClipboard()
 
 void QTermWidgetEmulator::selectAll()
 {
-    m_termWidget->selectAll();
+    // Select the visible screen
+    m_termWidget->setSelectionStart(0, 0);
+    m_termWidget->setSelectionEnd(m_termWidget->screenLinesCount() - 1, m_termWidget->screenColumnsCount() - 1);
 }
 
 bool QTermWidgetEmulator::findText(const QString &text, bool caseSensitive, bool searchForward)
 {
-    return m_termWidget->search(text, searchForward, caseSensitive);
+    Q_UNUSED(searchForward);
+
+    if (text.isEmpty()) {
+        return false;
+    }
+
+    // QTermWidget only offers an interactive search bar, so search the snapshot
+    return getText().contains(text, caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
 }
 
-void QTermWidgetEmulator::processTerminalOutput()
+void QTermWidgetEmulator::onReceivedData(const QString &text)
 {
-    // This slot is called when QTermWidget has new output
-    
-    // Get the displayed text to analyze
-    QString text = m_termWidget->getSelectedText();
-    
+    trackAlternateScreen(text);
+    trackSemanticPromptMarks(text);
+
     // Accumulate output if a command is executing
     if (m_commandExecuting) {
         m_currentOutput.append(text);
     }
-    
+
+    m_screenDirty = true;
+    m_damaged = true;
+
     // Emit signal for raw output
     Q_EMIT outputAvailable(text);
     Q_EMIT redrawRequired();
+
+    // Schedule command detection
+    m_commandDetectionTimer.start(100);
 }
 
-void QTermWidgetEmulator::handleTitleChanged(const QString &title)
+void QTermWidgetEmulator::onTitleChanged()
 {
-    Q_EMIT titleChanged(title);
+    Q_EMIT titleChanged(m_termWidget->title());
 }
 
-void QTermWidgetEmulator::handleFinished()
+void QTermWidgetEmulator::onFinished()
 {
     m_busy = false;
     Q_EMIT shellFinished(m_lastExitCode);
 }
 
-void QTermWidgetEmulator::handleBell()
-{
-    Q_EMIT bellTriggered();
-}
-
 void QTermWidgetEmulator::detectCommand()
 {
-    if (!m_busy) {
+    if (!m_busy || !m_commandExecuting || m_alternateScreenActive) {
         return;
     }
 
-    // We need to run a command to check the last command status
-    // This will be done by creating a temporary script and executing it
-    
-    QTemporaryFile tempFile;
-    tempFile.setAutoRemove(true);
-    if (tempFile.open()) {
-        QTextStream stream(&tempFile);
-        
-        // Write a script to get information about the current shell state
-        stream << "#!/bin/bash\n";
-        stream << "echo '--- WARPKATE_CMD_INFO_START ---'\n";
-        stream << "echo \"EXITCODE=$?\"\n";
-        stream << "echo \"PWD=$(pwd)\"\n";
-        stream << "echo \"LAST_CMD=$(history 1 | awk '{$1=\"\"; print substr($0,2)}')\"\n";
-        stream << "echo '--- WARPKATE_CMD_INFO_END ---'\n";
-        
-        stream.flush();
-        tempFile.close();
-        
-        // Make the script executable
-        QFile(tempFile.fileName()).setPermissions(
-            QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner);
-        
-        // Run the script in the terminal
-        QString scriptCmd = QString("source %1\r").arg(tempFile.fileName());
-        
-        // Save current command state
-        bool wasExecuting = m_commandExecuting;
-        QString currentCmd = m_currentCommand;
-        QString currentOutput = m_currentOutput;
-        
-        // Temporarily disable command tracking to avoid interference
-        m_commandExecuting = false;
-        
-        // Execute the info gathering script
-        m_termWidget->sendText(scriptCmd);
-        
-        // Restore command state
-        m_commandExecuting = wasExecuting;
-        m_currentCommand = currentCmd;
-        m_currentOutput = currentOutput;
-    }
-    
-    // Check if the output from the script is in the terminal
-    QString terminalText = m_termWidget->getScreenContents();
-    
-    QRegularExpression infoRegex(
-        QStringLiteral("--- WARPKATE_CMD_INFO_START ---\\s*"
-                      "EXITCODE=(\\d+)\\s*"
-                      "PWD=([^\\n]*)\\s*"
-                      "LAST_CMD=([^\\n]*)\\s*"
-                      "--- WARPKATE_CMD_INFO_END ---"));
-                      
-    QRegularExpressionMatch match = infoRegex.match(terminalText);
-    
-    if (match.hasMatch()) {
-        // Extract command information
-        m_lastExitCode = match.captured(1).toInt();
-        
-        QString newWorkingDir = match.captured(2).trimmed();
-        if (!newWorkingDir.isEmpty() && newWorkingDir != m_workingDirectory) {
-            m_workingDirectory = newWorkingDir;
-            Q_EMIT workingDirectoryChanged(m_workingDirectory);
+    updateScreenSnapshot();
+
+    // Look for a prompt on the last non-empty line
+    for (int y = m_screenLines.size() - 1; y >= 0; --y) {
+        const QString &line = m_screenLines.at(y);
+        if (line.trimmed().isEmpty()) {
+            continue;
         }
-        
-        QString lastCmd = match.captured(3).trimmed();
-        if (!lastCmd.isEmpty() && m_commandExecuting) {
-            // If we have a non-empty last command and we were tracking a command,
-            // it means the command has completed
+
+        if (m_promptRegex.match(line).hasMatch()) {
+            // QTermWidget has no exit code reporting; assume success
             m_commandExecuting = false;
-            
-            // Emit command executed signal
+            m_lastExitCode = 0;
+
             Q_EMIT commandExecuted(m_currentCommand, m_currentOutput, m_lastExitCode);
-            
-            // Add to history if not already present
-            if (!m_commandHistory.contains(m_currentCommand) && !m_currentCommand.isEmpty()) {
+
+            if (!m_currentCommand.trimmed().isEmpty() && !m_commandHistory.contains(m_currentCommand)) {
                 m_commandHistory.append(m_currentCommand);
             }
-            
-            // Clear current output
             m_currentOutput.clear();
+
+            // Report directory changes made by the command
+            QString directory = currentWorkingDirectory();
+            if (directory != m_workingDirectory) {
+                m_workingDirectory = directory;
+                Q_EMIT workingDirectoryChanged(m_workingDirectory);
+            }
         }
+        break;
     }
 }
 
-void QTermWidgetEmulator::detectWorkingDirectory()
+void QTermWidgetEmulator::updateScreenSnapshot() const
 {
-    // Working directory detection is handled in detectCommand()
-    // This is kept as a separate method for API compatibility
+    if (!m_screenDirty) {
+        return;
+    }
+
+    // Dump history plus screen as plain text and keep the visible part
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    m_termWidget->saveHistory(&buffer);
+
+    QStringList lines = QString::fromUtf8(buffer.data()).split(QLatin1Char('\n'));
+    int visibleLines = m_termWidget->screenLinesCount();
+    if (lines.size() > visibleLines) {
+        lines = lines.mid(lines.size() - visibleLines);
+    }
+
+    m_screenLines = lines;
+    m_screenDirty = false;
 }
 
-void QTermWidgetEmulator::detectExitCode()
+void QTermWidgetEmulator::trackSemanticPromptMarks(const QString &text)
 {
-    // Exit code detection is handled in detectCommand()
-    // This is kept as a separate method for API compatibility
+    QRegularExpressionMatchIterator it = m_semanticPromptRegex.globalMatch(text);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        Q_EMIT semanticPromptMark(match.captured(1).at(0), match.captured(2));
+    }
 }
 
+void QTermWidgetEmulator::trackAlternateScreen(const QString &text)
+{
+    // Only the last switch in a chunk matters
+    bool active = m_alternateScreenActive;
+    QRegularExpressionMatchIterator it = m_alternateScreenRegex.globalMatch(text);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        active = (match.captured(1) == QLatin1String("h"));
+    }
+
+    if (active != m_alternateScreenActive) {
+        m_alternateScreenActive = active;
+        Q_EMIT alternateScreenChanged(m_alternateScreenActive);
+    }
+}
@@ -6,49 +6,60 @@
 #ifndef QTERMWIDGETEMULATOR_H
 #define QTERMWIDGETEMULATOR_H
 
-#include "terminalemulator.h"
+#include "terminalbackend.h"
 
-#include <QObject>
-#include <QColor>
 #include <QDateTime>
-#include <QHash>
-#include <QList>
-#include <QMap>
 #include <QPoint>
 #include <QRegularExpression>
 #include <QSize>
 #include <QString>
 #include <QStringList>
 #include <QTimer>
+#include <QVector>
 #include <QWidget>
-#include <QProcess>
 
 class QTermWidget;
 
 /**
- * Terminal emulator implementation using QTermWidget
- * 
- * This class provides a terminal emulator implementation that uses the
- * QTermWidget library to handle terminal functionality. It implements the
- * same interface as TerminalEmulator but delegates the terminal handling
- * to QTermWidget.
+ * Terminal backend implementation using QTermWidget
+ *
+ * This class provides a TerminalBackend that delegates PTY handling,
+ * VT parsing and rendering to the QTermWidget library. It is mainly
+ * useful as a mature reference engine for heavy TUI work and for
+ * A/B comparison with the internal TerminalEmulator.
+ *
+ * QTermWidget does not expose its cell grid, so grid access works on a
+ * plain-text snapshot of the visible screen that is refreshed lazily
+ * after new output arrives. Formats are always the default format.
  */
-class QTermWidgetEmulator : public TerminalEmulator
+class QTermWidgetEmulator : public TerminalBackend
 {
     Q_OBJECT
 
 public:
     /**
      * Constructor
-     * @param parent Parent widget
+     * @param parent Parent widget, also used as parent of the QTermWidget
      */
     explicit QTermWidgetEmulator(QWidget *parent = nullptr);
-    
+
     /**
      * Destructor
      */
     ~QTermWidgetEmulator() override;
-    
+
+    /**
+     * Get the type of this backend
+     * @return TerminalBackendType::QTermWidget
+     */
+    TerminalBackendType backendType() const override;
+
+    /**
+     * Get the widget that renders this backend
+     * @return The underlying QTermWidget
+     */
+    QWidget *displayWidget() const override;
+
     /**
      * Initialize the terminal emulator
      * @param rows Number of rows
@@ -56,15 +67,21 @@ public:
      * @return True if initialization was successful
      */
     bool initialize(int rows, int cols) override;
-    
+
     /**
      * Start a shell process in the terminal
      * @param shellCommand Command to run (default: system shell)
      * @param initialWorkingDirectory Initial working directory
      * @return True if the shell was started successfully
      */
-    bool startShell(const QString &shellCommand = QString(), 
+    bool startShell(const QString &shellCommand = QString(),
                    const QString &initialWorkingDirectory = QString()) override;
+
+    /**
+     * Set the environment for the next startShell()
+     * @param environment KEY=VALUE entries to set and KEY entries to unset on top of Kate's environment
+     */
+    void setShellEnvironment(const QStringList &environment) override;
     
     /**
      * Resize the terminal
@@ -72,13 +89,13 @@ public:
      * @param cols New number of columns
      */
     void resize(int rows, int cols) override;
-    
+
     /**
      * Process input from the user and send it to the shell
      * @param text Text input from the user
      */
     void processInput(const QString &text) override;
-    
+
     /**
      * Process a key press and send it to the shell
      * @param key The Qt key code
@@ -86,7 +103,7 @@ public:
      * @param text Text from the key press
      */
     void processKeyPress(int key, Qt::KeyboardModifiers modifiers, const QString &text) override;
-    
+
     /**
      * Execute a command in the terminal
      * @param command Command to execute
@@ -94,17 +111,31 @@ public:
      */
     void executeCommand(const QString &command, bool addNewline = true) override;
     
+    /**
+     * Check whether the program in the terminal asked for mouse reports
+     * @return Always false, QTermWidget handles the mouse in its own widget
+     */
+    bool isMouseTrackingActive() const override;
+    
+    /**
+     * Report a mouse event to the program in the terminal
+     * 
+     * Does nothing, QTermWidget handles the mouse in its own widget.
+     */
+    void processMouseEvent(TerminalMouseAction action, Qt::MouseButton button,
+                           Qt::KeyboardModifiers modifiers, const QPoint &cell) override;
+
     /**
      * Clear the terminal screen
      */
     void clear() override;
-    
+
     /**
      * Get the terminal size
      * @return Terminal size in columns and rows
      */
     QSize size() const override;
-    
+
     /**
      * Get the character at the specified position
      * @param x Column
@@ -112,77 +143,40 @@ public:
      * @return Character at the position
      */
     QChar characterAt(int x, int y) const override;
-    
+
     /**
      * Get the format at the specified position
      * @param x Column
      * @param y Row
-     * @return Format at the position
+     * @return Default format, QTermWidget does not expose cell formats
      */
     TerminalCharFormat formatAt(int x, int y) const override;
-    
+
     /**
      * Get the cursor position
-     * @return Current cursor position (x, y)
+     * @return Estimated cursor position (end of the last non-empty line)
      */
     QPoint cursorPosition() const override;
-    
-    /**
-     * Set the cursor position
-     * @param x Column
-     * @param y Row
-     */
-    void setCursorPosition(int x, int y) override;
-    
-    /**
-     * Get the cursor style
-     * @return Current cursor style
-     */
-    CursorStyle cursorStyle() const override;
-    
-    /**
-     * Set the cursor style
-     * @param style New cursor style
-     */
-    void setCursorStyle(CursorStyle style) override;
-    
+
     /**
      * Get whether the cursor is visible
      * @return True if the cursor is visible
      */
     bool isCursorVisible() const override;
-    
-    /**
-     * Set whether the cursor is visible
-     * @param visible Whether the cursor should be visible
-     */
-    void setCursorVisible(bool visible) override;
-    
+
     /**
      * Get whether the terminal is in alternative screen mode
      * @return True if in alternative screen mode
      */
     bool isAlternateScreenActive() const override;
-    
-    /**
-     * Set the default foreground color
-     * @param color Default foreground color
-     */
-    void setDefaultForegroundColor(const QColor &color) override;
-    
-    /**
-     * Set the default background color
-     * @param color Default background color
-     */
-    void setDefaultBackgroundColor(const QColor &color) override;
-    
+
     /**
      * Get the terminal content as text
      * @param stripFormatting Whether to strip formatting
      * @return Terminal content as text
      */
     QString getText(bool stripFormatting = true) const override;
-    
+
     /**
      * Get a line of text from the terminal
      * @param line Line number
@@ -190,43 +184,49 @@ public:
      * @return Line of text
      */
     QString getLine(int line, bool stripFormatting = true) const override;
-    
+
+    /**
+     * Get the region of cells changed since the last call and reset it
+     * @return Whole screen after any output, empty otherwise
+     */
+    QRect takeDamage() override;
+
     /**
      * Get the current working directory of the shell
      * @return Current working directory
      */
     QString currentWorkingDirectory() const override;
-    
+
     /**
      * Check if the terminal is busy (shell process is running)
      * @return True if the terminal is busy
      */
     bool isBusy() const override;
-    
+
+    /**
+     * Check whether the shell is the foreground process of the terminal
+     * @return True if the shell is the foreground process
+     */
+    bool isShellInForeground() const override;
+
+    /**
+     * Check whether a program other than the shell turned off canonical mode
+     * @return True if the foreground program reads the PTY unbuffered
+     */
+    bool isRawModeActive() const override;
+
     /**
      * Get the exit code of the last command
      * @return Exit code of the last command
      */
     int lastExitCode() const override;
-    
-    /**
-     * Get all screen data
-     * @return Vector of screen lines
-     */
-    const QVector<TerminalLine> &screenData() const override;
-    
+
     /**
      * Get the current command being typed
      * @return Current command
      */
     QString currentCommand() const override;
-    
-    /**
-     * Get the current prompt
-     * @return Current prompt string
-     */
-    QString currentPrompt() const override;
-    
+
     /**
      * Get the command history
      * @return List of previous commands
@@ -237,42 +237,24 @@ public:
      * Get access to the underlying QTermWidget instance
      * @return Pointer to the QTermWidget
      */
-    QTermWidget* termWidget() const;
+    QTermWidget *termWidget() const;
 
 public Q_SLOTS:
-    /**
-     * Handle shell output
-     */
-    void readFromShell() override;
-    
-    /**
-     * Handle shell process finished
-     * @param exitCode Exit code of the shell process
-     * @param exitStatus Exit status of the shell process
-     */
-    void shellProcessFinished(int exitCode, QProcess::ExitStatus exitStatus) override;
-    
-    /**
-     * Handle shell process error
-     * @param error Error that occurred
-     */
-    void shellProcessError(QProcess::ProcessError error) override;
-    
     /**
      * Copy selected text to clipboard
      */
     void copyToClipboard() override;
-    
+
     /**
      * Paste text from clipboard
      */
     void pasteFromClipboard() override;
-    
+
     /**
      * Select all text
      */
     void selectAll() override;
-    
+
     /**
      * Find text in the terminal
      * @param text Text to find
@@ -284,95 +266,72 @@ public Q_SLOTS:
 
 private Q_SLOTS:
     /**
-     * Handle terminal output from QTermWidget
+     * Handle output received by QTermWidget
+     * @param text Received data
      */
-    void onTerminalOutput();
-    
-    /**
-     * Handle terminal finished signal
-     * @param exitCode Exit code of the terminal process
-     */
-    void onTerminalFinished(int exitCode);
-    
+    void onReceivedData(const QString &text);
+
     /**
      * Handle title changed signal
-     * @param title New terminal title
      */
-    void onTitleChanged(QString title);
-    
+    void onTitleChanged();
+
     /**
-     * Handle cursor position changed
+     * Handle terminal finished signal
      */
-    void onCursorPositionChanged();
-    
+    void onFinished();
+
     /**
      * Handle command detection timer timeout
      */
-    void onCommandDetectionTimer();
+    void detectCommand();
 
 private:
     /**
-     * Setup the QTermWidget
-     */
-    void setupTermWidget();
-    
-    /**
-     * Connect QTermWidget signals to slots
+     * Refresh the screen snapshot if output arrived since the last refresh
      */
-    void connectSignals();
-    
-    /**
-     * Detect command from terminal output
-     */
-    void detectCommand();
-    
-    /**
-     * Detect working directory from terminal output
-     */
-    void detectWorkingDirectory();
-    
+    void updateScreenSnapshot() const;
+
     /**
-     * Parse screendump output and update screen data
+     * Track alternate screen switches in raw output
+     * @param text Received data
      */
-    void updateScreenData();
-    
+    void trackAlternateScreen(const QString &text);
+
     /**
-     * Parse and update command information from terminal
+     * Report OSC 133 prompt marks found in raw output
+     * @param text Received data
      */
-    void updateCommandInfo();
+    void trackSemanticPromptMarks(const QString &text);
 
 private:
     QTermWidget *m_termWidget;                          ///< QTermWidget instance
-    QSize m_termSize;                                   ///< Terminal size
+    QSize m_termSize;                                   ///< Terminal size in columns and rows
     bool m_initialized;                                 ///< Whether the terminal is initialized
-    
+    bool m_busy;                                        ///< Whether the shell is running
+
     // Command tracking
     QString m_currentCommand;                           ///< Current command being typed
-    QString m_currentPrompt;                            ///< Current prompt
     QString m_currentOutput;                            ///< Current command output
     QStringList m_commandHistory;                       ///< Command history
     int m_lastExitCode;                                 ///< Last command exit code
-    
-    // Directory tracking
-    QString m_workingDirectory;                         ///< Current working directory
-    
-    // Screen data
-    QVector<TerminalLine> m_screenData;                 ///< Screen data
-    QPoint m_cursorPos;                                 ///< Current cursor position
-    bool m_cursorVisible;                               ///< Cursor visibility
-    CursorStyle m_cursorStyle;                          ///< Cursor style
-    bool m_alternateScreenActive;                       ///< Whether alternate screen is active
-    
-    // Command detection
-    QTimer m_commandDetectionTimer;                     ///< Timer for command detection
     bool m_commandExecuting;                            ///< Whether a command is currently executing
     QDateTime m_commandStartTime;                       ///< Start time of current command
-    
+    QTimer m_commandDetectionTimer;                     ///< Timer for command detection
+
+    // Directory tracking
+    QString m_workingDirectory;                         ///< Last known working directory
+
+    // Screen snapshot
+    mutable QStringList m_screenLines;                  ///< Plain-text copy of the visible screen
+    mutable bool m_screenDirty;                         ///< Whether the snapshot is stale
+    bool m_damaged;                                     ///< Whether output arrived since takeDamage()
+    bool m_alternateScreenActive;                       ///< Whether alternate screen is active
+
     // Regexes for detection
     QRegularExpression m_promptRegex;                   ///< Regex for detecting prompts
-    QRegularExpression m_cwdRegex;                      ///< Regex for detecting working directory
-    QRegularExpression m_exitCodeRegex;                 ///< Regex for detecting exit codes
+    QRegularExpression m_alternateScreenRegex;          ///< Regex for alternate screen switches
+    QRegularExpression m_semanticPromptRegex;           ///< Regex for OSC 133 prompt marks
 };
 
 #endif // QTERMWIDGETEMULATOR_H
-
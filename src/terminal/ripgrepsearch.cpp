@@ -0,0 +1,551 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "ripgrepsearch.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QStandardPaths>
+
+#include <functional>
+
+// Stored text per line; longer lines are cut around their first match (bytes)
+static const int MAX_LINE_BYTES = 256;
+
+// Text kept before the first match of a cut line (bytes)
+static const int LINE_LEAD_BYTES = 48;
+
+// Beyond this much line text, further lines are indexed without text (bytes)
+static const qint64 MAX_TEXT_BUFFER = 32 * 1024 * 1024;
+
+// Batches are handed to the GUI thread at most this often while rg outruns the parser (ms)
+static const qint64 BATCH_INTERVAL = 50;
+
+// A read smaller than this means the pipe was drained, so rg is the slower side (bytes)
+static const int DRAINED_CHUNK = 16 * 1024;
+
+// Upper bound for the lines of one batch
+static const int MAX_BATCH_LINES = 50000;
+
+// stderr kept from rg (bytes)
+static const int MAX_ERROR_OUTPUT = 16 * 1024;
+
+// Long options without match output
+static const QStringList LISTING_OPTIONS = {
+    QStringLiteral("--files"), QStringLiteral("--files-with-matches"), QStringLiteral("--files-without-match"),
+    QStringLiteral("--count"), QStringLiteral("--count-matches"), QStringLiteral("--type-list"),
+    QStringLiteral("--help"), QStringLiteral("--version"), QStringLiteral("--pcre2-version"),
+    QStringLiteral("--generate"), QStringLiteral("--json")
+};
+
+// Short options without match output
+static const QString LISTING_FLAGS = QStringLiteral("lchV");
+
+// Short options taking a value, which ends a flag cluster
+static const QString VALUE_FLAGS = QStringLiteral("efgmtTABCjMrE");
+
+/**
+ * Get the bytes of rg's "arbitrary data" object
+ * @param object {"text": "..."} or {"bytes": "<base64>"} for invalid UTF-8
+ * @return Raw bytes
+ */
+static QByteArray arbitraryData(const QJsonObject &object)
+{
+    const QJsonValue text = object.value(QLatin1String("text"));
+    if (text.isString()) {
+        return text.toString().toUtf8();
+    }
+    return QByteArray::fromBase64(object.value(QLatin1String("bytes")).toString().toLatin1());
+}
+
+/**
+ * Incremental parser of rg's JSON lines, runs on the worker thread
+ */
+class RipgrepParser
+{
+public:
+    using Sink = std::function<void(quint64 generation, const SearchResultBatch &batch)>;
+
+    explicit RipgrepParser(const Sink &sink)
+        : m_sink(sink)
+        , m_generation(0)
+        , m_nextFile(0)
+        , m_currentFile(-1)
+    {
+    }
+
+    /**
+     * Start parsing the output of a new search
+     * @param generation Search the output belongs to
+     */
+    void reset(quint64 generation)
+    {
+        m_generation = generation;
+        m_pending.clear();
+        m_batch = SearchResultBatch();
+        m_nextFile = 0;
+        m_currentFile = -1;
+        m_sinceFlush.start();
+    }
+
+    /**
+     * Parse the complete lines of more output
+     * @param data Output as read from rg
+     */
+    void feed(const QByteArray &data)
+    {
+        m_pending.append(data);
+        int start = 0;
+        for (int newline = m_pending.indexOf('\n'); newline >= 0; newline = m_pending.indexOf('\n', start)) {
+            parseMessage(m_pending.mid(start, newline - start));
+            start = newline + 1;
+        }
+        m_pending.remove(0, start);
+
+        // Coalesce while rg outruns us, hand over right away when it doesn't
+        if (data.size() < DRAINED_CHUNK || m_sinceFlush.elapsed() >= BATCH_INTERVAL
+            || m_batch.lines.size() >= MAX_BATCH_LINES) {
+            flush();
+        }
+    }
+
+    /**
+     * Parse what is left once rg exited and hand it over
+     */
+    void finish()
+    {
+        if (!m_pending.isEmpty()) {
+            parseMessage(m_pending);
+            m_pending.clear();
+        }
+        flush();
+    }
+
+private:
+    void flush()
+    {
+        if (!m_batch.files.isEmpty() || !m_batch.lines.isEmpty()) {
+            m_sink(m_generation, m_batch);
+            m_batch = SearchResultBatch();
+        }
+        m_sinceFlush.restart();
+    }
+
+    void parseMessage(const QByteArray &json)
+    {
+        QJsonParseError error;
+        const QJsonObject message = QJsonDocument::fromJson(json, &error).object();
+        if (error.error != QJsonParseError::NoError) {
+            qWarning() << "RipgrepSearch: Skipping malformed message:" << error.errorString();
+            return;
+        }
+
+        // "end" and "summary" only carry statistics we count ourselves
+        const QString type = message.value(QLatin1String("type")).toString();
+        const QJsonObject data = message.value(QLatin1String("data")).toObject();
+        if (type == QLatin1String("begin")) {
+            SearchFile file;
+            file.path = QFile::decodeName(arbitraryData(data.value(QLatin1String("path")).toObject()));
+            file.firstLine = m_batch.lines.size();
+            m_batch.files.append(file);
+            m_currentFile = m_nextFile++;
+        } else if (m_currentFile >= 0 && (type == QLatin1String("match") || type == QLatin1String("context"))) {
+            addLine(data, type == QLatin1String("context"));
+        }
+    }
+
+    void addLine(const QJsonObject &data, bool context)
+    {
+        // Multi-line matches are shown by their first line
+        QByteArray bytes = arbitraryData(data.value(QLatin1String("lines")).toObject());
+        int newline = bytes.indexOf('\n');
+        if (newline >= 0) {
+            bytes.truncate(newline);
+        }
+        if (bytes.endsWith('\r')) {
+            bytes.chop(1);
+        }
+
+        const QJsonArray submatches = data.value(QLatin1String("submatches")).toArray();
+        const int firstStart = submatches.isEmpty() ? 0 : qMin(submatches.at(0).toObject().value(QLatin1String("start")).toInt(), int(bytes.size()));
+
+        // Keep a window around the first match of long lines, on character boundaries
+        int skip = 0;
+        if (bytes.size() > MAX_LINE_BYTES) {
+            skip = qBound(0, firstStart - LINE_LEAD_BYTES, int(bytes.size()) - MAX_LINE_BYTES);
+            while (skip > 0 && (uchar(bytes.at(skip)) & 0xc0) == 0x80) {
+                --skip;
+            }
+        }
+        int length = qMin(int(bytes.size()) - skip, MAX_LINE_BYTES);
+        while (length > 0 && skip + length < bytes.size() && (uchar(bytes.at(skip + length)) & 0xc0) == 0x80) {
+            --length;
+        }
+
+        SearchLine line;
+        line.file = m_currentFile;
+        line.lineNumber = data.value(QLatin1String("line_number")).toInt();
+        line.column = context ? 0 : QString::fromUtf8(bytes.constData(), firstStart).size();
+        line.textOffset = quint32(m_batch.text.size());
+        line.textLength = quint16(length);
+        line.firstRange = quint32(m_batch.ranges.size());
+        line.context = context;
+
+        // Matches outside the window are kept empty, so they still count
+        for (const QJsonValue &value : submatches) {
+            const QJsonObject submatch = value.toObject();
+            int start = qBound(0, submatch.value(QLatin1String("start")).toInt() - skip, length);
+            int end = qBound(start, submatch.value(QLatin1String("end")).toInt() - skip, length);
+            m_batch.ranges.append({quint16(start), quint16(end)});
+            if (m_batch.ranges.size() - line.firstRange == 0xffff) {
+                break;
+            }
+        }
+        line.rangeCount = quint16(m_batch.ranges.size() - line.firstRange);
+
+        m_batch.text.append(bytes.constData() + skip, length);
+        m_batch.lines.append(line);
+    }
+
+    Sink m_sink;                    ///< Receives the batches
+    quint64 m_generation;           ///< Search being parsed
+    QByteArray m_pending;           ///< Output after the last complete line
+    SearchResultBatch m_batch;      ///< Results since the last hand-over
+    QElapsedTimer m_sinceFlush;     ///< Time since the last hand-over
+    int m_nextFile;                 ///< Index of the next file
+    int m_currentFile;              ///< Index of the file being reported, -1 before the first
+};
+
+RipgrepSearch::RipgrepSearch(QObject *parent)
+    : QObject(parent)
+    , m_worker(new QObject)
+    , m_parser(nullptr)
+    , m_process(nullptr)
+    , m_generation(0)
+    , m_running(false)
+    , m_elapsed(-1)
+    , m_matchCount(0)
+    , m_textTruncated(false)
+{
+    m_parser = new RipgrepParser([this](quint64 generation, const SearchResultBatch &batch) {
+        QMetaObject::invokeMethod(this, [this, generation, batch]() {
+            appendBatch(generation, batch);
+        }, Qt::QueuedConnection);
+    });
+
+    m_thread.setObjectName(QStringLiteral("RipgrepSearch"));
+    m_worker->moveToThread(&m_thread);
+    m_thread.start();
+}
+
+RipgrepSearch::~RipgrepSearch()
+{
+    if (m_process) {
+        m_process->disconnect(this);
+        m_process->kill();
+        m_process->waitForFinished(1000);
+    }
+
+    // Parser work still queued is dropped with the worker
+    m_thread.quit();
+    m_thread.wait();
+    delete m_worker;
+    delete m_parser;
+}
+
+bool RipgrepSearch::isAvailable()
+{
+    return !QStandardPaths::findExecutable(QStringLiteral("rg")).isEmpty();
+}
+
+bool RipgrepSearch::isSearch(const QStringList &arguments)
+{
+    for (int i = 0; i < arguments.size(); ++i) {
+        const QString &argument = arguments.at(i);
+        if (argument == QLatin1String("--")) {
+            break;
+        }
+
+        if (argument.startsWith(QLatin1String("--"))) {
+            if (LISTING_OPTIONS.contains(argument.section(QLatin1Char('='), 0, 0))) {
+                return false;
+            }
+        } else if (argument.startsWith(QLatin1Char('-')) && argument.size() > 1) {
+            for (int j = 1; j < argument.size(); ++j) {
+                if (LISTING_FLAGS.contains(argument.at(j))) {
+                    return false;
+                }
+                if (VALUE_FLAGS.contains(argument.at(j))) {
+                    // The value is the rest of the cluster or the next argument
+                    if (j == argument.size() - 1) {
+                        ++i;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void RipgrepSearch::setEnvironment(const QProcessEnvironment &environment)
+{
+    m_environment = environment;
+}
+
+bool RipgrepSearch::start(const QStringList &arguments, const QString &directory)
+{
+    // The rg the shell would run, from its PATH
+    QStringList paths;
+    if (m_environment.contains(QStringLiteral("PATH"))) {
+        paths = m_environment.value(QStringLiteral("PATH")).split(QLatin1Char(':'), Qt::SkipEmptyParts);
+    }
+    const QString program = QStandardPaths::findExecutable(QStringLiteral("rg"), paths);
+    if (program.isEmpty()) {
+        qWarning() << "RipgrepSearch: rg is not installed";
+        return false;
+    }
+
+    // A search still running is replaced; its batches in flight are dropped
+    // and the killed rg goes away once it exited
+    if (m_process) {
+        m_process->disconnect(this);
+        connect(m_process, &QProcess::finished, m_process, &QObject::deleteLater);
+        m_process->kill();
+        m_process = nullptr;
+    }
+
+    ++m_generation;
+    m_arguments = arguments;
+    m_directory = QDir(directory).absolutePath();
+    m_errorOutput.clear();
+    m_elapsed = -1;
+
+    Q_EMIT resultsAboutToBeCleared();
+    m_files.clear();
+    m_lines.clear();
+    m_ranges.clear();
+    m_text.clear();
+    m_matchCount = 0;
+    m_textTruncated = false;
+    Q_EMIT resultsCleared();
+
+    const quint64 generation = m_generation;
+    QMetaObject::invokeMethod(m_worker, [this, generation]() {
+        m_parser->reset(generation);
+    }, Qt::QueuedConnection);
+
+    m_process = new QProcess(this);
+    m_process->setProgram(program);
+    m_process->setArguments(QStringList{QStringLiteral("--json")} + arguments);
+    m_process->setWorkingDirectory(m_directory);
+    if (!m_environment.isEmpty()) {
+        m_process->setProcessEnvironment(m_environment);
+    }
+
+    // rg searches stdin when it is a pipe or file, the directory when it is not
+    m_process->setStandardInputFile(QProcess::nullDevice());
+
+    connect(m_process, &QProcess::readyReadStandardOutput, this, &RipgrepSearch::readOutput);
+    connect(m_process, &QProcess::readyReadStandardError, this, [this]() {
+        m_errorOutput.append(m_process->readAllStandardError());
+        if (m_errorOutput.size() > MAX_ERROR_OUTPUT) {
+            m_errorOutput.truncate(MAX_ERROR_OUTPUT);
+        }
+    });
+    connect(m_process, &QProcess::finished, this, [this](int exitCode, QProcess::ExitStatus exitStatus) {
+        onProcessFinished(exitStatus == QProcess::NormalExit ? exitCode : -1);
+    });
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            m_errorOutput = m_process->errorString().toUtf8();
+            onProcessFinished(-1);
+        }
+    });
+
+    m_running = true;
+    m_timer.start();
+    m_process->start();
+    return true;
+}
+
+void RipgrepSearch::cancel()
+{
+    if (m_process) {
+        m_process->kill();
+    }
+}
+
+bool RipgrepSearch::isRunning() const
+{
+    return m_running;
+}
+
+QStringList RipgrepSearch::arguments() const
+{
+    return m_arguments;
+}
+
+QString RipgrepSearch::directory() const
+{
+    return m_directory;
+}
+
+qint64 RipgrepSearch::elapsed() const
+{
+    return m_elapsed >= 0 ? m_elapsed : (m_timer.isValid() ? m_timer.elapsed() : 0);
+}
+
+QString RipgrepSearch::errorOutput() const
+{
+    return QString::fromUtf8(m_errorOutput);
+}
+
+int RipgrepSearch::fileCount() const
+{
+    return m_files.size();
+}
+
+int RipgrepSearch::lineCount() const
+{
+    return m_lines.size();
+}
+
+qint64 RipgrepSearch::matchCount() const
+{
+    return m_matchCount;
+}
+
+bool RipgrepSearch::isTextTruncated() const
+{
+    return m_textTruncated;
+}
+
+const SearchFile &RipgrepSearch::file(int index) const
+{
+    return m_files.at(index);
+}
+
+QString RipgrepSearch::filePath(int index) const
+{
+    return QDir::cleanPath(QDir(m_directory).absoluteFilePath(m_files.at(index).path));
+}
+
+const SearchLine &RipgrepSearch::line(int index) const
+{
+    return m_lines.at(index);
+}
+
+QString RipgrepSearch::lineText(int index) const
+{
+    const SearchLine &line = m_lines.at(index);
+    return QString::fromUtf8(m_text.constData() + line.textOffset, line.textLength);
+}
+
+QVector<QPair<int, int>> RipgrepSearch::matchRanges(int index) const
+{
+    const SearchLine &line = m_lines.at(index);
+    const char *text = m_text.constData() + line.textOffset;
+
+    QVector<QPair<int, int>> ranges;
+    for (quint32 i = line.firstRange; i < line.firstRange + line.rangeCount; ++i) {
+        const SearchRange &range = m_ranges.at(i);
+        if (range.end <= range.start || range.end > line.textLength) {
+            continue;
+        }
+        int start = QString::fromUtf8(text, range.start).size();
+        int length = QString::fromUtf8(text + range.start, range.end - range.start).size();
+        ranges.append({start, length});
+    }
+    return ranges;
+}
+
+void RipgrepSearch::readOutput()
+{
+    const QByteArray data = m_process->readAllStandardOutput();
+    if (data.isEmpty()) {
+        return;
+    }
+    QMetaObject::invokeMethod(m_worker, [this, data]() {
+        m_parser->feed(data);
+    }, Qt::QueuedConnection);
+}
+
+void RipgrepSearch::onProcessFinished(int exitCode)
+{
+    if (!m_process) {
+        return;
+    }
+
+    readOutput();
+    m_errorOutput.append(m_process->readAllStandardError());
+    m_process->deleteLater();
+    m_process = nullptr;
+
+    // Behind the output in the worker's queue, so all results are in before finished()
+    const quint64 generation = m_generation;
+    QMetaObject::invokeMethod(m_worker, [this, generation, exitCode]() {
+        m_parser->finish();
+        QMetaObject::invokeMethod(this, [this, generation, exitCode]() {
+            if (generation != m_generation) {
+                return;
+            }
+            m_running = false;
+            m_elapsed = m_timer.elapsed();
+            Q_EMIT finished(exitCode);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+void RipgrepSearch::appendBatch(quint64 generation, const SearchResultBatch &batch)
+{
+    if (generation != m_generation) {
+        return;
+    }
+
+    const int firstFile = m_files.size();
+    const int firstLine = m_lines.size();
+    const quint32 textBase = quint32(m_text.size());
+    const quint32 rangeBase = quint32(m_ranges.size());
+    const bool keepText = !m_textTruncated && m_text.size() + batch.text.size() <= MAX_TEXT_BUFFER;
+    if (!keepText && !batch.lines.isEmpty()) {
+        m_textTruncated = true;
+    }
+
+    for (SearchFile file : batch.files) {
+        file.firstLine += firstLine;
+        m_files.append(file);
+    }
+
+    m_lines.reserve(m_lines.size() + batch.lines.size());
+    for (SearchLine line : batch.lines) {
+        line.textOffset = keepText ? line.textOffset + textBase : 0;
+        line.textLength = keepText ? line.textLength : 0;
+        line.firstRange += rangeBase;
+        if (line.file >= m_files.size()) {
+            continue;
+        }
+
+        SearchFile &file = m_files[line.file];
+        ++file.lineCount;
+        if (!line.context) {
+            file.matchCount += line.rangeCount;
+            m_matchCount += line.rangeCount;
+        }
+        m_lines.append(line);
+    }
+
+    m_ranges += batch.ranges;
+    if (keepText) {
+        m_text += batch.text;
+    }
+
+    Q_EMIT resultsAdded(firstFile, firstLine);
+}
@@ -0,0 +1,295 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef RIPGREPSEARCH_H
+#define RIPGREPSEARCH_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPair>
+#include <QProcessEnvironment>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+
+class QProcess;
+class RipgrepParser;
+
+/**
+ * A file with results
+ */
+struct SearchFile {
+    QString path;           ///< Path as rg printed it, relative to the search directory
+    int firstLine = 0;      ///< Index of its first result line
+    int lineCount = 0;      ///< Number of result lines, matches and context
+    int matchCount = 0;     ///< Number of matches
+};
+
+/**
+ * A matching or context line
+ *
+ * The text is kept as UTF-8 in a shared buffer and only decoded for the
+ * rows on screen; very long lines are cut around their first match.
+ */
+struct SearchLine {
+    int file;               ///< Index of the file
+    int lineNumber;         ///< Line number, 1-based
+    int column;             ///< Character column of the first match, 0-based
+    quint32 textOffset;     ///< Start of the text in the text buffer
+    quint16 textLength;     ///< Length of the text in bytes
+    quint16 rangeCount;     ///< Number of match ranges
+    quint32 firstRange;     ///< Index of the first match range
+    bool context;           ///< Whether this is a context line
+};
+
+/**
+ * A match inside a line's stored text, in bytes
+ */
+struct SearchRange {
+    quint16 start;          ///< First byte
+    quint16 end;            ///< Byte after the match
+};
+
+/**
+ * Results parsed since the last batch
+ *
+ * Files continue the numbering of the results before them. Line text
+ * offsets and range indexes are relative to the batch.
+ */
+struct SearchResultBatch {
+    QVector<SearchFile> files;      ///< Files that began
+    QVector<SearchLine> lines;      ///< Lines, in file order
+    QVector<SearchRange> ranges;    ///< Match ranges of the lines
+    QByteArray text;                ///< Text of the lines
+};
+
+/**
+ * A ripgrep search whose results are indexed as they stream in
+ *
+ * rg runs with --json outside the terminal. Its JSON lines are parsed on
+ * a worker thread into batches of compact records, which are appended
+ * here on the GUI thread: a file table, a line table of fixed-size
+ * records, match ranges and one buffer of UTF-8 line text. Nothing is
+ * formatted for display until a row is shown, so millions of matches
+ * cost a few dozen bytes each.
+ *
+ * rg prints the results of each file together, so files arrive in order
+ * and only the last file ever grows; a batch is handed over after a
+ * short interval, or right away when rg is slower than the parser, so
+ * the first results show up as soon as rg finds them.
+ */
+class RipgrepSearch : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor
+     * @param parent Parent object
+     */
+    explicit RipgrepSearch(QObject *parent = nullptr);
+
+    /**
+     * Destructor, kills rg and stops the worker thread
+     */
+    ~RipgrepSearch() override;
+
+    /**
+     * Check whether rg is installed
+     * @return True if rg is in PATH
+     */
+    static bool isAvailable();
+
+    /**
+     * Check whether rg arguments produce results a search block can show
+     *
+     * Listing modes like --files, -l and -c and informational options
+     * like --help have no match output.
+     *
+     * @param arguments Arguments after "rg"
+     * @return True if the arguments are for a search
+     */
+    static bool isSearch(const QStringList &arguments);
+
+    /**
+     * Set the environment to run rg in, from the next search on
+     * @param environment Environment, e.g. the shell's exported one; empty for Kate's
+     */
+    void setEnvironment(const QProcessEnvironment &environment);
+
+    /**
+     * Start a search, replacing any previous results
+     * @param arguments Arguments after "rg"
+     * @param directory Directory to search in
+     * @return True if rg started
+     */
+    bool start(const QStringList &arguments, const QString &directory);
+
+    /**
+     * Kill rg; results so far are kept and finished() is emitted
+     */
+    void cancel();
+
+    /**
+     * Check whether rg is still running or results are still being parsed
+     * @return True while the search is in progress
+     */
+    bool isRunning() const;
+
+    /**
+     * Get the arguments of the search
+     * @return Arguments after "rg"
+     */
+    QStringList arguments() const;
+
+    /**
+     * Get the directory searched in
+     * @return Absolute path
+     */
+    QString directory() const;
+
+    /**
+     * Get the run time of the search
+     * @return Milliseconds since the start, or until the end once finished
+     */
+    qint64 elapsed() const;
+
+    /**
+     * Get what rg printed on stderr
+     * @return Error output, usually empty
+     */
+    QString errorOutput() const;
+
+    /**
+     * Get the number of files with results
+     * @return File count
+     */
+    int fileCount() const;
+
+    /**
+     * Get the number of result lines
+     * @return Line count, matches and context
+     */
+    int lineCount() const;
+
+    /**
+     * Get the number of matches
+     * @return Match count
+     */
+    qint64 matchCount() const;
+
+    /**
+     * Check whether the line text buffer filled up
+     *
+     * Lines after that are still counted and listed, but without text.
+     *
+     * @return True if some lines have no text
+     */
+    bool isTextTruncated() const;
+
+    /**
+     * Get a file
+     * @param index File index
+     * @return The file
+     */
+    const SearchFile &file(int index) const;
+
+    /**
+     * Get the absolute path of a file
+     * @param index File index
+     * @return Absolute path
+     */
+    QString filePath(int index) const;
+
+    /**
+     * Get a result line
+     * @param index Line index
+     * @return The line
+     */
+    const SearchLine &line(int index) const;
+
+    /**
+     * Decode the text of a result line
+     * @param index Line index
+     * @return Text, cut if the line was very long
+     */
+    QString lineText(int index) const;
+
+    /**
+     * Get the matches in the decoded text of a line
+     * @param index Line index
+     * @return Start and length of each match, in characters of lineText()
+     */
+    QVector<QPair<int, int>> matchRanges(int index) const;
+
+Q_SIGNALS:
+    /**
+     * Emitted when a new search is about to drop the previous results
+     */
+    void resultsAboutToBeCleared();
+
+    /**
+     * Emitted once the previous results are dropped
+     */
+    void resultsCleared();
+
+    /**
+     * Emitted when results were appended
+     * @param firstFile Index of the first new file, fileCount() if none
+     * @param firstLine Index of the first new line
+     */
+    void resultsAdded(int firstFile, int firstLine);
+
+    /**
+     * Emitted when rg exited and all its output is indexed
+     * @param exitCode rg's exit code: 0 with matches, 1 without, 2 on errors; -1 if killed
+     */
+    void finished(int exitCode);
+
+private:
+    /**
+     * Hand new rg output to the parser
+     */
+    void readOutput();
+
+    /**
+     * Flush the parser once rg exited
+     * @param exitCode Exit code, -1 if rg crashed or was killed
+     */
+    void onProcessFinished(int exitCode);
+
+    /**
+     * Append a parsed batch
+     * @param generation Search the batch belongs to
+     * @param batch Parsed results
+     */
+    void appendBatch(quint64 generation, const SearchResultBatch &batch);
+
+    QThread m_thread;                   ///< Worker thread the parser runs on
+    QObject *m_worker;                  ///< Context object living on the worker thread
+    RipgrepParser *m_parser;            ///< Parser, only used on the worker thread
+    QProcess *m_process;                ///< rg, nullptr when not running
+    quint64 m_generation;               ///< Incremented per search, stale batches are dropped
+    bool m_running;                     ///< Whether the search is in progress
+
+    QStringList m_arguments;            ///< Arguments of the search
+    QString m_directory;                ///< Directory searched in
+    QProcessEnvironment m_environment;  ///< Environment of the shell, empty for Kate's
+    QElapsedTimer m_timer;              ///< Runs from the start of the search
+    qint64 m_elapsed;                   ///< Run time once finished, -1 before
+    QByteArray m_errorOutput;           ///< rg's stderr
+
+    // Result index
+    QVector<SearchFile> m_files;        ///< Files in rg's order
+    QVector<SearchLine> m_lines;        ///< Lines in file order
+    QVector<SearchRange> m_ranges;      ///< Match ranges of all lines
+    QByteArray m_text;                  ///< Text of all lines
+    qint64 m_matchCount;                ///< Matches so far
+    bool m_textTruncated;               ///< Whether lines were indexed without text
+};
+
+#endif // RIPGREPSEARCH_H
@@ -0,0 +1,428 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "runbook.h"
+#include "shelljob.h"
+
+#include <KLocalizedString>
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+
+QString Runbook::storageDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QStringLiteral("/warpkate/runbooks");
+}
+
+QStringList Runbook::available()
+{
+    QStringList names;
+    const QFileInfoList files = QDir(storageDirectory()).entryInfoList({QStringLiteral("*.json")}, QDir::Files, QDir::Name);
+    for (const QFileInfo &file : files) {
+        names.append(file.completeBaseName());
+    }
+    return names;
+}
+
+QString Runbook::filePath(const QString &name)
+{
+    // Names become file names, keep them portable
+    static const QRegularExpression unsafe(QStringLiteral("[^A-Za-z0-9._-]"));
+    QString fileName = name.trimmed();
+    fileName.replace(unsafe, QStringLiteral("_"));
+    return storageDirectory() + QLatin1Char('/') + fileName + QStringLiteral(".json");
+}
+
+bool Runbook::load(const QString &name, Runbook *runbook, QString *errorMessage)
+{
+    QFile file(filePath(name));
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorMessage = i18n("Could not open %1", file.fileName());
+        return false;
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        *errorMessage = i18n("%1: %2 at offset %3", file.fileName(), parseError.errorString(), parseError.offset);
+        return false;
+    }
+
+    runbook->name = name;
+    runbook->steps.clear();
+
+    const QJsonArray steps = document.object().value(QStringLiteral("steps")).toArray();
+    for (const QJsonValue &value : steps) {
+        QJsonObject object = value.toObject();
+
+        Step step;
+        step.name = object.value(QStringLiteral("name")).toString();
+        step.command = object.value(QStringLiteral("command")).toString();
+        step.directory = object.value(QStringLiteral("directory")).toString();
+        const QJsonArray needs = object.value(QStringLiteral("needs")).toArray();
+        for (const QJsonValue &need : needs) {
+            step.needs.append(need.toString());
+        }
+        runbook->steps.append(step);
+    }
+
+    return runbook->validate(errorMessage);
+}
+
+bool Runbook::save() const
+{
+    QJsonArray steps;
+    for (const Step &step : this->steps) {
+        QJsonObject object;
+        object[QStringLiteral("name")] = step.name;
+        object[QStringLiteral("command")] = step.command;
+        if (!step.directory.isEmpty()) {
+            object[QStringLiteral("directory")] = step.directory;
+        }
+        if (!step.needs.isEmpty()) {
+            object[QStringLiteral("needs")] = QJsonArray::fromStringList(step.needs);
+        }
+        steps.append(object);
+    }
+
+    QJsonObject root;
+    root[QStringLiteral("steps")] = steps;
+
+    QDir().mkpath(storageDirectory());
+    QSaveFile file(filePath(name));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Runbook: Could not write" << file.fileName();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
+    return file.commit();
+}
+
+bool Runbook::validate(QString *errorMessage) const
+{
+    if (steps.isEmpty()) {
+        *errorMessage = i18n("Runbook %1 has no steps", name);
+        return false;
+    }
+
+    QHash<QString, int> indexes;
+    for (int i = 0; i < steps.size(); ++i) {
+        const Step &step = steps.at(i);
+        if (step.name.isEmpty() || step.command.trimmed().isEmpty()) {
+            *errorMessage = i18n("Step %1 needs a name and a command", i + 1);
+            return false;
+        }
+        if (indexes.contains(step.name)) {
+            *errorMessage = i18n("Step name %1 is used twice", step.name);
+            return false;
+        }
+        indexes.insert(step.name, i);
+    }
+
+    // Kahn's algorithm: whatever cannot be ordered is part of a cycle
+    QList<int> pending(steps.size(), 0);
+    QList<QList<int>> dependents(steps.size());
+    for (int i = 0; i < steps.size(); ++i) {
+        for (const QString &need : steps.at(i).needs) {
+            if (!indexes.contains(need)) {
+                *errorMessage = i18n("Step %1 needs unknown step %2", steps.at(i).name, need);
+                return false;
+            }
+            dependents[indexes.value(need)].append(i);
+            ++pending[i];
+        }
+    }
+
+    QList<int> ready;
+    for (int i = 0; i < steps.size(); ++i) {
+        if (pending.at(i) == 0) {
+            ready.append(i);
+        }
+    }
+    int ordered = 0;
+    while (!ready.isEmpty()) {
+        int index = ready.takeLast();
+        ++ordered;
+        for (int dependent : std::as_const(dependents[index])) {
+            if (--pending[dependent] == 0) {
+                ready.append(dependent);
+            }
+        }
+    }
+
+    if (ordered < steps.size()) {
+        QStringList cycle;
+        for (int i = 0; i < steps.size(); ++i) {
+            if (pending.at(i) > 0) {
+                cycle.append(steps.at(i).name);
+            }
+        }
+        *errorMessage = i18n("Steps %1 depend on each other in a cycle", cycle.join(QStringLiteral(", ")));
+        return false;
+    }
+
+    return true;
+}
+
+RunbookRunner::RunbookRunner(QObject *parent)
+    : QObject(parent)
+    , m_running(0)
+    , m_maxParallel(qMax(1, QThread::idealThreadCount()))
+    , m_active(false)
+    , m_useEnvironmentCache(false)
+{
+}
+
+RunbookRunner::~RunbookRunner()
+{
+    // The shell jobs are children and kill their process groups when
+    // deleted; nobody is left to receive the results
+    blockSignals(true);
+}
+
+void RunbookRunner::setMaxParallel(int count)
+{
+    m_maxParallel = qMax(1, count);
+}
+
+void RunbookRunner::setUseEnvironmentCache(bool enabled)
+{
+    m_useEnvironmentCache = enabled;
+}
+
+void RunbookRunner::setEnvironment(const QProcessEnvironment &environment)
+{
+    m_environment = environment;
+}
+
+bool RunbookRunner::start(const Runbook &runbook, const QString &baseDirectory)
+{
+    QString errorMessage;
+    if (isRunning() || !runbook.validate(&errorMessage)) {
+        return false;
+    }
+
+    m_runbook = runbook;
+    m_baseDirectory = baseDirectory;
+    m_results = QList<StepResult>(runbook.steps.size());
+    qDeleteAll(m_shellJobs);
+    m_shellJobs = QList<ShellJob *>(runbook.steps.size(), nullptr);
+
+    // Resolve needs to indexes once
+    QHash<QString, int> indexes;
+    for (int i = 0; i < runbook.steps.size(); ++i) {
+        indexes.insert(runbook.steps.at(i).name, i);
+    }
+    m_needs.clear();
+    for (const Runbook::Step &step : runbook.steps) {
+        QList<int> needs;
+        for (const QString &need : step.needs) {
+            needs.append(indexes.value(need));
+        }
+        m_needs.append(needs);
+    }
+
+    m_running = 0;
+    m_active = true;
+    m_startTime = QDateTime::currentDateTime();
+    m_endTime = QDateTime();
+
+    qDebug() << "RunbookRunner: Running" << runbook.name << "with" << runbook.steps.size() << "steps," << m_maxParallel << "at a time";
+    startReady();
+    return true;
+}
+
+void RunbookRunner::cancel()
+{
+    if (!isRunning()) {
+        return;
+    }
+
+    // Skip the waiting steps first so finishing the running ones starts nothing
+    for (int i = 0; i < m_results.size(); ++i) {
+        if (m_results.at(i).state == Waiting) {
+            m_results[i].state = Skipped;
+            Q_EMIT stepFinished(i);
+        }
+    }
+
+    // Running steps finish as they exit
+    for (ShellJob *shellJob : std::as_const(m_shellJobs)) {
+        if (shellJob) {
+            shellJob->stop();
+        }
+    }
+
+    checkFinished();
+}
+
+bool RunbookRunner::isRunning() const
+{
+    return m_active;
+}
+
+const Runbook &RunbookRunner::runbook() const
+{
+    return m_runbook;
+}
+
+const RunbookRunner::StepResult &RunbookRunner::result(int index) const
+{
+    return m_results.at(index);
+}
+
+QString RunbookRunner::stepDirectory(int index) const
+{
+    QString directory = m_runbook.steps.at(index).directory;
+    if (directory.isEmpty()) {
+        return m_baseDirectory;
+    }
+    return QDir(m_baseDirectory).absoluteFilePath(QDir::fromNativeSeparators(directory));
+}
+
+QString RunbookRunner::summary() const
+{
+    int nameWidth = 4;
+    for (const Runbook::Step &step : m_runbook.steps) {
+        nameWidth = qMax(nameWidth, int(step.name.size()));
+    }
+
+    QString text;
+    qint64 totalMsecs = 0;
+    int failed = 0;
+    int skipped = 0;
+    for (int i = 0; i < m_results.size(); ++i) {
+        const StepResult &result = m_results.at(i);
+
+        QString state;
+        switch (result.state) {
+        case Waiting:
+            state = i18n("waiting");
+            break;
+        case Running:
+            state = i18n("running");
+            break;
+        case Succeeded:
+            state = i18n("ok");
+            break;
+        case Failed:
+            state = result.exitCode >= 0 ? i18n("exit %1", result.exitCode) : i18n("failed");
+            ++failed;
+            break;
+        case Skipped:
+            state = i18n("skipped");
+            ++skipped;
+            break;
+        }
+
+        QString duration;
+        if (result.duration() >= 0) {
+            duration = QStringLiteral("%1 s").arg(result.duration() / 1000.0, 0, 'f', 1);
+            totalMsecs += result.duration();
+        }
+
+        text += QStringLiteral("%1  %2  %3\n").arg(m_runbook.steps.at(i).name, -nameWidth).arg(state, -8).arg(duration, 9);
+    }
+
+    QDateTime end = m_endTime.isValid() ? m_endTime : QDateTime::currentDateTime();
+    text += i18n("%1 failed, %2 skipped, wall time %3 s (%4 s sequentially)",
+                 failed, skipped,
+                 QString::number(m_startTime.msecsTo(end) / 1000.0, 'f', 1),
+                 QString::number(totalMsecs / 1000.0, 'f', 1));
+    return text;
+}
+
+void RunbookRunner::startReady()
+{
+    for (int index = 0; index < m_results.size() && m_running < m_maxParallel; ++index) {
+        if (m_results.at(index).state != Waiting) {
+            continue;
+        }
+        bool ready = true;
+        for (int need : std::as_const(m_needs[index])) {
+            if (m_results.at(need).state != Succeeded) {
+                ready = false;
+                break;
+            }
+        }
+        if (!ready) {
+            continue;
+        }
+
+        // Kept until the next run, a stopped step still reaps what its
+        // shell left behind
+        ShellJob *shellJob = new ShellJob(this);
+        shellJob->setUseEnvironmentCache(m_useEnvironmentCache);
+        shellJob->setEnvironment(m_environment);
+        connect(shellJob, &ShellJob::finished, this, [this, index](int exitCode) {
+            finishStep(index, exitCode);
+            startReady();
+            checkFinished();
+        });
+
+        StepResult &result = m_results[index];
+        result.state = Running;
+        result.startTime = QDateTime::currentDateTime();
+        m_shellJobs[index] = shellJob;
+        ++m_running;
+        Q_EMIT stepStarted(index);
+        shellJob->start(m_runbook.steps.at(index).command, stepDirectory(index));
+    }
+}
+
+void RunbookRunner::finishStep(int index, int exitCode)
+{
+    StepResult &result = m_results[index];
+    result.output = m_shellJobs.at(index)->output();
+    result.endTime = QDateTime::currentDateTime();
+    result.exitCode = exitCode;
+    result.state = exitCode == 0 ? Succeeded : Failed;
+    --m_running;
+
+    Q_EMIT stepFinished(index);
+
+    if (result.state == Failed) {
+        skipDependents(index);
+    }
+}
+
+void RunbookRunner::skipDependents(int index)
+{
+    for (int i = 0; i < m_results.size(); ++i) {
+        if (m_results.at(i).state == Waiting && m_needs.at(i).contains(index)) {
+            m_results[i].state = Skipped;
+            Q_EMIT stepFinished(i);
+            skipDependents(i);
+        }
+    }
+}
+
+void RunbookRunner::checkFinished()
+{
+    if (!m_active || m_running > 0) {
+        return;
+    }
+
+    // Steps still waiting will start once their needs finished
+    for (const StepResult &result : std::as_const(m_results)) {
+        if (result.state == Waiting) {
+            return;
+        }
+    }
+
+    m_active = false;
+    m_endTime = QDateTime::currentDateTime();
+    Q_EMIT finished();
+}
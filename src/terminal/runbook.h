@@ -0,0 +1,278 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef RUNBOOK_H
+#define RUNBOOK_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QObject>
+#include <QProcessEnvironment>
+#include <QString>
+#include <QStringList>
+
+class ShellJob;
+
+/**
+ * A saved sequence of commands with dependencies between them
+ *
+ * Runbooks are stored as JSON files in the WarpKate data directory, one
+ * per runbook, and are meant to be edited by hand:
+ *
+ * @code
+ * {
+ *     "steps": [
+ *         { "name": "client", "command": "make -C client" },
+ *         { "name": "server", "command": "make -C server" },
+ *         { "name": "test", "command": "./run-tests", "needs": ["client", "server"] },
+ *         { "name": "package", "command": "make dist", "needs": ["test"] }
+ *     ]
+ * }
+ * @endcode
+ *
+ * A step without "directory" runs in the directory the runbook is
+ * started from.
+ */
+struct Runbook {
+    /**
+     * One command of a runbook
+     */
+    struct Step {
+        QString name;               ///< Unique step name
+        QString command;            ///< Shell command
+        QString directory;          ///< Working directory, empty for the runbook's
+        QStringList needs;          ///< Steps that must succeed first
+    };
+
+    QString name;                   ///< Runbook name, also its file name
+    QList<Step> steps;              ///< Steps in file order
+
+    /**
+     * Get the directory runbooks are stored in
+     * @return Absolute path
+     */
+    static QString storageDirectory();
+
+    /**
+     * List the saved runbooks
+     * @return Runbook names, sorted
+     */
+    static QStringList available();
+
+    /**
+     * Get the file a runbook is stored in
+     * @param name Runbook name
+     * @return Absolute path
+     */
+    static QString filePath(const QString &name);
+
+    /**
+     * Load a saved runbook
+     * @param name Runbook name
+     * @param runbook Receives the runbook
+     * @param errorMessage Receives a description of the problem on failure
+     * @return True if the runbook was loaded and is valid
+     */
+    static bool load(const QString &name, Runbook *runbook, QString *errorMessage);
+
+    /**
+     * Save the runbook to its file
+     * @return True on success
+     */
+    bool save() const;
+
+    /**
+     * Check step names and dependencies
+     * @param errorMessage Receives a description of the problem
+     * @return True if names are unique, all needs exist and there are no cycles
+     */
+    bool validate(QString *errorMessage) const;
+};
+
+/**
+ * Runs a runbook as a dependency graph
+ *
+ * Steps start as soon as all steps they need have succeeded, at most
+ * maxParallel() at once, so independent steps run concurrently. When a
+ * step fails, every step depending on it, directly or not, is skipped;
+ * unrelated steps keep running. Each step runs in its own ShellJob, like
+ * the jobs of FanOutRunner.
+ */
+class RunbookRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Execution state of a step
+     */
+    enum StepState {
+        Waiting,                    ///< Needs have not all succeeded yet
+        Running,                    ///< Command is running
+        Succeeded,                  ///< Exited with code 0
+        Failed,                     ///< Exited with another code, crashed or did not start
+        Skipped                     ///< A needed step failed, or the run was cancelled
+    };
+
+    /**
+     * Result of a step
+     */
+    struct StepResult {
+        StepState state;            ///< Execution state
+        QDateTime startTime;        ///< When it started, invalid unless run
+        QDateTime endTime;          ///< When it finished, invalid unless run
+        int exitCode;               ///< Exit code, -1 unless it exited normally
+        QByteArray output;          ///< End of the output, as kept by ShellJob
+
+        StepResult() : state(Waiting), exitCode(-1) {}
+
+        /**
+         * Get the run time
+         * @return Milliseconds, -1 unless the step ran
+         */
+        qint64 duration() const {
+            return startTime.isValid() && endTime.isValid() ? startTime.msecsTo(endTime) : -1;
+        }
+    };
+
+    /**
+     * Constructor
+     * @param parent Parent object
+     */
+    explicit RunbookRunner(QObject *parent = nullptr);
+
+    /**
+     * Destructor, kills steps still running without waiting for them
+     */
+    ~RunbookRunner() override;
+
+    /**
+     * Set how many steps may run at once
+     * @param count Maximum number of parallel steps, at least 1
+     */
+    void setMaxParallel(int count);
+
+    /**
+     * Give each step the cached project environment of its directory
+     * @param enabled Whether to use the environment cache
+     */
+    void setUseEnvironmentCache(bool enabled);
+
+    /**
+     * Set the environment each step runs in
+     * @param environment Environment, e.g. the shell's exported one; empty for Kate's
+     */
+    void setEnvironment(const QProcessEnvironment &environment);
+
+    /**
+     * Start a runbook
+     *
+     * Does nothing if a run is in progress or the runbook is invalid.
+     *
+     * @param runbook Runbook to run
+     * @param baseDirectory Directory for steps without their own
+     * @return True if the run started
+     */
+    bool start(const Runbook &runbook, const QString &baseDirectory);
+
+    /**
+     * Stop running steps and skip the remaining ones
+     *
+     * Returns at once; finished() is emitted when the stopped steps exited.
+     */
+    void cancel();
+
+    /**
+     * Check whether a run is in progress
+     * @return True if steps are waiting or running
+     */
+    bool isRunning() const;
+
+    /**
+     * Get the runbook of the current or last run
+     * @return Runbook
+     */
+    const Runbook &runbook() const;
+
+    /**
+     * Get the result of a step
+     * @param index Step index
+     * @return Result so far
+     */
+    const StepResult &result(int index) const;
+
+    /**
+     * Get the working directory of a step
+     * @param index Step index
+     * @return Absolute path
+     */
+    QString stepDirectory(int index) const;
+
+    /**
+     * Format a summary of the run: state and duration per step, then the
+     * wall time
+     * @return Plain text table
+     */
+    QString summary() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted when a step started
+     * @param index Step index
+     */
+    void stepStarted(int index);
+
+    /**
+     * Emitted when a step succeeded, failed or was skipped
+     * @param index Step index
+     */
+    void stepFinished(int index);
+
+    /**
+     * Emitted when no step is left to run
+     */
+    void finished();
+
+private:
+    /**
+     * Start every waiting step whose needs succeeded, within the limit
+     */
+    void startReady();
+
+    /**
+     * Record the end of a step, skip its dependents on failure and continue
+     * @param index Step index
+     * @param exitCode Exit code, -1 if it crashed or did not start
+     */
+    void finishStep(int index, int exitCode);
+
+    /**
+     * Skip all waiting steps that depend on a step, directly or not
+     * @param index Failed or skipped step
+     */
+    void skipDependents(int index);
+
+    /**
+     * Emit finished() once no step is waiting or running
+     */
+    void checkFinished();
+
+private:
+    Runbook m_runbook;                  ///< Runbook of the current or last run
+    QString m_baseDirectory;            ///< Directory for steps without their own
+    QList<StepResult> m_results;        ///< Result per step
+    QList<QList<int>> m_needs;          ///< Indexes of the steps each step needs
+    QList<ShellJob *> m_shellJobs;      ///< Shell per step, nullptr unless started
+    QDateTime m_startTime;              ///< When the run started
+    QDateTime m_endTime;                ///< When the run finished
+    int m_running;                      ///< Number of running steps
+    int m_maxParallel;                  ///< Parallelism limit
+    bool m_active;                      ///< Whether finished() is still due
+    bool m_useEnvironmentCache;         ///< Whether steps get cached project environments
+    QProcessEnvironment m_environment;  ///< Environment of the steps, empty for Kate's
+};
+
+#endif // RUNBOOK_H
@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "sessionarena.h"
+
+#include <utility>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// Size of the first block of the batch arena; a 4 KiB read rarely needs
+// more, bigger batches chain further blocks until the next reset
+static const size_t BATCH_BUFFER_SIZE = 16 * 1024;
+
+// Most line buffers kept for reuse; a few screens of scrolling
+static const int MAX_POOLED_LINES = 256;
+
+SessionArena::SessionArena()
+    : m_batchBuffer(new char[BATCH_BUFFER_SIZE])
+    , m_batch(m_batchBuffer.get(), BATCH_BUFFER_SIZE)
+{
+}
+
+TerminalLine SessionArena::takeLine(int columns, const TerminalCell &fill)
+{
+    TerminalLine line;
+    if (!m_freeLines.isEmpty()) {
+        line = m_freeLines.takeLast();
+    }
+
+    // Overwrites in place when the buffer is big enough and not shared
+    line.fill(fill, columns);
+    return line;
+}
+
+void SessionArena::recycleLine(TerminalLine &line)
+{
+    if (m_freeLines.size() < MAX_POOLED_LINES && line.capacity() > 0) {
+        m_freeLines.append(std::exchange(line, TerminalLine()));
+    } else {
+        line = TerminalLine();
+    }
+}
+
+std::pmr::memory_resource *SessionArena::batchResource()
+{
+    return &m_batch;
+}
+
+void SessionArena::resetBatch()
+{
+    // Back to the first block; blocks chained after it are freed
+    m_batch.release();
+}
+
+void SessionArena::release()
+{
+    m_freeLines = QVector<TerminalLine>();
+    m_batch.release();
+
+#ifdef __GLIBC__
+    // glibc keeps freed memory in its arenas; give it back now that a
+    // whole session's worth of lines went away
+    malloc_trim(0);
+#endif
+}
@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef SESSIONARENA_H
+#define SESSIONARENA_H
+
+#include "terminalbackend.h"
+
+#include <QVector>
+
+#include <memory>
+#include <memory_resource>
+
+/**
+ * Memory owned by one terminal session
+ *
+ * Screen lines all have the width of the terminal, so instead of freeing
+ * the line that scrolls off the top and allocating a new one for the
+ * bottom, the buffers of scrolled off lines are pooled and handed out
+ * again as blank lines. Temporaries of a batch of output, like the
+ * parameters of escape sequences, come from a bump arena that is reset
+ * in one go after the batch has been parsed.
+ *
+ * When the session ends, release() drops the pool and the arena at once
+ * and asks the C library to hand the freed pages back to the system, so
+ * closed terminals don't leave a fragmented heap behind in the Kate
+ * process.
+ */
+class SessionArena
+{
+public:
+    /**
+     * Constructor
+     */
+    SessionArena();
+
+    SessionArena(const SessionArena &) = delete;
+    SessionArena &operator=(const SessionArena &) = delete;
+
+    /**
+     * Get a line filled with one cell, reusing a pooled buffer if possible
+     * @param columns Width of the line
+     * @param fill Cell to fill the line with
+     * @return The line
+     */
+    TerminalLine takeLine(int columns, const TerminalCell &fill);
+
+    /**
+     * Put the buffer of a line that is no longer needed into the pool
+     * @param line Line to recycle, left empty
+     */
+    void recycleLine(TerminalLine &line);
+
+    /**
+     * Get the memory resource for temporaries of the current batch
+     * @return Bump arena, valid until resetBatch()
+     */
+    std::pmr::memory_resource *batchResource();
+
+    /**
+     * Free all temporaries of the current batch at once
+     */
+    void resetBatch();
+
+    /**
+     * Drop pooled lines and batch memory and return freed pages to the system
+     */
+    void release();
+
+private:
+    QVector<TerminalLine> m_freeLines;              ///< Buffers of recycled lines
+    std::unique_ptr<char[]> m_batchBuffer;          ///< First block of the batch arena
+    std::pmr::monotonic_buffer_resource m_batch;    ///< Bump arena for batch temporaries
+};
+
+#endif // SESSIONARENA_H
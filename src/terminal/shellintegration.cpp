@@ -0,0 +1,301 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "shellintegration.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+// bash: used as --rcfile instead of ~/.bashrc
+static const char BASH_INTEGRATION[] = R"(# WarpKate shell integration for bash (generated, do not edit)
+if [ -n "$WARPKATE_TRACE_FILE" ]; then
+    exec {__warpkate_trace_fd}>"$WARPKATE_TRACE_FILE"
+    BASH_XTRACEFD=$__warpkate_trace_fd
+    PS4='+${EPOCHREALTIME} ${BASH_SOURCE[0]:-?}:${LINENO} '
+    set -x
+fi
+
+[ -f ~/.bashrc ] && . ~/.bashrc
+
+if [ -n "$WARPKATE_TRACE_FILE" ]; then
+    set +x
+    exec {__warpkate_trace_fd}>&-
+    unset BASH_XTRACEFD __warpkate_trace_fd
+    PS4='+ '
+fi
+unset WARPKATE_TRACE_FILE
+
+# Environment activation, run before the hooks exist so it isn't a command
+if [ -n "$WARPKATE_STARTUP_COMMAND" ]; then
+    eval "$WARPKATE_STARTUP_COMMAND"
+fi
+unset WARPKATE_STARTUP_COMMAND
+
+# Command metadata goes to the pipe in WARPKATE_META_FD, see ShellMetadataChannel
+__warpkate_meta_fd=$WARPKATE_META_FD
+unset WARPKATE_META_FD
+declare -A __warpkate_env=()
+__warpkate_histnum=0
+__warpkate_commands='rg z'
+
+__warpkate_field() {
+    local LC_ALL=C
+    __warpkate_record+="${#1}:$1,"
+}
+__warpkate_send() { { printf '%s\n' "$__warpkate_record" >&"$__warpkate_meta_fd"; } 2>/dev/null; }
+
+# Runs in PS0's command substitution, after the line went into the history.
+# A line kept out of it (HISTCONTROL, set +o history) leaves the history
+# number where the last prompt saw it; the command is then sent empty
+# rather than as the previous one
+__warpkate_command_record() {
+    local __warpkate_record='S ' line=
+    if [[ $(HISTTIMEFORMAT= builtin history 1) =~ ^\ *([0-9]+)\*?\ \ (.*)$ ]] \
+        && (( ${BASH_REMATCH[1]} > __warpkate_histnum )); then
+        line=${BASH_REMATCH[2]}
+    fi
+    __warpkate_field "$line"
+    __warpkate_field "$PWD"
+    __warpkate_field "${EPOCHREALTIME:-}"
+    __warpkate_send
+}
+
+__warpkate_status_record() {
+    local __warpkate_record='E ' name value names IFS=$'\n'
+    local -A seen=()
+    __warpkate_field "$1"
+    __warpkate_field "$2"
+    __warpkate_field "$PWD"
+    __warpkate_field "${EPOCHREALTIME:-}"
+
+    # Exported variables changed since the last prompt
+    names=$(compgen -e)
+    for name in $names; do
+        case $name in _|PWD|OLDPWD) continue ;; esac
+        seen[$name]=1
+        value=${!name}
+        if [[ ! -v __warpkate_env[$name] || ${__warpkate_env[$name]} != "$value" ]]; then
+            __warpkate_env[$name]=$value
+            __warpkate_field "+$name=$value"
+        fi
+    done
+    for name in "${!__warpkate_env[@]}"; do
+        if [[ ! -v seen[$name] ]]; then
+            unset '__warpkate_env[$name]'
+            __warpkate_field "-$name"
+        fi
+    done
+
+    # Commands WarpKate may run or stand in for that the shell defines otherwise
+    for name in $__warpkate_commands; do
+        if [[ -v BASH_ALIASES[$name] ]] || declare -F "$name" >/dev/null; then
+            __warpkate_field "@$name"
+        fi
+    done
+    __warpkate_send
+}
+
+__warpkate_command_done() {
+    local code=$? pipeline="${PIPESTATUS[*]}"
+    printf '\033]133;D;%s\007' "$code"
+    if [ -n "$__warpkate_meta_fd" ]; then
+        __warpkate_status_record "$code" "$pipeline"
+        [[ $(HISTTIMEFORMAT= builtin history 1) =~ ^\ *([0-9]+) ]] && __warpkate_histnum=${BASH_REMATCH[1]}
+    fi
+    return $code
+}
+__warpkate_prompt_ready() { printf '\033]133;A\007'; }
+PROMPT_COMMAND="__warpkate_command_done${PROMPT_COMMAND:+;$PROMPT_COMMAND};__warpkate_prompt_ready"
+PS0="${PS0}"$'\033]133;C\007'
+[ -n "$__warpkate_meta_fd" ] && PS0="${PS0}"'$(__warpkate_command_record)'
+)";
+
+// zsh: ZDOTDIR points here so these run in place of the user's files
+static const char ZSH_ZSHENV[] = R"(# WarpKate shell integration for zsh (generated, do not edit)
+__warpkate_zdotdir=$ZDOTDIR
+ZDOTDIR=${WARPKATE_USER_ZDOTDIR:-$HOME}
+[[ -f $ZDOTDIR/.zshenv ]] && source $ZDOTDIR/.zshenv
+ZDOTDIR=$__warpkate_zdotdir
+)";
+
+static const char ZSH_ZSHRC[] = R"(# WarpKate shell integration for zsh (generated, do not edit)
+ZDOTDIR=${WARPKATE_USER_ZDOTDIR:-$HOME}
+unset WARPKATE_USER_ZDOTDIR __warpkate_zdotdir
+
+if [[ -n $WARPKATE_TRACE_FILE ]]; then
+    zmodload zsh/datetime
+    exec {__warpkate_stderr}>&2 2>"$WARPKATE_TRACE_FILE"
+    PS4='+$EPOCHREALTIME %x:%I '
+    setopt xtrace
+fi
+
+[[ -f $ZDOTDIR/.zshrc ]] && source $ZDOTDIR/.zshrc
+
+if [[ -n $WARPKATE_TRACE_FILE ]]; then
+    unsetopt xtrace
+    exec 2>&$__warpkate_stderr {__warpkate_stderr}>&-
+    unset __warpkate_stderr
+fi
+unset WARPKATE_TRACE_FILE
+
+# Environment activation, run before the hooks exist so it isn't a command
+if [[ -n $WARPKATE_STARTUP_COMMAND ]]; then
+    eval "$WARPKATE_STARTUP_COMMAND"
+fi
+unset WARPKATE_STARTUP_COMMAND
+
+# Command metadata goes to the pipe in WARPKATE_META_FD, see ShellMetadataChannel
+typeset -g __warpkate_meta_fd=$WARPKATE_META_FD
+unset WARPKATE_META_FD
+zmodload zsh/datetime 2>/dev/null
+typeset -gA __warpkate_env
+typeset -ga __warpkate_commands=(rg z)
+
+__warpkate_field() {
+    setopt localoptions nomultibyte
+    __warpkate_record+="${#1}:$1,"
+}
+__warpkate_send() { { print -rn -- "$__warpkate_record"$'\n' >&$__warpkate_meta_fd } 2>/dev/null }
+
+__warpkate_command_record() {
+    local __warpkate_record='S '
+    __warpkate_field "$1"
+    __warpkate_field "$PWD"
+    __warpkate_field "$EPOCHREALTIME"
+    __warpkate_send
+}
+
+__warpkate_status_record() {
+    local __warpkate_record='E ' name value
+    local -A seen
+    __warpkate_field "$1"
+    __warpkate_field "$2"
+    __warpkate_field "$PWD"
+    __warpkate_field "$EPOCHREALTIME"
+
+    # Exported variables changed since the last prompt
+    for name in ${(k)parameters[(R)*export*]}; do
+        [[ $name == (_|PWD|OLDPWD) ]] && continue
+        seen[$name]=1
+        value=${(P)name}
+        if (( ! ${+__warpkate_env[$name]} )) || [[ ${__warpkate_env[$name]} != "$value" ]]; then
+            __warpkate_env[$name]=$value
+            __warpkate_field "+$name=$value"
+        fi
+    done
+    for name in ${(k)__warpkate_env}; do
+        if (( ! ${+seen[$name]} )); then
+            unset "__warpkate_env[$name]"
+            __warpkate_field "-$name"
+        fi
+    done
+
+    # Commands WarpKate may run or stand in for that the shell defines otherwise
+    for name in $__warpkate_commands; do
+        (( ${+aliases[$name]} || ${+functions[$name]} )) && __warpkate_field "@$name"
+    done
+    __warpkate_send
+}
+
+__warpkate_command_done() {
+    local code=$? pipeline="$pipestatus"
+    printf '\033]133;D;%s\007' "$code"
+    [[ -n $__warpkate_meta_fd ]] && __warpkate_status_record "$code" "$pipeline"
+    return $code
+}
+__warpkate_prompt_ready() { printf '\033]133;A\007'; }
+__warpkate_command_start() {
+    printf '\033]133;C\007'
+    [[ -n $__warpkate_meta_fd ]] && __warpkate_command_record "$1"
+}
+precmd_functions=(__warpkate_command_done $precmd_functions __warpkate_prompt_ready)
+preexec_functions+=(__warpkate_command_start)
+)";
+
+bool ShellIntegration::isSupported(const QString &shellProgram)
+{
+    QString name = QFileInfo(shellProgram).fileName();
+    return name == QLatin1String("bash") || name == QLatin1String("zsh");
+}
+
+ShellIntegration::Launch ShellIntegration::prepare(const QString &shellProgram, bool profileStartup, const QString &userZdotdir)
+{
+    Launch launch;
+    if (!isSupported(shellProgram)) {
+        return launch;
+    }
+
+    QString directory = scriptDirectory();
+    if (directory.isEmpty()) {
+        return launch;
+    }
+
+    if (QFileInfo(shellProgram).fileName() == QLatin1String("bash")) {
+        QString rcFile = directory + QStringLiteral("/bashrc");
+        if (!writeScript(rcFile, BASH_INTEGRATION)) {
+            return launch;
+        }
+        launch.arguments << QStringLiteral("--rcfile") << rcFile;
+    } else {
+        QString zshDirectory = directory + QStringLiteral("/zsh");
+        QDir().mkpath(zshDirectory);
+        if (!writeScript(zshDirectory + QStringLiteral("/.zshenv"), ZSH_ZSHENV)
+            || !writeScript(zshDirectory + QStringLiteral("/.zshrc"), ZSH_ZSHRC)) {
+            return launch;
+        }
+        launch.environment << QStringLiteral("ZDOTDIR=") + zshDirectory
+                           << QStringLiteral("WARPKATE_USER_ZDOTDIR=") + userZdotdir;
+    }
+
+    if (profileStartup) {
+        // One trace per shell, the profiler removes it once parsed
+        static int traceCounter = 0;
+        launch.tracePath = QStringLiteral("%1/startup-%2-%3.trace")
+                               .arg(directory)
+                               .arg(QCoreApplication::applicationPid())
+                               .arg(++traceCounter);
+        launch.environment << QStringLiteral("WARPKATE_TRACE_FILE=") + launch.tracePath;
+    }
+
+    return launch;
+}
+
+QString ShellIntegration::scriptDirectory()
+{
+    // The runtime directory is private to the user; fall back to the cache
+    QString base = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (base.isEmpty()) {
+        base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    }
+
+    QString directory = base + QStringLiteral("/warpkate-shell-integration");
+    if (!QDir().mkpath(directory)) {
+        qWarning() << "ShellIntegration: Could not create" << directory;
+        return QString();
+    }
+
+    return directory;
+}
+
+bool ShellIntegration::writeScript(const QString &path, const QByteArray &content)
+{
+    // Skip rewriting identical scripts, other shells may be reading them
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly) && file.readAll() == content) {
+        return true;
+    }
+    file.close();
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "ShellIntegration: Could not write" << path;
+        return false;
+    }
+
+    return file.write(content) == content.size();
+}
@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef SHELLINTEGRATION_H
+#define SHELLINTEGRATION_H
+
+#include <QString>
+#include <QStringList>
+
+/**
+ * Shell integration scripts for bash and zsh
+ *
+ * The scripts source the user's normal startup files and then add hooks
+ * that emit OSC 133 semantic prompt marks:
+ * - A when the prompt is about to be drawn (after all other prompt hooks)
+ * - C when a command starts
+ * - D;<exit code> when a command finished, before any prompt hooks run
+ *
+ * With startup profiling, sourcing the user's files runs under xtrace with
+ * a timestamped PS4 written to a trace file, for ShellProfiler to attribute
+ * startup time to individual files.
+ */
+class ShellIntegration
+{
+public:
+    /**
+     * How to launch a shell with integration
+     */
+    struct Launch {
+        QStringList arguments;      ///< Arguments to put right after the shell program
+        QStringList environment;    ///< KEY=VALUE entries to add to the environment
+        QString tracePath;          ///< Startup trace file, empty if not profiling
+    };
+
+    /**
+     * Check whether a shell has integration scripts
+     * @param shellProgram Shell program (path or name)
+     * @return True for bash and zsh
+     */
+    static bool isSupported(const QString &shellProgram);
+
+    /**
+     * Write the integration scripts and get the launch parameters
+     * @param shellProgram Shell program (path or name)
+     * @param profileStartup Whether to trace the user's startup files
+     * @param userZdotdir The ZDOTDIR the user's zsh files live in (zsh only)
+     * @return Launch parameters, empty if the shell is unsupported or the scripts couldn't be written
+     */
+    static Launch prepare(const QString &shellProgram, bool profileStartup, const QString &userZdotdir);
+
+private:
+    /**
+     * Get the directory the scripts are written to
+     * @return Private per-user directory
+     */
+    static QString scriptDirectory();
+
+    /**
+     * Write a script if its content changed
+     * @param path File to write
+     * @param content Script content
+     * @return True if the file has the content afterwards
+     */
+    static bool writeScript(const QString &path, const QByteArray &content);
+};
+
+#endif // SHELLINTEGRATION_H
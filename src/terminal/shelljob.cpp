@@ -0,0 +1,169 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "shelljob.h"
+#include "environmentcache.h"
+
+#include <QDebug>
+#include <QProcess>
+
+#include <signal.h>
+#include <unistd.h>
+
+// Output kept per job; the end of the output is what explains a failure
+static const qint64 MAX_JOB_OUTPUT = 256 * 1024;
+
+// Time a stopped job gets to clean up before it is killed (ms)
+static const int KILL_DELAY = 2000;
+
+ShellJob::ShellJob(QObject *parent)
+    : QObject(parent)
+    , m_process(nullptr)
+    , m_processGroup(0)
+    , m_useEnvironmentCache(false)
+    , m_stopping(false)
+    , m_outputSize(0)
+{
+    m_killTimer.setSingleShot(true);
+    m_killTimer.setInterval(KILL_DELAY);
+    connect(&m_killTimer, &QTimer::timeout, this, [this]() {
+        signalGroup(SIGKILL);
+    });
+}
+
+ShellJob::~ShellJob()
+{
+    // Nobody waits for a clean exit anymore
+    if (m_process) {
+        m_process->disconnect(this);
+    }
+    if (m_process || m_killTimer.isActive()) {
+        signalGroup(SIGKILL);
+    }
+}
+
+void ShellJob::setUseEnvironmentCache(bool enabled)
+{
+    m_useEnvironmentCache = enabled;
+}
+
+void ShellJob::setEnvironment(const QProcessEnvironment &environment)
+{
+    m_environment = environment;
+}
+
+void ShellJob::start(const QString &command, const QString &directory)
+{
+    if (m_process) {
+        return;
+    }
+
+    m_process = new QProcess(this);
+    m_process->setWorkingDirectory(directory);
+    m_process->setProcessChannelMode(QProcess::MergedChannels);
+    m_process->setStandardInputFile(QProcess::nullDevice());
+    if (!m_environment.isEmpty()) {
+        m_process->setProcessEnvironment(m_environment);
+    }
+    if (m_useEnvironmentCache) {
+        EnvironmentCache::instance().prepareCommand(m_process, command, directory);
+    } else {
+        m_process->setProgram(qEnvironmentVariable("SHELL", QStringLiteral("/bin/sh")));
+        m_process->setArguments({QStringLiteral("-c"), command});
+    }
+
+    // A session of its own makes the shell the leader of a new process
+    // group, which its children join
+    m_process->setChildProcessModifier([]() {
+        ::setsid();
+    });
+
+    connect(m_process, &QProcess::readyRead, this, [this]() {
+        QByteArray data = m_process->readAll();
+        m_outputSize += data.size();
+        m_output.append(data);
+        if (m_output.size() > MAX_JOB_OUTPUT) {
+            m_output.remove(0, m_output.size() - MAX_JOB_OUTPUT);
+        }
+    });
+    connect(m_process, &QProcess::started, this, [this]() {
+        m_processGroup = m_process->processId();
+    });
+    connect(m_process, &QProcess::finished, this, [this](int exitCode, QProcess::ExitStatus exitStatus) {
+        finish(exitStatus == QProcess::NormalExit && !m_stopping ? exitCode : -1);
+    });
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        // Only a failed start ends without finished()
+        if (error != QProcess::FailedToStart) {
+            return;
+        }
+        qWarning() << "ShellJob: Could not start the shell in" << m_process->workingDirectory();
+        finish(-1);
+    });
+
+    m_output.clear();
+    m_outputSize = 0;
+    m_stopping = false;
+    m_startTime = QDateTime::currentDateTime();
+    m_endTime = QDateTime();
+    m_process->start();
+}
+
+void ShellJob::stop()
+{
+    if (!m_process || m_stopping) {
+        return;
+    }
+
+    m_stopping = true;
+    signalGroup(SIGTERM);
+    m_killTimer.start();
+}
+
+bool ShellJob::isRunning() const
+{
+    return m_process != nullptr;
+}
+
+QByteArray ShellJob::output() const
+{
+    return m_output;
+}
+
+qint64 ShellJob::outputSize() const
+{
+    return m_outputSize;
+}
+
+QDateTime ShellJob::startTime() const
+{
+    return m_startTime;
+}
+
+QDateTime ShellJob::endTime() const
+{
+    return m_endTime;
+}
+
+void ShellJob::signalGroup(int signal)
+{
+    if (m_processGroup > 0) {
+        ::kill(-pid_t(m_processGroup), signal);
+    } else if (m_process) {
+        // Not started yet; only the shell can exist
+        m_process->kill();
+    }
+}
+
+void ShellJob::finish(int exitCode)
+{
+    // After stop() the kill timer keeps running for children the shell
+    // left behind
+    m_process->disconnect(this);
+    m_process->deleteLater();
+    m_process = nullptr;
+    m_endTime = QDateTime::currentDateTime();
+    Q_EMIT finished(exitCode);
+}
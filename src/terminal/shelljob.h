@@ -0,0 +1,132 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef SHELLJOB_H
+#define SHELLJOB_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QObject>
+#include <QProcessEnvironment>
+#include <QString>
+#include <QTimer>
+
+class QProcess;
+
+/**
+ * A command run in its own non-interactive shell outside the terminal
+ *
+ * The shell (`$SHELL -c`) runs in a new session, so it and everything it
+ * starts (make, compilers, test runners) form one process group that is
+ * signalled as a whole. Stopping a job sends SIGTERM to the group and
+ * SIGKILL a moment later if anything is left; finished() follows once the
+ * shell exited, without blocking the caller.
+ *
+ * Output and errors are merged into one pipe; the end of the output is
+ * kept, up to a limit.
+ */
+class ShellJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor
+     * @param parent Parent object
+     */
+    explicit ShellJob(QObject *parent = nullptr);
+
+    /**
+     * Destructor, kills the process group if the job still runs
+     */
+    ~ShellJob() override;
+
+    /**
+     * Run the command in the cached project environment of its directory
+     * @param enabled Whether to use the environment cache
+     */
+    void setUseEnvironmentCache(bool enabled);
+
+    /**
+     * Set the environment to run the command in
+     * @param environment Environment, e.g. the shell's exported one; empty for Kate's
+     */
+    void setEnvironment(const QProcessEnvironment &environment);
+
+    /**
+     * Start the job
+     * @param command Shell command
+     * @param directory Directory to run it in
+     */
+    void start(const QString &command, const QString &directory);
+
+    /**
+     * Stop the job and everything it started; finished() follows with -1
+     */
+    void stop();
+
+    /**
+     * Check whether the job is running
+     * @return True between start() and finished()
+     */
+    bool isRunning() const;
+
+    /**
+     * Get the end of the output
+     * @return Last bytes of stdout and stderr
+     */
+    QByteArray output() const;
+
+    /**
+     * Get how much output the job produced
+     * @return Bytes, including those no longer kept
+     */
+    qint64 outputSize() const;
+
+    /**
+     * Get when the job started
+     * @return Start time, invalid before start()
+     */
+    QDateTime startTime() const;
+
+    /**
+     * Get when the job finished
+     * @return End time, invalid until finished()
+     */
+    QDateTime endTime() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted when the shell exited or could not be started
+     * @param exitCode Exit code, -1 if it crashed, was stopped or did not start
+     */
+    void finished(int exitCode);
+
+private:
+    /**
+     * Send a signal to the job's process group
+     * @param signal Signal number
+     */
+    void signalGroup(int signal);
+
+    /**
+     * Record the end of the job
+     * @param exitCode Exit code, -1 if it crashed, was stopped or did not start
+     */
+    void finish(int exitCode);
+
+    QProcess *m_process;                ///< The shell, nullptr unless running
+    qint64 m_processGroup;              ///< Process group of the shell, 0 unless started
+    bool m_useEnvironmentCache;         ///< Whether to use cached project environments
+    QProcessEnvironment m_environment;  ///< Environment of the shell, empty for Kate's
+    bool m_stopping;                    ///< Whether stop() was called
+    QTimer m_killTimer;                 ///< Escalates to SIGKILL after stop()
+    QByteArray m_output;                ///< End of the output
+    qint64 m_outputSize;                ///< Bytes of output produced
+    QDateTime m_startTime;              ///< When the job started
+    QDateTime m_endTime;                ///< When the job finished
+};
+
+#endif // SHELLJOB_H
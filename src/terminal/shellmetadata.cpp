@@ -0,0 +1,326 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "shellmetadata.h"
+
+#include <QDebug>
+#include <QSocketNotifier>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+// A record that isn't complete after this many bytes is garbage and dropped
+static const int MAX_RECORD_SIZE = 1024 * 1024;
+
+// Longest length prefix of a field; keeps the prefix from overflowing
+static const int MAX_LENGTH_DIGITS = 7;
+
+// How far the shell's duration may be off the arrival stamps (us) before
+// the wall clock is considered to have jumped
+static const qint64 CLOCK_JUMP_TOLERANCE = 1000000;
+
+ShellMetadataChannel::ShellMetadataChannel(QObject *parent)
+    : QObject(parent)
+    , m_readFd(-1)
+    , m_writeFd(-1)
+    , m_notifier(nullptr)
+    , m_active(false)
+    , m_commandRunning(false)
+    , m_startTime(-1)
+    , m_startArrival(0)
+{
+    m_clock.start();
+}
+
+ShellMetadataChannel::~ShellMetadataChannel()
+{
+    close();
+}
+
+int ShellMetadataChannel::open()
+{
+    close();
+
+    int fds[2];
+    if (::pipe(fds) == -1) {
+        qWarning() << "ShellMetadataChannel: Could not create pipe:" << strerror(errno);
+        return -1;
+    }
+
+    // Only the shell gets the write end; non-blocking on both sides, so a
+    // hook can never hang the shell when nobody reads
+    for (int fd : fds) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+    m_readFd = fds[0];
+    m_writeFd = fds[1];
+
+    m_notifier = new QSocketNotifier(m_readFd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &ShellMetadataChannel::readRecords);
+
+    return m_writeFd;
+}
+
+void ShellMetadataChannel::closeWriteEnd()
+{
+    if (m_writeFd >= 0) {
+        ::close(m_writeFd);
+        m_writeFd = -1;
+    }
+}
+
+void ShellMetadataChannel::close()
+{
+    // May be called from a handler of a record, while the notifier is emitting
+    if (m_notifier) {
+        m_notifier->setEnabled(false);
+        m_notifier->deleteLater();
+        m_notifier = nullptr;
+    }
+
+    closeWriteEnd();
+    if (m_readFd >= 0) {
+        ::close(m_readFd);
+        m_readFd = -1;
+    }
+
+    m_buffer.clear();
+    m_active = false;
+    m_commandRunning = false;
+    m_directory.clear();
+    m_environment.clear();
+    m_definedCommands.clear();
+}
+
+bool ShellMetadataChannel::isActive() const
+{
+    return m_active;
+}
+
+QHash<QString, QString> ShellMetadataChannel::environment() const
+{
+    return m_environment;
+}
+
+bool ShellMetadataChannel::definesCommand(const QString &name) const
+{
+    return m_definedCommands.contains(name);
+}
+
+void ShellMetadataChannel::readRecords()
+{
+    char chunk[4096];
+    for (;;) {
+        ssize_t bytesRead = ::read(m_readFd, chunk, sizeof(chunk));
+        if (bytesRead > 0) {
+            m_buffer.append(chunk, int(bytesRead));
+        } else if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        } else {
+            // EOF: the shell and everything it started are gone
+            if (bytesRead == 0) {
+                m_notifier->setEnabled(false);
+            }
+            break;
+        }
+    }
+
+    int offset = 0;
+    char type;
+    QList<QByteArray> fields;
+    while (offset < m_buffer.size()) {
+        int consumed = decodeRecord(m_buffer, offset, &type, &fields);
+        if (consumed == 0) {
+            if (m_buffer.size() - offset <= MAX_RECORD_SIZE) {
+                break;
+            }
+            consumed = -1;
+        }
+
+        if (consumed < 0) {
+            // Resynchronize at the next line
+            qWarning() << "ShellMetadataChannel: Dropping malformed record";
+            int next = m_buffer.indexOf('\n', offset);
+            offset = next < 0 ? m_buffer.size() : next + 1;
+            continue;
+        }
+
+        offset += consumed;
+        m_active = true;
+
+        // Other types may come from newer hooks and are skipped
+        if (type == 'S') {
+            handleStart(fields);
+        } else if (type == 'E') {
+            handleEnd(fields);
+        }
+    }
+
+    m_buffer.remove(0, offset);
+}
+
+int ShellMetadataChannel::decodeRecord(const QByteArray &buffer, int from, char *type, QList<QByteArray> *fields)
+{
+    const int size = buffer.size();
+    fields->clear();
+
+    if (size - from < 2) {
+        return 0;
+    }
+    *type = buffer.at(from);
+    if (buffer.at(from + 1) != ' ') {
+        return -1;
+    }
+
+    int pos = from + 2;
+    for (;;) {
+        if (pos >= size) {
+            return 0;
+        }
+        if (buffer.at(pos) == '\n') {
+            return pos + 1 - from;
+        }
+
+        // <length>:<bytes>,
+        int length = 0;
+        int digits = 0;
+        while (pos < size && buffer.at(pos) >= '0' && buffer.at(pos) <= '9') {
+            if (++digits > MAX_LENGTH_DIGITS) {
+                return -1;
+            }
+            length = length * 10 + (buffer.at(pos) - '0');
+            ++pos;
+        }
+        if (pos >= size) {
+            return 0;
+        }
+        if (digits == 0 || buffer.at(pos) != ':') {
+            return -1;
+        }
+        ++pos;
+
+        if (size - pos < length + 1) {
+            return 0;
+        }
+        if (buffer.at(pos + length) != ',') {
+            return -1;
+        }
+        fields->append(buffer.mid(pos, length));
+        pos += length + 1;
+    }
+}
+
+void ShellMetadataChannel::handleStart(const QList<QByteArray> &fields)
+{
+    if (fields.size() < 3) {
+        qWarning() << "ShellMetadataChannel: Start record with" << fields.size() << "fields";
+        return;
+    }
+
+    m_current = ShellCommandRecord();
+    m_current.command = QString::fromUtf8(fields.at(0));
+    m_current.directory = QString::fromUtf8(fields.at(1));
+    m_startTime = parseShellTime(fields.at(2));
+    m_current.startTime = m_startTime >= 0 ? QDateTime::fromMSecsSinceEpoch(m_startTime / 1000) : QDateTime::currentDateTime();
+    m_startArrival = m_clock.nsecsElapsed() / 1000;
+    m_commandRunning = true;
+
+    Q_EMIT commandStarted(m_current.command);
+}
+
+void ShellMetadataChannel::handleEnd(const QList<QByteArray> &fields)
+{
+    if (fields.size() < 4) {
+        qWarning() << "ShellMetadataChannel: End record with" << fields.size() << "fields";
+        return;
+    }
+
+    int exitCode = fields.at(0).toInt();
+    QString directory = QString::fromUtf8(fields.at(2));
+    qint64 endTime = parseShellTime(fields.at(3));
+
+    QVector<int> pipeStatus;
+    const QList<QByteArray> stages = fields.at(1).split(' ');
+    for (const QByteArray &stage : stages) {
+        if (!stage.isEmpty()) {
+            pipeStatus.append(stage.toInt());
+        }
+    }
+
+    // "+NAME=VALUE", "-NAME" or "@NAME"
+    QMap<QString, QString> changes;
+    QStringList removals;
+    m_definedCommands.clear();
+    for (int i = 4; i < fields.size(); ++i) {
+        const QByteArray &field = fields.at(i);
+        if (field.startsWith('+')) {
+            int equals = field.indexOf('=');
+            if (equals > 1) {
+                QString name = QString::fromUtf8(field.mid(1, equals - 1));
+                QString value = QString::fromUtf8(field.mid(equals + 1));
+                changes.insert(name, value);
+                m_environment.insert(name, value);
+            }
+        } else if (field.startsWith('-') && field.size() > 1) {
+            QString name = QString::fromUtf8(field.mid(1));
+            removals.append(name);
+            m_environment.remove(name);
+        } else if (field.startsWith('@') && field.size() > 1) {
+            m_definedCommands.insert(QString::fromUtf8(field.mid(1)));
+        }
+    }
+
+    // The first prompt and empty command lines have no start record
+    if (m_commandRunning) {
+        m_commandRunning = false;
+        m_current.exitCode = exitCode;
+        m_current.pipeStatus = pipeStatus;
+        m_current.environmentChanges = changes;
+        m_current.environmentRemovals = removals;
+
+        // Prefer the shell's stamps, they don't include delays in reading them
+        qint64 arrivalDuration = m_clock.nsecsElapsed() / 1000 - m_startArrival;
+        qint64 shellDuration = (m_startTime >= 0 && endTime >= 0) ? endTime - m_startTime : -1;
+        bool clockJumped = shellDuration < 0 || qAbs(shellDuration - arrivalDuration) > CLOCK_JUMP_TOLERANCE + arrivalDuration / 10;
+        m_current.duration = clockJumped ? arrivalDuration : shellDuration;
+
+        Q_EMIT commandFinished(m_current);
+    }
+
+    // Reported after the command, which ran in the old directory
+    if (!directory.isEmpty() && directory != m_directory) {
+        m_directory = directory;
+        Q_EMIT directoryChanged(directory);
+    }
+}
+
+qint64 ShellMetadataChannel::parseShellTime(const QByteArray &field)
+{
+    // EPOCHREALTIME uses the locale's decimal separator
+    int separator = field.indexOf('.');
+    if (separator < 0) {
+        separator = field.indexOf(',');
+    }
+
+    bool ok;
+    qint64 seconds = field.left(separator < 0 ? field.size() : separator).toLongLong(&ok);
+    if (!ok) {
+        return -1;
+    }
+
+    qint64 micros = 0;
+    if (separator >= 0) {
+        QByteArray fraction = field.mid(separator + 1, 6).leftJustified(6, '0');
+        micros = fraction.toLongLong(&ok);
+        if (!ok) {
+            return -1;
+        }
+    }
+
+    return seconds * 1000000 + micros;
+}
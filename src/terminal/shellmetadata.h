@@ -0,0 +1,196 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef SHELLMETADATA_H
+#define SHELLMETADATA_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QSocketNotifier;
+
+/**
+ * What the shell reported about one command
+ */
+struct ShellCommandRecord {
+    QString command;                           ///< Command line as typed
+    QString directory;                         ///< Working directory the command started in
+    int exitCode = 0;                          ///< Exit status ($?)
+    QVector<int> pipeStatus;                   ///< Exit status of each pipeline stage
+    QDateTime startTime;                       ///< When the command started, by the shell's clock
+    qint64 duration = 0;                       ///< Run time in microseconds
+    QMap<QString, QString> environmentChanges; ///< Exported variables set or changed by the command
+    QStringList environmentRemovals;           ///< Exported variables unset by the command
+};
+
+/**
+ * Out-of-band channel for structured metadata from the shell
+ *
+ * The shell integration hooks don't print what they know about a command
+ * to the terminal, where it would go through the VT parser and could be
+ * mixed up with program output. They write records to a pipe whose write
+ * end the shell inherits; its descriptor number is in WARPKATE_META_FD.
+ *
+ * A record is a type byte, fields and a newline. Each field is its length
+ * in bytes, a colon, the bytes and a comma, so fields may contain any
+ * byte, newlines included:
+ *
+ *     S 12:make install,9:/home/me,17:1735689600.123456,\n
+ *
+ * - S (preexec): command line, working directory, start time
+ * - E (precmd): exit status, PIPESTATUS, working directory, end time, and
+ *   one field per environment change, "+NAME=VALUE" or "-NAME", and
+ *   "@NAME" for each command WarpKate may run itself (rg) that the shell
+ *   defines as an alias or function
+ *
+ * Times are the shell's EPOCHREALTIME, as no shell has a monotonic clock
+ * without forking. Records are also stamped with a monotonic clock when
+ * they arrive, which gives the duration instead if the wall clock jumped
+ * while the command ran.
+ *
+ * The first E record of a shell carries its whole exported environment.
+ */
+class ShellMetadataChannel : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor
+     * @param parent Parent object
+     */
+    explicit ShellMetadataChannel(QObject *parent = nullptr);
+
+    /**
+     * Destructor
+     */
+    ~ShellMetadataChannel() override;
+
+    /**
+     * Create the pipe for a shell about to be started
+     *
+     * Both ends are close-on-exec; the child clears the flag on the write
+     * end before exec'ing the shell, and the parent calls closeWriteEnd()
+     * after forking.
+     *
+     * @return Write end to pass to the shell, -1 on failure
+     */
+    int open();
+
+    /**
+     * Close the parent's copy of the write end
+     */
+    void closeWriteEnd();
+
+    /**
+     * Stop reading and close the pipe
+     */
+    void close();
+
+    /**
+     * Check whether the shell's hooks are talking to us
+     * @return True once a valid record arrived from the current shell
+     */
+    bool isActive() const;
+
+    /**
+     * Get the exported environment of the shell at its last prompt
+     * @return Variable values by name
+     */
+    QHash<QString, QString> environment() const;
+
+    /**
+     * Check whether the shell defines a command as an alias or function
+     *
+     * Only known for the commands the integration asks about, the ones
+     * WarpKate may run itself instead of the shell.
+     *
+     * @param name Command name
+     * @return True if the command was an alias or function at the last prompt
+     */
+    bool definesCommand(const QString &name) const;
+
+Q_SIGNALS:
+    /**
+     * Emitted when the shell is about to run a command
+     * @param command Command line as typed
+     */
+    void commandStarted(const QString &command);
+
+    /**
+     * Emitted when a command finished and the shell is back at its prompt
+     * @param record What the shell reported about the command
+     */
+    void commandFinished(const ShellCommandRecord &record);
+
+    /**
+     * Emitted at a prompt in a different directory than the last one
+     * @param directory New working directory
+     */
+    void directoryChanged(const QString &directory);
+
+private:
+    /**
+     * Read what the shell wrote and handle complete records
+     */
+    void readRecords();
+
+    /**
+     * Decode one record
+     * @param buffer Received bytes
+     * @param from Offset of the record
+     * @param type Receives the record type
+     * @param fields Receives the fields
+     * @return Bytes consumed, 0 if the record is incomplete, -1 if it is malformed
+     */
+    static int decodeRecord(const QByteArray &buffer, int from, char *type, QList<QByteArray> *fields);
+
+    /**
+     * Handle a command start record
+     * @param fields Record fields
+     */
+    void handleStart(const QList<QByteArray> &fields);
+
+    /**
+     * Handle a command end record
+     * @param fields Record fields
+     */
+    void handleEnd(const QList<QByteArray> &fields);
+
+    /**
+     * Convert an EPOCHREALTIME value
+     * @param field Seconds since the epoch with a fraction
+     * @return Microseconds since the epoch, -1 if unknown
+     */
+    static qint64 parseShellTime(const QByteArray &field);
+
+    int m_readFd;                              ///< Read end of the pipe
+    int m_writeFd;                             ///< Parent's copy of the write end until closeWriteEnd()
+    QSocketNotifier *m_notifier;               ///< Fires when records arrive
+    QByteArray m_buffer;                       ///< Received bytes not decoded yet
+    bool m_active;                             ///< Whether a valid record arrived
+    QElapsedTimer m_clock;                     ///< Monotonic clock for arrival stamps
+
+    // Command in progress
+    bool m_commandRunning;                     ///< Whether an S record is waiting for its E record
+    ShellCommandRecord m_current;              ///< The command in progress
+    qint64 m_startTime;                        ///< Its start by the shell's clock (us since the epoch)
+    qint64 m_startArrival;                     ///< Monotonic arrival of its S record (us)
+
+    QString m_directory;                       ///< Working directory at the last prompt
+    QHash<QString, QString> m_environment;     ///< Exported environment at the last prompt
+    QSet<QString> m_definedCommands;           ///< Aliases and functions at the last prompt, of those asked about
+};
+
+#endif // SHELLMETADATA_H
@@ -0,0 +1,162 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "shellprofiler.h"
+
+#include <KLocalizedString>
+
+#include <QDebug>
+#include <QFile>
+#include <QHash>
+#include <QRegularExpression>
+
+#include <algorithm>
+
+// Prompt overheads kept for the report
+static const int MAX_PROMPT_SAMPLES = 100;
+
+// Files listed in the report
+static const int REPORT_FILE_COUNT = 10;
+
+ShellProfiler::ShellProfiler(QObject *parent)
+    : QObject(parent)
+    , m_startupTime(-1)
+    , m_commandFinishedAt(-1)
+{
+}
+
+ShellProfiler::~ShellProfiler()
+{
+}
+
+void ShellProfiler::shellStarting(const QString &tracePath)
+{
+    m_clock.start();
+    m_startupTime = -1;
+    m_commandFinishedAt = -1;
+    m_promptOverheads.clear();
+    m_tracePath = tracePath;
+    m_fileCosts.clear();
+}
+
+qint64 ShellProfiler::startupTime() const
+{
+    return m_startupTime;
+}
+
+QVector<qint64> ShellProfiler::promptOverheads() const
+{
+    return m_promptOverheads;
+}
+
+QList<ShellProfiler::FileCost> ShellProfiler::startupFileCosts() const
+{
+    return m_fileCosts;
+}
+
+void ShellProfiler::onSemanticPromptMark(QChar mark, const QString &parameters)
+{
+    Q_UNUSED(parameters);
+
+    if (!m_clock.isValid()) {
+        return;
+    }
+
+    if (mark == QLatin1Char('D')) {
+        m_commandFinishedAt = m_clock.elapsed();
+    } else if (mark == QLatin1Char('A')) {
+        if (m_startupTime < 0) {
+            // First prompt: startup is done and the trace is complete
+            m_startupTime = m_clock.elapsed();
+
+            if (!m_tracePath.isEmpty()) {
+                m_fileCosts = attributeTrace(m_tracePath);
+                QFile::remove(m_tracePath);
+                m_tracePath.clear();
+            }
+
+            Q_EMIT startupMeasured(m_startupTime);
+        } else if (m_commandFinishedAt >= 0) {
+            m_promptOverheads.append(m_clock.elapsed() - m_commandFinishedAt);
+            if (m_promptOverheads.size() > MAX_PROMPT_SAMPLES) {
+                m_promptOverheads.removeFirst();
+            }
+        }
+        m_commandFinishedAt = -1;
+    }
+}
+
+QList<ShellProfiler::FileCost> ShellProfiler::attributeTrace(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "ShellProfiler: Could not read trace" << path;
+        return {};
+    }
+
+    // bash repeats the leading + per nesting level; the decimal separator
+    // of EPOCHREALTIME follows the locale
+    static const QRegularExpression lineRegex(QStringLiteral("^\\++(\\d+[.,]\\d+) (.+):(\\d+) "));
+
+    QHash<QString, double> costs;
+    QString previousFile;
+    double previousTime = -1;
+
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine());
+        QRegularExpressionMatch match = lineRegex.match(line);
+        if (!match.hasMatch()) {
+            // Output or continuation of a multi-line command
+            continue;
+        }
+
+        double time = match.captured(1).replace(QLatin1Char(','), QLatin1Char('.')).toDouble();
+        if (previousTime >= 0 && time >= previousTime) {
+            costs[previousFile] += (time - previousTime) * 1000.0;
+        }
+
+        previousTime = time;
+        previousFile = match.captured(2);
+    }
+
+    QList<FileCost> result;
+    for (auto it = costs.constBegin(); it != costs.constEnd(); ++it) {
+        result.append({it.key(), it.value()});
+    }
+    std::sort(result.begin(), result.end(), [](const FileCost &a, const FileCost &b) {
+        return a.milliseconds > b.milliseconds;
+    });
+
+    return result;
+}
+
+QString ShellProfiler::report() const
+{
+    QStringList lines;
+
+    if (m_startupTime < 0) {
+        lines << i18n("Shell startup: no prompt seen yet (shell integration may be off or unsupported for this shell)");
+    } else {
+        lines << i18n("Shell startup: %1 ms to first prompt", m_startupTime);
+    }
+
+    if (!m_promptOverheads.isEmpty()) {
+        QVector<qint64> sorted = m_promptOverheads;
+        std::sort(sorted.begin(), sorted.end());
+        qint64 median = sorted.at(sorted.size() / 2);
+        qint64 p90 = sorted.at(qMin(sorted.size() - 1, sorted.size() * 9 / 10));
+        lines << i18n("Prompt overhead: median %1 ms, 90th percentile %2 ms over %3 commands",
+                      median, p90, sorted.size());
+    }
+
+    if (!m_fileCosts.isEmpty()) {
+        lines << i18n("Startup time by file:");
+        for (int i = 0; i < qMin(REPORT_FILE_COUNT, m_fileCosts.size()); ++i) {
+            lines << QStringLiteral("  %1 ms  %2").arg(m_fileCosts.at(i).milliseconds, 8, 'f', 1).arg(m_fileCosts.at(i).file);
+        }
+    }
+
+    return lines.join(QLatin1Char('\n'));
+}
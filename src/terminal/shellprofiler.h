@@ -0,0 +1,113 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef SHELLPROFILER_H
+#define SHELLPROFILER_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+/**
+ * Measures shell startup and prompt latency from OSC 133 marks
+ *
+ * - Startup time: from starting the shell process to its first prompt (A)
+ * - Prompt overhead: from a command finishing (D) to the next prompt (A),
+ *   i.e. the time spent in prompt hooks such as git prompts
+ * - With a startup trace (see ShellIntegration), the startup time spent in
+ *   each sourced file
+ */
+class ShellProfiler : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Time spent in one file during startup
+     */
+    struct FileCost {
+        QString file;               ///< Sourced file
+        double milliseconds;        ///< Time spent executing its lines
+    };
+
+    /**
+     * Constructor
+     * @param parent Parent object
+     */
+    explicit ShellProfiler(QObject *parent = nullptr);
+
+    /**
+     * Destructor
+     */
+    ~ShellProfiler() override;
+
+    /**
+     * Start measuring a new shell; call right before it is started
+     * @param tracePath Startup trace the shell will write, empty if not profiling
+     */
+    void shellStarting(const QString &tracePath = QString());
+
+    /**
+     * Get the time from shell start to the first prompt
+     * @return Milliseconds, or -1 if no prompt was seen yet
+     */
+    qint64 startupTime() const;
+
+    /**
+     * Get the measured prompt overheads, oldest first
+     * @return Milliseconds between command end and the next prompt
+     */
+    QVector<qint64> promptOverheads() const;
+
+    /**
+     * Get the startup time per sourced file
+     * @return Costs sorted by time, most expensive first; empty without a trace
+     */
+    QList<FileCost> startupFileCosts() const;
+
+    /**
+     * Get a human readable summary of all measurements
+     * @return Multi-line report
+     */
+    QString report() const;
+
+    /**
+     * Attribute the time in an xtrace log to the files being executed
+     *
+     * Each trace line starts with "+<epoch seconds> <file>:<line> "; the
+     * time until the next line is charged to that line's file.
+     *
+     * @param path Trace file
+     * @return Costs sorted by time, most expensive first
+     */
+    static QList<FileCost> attributeTrace(const QString &path);
+
+public Q_SLOTS:
+    /**
+     * Handle an OSC 133 semantic prompt mark from the terminal
+     * @param mark Mark letter (A, B, C or D)
+     * @param parameters Parameters after the mark, e.g. the exit code for D
+     */
+    void onSemanticPromptMark(QChar mark, const QString &parameters);
+
+Q_SIGNALS:
+    /**
+     * Emitted when the first prompt of a shell appeared
+     * @param milliseconds Time from shell start to the prompt
+     */
+    void startupMeasured(qint64 milliseconds);
+
+private:
+    QElapsedTimer m_clock;                  ///< Started when the shell starts
+    qint64 m_startupTime;                   ///< Time to the first prompt, -1 until seen
+    qint64 m_commandFinishedAt;             ///< Clock time of the last D mark, -1 if none pending
+    QVector<qint64> m_promptOverheads;      ///< Recent prompt overheads
+    QString m_tracePath;                    ///< Startup trace of the current shell
+    QList<FileCost> m_fileCosts;            ///< Parsed startup trace
+};
+
+#endif // SHELLPROFILER_H
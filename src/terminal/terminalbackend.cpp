@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "terminalbackend.h"
+#include "terminalemulator.h"
+
+#ifdef WARPKATE_HAVE_QTERMWIDGET
+#include "qtermwidgetemulator.h"
+#endif
+
+#include <KConfigGroup>
+#include <KSharedConfig>
+
+#include <QDebug>
+
+bool TerminalBackendFactory::isAvailable(TerminalBackendType type)
+{
+    switch (type) {
+    case TerminalBackendType::Internal:
+        return true;
+
+    case TerminalBackendType::QTermWidget:
+#ifdef WARPKATE_HAVE_QTERMWIDGET
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    return false;
+}
+
+TerminalBackendType TerminalBackendFactory::configuredBackend()
+{
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    QString name = config.readEntry("TerminalBackend", backendName(TerminalBackendType::Internal));
+
+    // Map the stored name back to a type
+    TerminalBackendType type = TerminalBackendType::Internal;
+    if (name == backendName(TerminalBackendType::QTermWidget)) {
+        type = TerminalBackendType::QTermWidget;
+    }
+
+    // Fall back to the internal engine if this build lacks the selected one
+    if (!isAvailable(type)) {
+        qDebug() << "Terminal backend" << name << "not available in this build, using internal backend";
+        type = TerminalBackendType::Internal;
+    }
+
+    return type;
+}
+
+QString TerminalBackendFactory::backendName(TerminalBackendType type)
+{
+    switch (type) {
+    case TerminalBackendType::QTermWidget:
+        return QStringLiteral("qtermwidget");
+
+    case TerminalBackendType::Internal:
+    default:
+        return QStringLiteral("internal");
+    }
+}
+
+TerminalBackend *TerminalBackendFactory::createBackend(TerminalBackendType type, QWidget *parent)
+{
+    switch (type) {
+    case TerminalBackendType::QTermWidget:
+#ifdef WARPKATE_HAVE_QTERMWIDGET
+        return new QTermWidgetEmulator(parent);
+#else
+        qWarning() << "QTermWidget backend requested but not compiled in, falling back to internal backend";
+        return new TerminalEmulator(parent);
+#endif
+
+    case TerminalBackendType::Internal:
+    default:
+        return new TerminalEmulator(parent);
+    }
+}
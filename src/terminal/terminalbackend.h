@@ -0,0 +1,496 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef TERMINALBACKEND_H
+#define TERMINALBACKEND_H
+
+#include <QObject>
+#include <QColor>
+#include <QLatin1Char>
+#include <QPoint>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QWidget;
+
+/**
+ * Terminal character format attributes
+ */
+enum TerminalAttribute {
+    Bold = 0x01,
+    Italic = 0x02,
+    Underline = 0x04,
+    StrikeThrough = 0x08,
+    Reverse = 0x10,
+    Blink = 0x20,
+    Dim = 0x40,
+    Invisible = 0x80
+};
+
+/**
+ * Character format for a terminal cell
+ */
+struct TerminalCharFormat {
+    QColor foreground;      ///< Foreground color
+    QColor background;      ///< Background color
+    int attributes;         ///< Attributes (combination of TerminalAttribute flags)
+
+    TerminalCharFormat() : foreground(Qt::white), background(Qt::black), attributes(0) {}
+
+    bool operator==(const TerminalCharFormat &other) const {
+        return foreground == other.foreground &&
+               background == other.background &&
+               attributes == other.attributes;
+    }
+
+    bool operator!=(const TerminalCharFormat &other) const {
+        return !(*this == other);
+    }
+};
+
+/**
+ * Terminal cell containing a character and its format
+ */
+struct TerminalCell {
+    QChar character;               ///< The character in this cell
+    TerminalCharFormat format;     ///< Format of this cell
+
+    TerminalCell() : character(QLatin1Char(' ')) {}
+    TerminalCell(QChar ch, const TerminalCharFormat &fmt) : character(ch), format(fmt) {}
+
+    bool operator==(const TerminalCell &other) const {
+        return character == other.character && format == other.format;
+    }
+
+    bool operator!=(const TerminalCell &other) const {
+        return !(*this == other);
+    }
+};
+
+/**
+ * Terminal screen line
+ */
+typedef QVector<TerminalCell> TerminalLine;
+
+/**
+ * Cursor state in the terminal
+ */
+enum CursorStyle {
+    Block,
+    UnderlineCursor,
+    IBeam
+};
+
+/**
+ * Mouse actions that can be reported to the program in the terminal
+ */
+enum class TerminalMouseAction {
+    Press,          ///< Button pressed
+    Release,        ///< Button released
+    Move,           ///< Pointer moved, with or without a button held
+    WheelUp,        ///< Wheel scrolled up one step
+    WheelDown       ///< Wheel scrolled down one step
+};
+
+/**
+ * Available terminal engine implementations
+ */
+enum class TerminalBackendType {
+    Internal,       ///< WarpKate's own VT parser and PTY handling (TerminalEmulator)
+    QTermWidget     ///< The qtermwidget library (QTermWidgetEmulator)
+};
+
+/**
+ * Abstract interface for a terminal engine
+ *
+ * The rest of WarpKate (the view, the block model, the block view) only
+ * talks to a terminal through this interface, so the engine behind it can
+ * be swapped at runtime. It covers four areas:
+ * - grid access: size, cells, cursor and screen contents
+ * - damage: which rows changed since the last paint
+ * - input: text, key presses and commands sent to the shell
+ * - signals: output, command and shell lifecycle notifications
+ */
+class TerminalBackend : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor
+     * @param parent Parent object
+     */
+    explicit TerminalBackend(QObject *parent = nullptr) : QObject(parent) {}
+
+    /**
+     * Destructor
+     */
+    ~TerminalBackend() override = default;
+
+    /**
+     * Get the type of this backend
+     * @return Backend type
+     */
+    virtual TerminalBackendType backendType() const = 0;
+
+    /**
+     * Get the widget that renders this backend, if it brings its own
+     * @return Display widget, or nullptr if WarpKate renders the grid itself
+     */
+    virtual QWidget *displayWidget() const = 0;
+
+    // Lifecycle
+
+    /**
+     * Initialize the terminal
+     * @param rows Number of rows
+     * @param cols Number of columns
+     * @return True if initialization was successful
+     */
+    virtual bool initialize(int rows, int cols) = 0;
+
+    /**
+     * Start a shell process in the terminal
+     * @param shellCommand Command to run (default: system shell)
+     * @param initialWorkingDirectory Initial working directory
+     * @return True if the shell was started successfully
+     */
+    virtual bool startShell(const QString &shellCommand = QString(),
+                            const QString &initialWorkingDirectory = QString()) = 0;
+    
+    /**
+     * Set the environment for the next startShell()
+     * @param environment KEY=VALUE entries to set and KEY entries to unset on top of Kate's environment
+     */
+    virtual void setShellEnvironment(const QStringList &environment) = 0;
+
+    /**
+     * Resize the terminal
+     * @param rows New number of rows
+     * @param cols New number of columns
+     */
+    virtual void resize(int rows, int cols) = 0;
+
+    // Input
+
+    /**
+     * Send text input to the shell
+     * @param text Text input from the user
+     */
+    virtual void processInput(const QString &text) = 0;
+
+    /**
+     * Send a key press to the shell
+     * @param key The Qt key code
+     * @param modifiers Keyboard modifiers
+     * @param text Text from the key press
+     */
+    virtual void processKeyPress(int key, Qt::KeyboardModifiers modifiers, const QString &text) = 0;
+
+    /**
+     * Execute a command in the terminal
+     * @param command Command to execute
+     * @param addNewline Whether to add a newline at the end
+     */
+    virtual void executeCommand(const QString &command, bool addNewline = true) = 0;
+    
+    /**
+     * Check whether the program in the terminal asked for mouse reports
+     * @return True if mouse events should be sent via processMouseEvent
+     */
+    virtual bool isMouseTrackingActive() const = 0;
+    
+    /**
+     * Report a mouse event to the program in the terminal
+     * 
+     * Events the active tracking mode doesn't ask for are dropped.
+     * 
+     * @param action What happened
+     * @param button Button pressed or released (ignored for moves and wheel)
+     * @param modifiers Keyboard modifiers
+     * @param cell Cell under the pointer (column, row)
+     */
+    virtual void processMouseEvent(TerminalMouseAction action, Qt::MouseButton button,
+                                   Qt::KeyboardModifiers modifiers, const QPoint &cell) = 0;
+
+    /**
+     * Clear the terminal screen
+     */
+    virtual void clear() = 0;
+
+    // Grid access
+
+    /**
+     * Get the terminal size
+     * @return Terminal size in columns and rows
+     */
+    virtual QSize size() const = 0;
+
+    /**
+     * Get the character at the specified position
+     * @param x Column
+     * @param y Row
+     * @return Character at the position
+     */
+    virtual QChar characterAt(int x, int y) const = 0;
+
+    /**
+     * Get the format at the specified position
+     * @param x Column
+     * @param y Row
+     * @return Format at the position
+     */
+    virtual TerminalCharFormat formatAt(int x, int y) const = 0;
+
+    /**
+     * Get the cursor position
+     * @return Current cursor position (x, y)
+     */
+    virtual QPoint cursorPosition() const = 0;
+
+    /**
+     * Get whether the cursor is visible
+     * @return True if the cursor is visible
+     */
+    virtual bool isCursorVisible() const = 0;
+
+    /**
+     * Get whether the terminal is in alternative screen mode
+     * @return True if in alternative screen mode
+     */
+    virtual bool isAlternateScreenActive() const = 0;
+
+    /**
+     * Get a line of text from the terminal
+     * @param line Line number
+     * @param stripFormatting Whether to strip formatting
+     * @return Line of text
+     */
+    virtual QString getLine(int line, bool stripFormatting = true) const = 0;
+
+    /**
+     * Get the terminal content as text
+     * @param stripFormatting Whether to strip formatting
+     * @return Terminal content as text
+     */
+    virtual QString getText(bool stripFormatting = true) const = 0;
+
+    // Damage tracking
+
+    /**
+     * Get the region of cells changed since the last call and reset it
+     *
+     * Renderers call this once per paint and only repaint the returned
+     * rows. An empty rectangle means nothing changed.
+     *
+     * @return Damaged region in cell coordinates (columns x rows)
+     */
+    virtual QRect takeDamage() = 0;
+
+    // Shell state
+
+    /**
+     * Get the current working directory of the shell
+     * @return Current working directory
+     */
+    virtual QString currentWorkingDirectory() const = 0;
+
+    /**
+     * Check if the terminal is busy (shell process is running)
+     * @return True if the terminal is busy
+     */
+    virtual bool isBusy() const = 0;
+
+    /**
+     * Check whether the shell itself owns the terminal
+     *
+     * False while another program (an editor, a pager, a REPL) is the
+     * foreground process group of the PTY.
+     *
+     * @return True if the shell is the foreground process
+     */
+    virtual bool isShellInForeground() const = 0;
+
+    /**
+     * Check whether a program other than the shell put the TTY in raw mode
+     *
+     * Programs that read keys one by one (REPLs, pagers, prompts) turn off
+     * canonical mode; programs that only print (make, test runners) don't.
+     *
+     * @return True if a foreground program reads the terminal unbuffered
+     */
+    virtual bool isRawModeActive() const = 0;
+
+    /**
+     * Get the exit code of the last command
+     * @return Exit code of the last command
+     */
+    virtual int lastExitCode() const = 0;
+
+    /**
+     * Get the current command being typed
+     * @return Current command
+     */
+    virtual QString currentCommand() const = 0;
+
+    /**
+     * Get the command history
+     * @return List of previous commands
+     */
+    virtual QStringList commandHistory() const = 0;
+
+public Q_SLOTS:
+    /**
+     * Copy selected text to clipboard
+     */
+    virtual void copyToClipboard() = 0;
+
+    /**
+     * Paste text from clipboard
+     */
+    virtual void pasteFromClipboard() = 0;
+
+    /**
+     * Select all text
+     */
+    virtual void selectAll() = 0;
+
+    /**
+     * Find text in the terminal
+     * @param text Text to find
+     * @param caseSensitive Whether the search is case sensitive
+     * @param searchForward Whether to search forward
+     * @return True if text was found
+     */
+    virtual bool findText(const QString &text, bool caseSensitive = false, bool searchForward = true) = 0;
+
+Q_SIGNALS:
+    /**
+     * Emitted when terminal output is available
+     * @param text Output text
+     */
+    void outputAvailable(const QString &text);
+
+    /**
+     * Emitted when the terminal size changes
+     * @param size New terminal size
+     */
+    void sizeChanged(const QSize &size);
+
+    /**
+     * Emitted when the cursor position changes
+     * @param position New cursor position
+     */
+    void cursorPositionChanged(const QPoint &position);
+
+    /**
+     * Emitted when the shell process finishes
+     * @param exitCode Exit code of the shell process
+     */
+    void shellFinished(int exitCode);
+
+    /**
+     * Emitted when a command is detected
+     * @param command Command text
+     */
+    void commandDetected(const QString &command);
+
+    /**
+     * Emitted when a command execution is completed
+     * @param command Command text
+     * @param output Command output
+     * @param exitCode Exit code of the command
+     */
+    void commandExecuted(const QString &command, const QString &output, int exitCode);
+
+    /**
+     * Emitted when the working directory changes
+     * @param directory New working directory
+     */
+    void workingDirectoryChanged(const QString &directory);
+
+    /**
+     * Emitted when the shell itself reports its working directory
+     *
+     * Only for reports from the shell (OSC 7, shell integration), never
+     * for directories guessed from the output.
+     *
+     * @param directory Reported working directory
+     */
+    void workingDirectoryReported(const QString &directory);
+
+    /**
+     * Emitted when the terminal enters or leaves the alternate screen
+     * @param active Whether the alternate screen is now active
+     */
+    void alternateScreenChanged(bool active);
+    
+    /**
+     * Emitted for OSC 133 semantic prompt marks from shell integration
+     * @param mark A (prompt starts), B (input starts), C (command output starts) or D (command done)
+     * @param parameters Parameters after the mark, e.g. the exit code for D
+     */
+    void semanticPromptMark(QChar mark, const QString &parameters);
+
+    /**
+     * Emitted when the terminal requires a redraw
+     */
+    void redrawRequired();
+
+    /**
+     * Emitted when the terminal bell is triggered
+     */
+    void bellTriggered();
+
+    /**
+     * Emitted when the terminal title changes
+     * @param title New terminal title
+     */
+    void titleChanged(const QString &title);
+};
+
+/**
+ * Factory for terminal backends
+ */
+class TerminalBackendFactory
+{
+public:
+    /**
+     * Check whether a backend was compiled into this build
+     * @param type Backend type
+     * @return True if the backend can be created
+     */
+    static bool isAvailable(TerminalBackendType type);
+
+    /**
+     * Get the backend selected in the WarpKate configuration
+     *
+     * Falls back to the internal backend if the configured one is not
+     * available in this build.
+     *
+     * @return Configured backend type
+     */
+    static TerminalBackendType configuredBackend();
+
+    /**
+     * Get the configuration name of a backend type
+     * @param type Backend type
+     * @return Name stored in the "TerminalBackend" config entry
+     */
+    static QString backendName(TerminalBackendType type);
+
+    /**
+     * Create a terminal backend
+     * @param type Backend type to create
+     * @param parent Parent widget for the backend (and its display widget)
+     * @return Newly created backend, owned by parent
+     */
+    static TerminalBackend *createBackend(TerminalBackendType type, QWidget *parent);
+};
+
+#endif // TERMINALBACKEND_H
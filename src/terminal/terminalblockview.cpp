@@ -5,7 +5,7 @@
 
 #include "terminalblockview.h"
 #include "blockmodel.h"
-#include "terminalemulator.h"
+#include "terminalbackend.h"
 
 #include <QMessageBox>
 
@@ -132,7 +132,7 @@ TerminalBlockView::~TerminalBlockView()
     m_blockParts.clear();
 }
 
-void TerminalBlockView::setTerminalEmulator(TerminalEmulator *terminal)
+void TerminalBlockView::setTerminalEmulator(TerminalBackend *terminal)
 {
     if (m_terminal == terminal) {
         return;
@@ -147,7 +147,7 @@ void TerminalBlockView::setTerminalEmulator(TerminalEmulator *terminal)
     
     if (m_terminal) {
         // Connect signals from terminal
-        connect(m_terminal, &TerminalEmulator::redrawRequired, this, &TerminalBlockView::onTerminalRedrawRequired);
+        connect(m_terminal, &TerminalBackend::redrawRequired, this, &TerminalBlockView::onTerminalRedrawRequired);
     }
 }
 
@@ -176,10 +176,10 @@ void TerminalBlockView::setBlockModel(BlockModel *model)
         connect(m_model, &BlockModel::blockStateChanged, this, &TerminalBlockView::onBlockStateChanged);
         connect(m_model, &BlockModel::blockChanged, this, &TerminalBlockView::onBlockChanged);
         
-        // Create widgets for existing blocks
+        // Create widgets for existing blocks, with their outputs expanded
         QList<CommandBlock> blocks = m_model->blocks();
         for (const CommandBlock &block : blocks) {
-            QWidget *blockWidget = createBlockWidget(block);
+            QWidget *blockWidget = createBlockWidget(m_model->blockById(block.id));
             m_blockLayout->addWidget(blockWidget);
             m_blockWidgets.insert(block.id, blockWidget);
         }
@@ -192,7 +192,7 @@ void TerminalBlockView::setBlockModel(BlockModel *model)
     }
 }
 
-TerminalEmulator *TerminalBlockView::terminalEmulator() const
+TerminalBackend *TerminalBlockView::terminalEmulator() const
 {
     return m_terminal;
 }
@@ -24,7 +24,7 @@ class QKeyEvent;
 class QFocusEvent;
 class QContextMenuEvent;
 
-class TerminalEmulator;
+class TerminalBackend;
 class BlockModel;
 class CommandBlock;
 
@@ -32,7 +32,7 @@ class CommandBlock;
  * Terminal block view widget
  * 
  * This widget displays terminal content in a block-based view, similar to
- * Warp Terminal. It integrates with BlockModel and TerminalEmulator classes
+ * Warp Terminal. It integrates with BlockModel and TerminalBackend classes
  * to display command blocks and terminal output.
  */
 class TerminalBlockView : public QWidget
@@ -55,7 +55,7 @@ public:
      * Set the terminal emulator to use
      * @param terminal Terminal emulator
      */
-    void setTerminalEmulator(TerminalEmulator *terminal);
+    void setTerminalEmulator(TerminalBackend *terminal);
     
     /**
      * Set the block model to use
@@ -67,7 +67,7 @@ public:
      * Get the terminal emulator
      * @return Terminal emulator
      */
-    TerminalEmulator *terminalEmulator() const;
+    TerminalBackend *terminalEmulator() const;
     
     /**
      * Get the block model
@@ -252,7 +252,7 @@ Q_SIGNALS:
     void scrollPositionChanged(int position);
     
 private:
-    TerminalEmulator *m_terminal;                         ///< Terminal emulator
+    TerminalBackend *m_terminal;                          ///< Terminal backend
     BlockModel *m_model;                                  ///< Block model
     
     QScrollArea *m_scrollArea;                           ///< Scroll area for blocks
@@ -4,18 +4,26 @@
  */
 
 #include "terminalemulator.h"
+#include "environmentcache.h"
+#include "kittygraphics.h"
+#include "shellintegration.h"
+#include "shellmetadata.h"
 
 #include <QApplication>
 #include <QClipboard>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
+#include <QLocale>
+#include <QProcessEnvironment>
 #include <QRegularExpression>
 #include <QSocketNotifier>
+#include <QStandardPaths>
 
 // System includes for PTY handling
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <pwd.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -36,10 +44,46 @@
 #define BEL "\007"
 #define ST  "\033\\"
 
+// Predictions are only drawn once typing echo is slower than this (ms);
+// on a responsive shell the real echo arrives before the next frame anyway
+static const double PREDICTION_DISPLAY_LATENCY = 20.0;
+
+// Unconfirmed predictions are rolled back after this long (ms)
+static const int PREDICTION_TIMEOUT = 1000;
+
+// Most input written to the PTY per event loop pass, so large pastes
+// can't block the UI while the program is slow to read
+static const int INPUT_CHUNK_SIZE = 4096;
+static const int INPUT_WRITE_BUDGET = 64 * 1024;
+
+// Most output read from the PTY at once
+static const int OUTPUT_READ_SIZE = 4096;
+
+// Mouse motion reports are limited to one per frame (ms)
+static const int MOUSE_MOTION_INTERVAL = 16;
+
+// Escape sequences longer than this are garbage and dropped. OSC and other
+// string sequences get more room for titles, hyperlinks and clipboard data
+static const int MAX_ESCAPE_SEQUENCE_LENGTH = 256;
+static const int MAX_STRING_SEQUENCE_LENGTH = 64 * 1024;
+
+// An output chunk of at least this size with this share (percent) of
+// NULs, odd control bytes or invalid UTF-8 switches to binary mode
+static const int BINARY_MIN_CHUNK = 32;
+static const int BINARY_DENSITY_PERCENT = 10;
+
+// Binary mode ends after this much silence (ms)
+static const int BINARY_QUIET_TIMEOUT = 250;
+
+// Summary details kept from binary output (bytes)
+static const int BINARY_HEAD_SIZE = 16;
+static const int BINARY_TAIL_SIZE = 512;
+
 TerminalEmulator::TerminalEmulator(QWidget *parent)
-    : QObject(parent)
+    : TerminalBackend(parent)
     , m_ptyFd(-1)
     , m_ptyNotifier(nullptr)
+    , m_ptyWriteNotifier(nullptr)
     , m_shellPid(0)
     , m_lastExitCode(0)
     , m_commandExecuting(false)
@@ -59,6 +103,63 @@ TerminalEmulator::TerminalEmulator(QWidget *parent)
     m_parsingEscapeSequence = false;
     m_newLineMode = false;
     
+    // Predictive echo stays off until the view enables it
+    m_predictiveEchoEnabled = false;
+    m_trustedPredictionRow = -1;
+    m_atShellPrompt = false;
+    m_echoLatency = 0.0;
+    m_predictionClock.start();
+    m_predictionTimeout.setSingleShot(true);
+    m_predictionTimeout.setInterval(PREDICTION_TIMEOUT);
+    connect(&m_predictionTimeout, &QTimer::timeout, this, [this]() {
+        // The echo never came; stop trusting this row
+        m_trustedPredictionRow = -1;
+        rollbackPredictions();
+    });
+    
+    // No mouse reporting until the program asks for it
+    m_mouseTrackingMode = MouseTrackingOff;
+    m_sgrMouseEncoding = false;
+    m_mouseButtonDown = Qt::NoButton;
+    m_lastMouseCell = QPoint(-1, -1);
+    m_mouseMotionTimer.setSingleShot(true);
+    m_mouseMotionTimer.setInterval(MOUSE_MOTION_INTERVAL);
+    connect(&m_mouseMotionTimer, &QTimer::timeout, this, &TerminalEmulator::flushMouseMotion);
+    
+    // Shell integration is off until the view enables it
+    m_shellIntegrationEnabled = false;
+    m_profileShellStartup = false;
+    
+    // Commands reported by the integration scripts, out of band
+    m_metadata = new ShellMetadataChannel(this);
+    connect(m_metadata, &ShellMetadataChannel::commandStarted, this, &TerminalEmulator::onShellCommandStarted);
+    connect(m_metadata, &ShellMetadataChannel::commandFinished, this, &TerminalEmulator::onShellCommandFinished);
+    connect(m_metadata, &ShellMetadataChannel::directoryChanged, this, [this](const QString &directory) {
+        m_workingDirectory = directory;
+        Q_EMIT workingDirectoryChanged(directory);
+        Q_EMIT workingDirectoryReported(directory);
+    });
+    
+    // Binary output detection
+    m_binaryOutputMode = false;
+    m_binaryByteCount = 0;
+    m_binaryQuietTimer.setSingleShot(true);
+    m_binaryQuietTimer.setInterval(BINARY_QUIET_TIMEOUT);
+    connect(&m_binaryQuietTimer, &QTimer::timeout, this, &TerminalEmulator::leaveBinaryMode);
+    
+    // Kitty graphics: replies go to the program, decoded images need a repaint
+    m_graphics = new KittyGraphics(this);
+    connect(m_graphics, &KittyGraphics::responseReady, this, [this](const QByteArray &response) {
+        // Only a graphics-aware program expects a reply; the shell would read it as typed input
+        if (!isShellInForeground()) {
+            writeToShell(response);
+        }
+    });
+    connect(m_graphics, &KittyGraphics::changed, this, [this]() {
+        markAllDamaged();
+        Q_EMIT redrawRequired();
+    });
+    
     // Default colors
     m_defaultForeground = Qt::white;
     m_defaultBackground = Qt::black;
@@ -107,6 +208,11 @@ TerminalEmulator::~TerminalEmulator()
         m_ptyNotifier = nullptr;
     }
     
+    if (m_ptyWriteNotifier) {
+        delete m_ptyWriteNotifier;
+        m_ptyWriteNotifier = nullptr;
+    }
+    
     // Close PTY
     if (m_ptyFd >= 0) {
         ::close(m_ptyFd);
@@ -118,6 +224,11 @@ TerminalEmulator::~TerminalEmulator()
         ::kill(m_shellPid, SIGTERM);
         m_shellPid = 0;
     }
+    
+    // Free the screens with the rest of the session's memory
+    m_screen.clear();
+    m_alternateScreen.clear();
+    m_arena.release();
 }
 
 bool TerminalEmulator::initialize(int rows, int cols)
@@ -153,6 +264,9 @@ bool TerminalEmulator::initialize(int rows, int cols)
     // Start cursor blinking
     m_cursorBlinkTimer.start(500);
     
+    // Everything needs painting initially
+    markAllDamaged();
+    
     m_initialized = true;
     return true;
 }
@@ -164,6 +278,9 @@ bool TerminalEmulator::startShell(const QString &shellCommand, const QString &in
         return true;
     }
     
+    // A new shell has not shown its prompt yet
+    m_atShellPrompt = false;
+    
     // Get default shell if none specified
     QString shell = shellCommand;
     if (shell.isEmpty()) {
@@ -192,12 +309,79 @@ bool TerminalEmulator::startShell(const QString &shellCommand, const QString &in
     m_shellCommand = shell;
     m_workingDirectory = workingDir;
     
+    QString program = shell.section(QLatin1Char(' '), 0, 0);
+    
+    // Integration hooks for OSC 133 prompt marks, and the startup trace
+    ShellIntegration::Launch integration;
+    if (m_shellIntegrationEnabled) {
+        QString userZdotdir = QString::fromLocal8Bit(qgetenv("ZDOTDIR"));
+        integration = ShellIntegration::prepare(program, m_profileShellStartup,
+                                                userZdotdir.isEmpty() ? QDir::homePath() : userZdotdir);
+    }
+    m_startupTracePath = integration.tracePath;
+    
+    // The integration script runs the startup command; without it, it is typed
+    QString startupCommand = m_startupCommand;
+    m_startupCommand.clear();
+    bool integrated = !integration.arguments.isEmpty() || !integration.environment.isEmpty();
+    if (integrated && !startupCommand.isEmpty()) {
+        integration.environment << QStringLiteral("WARPKATE_STARTUP_COMMAND=") + startupCommand;
+        startupCommand.clear();
+    }
+    
+    // The scripts write command records to this pipe; the shell inherits the write end
+    int metadataFd = -1;
+    if (integrated) {
+        metadataFd = m_metadata->open();
+        if (metadataFd >= 0) {
+            integration.environment << QStringLiteral("WARPKATE_META_FD=%1").arg(metadataFd);
+        }
+    }
+    
+    QVector<QByteArray> integrationArguments;
+    QVector<QByteArray> integrationEnvironment;
+    for (const QString &argument : std::as_const(integration.arguments)) {
+        integrationArguments.append(argument.toUtf8());
+    }
+    for (const QString &variable : std::as_const(integration.environment)) {
+        integrationEnvironment.append(variable.toUtf8());
+    }
+    
+    // Environment changes are applied on top of the inherited environment.
+    // Build it before forking; execve doesn't search PATH, so resolve the
+    // shell here too
+    QVector<QByteArray> environmentData;
+    QVector<char*> environmentPointers;
+    QByteArray shellPath;
+    if (!m_shellEnvironment.isEmpty()) {
+        QProcessEnvironment environment = EnvironmentCache::applyChanges(QProcessEnvironment::systemEnvironment(), m_shellEnvironment);
+        environment.insert(QStringLiteral("TERM"), QStringLiteral("xterm-256color"));
+        
+        // Inserted, not appended, so a cached ZDOTDIR can't leave a duplicate key
+        for (const QString &variable : std::as_const(integration.environment)) {
+            environment.insert(variable.section(QLatin1Char('='), 0, 0), variable.section(QLatin1Char('='), 1));
+        }
+        
+        const QStringList variables = environment.toStringList();
+        for (const QString &variable : variables) {
+            environmentData.append(variable.toUtf8());
+        }
+        
+        for (QByteArray &variable : environmentData) {
+            environmentPointers.append(variable.data());
+        }
+        environmentPointers.append(nullptr);
+        
+        shellPath = (QDir::isAbsolutePath(program) ? program : QStandardPaths::findExecutable(program)).toUtf8();
+    }
+    
     // Open a pseudo-terminal
     int master, slave;
     char ptyName[100];
     
     if (openpty(&master, &slave, ptyName, nullptr, nullptr) == -1) {
         qWarning() << "Failed to open pseudo-terminal:" << strerror(errno);
+        m_metadata->close();
         return false;
     }
     
@@ -207,6 +391,7 @@ bool TerminalEmulator::startShell(const QString &shellCommand, const QString &in
         qWarning() << "Failed to fork process:" << strerror(errno);
         ::close(master);
         ::close(slave);
+        m_metadata->close();
         return false;
     }
     
@@ -232,6 +417,11 @@ bool TerminalEmulator::startShell(const QString &shellCommand, const QString &in
             ::close(slave);
         }
         
+        // Keep the metadata pipe open across exec
+        if (metadataFd >= 0) {
+            fcntl(metadataFd, F_SETFD, 0);
+        }
+        
         // Change to requested working directory
         if (chdir(workingDir.toUtf8().constData()) == -1) {
             qWarning() << "Failed to change directory to" << workingDir;
@@ -240,6 +430,9 @@ bool TerminalEmulator::startShell(const QString &shellCommand, const QString &in
         
         // Set environment variables
         setenv("TERM", "xterm-256color", 1);
+        for (QByteArray &variable : integrationEnvironment) {
+            putenv(variable.data());
+        }
         
         // Execute the shell
         QStringList shellParts = shell.split(QLatin1Char(' '));
@@ -249,6 +442,11 @@ bool TerminalEmulator::startShell(const QString &shellCommand, const QString &in
         QByteArray shellProgramBytes = shellProgram.toUtf8();
         args.append(shellProgramBytes.data());
         
+        // Integration options (e.g. --rcfile) must precede the shell's own
+        for (QByteArray &argument : integrationArguments) {
+            args.append(argument.data());
+        }
+        
         QVector<QByteArray> argBytes;
         for (const QString &arg : shellParts) {
             argBytes.append(arg.toUtf8());
@@ -259,7 +457,11 @@ bool TerminalEmulator::startShell(const QString &shellCommand, const QString &in
         args.append(nullptr);
         
         // Execute shell
-        execvp(shellProgramBytes.constData(), args.data());
+        if (!environmentPointers.isEmpty() && !shellPath.isEmpty()) {
+            execve(shellPath.constData(), args.data(), environmentPointers.data());
+        } else {
+            execvp(shellProgramBytes.constData(), args.data());
+        }
         
         // If we get here, exec failed
         fprintf(stderr, "exec failed: %s\n", strerror(errno));
@@ -271,6 +473,9 @@ bool TerminalEmulator::startShell(const QString &shellCommand, const QString &in
     // Close slave side
     ::close(slave);
     
+    // Only the shell writes metadata
+    m_metadata->closeWriteEnd();
+    
     // Store master file descriptor and shell PID
     m_ptyFd = master;
     m_shellPid = pid;
@@ -283,15 +488,74 @@ bool TerminalEmulator::startShell(const QString &shellCommand, const QString &in
     m_ptyNotifier = new QSocketNotifier(m_ptyFd, QSocketNotifier::Read, this);
     connect(m_ptyNotifier, &QSocketNotifier::activated, this, &TerminalEmulator::readFromShell);
     
+    // And for input the PTY couldn't take right away
+    m_pendingInput.clear();
+    m_ptyWriteNotifier = new QSocketNotifier(m_ptyFd, QSocketNotifier::Write, this);
+    m_ptyWriteNotifier->setEnabled(false);
+    connect(m_ptyWriteNotifier, &QSocketNotifier::activated, this, &TerminalEmulator::flushPendingInput);
+    
     // Set terminal size
     resize(m_terminalSize.height(), m_terminalSize.width());
     
     // Set flag
     m_busy = true;
     
+    // Raw, so it is neither a tracked command nor detected as one
+    if (!startupCommand.isEmpty()) {
+        writeToShell(QByteArray(" ") + startupCommand.toUtf8() + '\r');
+    }
+    
     return true;
 }
 
+void TerminalEmulator::setShellEnvironment(const QStringList &environment)
+{
+    m_shellEnvironment = environment;
+}
+
+void TerminalEmulator::setStartupCommand(const QString &command)
+{
+    m_startupCommand = command;
+}
+
+void TerminalEmulator::setShellIntegrationEnabled(bool enabled)
+{
+    m_shellIntegrationEnabled = enabled;
+}
+
+void TerminalEmulator::setProfileShellStartup(bool enabled)
+{
+    m_profileShellStartup = enabled;
+}
+
+QString TerminalEmulator::startupTracePath() const
+{
+    return m_startupTracePath;
+}
+
+ShellCommandRecord TerminalEmulator::lastCommandRecord() const
+{
+    return m_lastCommandRecord;
+}
+
+QProcessEnvironment TerminalEmulator::exportedEnvironment() const
+{
+    QProcessEnvironment environment;
+    if (!m_metadata->isActive()) {
+        return environment;
+    }
+    const QHash<QString, QString> variables = m_metadata->environment();
+    for (auto it = variables.constBegin(); it != variables.constEnd(); ++it) {
+        environment.insert(it.key(), it.value());
+    }
+    return environment;
+}
+
+bool TerminalEmulator::runsAsProgram(const QString &name) const
+{
+    return m_metadata->isActive() && !m_metadata->definesCommand(name);
+}
+
 void TerminalEmulator::resize(int rows, int cols)
 {
     // Update size
@@ -361,6 +625,9 @@ void TerminalEmulator::resize(int rows, int cols)
     m_scrollRegionTop = qMin(m_scrollRegionTop, rows - 1);
     m_scrollRegionBottom = qMin(m_scrollRegionBottom, rows - 1);
     
+    // Every row has to be repainted at the new size
+    markAllDamaged();
+    
     // Update PTY size
     if (m_ptyFd >= 0) {
         struct winsize size;
@@ -391,9 +658,9 @@ void TerminalEmulator::processInput(const QString &text)
     // Handle bracketed paste mode
     if (m_bracketedPasteMode && data.length() > 0) {
         QByteArray bracketedData = QByteArray(CSI) + "200~" + data + QByteArray(CSI) + "201~";
-        ::write(m_ptyFd, bracketedData.constData(), bracketedData.length());
+        writeToShell(bracketedData);
     } else {
-        ::write(m_ptyFd, data.constData(), data.length());
+        writeToShell(data);
     }
     
     // Detect command
@@ -406,6 +673,9 @@ void TerminalEmulator::processKeyPress(int key, Qt::KeyboardModifiers modifiers,
         return;
     }
     
+    // Show the echo before the shell gets a chance to
+    predictKeyEcho(key, modifiers, text);
+    
     // Handle special keys with appropriate escape sequences
     QByteArray data;
     
@@ -558,9 +828,7 @@ void TerminalEmulator::processKeyPress(int key, Qt::KeyboardModifiers modifiers,
     }
     
     // Send the key to the PTY
-    if (!data.isEmpty()) {
-        ::write(m_ptyFd, data.constData(), data.length());
-    }
+    writeToShell(data);
     
     // Detect command
     m_commandDetectionTimer.start(100);
@@ -574,13 +842,14 @@ void TerminalEmulator::executeCommand(const QString &command, bool addNewline)
     
     // Write command to the PTY
     QByteArray data = command.toUtf8();
-    ::write(m_ptyFd, data.constData(), data.length());
     
     // Add newline if requested
     if (addNewline) {
-        ::write(m_ptyFd, "\r", 1);
+        data.append('\r');
     }
     
+    writeToShell(data);
+    
     // Record command start
     m_currentCommand = command;
     m_commandExecuting = true;
@@ -601,21 +870,30 @@ void TerminalEmulator::readFromShell()
     }
     
     // Read data from the PTY
-    char buffer[4096];
+    char buffer[OUTPUT_READ_SIZE];
     ssize_t bytesRead = ::read(m_ptyFd, buffer, sizeof(buffer));
     
     if (bytesRead > 0) {
-        // Process the data
         QByteArray data = QByteArray::fromRawData(buffer, bytesRead);
+        
+        // Binary dumps are counted, not parsed
+        if (filterBinaryOutput(data)) {
+            return;
+        }
+        
+        // Process the data
         processOutputData(data);
         
+        // Decode once for both the command output and the signal
+        QString text = QString::fromUtf8(data);
+        
         // Accumulate output if a command is executing
         if (m_commandExecuting) {
-            m_currentOutput.append(QString::fromUtf8(data));
+            m_currentOutput.append(text);
         }
         
         // Emit signal for raw output
-        Q_EMIT outputAvailable(QString::fromUtf8(data));
+        Q_EMIT outputAvailable(text);
         
         // Schedule command detection
         m_commandDetectionTimer.start(100);
@@ -630,11 +908,19 @@ void TerminalEmulator::readFromShell()
             m_ptyNotifier->setEnabled(false);
         }
         
+        if (m_ptyWriteNotifier) {
+            m_ptyWriteNotifier->setEnabled(false);
+        }
+        
         if (m_ptyFd >= 0) {
             ::close(m_ptyFd);
             m_ptyFd = -1;
         }
         
+        // Spare lines and batch memory go back to the system
+        m_arena.release();
+        m_metadata->close();
+        
         Q_EMIT shellFinished(m_lastExitCode);
     }
 }
@@ -650,13 +936,23 @@ void TerminalEmulator::processOutputData(const QByteArray &data)
             m_escapeBuffer.append(ch);
             
             // Check if the sequence is complete
-            if (isEscapeSequenceFinal(ch)) {
+            if (isEscapeSequenceComplete(m_escapeBuffer)) {
                 // Process the entire escape sequence
                 processEscapeSequence(m_escapeBuffer);
                 
-                // Reset for next sequence
-                m_escapeBuffer.clear();
+                // Reset for next sequence, keeping the buffer
+                m_escapeBuffer.truncate(0);
                 m_parsingEscapeSequence = false;
+            } else {
+                // Never let an unterminated sequence grow without bound
+                char type = m_escapeBuffer[1];
+                bool stringSequence = type == ']' || type == 'P' || type == '_' || type == '^';
+                int limit = stringSequence ? MAX_STRING_SEQUENCE_LENGTH : MAX_ESCAPE_SEQUENCE_LENGTH;
+                if (m_escapeBuffer.size() > limit) {
+                    qDebug() << "Dropping overlong escape sequence of" << m_escapeBuffer.size() << "bytes";
+                    m_escapeBuffer.clear();
+                    m_parsingEscapeSequence = false;
+                }
             }
             continue;
         }
@@ -665,7 +961,7 @@ void TerminalEmulator::processOutputData(const QByteArray &data)
         switch (ch) {
             case '\033': // ESC
                 // Start of an escape sequence
-                m_escapeBuffer.clear();
+                m_escapeBuffer.truncate(0);
                 m_escapeBuffer.append(ch);
                 m_parsingEscapeSequence = true;
                 break;
@@ -727,6 +1023,9 @@ void TerminalEmulator::processOutputData(const QByteArray &data)
         }
     }
     
+    // Temporaries of this batch are no longer referenced
+    m_arena.resetBatch();
+    
     // Trigger redraw
     Q_EMIT redrawRequired();
 }
@@ -746,6 +1045,9 @@ int TerminalEmulator::processEscapeSequence(const QByteArray &sequence)
             case ']': // OSC - Operating System Command
                 return processOSC(sequence);
                 
+            case '_': // APC - Application Program Command
+                return processAPC(sequence);
+                
             case 'D': // IND - Index (line feed)
                 setCursorPositionInternal(m_cursorPosition.x(), m_cursorPosition.y() + 1);
                 return 2;
@@ -760,7 +1062,11 @@ int TerminalEmulator::processEscapeSequence(const QByteArray &sequence)
                 
             case 'c': // RIS - Reset to Initial State
                 clear();
+                m_graphics->reset();
                 m_currentFormat = TerminalCharFormat();
+                m_mouseTrackingMode = MouseTrackingOff;
+                m_sgrMouseEncoding = false;
+                m_pendingMouseMotion.clear();
                 setCursorPositionInternal(0, 0);
                 return 2;
                 
@@ -809,13 +1115,13 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
     char finalByte = sequence[finalBytePos];
     
     // Parse parameters
-    QList<int> parameters = parseParameters(sequence, 2, finalBytePos - 2);
+    std::pmr::vector<int> parameters = parseParameters(sequence, 2, finalBytePos - 2);
     
     // Handle the sequence based on the final byte
     switch (finalByte) {
         case 'A': // CUU - Cursor Up
         {
-            int n = parameters.isEmpty() ? 1 : parameters[0];
+            int n = parameters.empty() ? 1 : parameters[0];
             if (n < 1) n = 1;
             setCursorPositionInternal(m_cursorPosition.x(), m_cursorPosition.y() - n);
             break;
@@ -823,7 +1129,7 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
         
         case 'B': // CUD - Cursor Down
         {
-            int n = parameters.isEmpty() ? 1 : parameters[0];
+            int n = parameters.empty() ? 1 : parameters[0];
             if (n < 1) n = 1;
             setCursorPositionInternal(m_cursorPosition.x(), m_cursorPosition.y() + n);
             break;
@@ -831,7 +1137,7 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
         
         case 'C': // CUF - Cursor Forward
         {
-            int n = parameters.isEmpty() ? 1 : parameters[0];
+            int n = parameters.empty() ? 1 : parameters[0];
             if (n < 1) n = 1;
             setCursorPositionInternal(m_cursorPosition.x() + n, m_cursorPosition.y());
             break;
@@ -839,7 +1145,7 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
         
         case 'D': // CUB - Cursor Backward
         {
-            int n = parameters.isEmpty() ? 1 : parameters[0];
+            int n = parameters.empty() ? 1 : parameters[0];
             if (n < 1) n = 1;
             setCursorPositionInternal(m_cursorPosition.x() - n, m_cursorPosition.y());
             break;
@@ -847,7 +1153,7 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
         
         case 'E': // CNL - Cursor Next Line
         {
-            int n = parameters.isEmpty() ? 1 : parameters[0];
+            int n = parameters.empty() ? 1 : parameters[0];
             if (n < 1) n = 1;
             setCursorPositionInternal(0, m_cursorPosition.y() + n);
             break;
@@ -855,7 +1161,7 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
         
         case 'F': // CPL - Cursor Previous Line
         {
-            int n = parameters.isEmpty() ? 1 : parameters[0];
+            int n = parameters.empty() ? 1 : parameters[0];
             if (n < 1) n = 1;
             setCursorPositionInternal(0, m_cursorPosition.y() - n);
             break;
@@ -863,7 +1169,7 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
         
         case 'G': // CHA - Cursor Horizontal Absolute
         {
-            int n = parameters.isEmpty() ? 1 : parameters[0];
+            int n = parameters.empty() ? 1 : parameters[0];
             if (n < 1) n = 1;
             setCursorPositionInternal(n - 1, m_cursorPosition.y());
             break;
@@ -872,7 +1178,7 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
         case 'H': // CUP - Cursor Position
         case 'f': // HVP - Horizontal and Vertical Position
         {
-            int row = parameters.isEmpty() ? 1 : parameters[0];
+            int row = parameters.empty() ? 1 : parameters[0];
             int col = parameters.size() < 2 ? 1 : parameters[1];
             if (row < 1) row = 1;
             if (col < 1) col = 1;
@@ -882,8 +1188,9 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
         
         case 'J': // ED - Erase Display
         {
-            int mode = parameters.isEmpty() ? 0 : parameters[0];
+            int mode = parameters.empty() ? 0 : parameters[0];
             QVector<TerminalLine> &activeScreen = m_alternateScreenActive ? m_alternateScreen : m_screen;
+            markAllDamaged();
             
             switch (mode) {
                 case 0: // From cursor to end of screen
@@ -941,6 +1248,7 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
                             clearLine[x] = TerminalCell(QChar(QLatin1Char(' ')), m_currentFormat);
                         }
                     }
+                    m_graphics->clearPlacements(m_alternateScreenActive);
                     break;
             }
             break;
@@ -948,7 +1256,7 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
         
         case 'K': // EL - Erase in Line
         {
-            int mode = parameters.isEmpty() ? 0 : parameters[0];
+            int mode = parameters.empty() ? 0 : parameters[0];
             QVector<TerminalLine> &activeScreen = m_alternateScreenActive ? m_alternateScreen : m_screen;
             int currentY = m_cursorPosition.y();
             
@@ -958,6 +1266,7 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
             
             TerminalLine &line = activeScreen[currentY];
             int currentX = m_cursorPosition.x();
+            markDamaged(currentY, currentY);
             
             switch (mode) {
                 case 0: // From cursor to end of line
@@ -988,7 +1297,7 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
         case 'r': // DECSTBM - Set Top and Bottom Margins
         {
             // Set scrolling region
-            int top = parameters.isEmpty() ? 1 : parameters[0];
+            int top = parameters.empty() ? 1 : parameters[0];
             int bottom = parameters.size() < 2 ? m_terminalSize.height() : parameters[1];
             
             // Convert from 1-based to 0-based
@@ -1026,9 +1335,9 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
             
             // Get the mode number
             int modeOffset = isPrivateMode ? 3 : 2;
-            QList<int> modeParams = parseParameters(sequence, modeOffset, finalBytePos - modeOffset);
+            std::pmr::vector<int> modeParams = parseParameters(sequence, modeOffset, finalBytePos - modeOffset);
             
-            if (modeParams.isEmpty()) {
+            if (modeParams.empty()) {
                 break;
             }
             
@@ -1060,7 +1369,12 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
                         case 47: // Alternate Screen Buffer
                         case 1047:
                             if (set != m_alternateScreenActive) {
+                                if (!set) {
+                                    m_graphics->clearPlacements(true);
+                                }
                                 m_alternateScreenActive = set;
+                                markAllDamaged();
+                                Q_EMIT alternateScreenChanged(m_alternateScreenActive);
                                 // Reset cursor position when switching screens
                                 setCursorPositionInternal(0, 0);
                             }
@@ -1084,12 +1398,17 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
                                 
                                 // Switch to alternate screen
                                 m_alternateScreenActive = true;
+                                markAllDamaged();
+                                Q_EMIT alternateScreenChanged(true);
                                 
                                 // Reset cursor position
                                 setCursorPositionInternal(0, 0);
                             } else {
-                                // Switch back to normal screen
+                                // Switch back to normal screen, dropping the alternate screen's images
+                                m_graphics->clearPlacements(true);
                                 m_alternateScreenActive = false;
+                                markAllDamaged();
+                                Q_EMIT alternateScreenChanged(false);
                                 
                                 // Restore cursor position
                                 m_cursorPosition = m_savedCursorPosition;
@@ -1097,6 +1416,22 @@ int TerminalEmulator::processCSI(const QByteArray &sequence)
                             }
                             break;
                             
+                        case 1000: // Mouse press/release reporting
+                        case 1002: // ... plus motion while a button is held
+                        case 1003: // ... plus all motion
+                            if (set) {
+                                m_mouseTrackingMode = static_cast<MouseTrackingMode>(mode);
+                            } else if (m_mouseTrackingMode == mode) {
+                                m_mouseTrackingMode = MouseTrackingOff;
+                            }
+                            m_mouseButtonDown = Qt::NoButton;
+                            m_pendingMouseMotion.clear();
+                            break;
+                            
+                        case 1006: // SGR mouse encoding
+                            m_sgrMouseEncoding = set;
+                            break;
+                            
                         case 2004: // Bracketed paste mode
                             m_bracketedPasteMode = set;
                             break;
@@ -1184,6 +1519,19 @@ int TerminalEmulator::processOSC(const QByteArray &sequence)
         case 7: // Set current directory for shell integration
             m_workingDirectory = param;
             Q_EMIT workingDirectoryChanged(m_workingDirectory);
+            Q_EMIT workingDirectoryReported(m_workingDirectory);
+            break;
+            
+        case 133: // Semantic prompt marks (FinalTerm): A prompt, B input, C output, D;<exit> done
+            if (!param.isEmpty()) {
+                // The line editor owns the input from the prompt until the command runs
+                if (param.at(0) == QLatin1Char('A')) {
+                    m_atShellPrompt = true;
+                } else if (param.at(0) == QLatin1Char('C') || param.at(0) == QLatin1Char('D')) {
+                    m_atShellPrompt = false;
+                }
+                Q_EMIT semanticPromptMark(param.at(0), param.section(QLatin1Char(';'), 1));
+            }
             break;
             
         default:
@@ -1194,10 +1542,47 @@ int TerminalEmulator::processOSC(const QByteArray &sequence)
     return endPos + 1;
 }
 
-void TerminalEmulator::processSGR(const QList<int> &parameters)
+int TerminalEmulator::processAPC(const QByteArray &sequence)
+{
+    // Terminated by BEL or ST, see isEscapeSequenceComplete()
+    int terminatorLength = sequence.endsWith('\a') ? 1 : 2;
+    QByteArray payload = sequence.mid(2, sequence.size() - 2 - terminatorLength);
+    
+    // Only the kitty graphics protocol uses APC here: ESC _ G <keys> ; <data> ST
+    if (!payload.startsWith('G')) {
+        qDebug() << "Unhandled APC sequence:" << payload.left(16);
+        return sequence.size();
+    }
+    
+    QPoint cursor = m_cursorPosition;
+    m_graphics->processCommand(payload.mid(1), &cursor, m_alternateScreenActive);
+    
+    // Displayed images move the cursor past them, scrolling if needed
+    if (cursor != m_cursorPosition) {
+        if (cursor.y() > m_scrollRegionBottom) {
+            scrollScreen(cursor.y() - m_scrollRegionBottom);
+            cursor.setY(m_scrollRegionBottom);
+        }
+        setCursorPositionInternal(qMin(cursor.x(), m_terminalSize.width() - 1), cursor.y());
+    }
+    
+    return sequence.size();
+}
+
+void TerminalEmulator::setCellPixelSize(const QSize &size)
+{
+    m_graphics->setCellSize(size);
+}
+
+KittyGraphics *TerminalEmulator::graphics() const
+{
+    return m_graphics;
+}
+
+void TerminalEmulator::processSGR(const std::pmr::vector<int> &parameters)
 {
     // If no parameters, reset attributes
-    if (parameters.isEmpty()) {
+    if (parameters.empty()) {
         m_currentFormat = TerminalCharFormat();
         m_currentFormat.foreground = m_defaultForeground;
         m_currentFormat.background = m_defaultBackground;
@@ -1205,7 +1590,8 @@ void TerminalEmulator::processSGR(const QList<int> &parameters)
     }
     
     // Process each parameter
-    for (int i = 0; i < parameters.size(); ++i) {
+    const int count = int(parameters.size());
+    for (int i = 0; i < count; ++i) {
         int param = parameters[i];
         
         switch (param) {
@@ -1292,7 +1678,7 @@ void TerminalEmulator::processSGR(const QList<int> &parameters)
                 break;
                 
             case 38: // Extended foreground color
-                if (i + 2 < parameters.size() && parameters[i + 1] == 5) {
+                if (i + 2 < count && parameters[i + 1] == 5) {
                     // 8-bit color (256 colors)
                     int colorCode = parameters[i + 2];
                     if (m_colorPalette.contains(colorCode)) {
@@ -1316,7 +1702,7 @@ void TerminalEmulator::processSGR(const QList<int> &parameters)
                         }
                     }
                     i += 2; // Skip the next two parameters
-                } else if (i + 4 < parameters.size() && parameters[i + 1] == 2) {
+                } else if (i + 4 < count && parameters[i + 1] == 2) {
                     // 24-bit color (RGB)
                     int r = parameters[i + 2];
                     int g = parameters[i + 3];
@@ -1342,7 +1728,7 @@ void TerminalEmulator::processSGR(const QList<int> &parameters)
                 break;
                 
             case 48: // Extended background color
-                if (i + 2 < parameters.size() && parameters[i + 1] == 5) {
+                if (i + 2 < count && parameters[i + 1] == 5) {
                     // 8-bit color (256 colors)
                     int colorCode = parameters[i + 2];
                     if (m_colorPalette.contains(colorCode)) {
@@ -1366,7 +1752,7 @@ void TerminalEmulator::processSGR(const QList<int> &parameters)
                         }
                     }
                     i += 2; // Skip the next two parameters
-                } else if (i + 4 < parameters.size() && parameters[i + 1] == 2) {
+                } else if (i + 4 < count && parameters[i + 1] == 2) {
                     // 24-bit color (RGB)
                     int r = parameters[i + 2];
                     int g = parameters[i + 3];
@@ -1419,6 +1805,11 @@ void TerminalEmulator::putCharacter(QChar ch)
         return;
     }
     
+    // Real output confirms or contradicts predicted echo
+    if (!m_predictions.isEmpty()) {
+        checkPredictedEcho(ch);
+    }
+    
     // Get the current line
     TerminalLine &currentLine = activeScreen[m_cursorPosition.y()];
     
@@ -1432,6 +1823,7 @@ void TerminalEmulator::putCharacter(QChar ch)
     
     // Put the character at the cursor position
     currentLine[m_cursorPosition.x()] = TerminalCell(ch, m_currentFormat);
+    markDamaged(m_cursorPosition.y(), m_cursorPosition.y());
     
     // Move cursor to the next position
     if (m_cursorPosition.x() + 1 >= m_terminalSize.width()) {
@@ -1486,12 +1878,18 @@ void TerminalEmulator::scrollScreen(int lines)
         return;
     }
     
+    // Every row inside the scroll region moves, images included
+    markDamaged(m_scrollRegionTop, m_scrollRegionBottom);
+    m_graphics->scroll(m_scrollRegionTop, m_scrollRegionBottom, lines, m_alternateScreenActive);
+    
     // Scroll up (positive lines) or down (negative lines)
     if (lines > 0) {
         // Scroll up - remove lines from top, add new lines at bottom
         for (int i = 0; i < lines; ++i) {
             if (m_scrollRegionTop < m_scrollRegionBottom) {
-                // Remove line from the top of the scroll region
+                // Remove line from the top of the scroll region,
+                // keeping its buffer for the blank line
+                m_arena.recycleLine(activeScreen[m_scrollRegionTop]);
                 activeScreen.removeAt(m_scrollRegionTop);
                 
                 // Add a new blank line at the bottom of the scroll region
@@ -1503,7 +1901,9 @@ void TerminalEmulator::scrollScreen(int lines)
         lines = -lines; // Make positive for loop
         for (int i = 0; i < lines; ++i) {
             if (m_scrollRegionTop < m_scrollRegionBottom) {
-                // Remove line from the bottom of the scroll region
+                // Remove line from the bottom of the scroll region,
+                // keeping its buffer for the blank line
+                m_arena.recycleLine(activeScreen[m_scrollRegionBottom]);
                 activeScreen.removeAt(m_scrollRegionBottom);
                 
                 // Add a new blank line at the top of the scroll region
@@ -1513,46 +1913,45 @@ void TerminalEmulator::scrollScreen(int lines)
     }
 }
 
-TerminalLine TerminalEmulator::createBlankLine() const
+TerminalLine TerminalEmulator::createBlankLine()
 {
     // Create a new line filled with spaces
-    TerminalLine line;
-    line.reserve(m_terminalSize.width());
-    
-    for (int i = 0; i < m_terminalSize.width(); ++i) {
-        line.append(TerminalCell(QChar(QLatin1Char(' ')), m_currentFormat));
-    }
-    
-    return line;
+    return m_arena.takeLine(m_terminalSize.width(), TerminalCell(QChar(QLatin1Char(' ')), m_currentFormat));
 }
 
-QList<int> TerminalEmulator::parseParameters(const QByteArray &sequence, int start, int length)
+std::pmr::vector<int> TerminalEmulator::parseParameters(const QByteArray &sequence, int start, int length)
 {
-    QList<int> result;
+    // Nearly every color change is a CSI sequence, so parse in place into
+    // the batch arena instead of splitting into temporary byte arrays
+    std::pmr::vector<int> result(m_arena.batchResource());
     
     // Adjust length if needed
-    length = qMin(length, sequence.length() - start);
+    length = qMin(length, int(sequence.length()) - start);
     if (length <= 0) {
         return result;
     }
     
-    // Extract parameter substring
-    QByteArray params = sequence.mid(start, length);
-    
-    // Split by semicolons
-    QList<QByteArray> paramList = params.split(';');
-    
-    // Convert to integers
-    for (const QByteArray &param : paramList) {
-        bool ok;
-        int value = param.toInt(&ok);
-        
-        // If conversion failed, use default value 0
-        if (!ok) {
+    // Semicolon separated integers; empty or malformed ones count as 0
+    const char *data = sequence.constData() + start;
+    int value = 0;
+    bool hasDigits = false;
+    bool valid = true;
+    for (int i = 0; i <= length; ++i) {
+        if (i == length || data[i] == ';') {
+            result.push_back(valid && hasDigits ? value : 0);
             value = 0;
+            hasDigits = false;
+            valid = true;
+            continue;
         }
         
-        result.append(value);
+        char ch = data[i];
+        if (ch >= '0' && ch <= '9' && value <= (INT_MAX - 9) / 10) {
+            value = value * 10 + (ch - '0');
+            hasDigits = true;
+        } else {
+            valid = false;
+        }
     }
     
     return result;
@@ -1564,6 +1963,477 @@ bool TerminalEmulator::isEscapeSequenceFinal(char ch) const
     return (ch >= 0x40 && ch <= 0x7E);
 }
 
+bool TerminalEmulator::isEscapeSequenceComplete(const QByteArray &sequence) const
+{
+    if (sequence.size() < 2) {
+        return false;
+    }
+    
+    char type = sequence[1];
+    switch (type) {
+        case '[': // CSI - parameters and intermediates, then a final byte
+            return sequence.size() > 2 && isEscapeSequenceFinal(sequence.back());
+            
+        case ']': // OSC
+        case 'P': // DCS
+        case '_': // APC
+        case '^': // PM - strings terminated by BEL or ST
+            return sequence.endsWith('\a') || (sequence.size() > 3 && sequence.endsWith("\033\\"));
+            
+        default:
+            // Intermediate bytes (e.g. ESC ( B) are followed by one final byte
+            if (type >= 0x20 && type <= 0x2F) {
+                char last = sequence.back();
+                return sequence.size() > 2 && last >= 0x30 && last <= 0x7E;
+            }
+            return true;
+    }
+}
+
+int TerminalEmulator::countSuspiciousBytes(const QByteArray &data, int *lastSuspicious) const
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+    const int size = data.size();
+    int suspicious = 0;
+    *lastSuspicious = -1;
+    
+    int i = 0;
+    while (i < size) {
+        uchar c = bytes[i];
+        
+        if (c < 0x80) {
+            // NUL and C0 controls terminals and shells don't normally send
+            bool usual = c >= 0x20 || (c >= '\a' && c <= '\r') || c == 0x0E || c == 0x0F || c == 0x1B;
+            if (!usual) {
+                suspicious++;
+                *lastSuspicious = i;
+            }
+            i++;
+            continue;
+        }
+        
+        // Length of a well-formed UTF-8 sequence starting with this byte
+        int length = (c >= 0xC2 && c <= 0xDF) ? 2 : (c >= 0xE0 && c <= 0xEF) ? 3 : (c >= 0xF0 && c <= 0xF4) ? 4 : 0;
+        bool valid = length > 0 && i + length <= size;
+        for (int j = 1; valid && j < length; ++j) {
+            valid = (bytes[i + j] & 0xC0) == 0x80;
+        }
+        
+        if (valid) {
+            i += length;
+        } else {
+            suspicious++;
+            *lastSuspicious = i;
+            i++;
+        }
+    }
+    
+    return suspicious;
+}
+
+bool TerminalEmulator::filterBinaryOutput(const QByteArray &data)
+{
+    int lastSuspicious = -1;
+    int suspicious = countSuspiciousBytes(data, &lastSuspicious);
+    
+    if (!m_binaryOutputMode) {
+        if (data.size() < BINARY_MIN_CHUNK || suspicious * 100 < data.size() * BINARY_DENSITY_PERCENT) {
+            return false;
+        }
+        
+        qDebug() << "Binary output detected, suspending VT parsing";
+        m_binaryOutputMode = true;
+        m_binaryByteCount = 0;
+        m_binaryHead.clear();
+        
+        // Whatever sequence the binary started is meaningless
+        m_escapeBuffer.clear();
+        m_parsingEscapeSequence = false;
+    } else if (suspicious == 0) {
+        // Text again, summarize and let this chunk through
+        leaveBinaryMode();
+        return false;
+    }
+    
+    m_binaryByteCount += data.size();
+    if (m_binaryHead.size() < BINARY_HEAD_SIZE) {
+        m_binaryHead.append(data.left(BINARY_HEAD_SIZE - m_binaryHead.size()));
+    }
+    
+    // Clean bytes at the end may be the start of the next prompt
+    m_binaryTail = data.mid(lastSuspicious + 1).right(BINARY_TAIL_SIZE);
+    
+    m_binaryQuietTimer.start();
+    return true;
+}
+
+void TerminalEmulator::leaveBinaryMode()
+{
+    if (!m_binaryOutputMode) {
+        return;
+    }
+    
+    m_binaryOutputMode = false;
+    m_binaryQuietTimer.stop();
+    
+    QString summary = QStringLiteral("[binary output: %1 suppressed, starts with %2]")
+                          .arg(QLocale().formattedDataSize(m_binaryByteCount),
+                               QString::fromLatin1(m_binaryHead.toHex(' ')));
+    
+    // Print the summary on a fresh line with default attributes, then the
+    // clean tail that followed the binary data
+    m_currentFormat = TerminalCharFormat();
+    QByteArray data = "\r\n" + summary.toUtf8() + "\r\n" + m_binaryTail;
+    m_binaryHead.clear();
+    m_binaryTail.clear();
+    m_binaryByteCount = 0;
+    
+    processOutputData(data);
+    
+    if (m_commandExecuting) {
+        m_currentOutput.append(QString::fromUtf8(data));
+    }
+    
+    Q_EMIT outputAvailable(QString::fromUtf8(data));
+    m_commandDetectionTimer.start(100);
+}
+
+void TerminalEmulator::markDamaged(int firstLine, int lastLine)
+{
+    // Damage is tracked per row, always spanning the full width
+    QRect rows(0, firstLine, m_terminalSize.width(), lastLine - firstLine + 1);
+    m_damage = m_damage.isNull() ? rows : m_damage.united(rows);
+}
+
+void TerminalEmulator::markAllDamaged()
+{
+    markDamaged(0, m_terminalSize.height() - 1);
+}
+
+void TerminalEmulator::setPredictiveEchoEnabled(bool enabled)
+{
+    m_predictiveEchoEnabled = enabled;
+    if (!enabled) {
+        rollbackPredictions();
+    }
+}
+
+bool TerminalEmulator::isPredictiveEchoEnabled() const
+{
+    return m_predictiveEchoEnabled;
+}
+
+void TerminalEmulator::predictKeyEcho(int key, Qt::KeyboardModifiers modifiers, const QString &text)
+{
+    if (!m_predictiveEchoEnabled) {
+        return;
+    }
+    
+    // Backspace retracts the newest guess; the shell erases confirmed text itself
+    if (key == Qt::Key_Backspace) {
+        if (!m_predictions.isEmpty()) {
+            PredictedCell last = m_predictions.takeLast();
+            markDamaged(last.position.y(), last.position.y());
+            Q_EMIT redrawRequired();
+        }
+        return;
+    }
+    
+    // Anything that isn't a plain printable character makes the outcome unknown
+    bool printable = text.size() == 1 && text.at(0).isPrint()
+                     && !(modifiers & (Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier));
+    if (!printable) {
+        rollbackPredictions();
+        return;
+    }
+    
+    if (!canPredictEcho()) {
+        return;
+    }
+    
+    // Each guess goes right after the previous one, starting at the cursor
+    QPoint position = m_predictions.isEmpty() ? m_cursorPosition : m_predictions.last().position + QPoint(1, 0);
+    if (position.x() >= m_terminalSize.width() - 1) {
+        // Don't guess how the line wraps
+        return;
+    }
+    
+    m_predictions.append({position, text.at(0), m_predictionClock.elapsed()});
+    m_predictionTimeout.start();
+    
+    markDamaged(position.y(), position.y());
+    Q_EMIT redrawRequired();
+}
+
+bool TerminalEmulator::canPredictEcho() const
+{
+    // Full-screen programs draw whatever they like where the cursor is
+    if (m_alternateScreenActive || m_ptyFd < 0) {
+        return false;
+    }
+    
+    // getpass() style password prompts keep canonical mode but turn echo off.
+    // With echo on, the line discipline echoes each key where the cursor is
+    struct termios attributes;
+    if (tcgetattr(m_ptyFd, &attributes) == 0 && (attributes.c_lflag & ICANON)) {
+        return (attributes.c_lflag & ECHO) != 0;
+    }
+    
+    // readline and zle turn both off and echo themselves; at a marked prompt
+    // that is the typed character, anything else (completion, history) rolls back
+    if (m_atShellPrompt) {
+        return true;
+    }
+    
+    // Keep predicting on a row where echo was just confirmed
+    int row = m_predictions.isEmpty() ? m_cursorPosition.y() : m_predictions.last().position.y();
+    if (row == m_trustedPredictionRow) {
+        return true;
+    }
+    
+    // Otherwise only right after something that looks like a prompt
+    static const QRegularExpression promptEnd(QStringLiteral("[\\$#%>\\x{276F}]\\s$"));
+    QString beforeCursor = getLine(row).left(m_cursorPosition.x());
+    return m_promptRegex.match(beforeCursor).hasMatch() || promptEnd.match(beforeCursor).hasMatch();
+}
+
+void TerminalEmulator::checkPredictedEcho(QChar ch)
+{
+    const PredictedCell &front = m_predictions.first();
+    
+    if (front.position != m_cursorPosition) {
+        // Output overtaking the prediction on its row means the line was redrawn differently
+        if (m_cursorPosition.y() == front.position.y() && m_cursorPosition.x() > front.position.x()) {
+            rollbackPredictions();
+        }
+        return;
+    }
+    
+    if (front.character == ch) {
+        // Confirmed; keep a smoothed echo latency to decide whether guesses are worth drawing
+        qint64 latency = m_predictionClock.elapsed() - front.sentAt;
+        m_echoLatency = m_echoLatency * 0.8 + latency * 0.2;
+        m_trustedPredictionRow = front.position.y();
+        
+        m_predictions.removeFirst();
+        if (m_predictions.isEmpty()) {
+            m_predictionTimeout.stop();
+        }
+    } else {
+        // Misprediction, the program echoes differently than we guessed
+        m_trustedPredictionRow = -1;
+        rollbackPredictions();
+    }
+}
+
+void TerminalEmulator::rollbackPredictions()
+{
+    if (m_predictions.isEmpty()) {
+        return;
+    }
+    
+    for (const PredictedCell &prediction : std::as_const(m_predictions)) {
+        markDamaged(prediction.position.y(), prediction.position.y());
+    }
+    
+    m_predictions.clear();
+    m_predictionTimeout.stop();
+    Q_EMIT redrawRequired();
+}
+
+int TerminalEmulator::predictionAt(int x, int y) const
+{
+    // Predictions stay invisible while the real echo is fast enough
+    if (m_predictions.isEmpty() || m_echoLatency < PREDICTION_DISPLAY_LATENCY) {
+        return -1;
+    }
+    
+    for (int i = 0; i < m_predictions.size(); ++i) {
+        if (m_predictions[i].position == QPoint(x, y)) {
+            return i;
+        }
+    }
+    
+    return -1;
+}
+
+void TerminalEmulator::writeToShell(const QByteArray &data)
+{
+    if (m_ptyFd < 0 || data.isEmpty()) {
+        return;
+    }
+    
+    // Queue behind anything still pending to keep the order
+    m_pendingInput.append(data);
+    flushPendingInput();
+}
+
+void TerminalEmulator::flushPendingInput()
+{
+    int budget = INPUT_WRITE_BUDGET;
+    
+    while (!m_pendingInput.isEmpty() && m_ptyFd >= 0 && budget > 0) {
+        qsizetype chunk = qMin<qsizetype>(m_pendingInput.size(), qMin(INPUT_CHUNK_SIZE, budget));
+        ssize_t written = ::write(m_ptyFd, m_pendingInput.constData(), chunk);
+        
+        if (written > 0) {
+            m_pendingInput.remove(0, written);
+            budget -= int(written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // PTY is full, wait until the program reads
+            break;
+        } else {
+            qWarning() << "Error writing to shell:" << strerror(errno);
+            m_pendingInput.clear();
+        }
+    }
+    
+    // Continue from the event loop if anything is left
+    if (m_ptyWriteNotifier) {
+        m_ptyWriteNotifier->setEnabled(!m_pendingInput.isEmpty() && m_ptyFd >= 0);
+    }
+}
+
+bool TerminalEmulator::isMouseTrackingActive() const
+{
+    return m_mouseTrackingMode != MouseTrackingOff;
+}
+
+void TerminalEmulator::processMouseEvent(TerminalMouseAction action, Qt::MouseButton button,
+                                         Qt::KeyboardModifiers modifiers, const QPoint &cell)
+{
+    if (m_mouseTrackingMode == MouseTrackingOff || m_ptyFd < 0) {
+        return;
+    }
+    
+    // Drags can leave the widget, report them at the edge
+    QPoint position(qBound(0, cell.x(), m_terminalSize.width() - 1),
+                    qBound(0, cell.y(), m_terminalSize.height() - 1));
+    
+    // xterm button numbers
+    auto buttonNumber = [](Qt::MouseButton mouseButton) {
+        switch (mouseButton) {
+            case Qt::LeftButton:
+                return 0;
+            case Qt::MiddleButton:
+                return 1;
+            case Qt::RightButton:
+                return 2;
+            default:
+                return -1;
+        }
+    };
+    
+    int code = 0;
+    switch (action) {
+        case TerminalMouseAction::Press:
+        case TerminalMouseAction::Release:
+            code = buttonNumber(button);
+            if (code < 0) {
+                return;
+            }
+            break;
+            
+        case TerminalMouseAction::WheelUp:
+            code = 64;
+            break;
+            
+        case TerminalMouseAction::WheelDown:
+            code = 65;
+            break;
+            
+        case TerminalMouseAction::Move:
+            // 1000 wants no motion, 1002 only drags
+            if (m_mouseTrackingMode == MouseTrackingNormal
+                || (m_mouseTrackingMode == MouseTrackingButtonEvent && m_mouseButtonDown == Qt::NoButton)) {
+                return;
+            }
+            
+            // Moves within a cell tell the program nothing new
+            if (position == m_lastMouseCell) {
+                return;
+            }
+            
+            code = 32 + (m_mouseButtonDown == Qt::NoButton ? 3 : buttonNumber(m_mouseButtonDown));
+            break;
+    }
+    
+    // Modifier bits
+    if (modifiers & Qt::ShiftModifier) {
+        code |= 4;
+    }
+    if (modifiers & Qt::AltModifier) {
+        code |= 8;
+    }
+    if (modifiers & Qt::ControlModifier) {
+        code |= 16;
+    }
+    
+    m_lastMouseCell = position;
+    QByteArray report = encodeMouseReport(code, position, action == TerminalMouseAction::Release);
+    
+    if (action == TerminalMouseAction::Move) {
+        // Within a frame only the latest position survives
+        if (m_mouseMotionTimer.isActive()) {
+            m_pendingMouseMotion = report;
+        } else {
+            writeToShell(report);
+            m_mouseMotionTimer.start();
+        }
+        return;
+    }
+    
+    // Clicks are never dropped, but pending motion has to go first
+    flushMouseMotion();
+    
+    if (action == TerminalMouseAction::Press) {
+        m_mouseButtonDown = button;
+    } else if (action == TerminalMouseAction::Release) {
+        m_mouseButtonDown = Qt::NoButton;
+    }
+    
+    writeToShell(report);
+}
+
+QByteArray TerminalEmulator::encodeMouseReport(int buttonCode, const QPoint &cell, bool release) const
+{
+    // SGR: CSI < b ; x ; y M (press/motion) or m (release), 1-based, unbounded
+    if (m_sgrMouseEncoding) {
+        return QByteArray(CSI) + '<' + QByteArray::number(buttonCode) + ';'
+               + QByteArray::number(cell.x() + 1) + ';' + QByteArray::number(cell.y() + 1)
+               + (release ? 'm' : 'M');
+    }
+    
+    // X10: CSI M followed by three bytes offset by 32, releases don't say which button
+    if (release) {
+        buttonCode = (buttonCode & ~3) | 3;
+    }
+    if (cell.x() + 1 > 223 || cell.y() + 1 > 223) {
+        return QByteArray();
+    }
+    
+    QByteArray report(CSI "M");
+    report.append(char(32 + buttonCode));
+    report.append(char(32 + cell.x() + 1));
+    report.append(char(32 + cell.y() + 1));
+    return report;
+}
+
+void TerminalEmulator::flushMouseMotion()
+{
+    if (m_pendingMouseMotion.isEmpty()) {
+        return;
+    }
+    
+    writeToShell(m_pendingMouseMotion);
+    m_pendingMouseMotion.clear();
+    
+    // Start the next frame
+    m_mouseMotionTimer.start();
+}
+
 void TerminalEmulator::clear()
 {
     // Clear the active screen
@@ -1576,6 +2446,8 @@ void TerminalEmulator::clear()
             line[j] = TerminalCell(QChar(QLatin1Char(' ')), m_currentFormat);
         }
     }
+    markAllDamaged();
+    m_graphics->clearPlacements(m_alternateScreenActive);
     
     // Reset cursor position
     setCursorPositionInternal(0, 0);
@@ -1583,6 +2455,24 @@ void TerminalEmulator::clear()
 
 // Accessor Methods
 
+TerminalBackendType TerminalEmulator::backendType() const
+{
+    return TerminalBackendType::Internal;
+}
+
+QWidget *TerminalEmulator::displayWidget() const
+{
+    return nullptr;
+}
+
+QRect TerminalEmulator::takeDamage()
+{
+    // Hand the accumulated damage to the renderer and start over
+    QRect damage = m_damage.intersected(QRect(QPoint(0, 0), m_terminalSize));
+    m_damage = QRect();
+    return damage;
+}
+
 QSize TerminalEmulator::size() const
 {
     return m_terminalSize;
@@ -1598,6 +2488,12 @@ QChar TerminalEmulator::characterAt(int x, int y) const
         return QChar();
     }
     
+    // Predicted echo is drawn over the real cell
+    int predicted = predictionAt(x, y);
+    if (predicted >= 0) {
+        return m_predictions[predicted].character;
+    }
+    
     const TerminalLine &line = activeScreen[y];
     
     // Check if the position is within the line
@@ -1618,6 +2514,13 @@ TerminalCharFormat TerminalEmulator::formatAt(int x, int y) const
         return TerminalCharFormat();
     }
     
+    // Tentative style for predicted echo
+    if (predictionAt(x, y) >= 0) {
+        TerminalCharFormat tentative = m_currentFormat;
+        tentative.attributes |= Underline | Dim;
+        return tentative;
+    }
+    
     const TerminalLine &line = activeScreen[y];
     
     // Check if the position is within the line
@@ -1630,6 +2533,14 @@ TerminalCharFormat TerminalEmulator::formatAt(int x, int y) const
 
 QPoint TerminalEmulator::cursorPosition() const
 {
+    // The cursor follows displayed predictions
+    if (!m_predictions.isEmpty()) {
+        const PredictedCell &last = m_predictions.last();
+        if (predictionAt(last.position.x(), last.position.y()) >= 0) {
+            return last.position + QPoint(1, 0);
+        }
+    }
+    
     return m_cursorPosition;
 }
 
@@ -1672,11 +2583,19 @@ void TerminalEmulator::shellProcessFinished(int exitCode, QProcess::ExitStatus e
         m_ptyNotifier->setEnabled(false);
     }
     
+    if (m_ptyWriteNotifier) {
+        m_ptyWriteNotifier->setEnabled(false);
+    }
+    
     if (m_ptyFd >= 0) {
         ::close(m_ptyFd);
         m_ptyFd = -1;
     }
     
+    // Spare lines and batch memory go back to the system
+    m_arena.release();
+    m_metadata->close();
+    
     // Emit the shell finished signal
     Q_EMIT shellFinished(exitCode);
 }
@@ -1695,11 +2614,19 @@ void TerminalEmulator::shellProcessError(QProcess::ProcessError error)
         m_ptyNotifier->setEnabled(false);
     }
     
+    if (m_ptyWriteNotifier) {
+        m_ptyWriteNotifier->setEnabled(false);
+    }
+    
     if (m_ptyFd >= 0) {
         ::close(m_ptyFd);
         m_ptyFd = -1;
     }
     
+    // Spare lines and batch memory go back to the system
+    m_arena.release();
+    m_metadata->close();
+    
     // Use a generic error code for shell errors
     m_lastExitCode = 1;
     Q_EMIT shellFinished(m_lastExitCode);
@@ -1864,6 +2791,13 @@ void TerminalEmulator::detectCommand()
         return;
     }
     
+    // With integration, commands come from the metadata channel; the
+    // screen is only looked at for the prompt text
+    if (m_metadata->isActive()) {
+        detectPrompt();
+        return;
+    }
+    
     // Get the active screen buffer
     const QVector<TerminalLine> &activeScreen = m_alternateScreenActive ? m_alternateScreen : m_screen;
     
@@ -1921,6 +2855,59 @@ void TerminalEmulator::detectCommand()
     }
 }
 
+void TerminalEmulator::onShellCommandStarted(const QString &command)
+{
+    // Commands sent through executeCommand() are tracked already; the
+    // shell's line is what actually ran. It is empty when bash kept the
+    // line out of its history, then only executeCommand() knows it
+    if (!command.isEmpty() || !m_commandExecuting) {
+        m_currentCommand = command;
+    }
+    if (m_commandExecuting) {
+        return;
+    }
+    
+    m_commandExecuting = true;
+    m_commandStartTime = QDateTime::currentDateTime();
+    
+    if (m_blockModeEnabled) {
+        m_currentBlockId++;
+        Q_EMIT commandDetected(command);
+    }
+}
+
+void TerminalEmulator::onShellCommandFinished(const ShellCommandRecord &record)
+{
+    m_lastCommandRecord = record;
+    if (m_lastCommandRecord.command.isEmpty()) {
+        m_lastCommandRecord.command = m_currentCommand;
+    }
+    m_lastExitCode = record.exitCode;
+    
+    if (!m_commandExecuting) {
+        return;
+    }
+    
+    // The record can overtake the command's last output on the PTY. Only
+    // what is there now belongs to the command; a background job that
+    // keeps writing must not keep the UI in this loop
+    int pending = 0;
+    if (m_ptyFd >= 0 && ioctl(m_ptyFd, FIONREAD, &pending) == 0) {
+        for (int reads = (pending + OUTPUT_READ_SIZE - 1) / OUTPUT_READ_SIZE; reads > 0 && m_ptyFd >= 0; --reads) {
+            readFromShell();
+        }
+    }
+    
+    m_commandExecuting = false;
+    const QString command = m_lastCommandRecord.command;
+    Q_EMIT commandExecuted(command, m_currentOutput, record.exitCode);
+    
+    if (!command.trimmed().isEmpty() && !m_commandHistory.contains(command)) {
+        m_commandHistory.append(command);
+    }
+    m_currentOutput.clear();
+}
+
 void TerminalEmulator::setCursorPosition(int x, int y)
 {
     setCursorPositionInternal(x, y, true);
@@ -1969,6 +2956,28 @@ bool TerminalEmulator::isBusy() const
     return m_busy;
 }
 
+bool TerminalEmulator::isShellInForeground() const
+{
+    if (m_ptyFd < 0 || m_shellPid <= 0) {
+        return true;
+    }
+    
+    // The shell is a session leader, so its process group id is its pid
+    pid_t foreground = tcgetpgrp(m_ptyFd);
+    return foreground < 0 || foreground == m_shellPid;
+}
+
+bool TerminalEmulator::isRawModeActive() const
+{
+    // The shell's line editor runs non-canonical too, so it doesn't count
+    if (m_ptyFd < 0 || isShellInForeground()) {
+        return false;
+    }
+    
+    struct termios attributes;
+    return tcgetattr(m_ptyFd, &attributes) == 0 && !(attributes.c_lflag & ICANON);
+}
+
 int TerminalEmulator::lastExitCode() const
 {
     return m_lastExitCode;
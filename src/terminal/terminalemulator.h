@@ -6,6 +6,10 @@
 #ifndef TERMINALEMULATOR_H
 #define TERMINALEMULATOR_H
 
+#include "terminalbackend.h"
+#include "sessionarena.h"
+#include "shellmetadata.h"
+
 #include <QObject>
 #include <QColor>
 #include <QDateTime>
@@ -18,87 +22,23 @@
 #include <QString>
 #include <QStringList>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QWidget>
 #include <QProcess>
 #include <QSocketNotifier>
 #include <QLatin1Char>
 
-/**
- * Terminal character format attributes
- */
-enum TerminalAttribute {
-    Bold = 0x01,
-    Italic = 0x02,
-    Underline = 0x04,
-    StrikeThrough = 0x08,
-    Reverse = 0x10,
-    Blink = 0x20,
-    Dim = 0x40,
-    Invisible = 0x80
-};
-
-/**
- * Character format for a terminal cell
- */
-struct TerminalCharFormat {
-    QColor foreground;      ///< Foreground color
-    QColor background;      ///< Background color
-    int attributes;         ///< Attributes (combination of TerminalAttribute flags)
-    
-    TerminalCharFormat() : foreground(Qt::white), background(Qt::black), attributes(0) {}
-    
-    bool operator==(const TerminalCharFormat &other) const {
-        return foreground == other.foreground &&
-               background == other.background &&
-               attributes == other.attributes;
-    }
-    
-    bool operator!=(const TerminalCharFormat &other) const {
-        return !(*this == other);
-    }
-};
-
-/**
- * Terminal cell containing a character and its format
- */
-struct TerminalCell {
-    QChar character;               ///< The character in this cell
-    TerminalCharFormat format;     ///< Format of this cell
-    
-    TerminalCell() : character(QLatin1Char(' ')) {}
-    TerminalCell(QChar ch, const TerminalCharFormat &fmt) : character(ch), format(fmt) {}
-    
-    bool operator==(const TerminalCell &other) const {
-        return character == other.character && format == other.format;
-    }
-    
-    bool operator!=(const TerminalCell &other) const {
-        return !(*this == other);
-    }
-};
-
-/**
- * Terminal screen line
- */
-typedef QVector<TerminalCell> TerminalLine;
-
-/**
- * Cursor state in the terminal
- */
-enum CursorStyle {
-    Block,
-    UnderlineCursor,
-    IBeam
-};
+class KittyGraphics;
 
 /**
  * Class for handling terminal emulation
  * 
  * This class provides VT100/ANSI terminal emulation capabilities, 
  * manages the terminal state, and interfaces with a pseudo-terminal
- * for communication with the shell.
+ * for communication with the shell. It is the internal implementation
+ * of TerminalBackend.
  */
-class TerminalEmulator : public QObject
+class TerminalEmulator : public TerminalBackend
 {
     Q_OBJECT
 
@@ -114,13 +54,25 @@ public:
      */
     ~TerminalEmulator() override;
     
+    /**
+     * Get the type of this backend
+     * @return TerminalBackendType::Internal
+     */
+    TerminalBackendType backendType() const override;
+    
+    /**
+     * Get the widget that renders this backend
+     * @return nullptr, the grid is rendered by WarpKate itself
+     */
+    QWidget *displayWidget() const override;
+    
     /**
      * Initialize the terminal emulator
      * @param rows Number of rows
      * @param cols Number of columns
      * @return True if initialization was successful
      */
-    bool initialize(int rows, int cols);
+    bool initialize(int rows, int cols) override;
     
     /**
      * Start a shell process in the terminal
@@ -129,20 +81,99 @@ public:
      * @return True if the shell was started successfully
      */
     bool startShell(const QString &shellCommand = QString(), 
-                   const QString &initialWorkingDirectory = QString());
+                   const QString &initialWorkingDirectory = QString()) override;
+    
+    /**
+     * Set the environment for the next startShell()
+     * 
+     * The changes are applied to Kate's environment: KEY=VALUE entries set
+     * or override a variable and bare KEY entries unset it; everything else
+     * is inherited. With the project's activation already applied, hooks
+     * in the shell's startup files find nothing left to do.
+     * 
+     * @param environment KEY=VALUE entries to set and KEY entries to unset on top of Kate's environment
+     */
+    void setShellEnvironment(const QStringList &environment) override;
+    
+    /**
+     * Set a command for the next startShell() to run once, e.g. an environment activation
+     * 
+     * It is not a command of the user's: it gets no block and no history
+     * entry. With shell integration the script runs it after the user's
+     * startup files; otherwise it is typed raw with a leading space, which
+     * keeps it out of the history where the shell ignores such lines.
+     * 
+     * @param command Shell command line
+     */
+    void setStartupCommand(const QString &command);
+    
+    /**
+     * Enable or disable shell integration for the next startShell()
+     * 
+     * For bash and zsh, the shell is started with WarpKate's integration
+     * scripts, which source the user's files and emit OSC 133 prompt marks.
+     * Commands, exit codes and directories then come from the scripts'
+     * records on a ShellMetadataChannel instead of being read off the screen.
+     * 
+     * @param enabled Whether to inject the integration scripts
+     */
+    void setShellIntegrationEnabled(bool enabled);
+    
+    /**
+     * Trace the user's startup files on the next startShell()
+     * 
+     * Only has an effect with shell integration enabled.
+     * 
+     * @param enabled Whether to write a startup trace
+     */
+    void setProfileShellStartup(bool enabled);
+    
+    /**
+     * Get the startup trace the current shell writes
+     * @return Trace file path, empty if startup is not profiled
+     */
+    QString startupTracePath() const;
+    
+    /**
+     * Get what the shell integration reported about the last command
+     * @return Record of the last finished command, empty without integration
+     */
+    ShellCommandRecord lastCommandRecord() const;
+    
+    /**
+     * Get the exported environment of the shell, as the integration reports it
+     *
+     * Commands run outside the terminal (fan-out, runbooks, search) use it
+     * to see what the user exported or activated in the shell.
+     *
+     * @return Environment at the last prompt, empty without integration
+     */
+    QProcessEnvironment exportedEnvironment() const;
+    
+    /**
+     * Check whether the shell runs a command name as the program of that name
+     *
+     * Used before running a program outside the terminal in place of the
+     * shell (rg search blocks), or answering it in the shell's place
+     * (z directory jumps).
+     *
+     * @param name Command name the integration asks the shell about
+     * @return False if it is an alias or function, or unknown without integration
+     */
+    bool runsAsProgram(const QString &name) const;
     
     /**
      * Resize the terminal
      * @param rows New number of rows
      * @param cols New number of columns
      */
-    void resize(int rows, int cols);
+    void resize(int rows, int cols) override;
     
     /**
      * Process input from the user and send it to the shell
      * @param text Text input from the user
      */
-    void processInput(const QString &text);
+    void processInput(const QString &text) override;
     
     /**
      * Process a key press and send it to the shell
@@ -150,25 +181,46 @@ public:
      * @param modifiers Keyboard modifiers
      * @param text Text from the key press
      */
-    void processKeyPress(int key, Qt::KeyboardModifiers modifiers, const QString &text);
+    void processKeyPress(int key, Qt::KeyboardModifiers modifiers, const QString &text) override;
     
     /**
      * Execute a command in the terminal
      * @param command Command to execute
      * @param addNewline Whether to add a newline at the end
      */
-    void executeCommand(const QString &command, bool addNewline = true);
+    void executeCommand(const QString &command, bool addNewline = true) override;
+    
+    /**
+     * Check whether the program in the terminal asked for mouse reports
+     * @return True if one of the 1000/1002/1003 tracking modes is set
+     */
+    bool isMouseTrackingActive() const override;
+    
+    /**
+     * Report a mouse event to the program in the terminal
+     * 
+     * Presses, releases and wheel steps are written right away. Motion is
+     * only reported when it enters another cell, and at most once per frame;
+     * in between only the latest position is kept.
+     * 
+     * @param action What happened
+     * @param button Button pressed or released
+     * @param modifiers Keyboard modifiers
+     * @param cell Cell under the pointer (column, row)
+     */
+    void processMouseEvent(TerminalMouseAction action, Qt::MouseButton button,
+                           Qt::KeyboardModifiers modifiers, const QPoint &cell) override;
     
     /**
      * Clear the terminal screen
      */
-    void clear();
+    void clear() override;
     
     /**
      * Get the terminal size
      * @return Terminal size in columns and rows
      */
-    QSize size() const;
+    QSize size() const override;
     
     /**
      * Get the character at the specified position
@@ -176,7 +228,7 @@ public:
      * @param y Row
      * @return Character at the position
      */
-    QChar characterAt(int x, int y) const;
+    QChar characterAt(int x, int y) const override;
     
     /**
      * Get the format at the specified position
@@ -184,13 +236,13 @@ public:
      * @param y Row
      * @return Format at the position
      */
-    TerminalCharFormat formatAt(int x, int y) const;
+    TerminalCharFormat formatAt(int x, int y) const override;
     
     /**
      * Get the cursor position
      * @return Current cursor position (x, y)
      */
-    QPoint cursorPosition() const;
+    QPoint cursorPosition() const override;
     
     /**
      * Set the cursor position
@@ -215,7 +267,7 @@ public:
      * Get whether the cursor is visible
      * @return True if the cursor is visible
      */
-    bool isCursorVisible() const;
+    bool isCursorVisible() const override;
     
     /**
      * Set whether the cursor is visible
@@ -227,7 +279,7 @@ public:
      * Get whether the terminal is in alternative screen mode
      * @return True if in alternative screen mode
      */
-    bool isAlternateScreenActive() const;
+    bool isAlternateScreenActive() const override;
     
     /**
      * Set the default foreground color
@@ -246,7 +298,7 @@ public:
      * @param stripFormatting Whether to strip formatting
      * @return Terminal content as text
      */
-    QString getText(bool stripFormatting = true) const;
+    QString getText(bool stripFormatting = true) const override;
     
     /**
      * Get a line of text from the terminal
@@ -254,25 +306,37 @@ public:
      * @param stripFormatting Whether to strip formatting
      * @return Line of text
      */
-    QString getLine(int line, bool stripFormatting = true) const;
+    QString getLine(int line, bool stripFormatting = true) const override;
     
     /**
      * Get the current working directory of the shell
      * @return Current working directory
      */
-    QString currentWorkingDirectory() const;
+    QString currentWorkingDirectory() const override;
     
     /**
      * Check if the terminal is busy (shell process is running)
      * @return True if the terminal is busy
      */
-    bool isBusy() const;
+    bool isBusy() const override;
+    
+    /**
+     * Check whether the shell is the foreground process group of the PTY
+     * @return True if the shell is the foreground process
+     */
+    bool isShellInForeground() const override;
+    
+    /**
+     * Check whether a program other than the shell turned off canonical mode
+     * @return True if the foreground program reads the PTY unbuffered
+     */
+    bool isRawModeActive() const override;
     
     /**
      * Get the exit code of the last command
      * @return Exit code of the last command
      */
-    int lastExitCode() const;
+    int lastExitCode() const override;
     
     /**
      * Get all screen data
@@ -284,7 +348,7 @@ public:
      * Get the current command being typed
      * @return Current command
      */
-    QString currentCommand() const;
+    QString currentCommand() const override;
     
     /**
      * Get the current prompt
@@ -296,7 +360,42 @@ public:
      * Get the command history
      * @return List of previous commands
      */
-    QStringList commandHistory() const;
+    QStringList commandHistory() const override;
+    
+    /**
+     * Get the region of cells changed since the last call and reset it
+     * @return Damaged region in cell coordinates
+     */
+    QRect takeDamage() override;
+    
+    /**
+     * Enable or disable predictive local echo
+     * 
+     * When enabled, printable keys typed at a prompt are shown immediately
+     * in a tentative style and confirmed or rolled back once the real echo
+     * arrives from the shell.
+     * 
+     * @param enabled Whether to predict echo
+     */
+    void setPredictiveEchoEnabled(bool enabled);
+    
+    /**
+     * Get whether predictive local echo is enabled
+     * @return True if echo is predicted
+     */
+    bool isPredictiveEchoEnabled() const;
+    
+    /**
+     * Set the pixel size of one cell, used to size kitty graphics placements
+     * @param size Cell size in pixels
+     */
+    void setCellPixelSize(const QSize &size);
+    
+    /**
+     * Get the kitty graphics state of this session
+     * @return Images and their placements on the grid
+     */
+    KittyGraphics *graphics() const;
 
 public Q_SLOTS:
     /**
@@ -320,17 +419,17 @@ public Q_SLOTS:
     /**
      * Copy selected text to clipboard
      */
-    void copyToClipboard();
+    void copyToClipboard() override;
     
     /**
      * Paste text from clipboard
      */
-    void pasteFromClipboard();
+    void pasteFromClipboard() override;
     
     /**
      * Select all text
      */
-    void selectAll();
+    void selectAll() override;
     
     /**
      * Find text in the terminal
@@ -339,68 +438,7 @@ public Q_SLOTS:
      * @param searchForward Whether to search forward
      * @return True if text was found
      */
-    bool findText(const QString &text, bool caseSensitive = false, bool searchForward = true);
-
-Q_SIGNALS:
-    /**
-     * Emitted when terminal output is available
-     * @param text Output text
-     */
-    void outputAvailable(const QString &text);
-    
-    /**
-     * Emitted when the terminal size changes
-     * @param size New terminal size
-     */
-    void sizeChanged(const QSize &size);
-    
-    /**
-     * Emitted when the cursor position changes
-     * @param position New cursor position
-     */
-    void cursorPositionChanged(const QPoint &position);
-    
-    /**
-     * Emitted when the shell process finishes
-     * @param exitCode Exit code of the shell process
-     */
-    void shellFinished(int exitCode);
-    
-    /**
-     * Emitted when a command is detected
-     * @param command Command text
-     */
-    void commandDetected(const QString &command);
-    
-    /**
-     * Emitted when a command execution is completed
-     * @param command Command text
-     * @param output Command output
-     * @param exitCode Exit code of the command
-     */
-    void commandExecuted(const QString &command, const QString &output, int exitCode);
-    
-    /**
-     * Emitted when the working directory changes
-     * @param directory New working directory
-     */
-    void workingDirectoryChanged(const QString &directory);
-    
-    /**
-     * Emitted when the terminal requires a redraw
-     */
-    void redrawRequired();
-    
-    /**
-     * Emitted when the terminal bell is triggered
-     */
-    void bellTriggered();
-    
-    /**
-     * Emitted when the terminal title changes
-     * @param title New terminal title
-     */
-    void titleChanged(const QString &title);
+    bool findText(const QString &text, bool caseSensitive = false, bool searchForward = true) override;
 
 private:
     /**
@@ -420,7 +458,7 @@ private:
      * Parse an SGR (Select Graphic Rendition) sequence
      * @param parameters Parameters of the sequence
      */
-    void processSGR(const QList<int> &parameters);
+    void processSGR(const std::pmr::vector<int> &parameters);
     
     /**
      * Parse a CSI (Control Sequence Introducer) sequence
@@ -436,6 +474,13 @@ private:
      */
     int processOSC(const QByteArray &sequence);
     
+    /**
+     * Parse an APC (Application Program Command) sequence
+     * @param sequence Complete APC sequence including terminator
+     * @return Number of bytes processed
+     */
+    int processAPC(const QByteArray &sequence);
+    
     /**
      * Put a character at the current cursor position
      * @param ch Character to put
@@ -464,16 +509,28 @@ private:
     void scrollScreen(int lines);
     
     /**
-     * Create a new blank line
+     * Create a new blank line, reusing a scrolled off line's buffer if possible
      * @return Blank line initialized with spaces
      */
-    TerminalLine createBlankLine() const;
+    TerminalLine createBlankLine();
     
     /**
      * Detect a command in the terminal output
      */
     void detectCommand();
     
+    /**
+     * Start tracking a command the shell integration reported
+     * @param command Command line
+     */
+    void onShellCommandStarted(const QString &command);
+    
+    /**
+     * Finish the command the shell integration reported
+     * @param record What the shell reported about it
+     */
+    void onShellCommandFinished(const ShellCommandRecord &record);
+    
     /**
      * Detect the current working directory in the terminal output
      */
@@ -494,9 +551,9 @@ private:
      * @param sequence Escape sequence
      * @param start Start position within the sequence
      * @param length Length of the parameter section
-     * @return List of parsed parameters
+     * @return Parsed parameters, allocated in the batch arena
      */
-    QList<int> parseParameters(const QByteArray &sequence, int start, int length);
+    std::pmr::vector<int> parseParameters(const QByteArray &sequence, int start, int length);
     
     /**
      * Is the character a valid escape sequence final byte?
@@ -504,11 +561,131 @@ private:
      * @return True if it's a valid escape sequence final byte
      */
     bool isEscapeSequenceFinal(char ch) const;
+    
+    /**
+     * Check whether a buffered escape sequence is complete
+     * 
+     * CSI sequences end with a final byte, OSC/DCS/APC/PM strings with
+     * BEL or ST, sequences with intermediates after one more byte, and
+     * everything else after the byte following ESC.
+     * 
+     * @param sequence Buffered sequence starting with ESC
+     * @return True if the sequence can be processed
+     */
+    bool isEscapeSequenceComplete(const QByteArray &sequence) const;
+    
+    /**
+     * Count bytes that don't belong in terminal text
+     * 
+     * NULs, unusual C0 controls and bytes that aren't valid UTF-8.
+     * 
+     * @param data Output chunk
+     * @param lastSuspicious Set to the index of the last such byte, or -1
+     * @return Number of suspicious bytes
+     */
+    int countSuspiciousBytes(const QByteArray &data, int *lastSuspicious) const;
+    
+    /**
+     * Keep binary output away from the VT parser
+     * 
+     * Switches to binary mode when a chunk is dense in suspicious bytes;
+     * in binary mode chunks are only counted until text shows up again
+     * or the output goes quiet, then a short summary is printed instead.
+     * 
+     * @param data Output chunk
+     * @return True if the chunk was consumed as binary output
+     */
+    bool filterBinaryOutput(const QByteArray &data);
+    
+    /**
+     * Stop treating output as binary and print the summary
+     */
+    void leaveBinaryMode();
+    
+    /**
+     * Mark a range of rows as damaged
+     * @param firstLine First damaged row
+     * @param lastLine Last damaged row (inclusive)
+     */
+    void markDamaged(int firstLine, int lastLine);
+    
+    /**
+     * Mark the whole screen as damaged
+     */
+    void markAllDamaged();
+    
+    /**
+     * Record a predicted echo for a key about to be sent
+     * @param key The Qt key code
+     * @param modifiers Keyboard modifiers
+     * @param text Text from the key press
+     */
+    void predictKeyEcho(int key, Qt::KeyboardModifiers modifiers, const QString &text);
+    
+    /**
+     * Check whether echo may be predicted at the current cursor position
+     *
+     * Canonical mode with echo on and the shell's line editor (known from
+     * the integration's prompt marks) echo what is typed; anywhere else a
+     * prompt has to be recognised on the cursor row.
+     *
+     * @return False for password prompts, TUIs and unknown contexts
+     */
+    bool canPredictEcho() const;
+    
+    /**
+     * Confirm or contradict pending predictions with real output
+     * @param ch Character the shell is writing at the cursor
+     */
+    void checkPredictedEcho(QChar ch);
+    
+    /**
+     * Drop all pending predictions and repaint their cells
+     */
+    void rollbackPredictions();
+    
+    /**
+     * Find a displayed prediction for a cell
+     * @param x Column
+     * @param y Row
+     * @return Index into m_predictions, or -1
+     */
+    int predictionAt(int x, int y) const;
+    
+    /**
+     * Queue input for the shell and write as much as the PTY accepts
+     * 
+     * All input goes through here so ordering is kept when the PTY is
+     * full; the rest is written when the PTY becomes writable again.
+     * 
+     * @param data Bytes to send
+     */
+    void writeToShell(const QByteArray &data);
+    
+    /**
+     * Write queued input in bounded chunks
+     */
+    void flushPendingInput();
+    
+    /**
+     * Encode a mouse report for the active encoding
+     * @param buttonCode xterm button code including modifier and motion bits
+     * @param cell Cell of the event
+     * @param release Whether this reports a button release
+     * @return Encoded report, empty if the cell can't be encoded
+     */
+    QByteArray encodeMouseReport(int buttonCode, const QPoint &cell, bool release) const;
+    
+    /**
+     * Write the coalesced motion report, if any
+     */
+    void flushMouseMotion();
 
 private:
     // Terminal state
     QVector<TerminalLine> m_screen;            ///< Screen buffer
     QVector<TerminalLine> m_alternateScreen;   ///< Alternate screen buffer
+    SessionArena m_arena;                      ///< Pooled lines and per-batch temporaries
     TerminalCharFormat m_currentFormat;        ///< Current character format
     QPoint m_cursorPosition;                   ///< Current cursor position
     QSize m_terminalSize;                      ///< Terminal size in columns and rows
@@ -524,12 +701,20 @@ private:
     QByteArray m_escapeBuffer;                 ///< Buffer for escape sequences
     bool m_parsingEscapeSequence;              ///< Whether an escape sequence is being parsed
     bool m_newLineMode;                        ///< Line feed/new line mode
+    QRect m_damage;                            ///< Rows changed since the last takeDamage()
     
     // Process handling
     int m_ptyFd;                               ///< File descriptor for the pseudo-terminal
     QSocketNotifier *m_ptyNotifier;            ///< Socket notifier for the PTY
     pid_t m_shellPid;                          ///< PID of the shell process
     QString m_shellCommand;                    ///< Command used to start the shell
+    QStringList m_shellEnvironment;            ///< Environment changes for the shell, applied to the inherited one
+    QString m_startupCommand;                  ///< Run once by the next shell, without being tracked
+    bool m_shellIntegrationEnabled;            ///< Whether to inject the integration scripts
+    bool m_profileShellStartup;                ///< Whether to trace the startup files
+    QString m_startupTracePath;                ///< Startup trace of the current shell
+    ShellMetadataChannel *m_metadata;          ///< Records from the integration scripts
+    ShellCommandRecord m_lastCommandRecord;    ///< Record of the last finished command
     QString m_workingDirectory;                ///< Current working directory
     int m_lastExitCode;                        ///< Exit code of the last command
     
@@ -550,6 +735,48 @@ private:
     QPoint m_savedCursorPosition;              ///< Saved cursor position
     TerminalCharFormat m_savedFormat;          ///< Saved character format
     
+    // Predictive local echo
+    struct PredictedCell {
+        QPoint position;                       ///< Cell the echo is expected in
+        QChar character;                       ///< Character expected
+        qint64 sentAt;                         ///< Monotonic time the key was sent (ms)
+    };
+    bool m_predictiveEchoEnabled;              ///< Whether echo is predicted at all
+    QVector<PredictedCell> m_predictions;      ///< Unconfirmed predictions, oldest first
+    int m_trustedPredictionRow;                ///< Row where echo was recently confirmed, or -1
+    bool m_atShellPrompt;                      ///< Between the prompt (OSC 133;A) and command (133;C) marks
+    double m_echoLatency;                      ///< Smoothed keypress-to-echo latency (ms)
+    QElapsedTimer m_predictionClock;           ///< Clock for prediction timestamps
+    QTimer m_predictionTimeout;                ///< Rolls back predictions that never get echoed
+    
+    // Input writing
+    QByteArray m_pendingInput;                 ///< Input the PTY hasn't accepted yet
+    QSocketNotifier *m_ptyWriteNotifier;       ///< Fires when the PTY accepts more input
+    
+    // Mouse reporting
+    enum MouseTrackingMode {
+        MouseTrackingOff = 0,
+        MouseTrackingNormal = 1000,            ///< Press and release only
+        MouseTrackingButtonEvent = 1002,       ///< Also motion while a button is held
+        MouseTrackingAnyEvent = 1003           ///< All motion
+    };
+    MouseTrackingMode m_mouseTrackingMode;     ///< Requested mouse tracking mode
+    bool m_sgrMouseEncoding;                   ///< Whether SGR (1006) encoding is requested
+    Qt::MouseButton m_mouseButtonDown;         ///< Button held for drag reports
+    QPoint m_lastMouseCell;                    ///< Cell of the last reported event
+    QByteArray m_pendingMouseMotion;           ///< Latest coalesced motion report
+    QTimer m_mouseMotionTimer;                 ///< Limits motion reports to one per frame
+    
+    // Binary output protection
+    bool m_binaryOutputMode;                   ///< Whether output is currently treated as binary
+    qint64 m_binaryByteCount;                  ///< Bytes suppressed in binary mode
+    QByteArray m_binaryHead;                   ///< First bytes of the binary output, for the summary
+    QByteArray m_binaryTail;                   ///< Clean bytes after the last binary byte seen
+    QTimer m_binaryQuietTimer;                 ///< Ends binary mode once output goes quiet
+    
+    // Graphics
+    KittyGraphics *m_graphics;                 ///< Kitty graphics images and placements
+    
     // Color palette
     QMap<int, QColor> m_colorPalette;          ///< Terminal color palette (0-255)
     
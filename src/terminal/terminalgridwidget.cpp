@@ -0,0 +1,313 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "terminalgridwidget.h"
+#include "terminalbackend.h"
+#include "terminalemulator.h"
+#include "kittygraphics.h"
+
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QShowEvent>
+#include <QWheelEvent>
+
+// Quiet period before a new size is sent to the terminal (ms)
+static const int RESIZE_DEBOUNCE = 80;
+
+// A size change is never held back longer than this, even mid-drag (ms)
+static const int RESIZE_MAX_LATENCY = 400;
+
+TerminalGridWidget::TerminalGridWidget(TerminalBackend *terminal, QWidget *parent)
+    : QWidget(parent)
+    , m_terminal(terminal)
+    , m_fontAscent(0)
+{
+    // Monospace font, cell metrics derived from it
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    QFontMetrics metrics(font());
+    m_cellSize = QSize(qMax(1, metrics.horizontalAdvance(QLatin1Char('M'))), qMax(1, metrics.height()));
+    m_fontAscent = metrics.ascent();
+
+    // We paint every pixel ourselves
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setFocusPolicy(Qt::StrongFocus);
+    setAttribute(Qt::WA_InputMethodEnabled, false);
+
+    // Needed for any-motion mouse tracking (1003)
+    setMouseTracking(true);
+
+    connect(m_terminal, &TerminalBackend::redrawRequired, this, &TerminalGridWidget::onRedrawRequired);
+
+    // Kitty graphics placements are sized in cells of this font
+    if (TerminalEmulator *emulator = qobject_cast<TerminalEmulator *>(m_terminal)) {
+        emulator->setCellPixelSize(m_cellSize);
+    }
+
+    m_resizeTimer.setSingleShot(true);
+    connect(&m_resizeTimer, &QTimer::timeout, this, &TerminalGridWidget::syncTerminalSize);
+}
+
+TerminalGridWidget::~TerminalGridWidget()
+{
+}
+
+QSize TerminalGridWidget::cellSize() const
+{
+    return m_cellSize;
+}
+
+QSize TerminalGridWidget::gridSizeForWidget() const
+{
+    return QSize(qMax(1, width() / m_cellSize.width()), qMax(1, height() / m_cellSize.height()));
+}
+
+void TerminalGridWidget::onRedrawRequired()
+{
+    if (!isVisible()) {
+        return;
+    }
+
+    // Repaint only the damaged rows plus the rows the cursor moved between
+    QRect damage = m_terminal->takeDamage();
+    QPoint cursor = m_terminal->cursorPosition();
+
+    QRect rows = damage;
+    QRect cursorRows(0, qMin(cursor.y(), m_lastCursorPosition.y()), 1,
+                     qAbs(cursor.y() - m_lastCursorPosition.y()) + 1);
+    rows = rows.isNull() ? cursorRows : rows.united(cursorRows);
+    m_lastCursorPosition = cursor;
+
+    update(0, rows.top() * m_cellSize.height(), width(), rows.height() * m_cellSize.height());
+}
+
+void TerminalGridWidget::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    painter.setFont(font());
+
+    const QSize grid = m_terminal->size();
+    const int cellWidth = m_cellSize.width();
+    const int cellHeight = m_cellSize.height();
+
+    // Background outside of the grid
+    painter.fillRect(event->rect(), Qt::black);
+
+    // Only walk the rows intersecting the exposed area
+    int firstRow = qMax(0, event->rect().top() / cellHeight);
+    int lastRow = qMin(grid.height() - 1, event->rect().bottom() / cellHeight);
+
+    // Backgrounds first, so images with a negative z-index go between them and the text
+    for (int y = firstRow; y <= lastRow; ++y) {
+        for (int x = 0; x < grid.width(); ++x) {
+            TerminalCharFormat format = m_terminal->formatAt(x, y);
+            QColor background = (format.attributes & Reverse) ? format.foreground : format.background;
+            painter.fillRect(QRect(x * cellWidth, y * cellHeight, cellWidth, cellHeight), background);
+        }
+    }
+
+    paintImages(painter, event->rect(), true);
+
+    for (int y = firstRow; y <= lastRow; ++y) {
+        for (int x = 0; x < grid.width(); ++x) {
+            TerminalCharFormat format = m_terminal->formatAt(x, y);
+            QColor foreground = format.foreground;
+            if (format.attributes & Reverse) {
+                foreground = format.background;
+            }
+
+            QRect cellRect(x * cellWidth, y * cellHeight, cellWidth, cellHeight);
+            QChar ch = m_terminal->characterAt(x, y);
+            if (ch.isNull() || ch == QLatin1Char(' ') || (format.attributes & Invisible)) {
+                continue;
+            }
+
+            QFont cellFont = font();
+            cellFont.setBold(format.attributes & Bold);
+            cellFont.setItalic(format.attributes & Italic);
+            cellFont.setUnderline(format.attributes & Underline);
+            cellFont.setStrikeOut(format.attributes & StrikeThrough);
+            painter.setFont(cellFont);
+
+            if (format.attributes & Dim) {
+                foreground = foreground.darker(150);
+            }
+            painter.setPen(foreground);
+            painter.drawText(cellRect.left(), cellRect.top() + m_fontAscent, QString(ch));
+        }
+    }
+
+    paintImages(painter, event->rect(), false);
+
+    // Draw the cursor as an inverted block
+    if (m_terminal->isCursorVisible() && hasFocus()) {
+        QPoint cursor = m_terminal->cursorPosition();
+        if (cursor.y() >= firstRow && cursor.y() <= lastRow) {
+            QRect cursorRect(cursor.x() * cellWidth, cursor.y() * cellHeight, cellWidth, cellHeight);
+            painter.setCompositionMode(QPainter::RasterOp_SourceXorDestination);
+            painter.fillRect(cursorRect, Qt::white);
+        }
+    }
+}
+
+void TerminalGridWidget::paintImages(QPainter &painter, const QRect &exposed, bool belowText)
+{
+    TerminalEmulator *emulator = qobject_cast<TerminalEmulator *>(m_terminal);
+    if (!emulator) {
+        return;
+    }
+
+    KittyGraphics *graphics = emulator->graphics();
+    const QList<KittyGraphics::Placement> placements = graphics->placements(emulator->isAlternateScreenActive());
+    for (const KittyGraphics::Placement &placement : placements) {
+        if ((placement.zIndex < 0) != belowText) {
+            continue;
+        }
+
+        QRect target(placement.cell.x() * m_cellSize.width() + placement.pixelOffset.x(),
+                     placement.cell.y() * m_cellSize.height() + placement.pixelOffset.y(),
+                     placement.columns * m_cellSize.width() - placement.pixelOffset.x(),
+                     placement.rows * m_cellSize.height() - placement.pixelOffset.y());
+        if (!target.intersects(exposed)) {
+            continue;
+        }
+
+        // Still decoding: the cells stay reserved and show up once it's done
+        QImage image = graphics->image(placement.imageId);
+        if (image.isNull()) {
+            continue;
+        }
+
+        painter.drawImage(target, image, placement.sourceRect.isValid() ? placement.sourceRect : image.rect());
+    }
+}
+
+void TerminalGridWidget::keyPressEvent(QKeyEvent *event)
+{
+    // No line editing: every key goes straight to the program
+    m_terminal->processKeyPress(event->key(), event->modifiers(), event->text());
+    event->accept();
+}
+
+void TerminalGridWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (!m_terminal->isMouseTrackingActive()) {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    setFocus(Qt::MouseFocusReason);
+    m_terminal->processMouseEvent(TerminalMouseAction::Press, event->button(), event->modifiers(),
+                                  cellAt(event->position().toPoint()));
+    event->accept();
+}
+
+void TerminalGridWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (!m_terminal->isMouseTrackingActive()) {
+        QWidget::mouseReleaseEvent(event);
+        return;
+    }
+
+    m_terminal->processMouseEvent(TerminalMouseAction::Release, event->button(), event->modifiers(),
+                                  cellAt(event->position().toPoint()));
+    event->accept();
+}
+
+void TerminalGridWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!m_terminal->isMouseTrackingActive()) {
+        QWidget::mouseMoveEvent(event);
+        return;
+    }
+
+    // The terminal drops same-cell moves and coalesces the rest per frame
+    m_terminal->processMouseEvent(TerminalMouseAction::Move, Qt::NoButton, event->modifiers(),
+                                  cellAt(event->position().toPoint()));
+    event->accept();
+}
+
+void TerminalGridWidget::wheelEvent(QWheelEvent *event)
+{
+    int delta = event->angleDelta().y();
+    if (!m_terminal->isMouseTrackingActive() || delta == 0) {
+        QWidget::wheelEvent(event);
+        return;
+    }
+
+    m_terminal->processMouseEvent(delta > 0 ? TerminalMouseAction::WheelUp : TerminalMouseAction::WheelDown,
+                                  Qt::NoButton, event->modifiers(), cellAt(event->position().toPoint()));
+    event->accept();
+}
+
+bool TerminalGridWidget::event(QEvent *event)
+{
+    // Kate binds many Ctrl+letter shortcuts; a full-screen program needs them
+    if (event->type() == QEvent::ShortcutOverride) {
+        event->accept();
+        return true;
+    }
+
+    return QWidget::event(event);
+}
+
+bool TerminalGridWidget::focusNextPrevChild(bool next)
+{
+    Q_UNUSED(next);
+    return false;
+}
+
+void TerminalGridWidget::resizeEvent(QResizeEvent *event)
+{
+    // Paint the current grid clipped/padded until the size settles
+    QWidget::resizeEvent(event);
+    scheduleTerminalResize();
+}
+
+void TerminalGridWidget::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+
+    // A program just took over the screen, give it the right size right away
+    syncTerminalSize();
+}
+
+void TerminalGridWidget::scheduleTerminalResize()
+{
+    if (!isVisible() || gridSizeForWidget() == m_terminal->size()) {
+        // Back at the terminal's size, nothing to send
+        m_resizeTimer.stop();
+        m_resizePending.invalidate();
+        return;
+    }
+
+    // Each change restarts the quiet period, capped by the maximum latency
+    if (!m_resizePending.isValid()) {
+        m_resizePending.start();
+    }
+    qint64 remaining = RESIZE_MAX_LATENCY - m_resizePending.elapsed();
+    m_resizeTimer.start(int(qBound<qint64>(0, remaining, RESIZE_DEBOUNCE)));
+}
+
+void TerminalGridWidget::syncTerminalSize()
+{
+    m_resizeTimer.stop();
+    m_resizePending.invalidate();
+
+    // Keep the terminal grid matching the visible area
+    QSize grid = gridSizeForWidget();
+    if (isVisible() && grid != m_terminal->size()) {
+        m_terminal->resize(grid.height(), grid.width());
+    }
+}
+
+QPoint TerminalGridWidget::cellAt(const QPoint &position) const
+{
+    return QPoint(position.x() / m_cellSize.width(), position.y() / m_cellSize.height());
+}
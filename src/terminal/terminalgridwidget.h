@@ -0,0 +1,156 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef TERMINALGRIDWIDGET_H
+#define TERMINALGRIDWIDGET_H
+
+#include <QElapsedTimer>
+#include <QSize>
+#include <QTimer>
+#include <QWidget>
+
+class TerminalBackend;
+class QKeyEvent;
+class QMouseEvent;
+class QPainter;
+class QPaintEvent;
+class QResizeEvent;
+class QShowEvent;
+class QWheelEvent;
+
+/**
+ * Widget that renders a terminal backend's cell grid
+ *
+ * Used for full-screen programs (vim, htop, REPLs) that need the real
+ * screen rather than the block transcript. Key presses are forwarded
+ * straight to TerminalBackend::processKeyPress without any line editing,
+ * and only the rows reported by TerminalBackend::takeDamage are repainted.
+ *
+ * Size changes are debounced: while a splitter is dragged the current grid
+ * is just clipped or padded locally, and only the settled size is sent to
+ * the terminal (and so to the PTY as SIGWINCH).
+ */
+class TerminalGridWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor
+     * @param terminal Terminal backend to render and send keys to
+     * @param parent Parent widget
+     */
+    explicit TerminalGridWidget(TerminalBackend *terminal, QWidget *parent = nullptr);
+
+    /**
+     * Destructor
+     */
+    ~TerminalGridWidget() override;
+
+    /**
+     * Get the size of a single cell in pixels
+     * @return Cell size
+     */
+    QSize cellSize() const;
+
+    /**
+     * Get the grid size (columns x rows) that fits the widget
+     * @return Grid size in cells
+     */
+    QSize gridSizeForWidget() const;
+
+protected:
+    /**
+     * Paint the damaged part of the grid
+     */
+    void paintEvent(QPaintEvent *event) override;
+
+    /**
+     * Forward key presses to the terminal
+     */
+    void keyPressEvent(QKeyEvent *event) override;
+
+    /**
+     * Forward mouse presses when the program tracks the mouse
+     */
+    void mousePressEvent(QMouseEvent *event) override;
+
+    /**
+     * Forward mouse releases when the program tracks the mouse
+     */
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+    /**
+     * Forward mouse motion when the program tracks the mouse
+     */
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+    /**
+     * Forward wheel steps when the program tracks the mouse
+     */
+    void wheelEvent(QWheelEvent *event) override;
+
+    /**
+     * Claim shortcuts so Kate's actions don't steal keys from the program
+     */
+    bool event(QEvent *event) override;
+
+    /**
+     * Keep Tab/Backtab inside the terminal
+     */
+    bool focusNextPrevChild(bool next) override;
+
+    /**
+     * Schedule propagating the new grid size to the terminal
+     */
+    void resizeEvent(QResizeEvent *event) override;
+
+    /**
+     * Sync the grid size when the widget becomes visible
+     */
+    void showEvent(QShowEvent *event) override;
+
+private Q_SLOTS:
+    /**
+     * Schedule repaint of the damaged rows
+     */
+    void onRedrawRequired();
+
+private:
+    /**
+     * Schedule a terminal resize once the widget size settles
+     */
+    void scheduleTerminalResize();
+
+    /**
+     * Resize the terminal to the grid that fits the widget
+     */
+    void syncTerminalSize();
+
+    /**
+     * Get the cell under a widget position
+     * @param position Position in widget coordinates
+     * @return Cell (column, row)
+     */
+    QPoint cellAt(const QPoint &position) const;
+
+    /**
+     * Draw the kitty graphics placements of the active screen
+     * @param painter Painter of the current paint event
+     * @param exposed Area being repainted
+     * @param belowText Draw the placements below the text (negative z-index) or above
+     */
+    void paintImages(QPainter &painter, const QRect &exposed, bool belowText);
+
+private:
+    TerminalBackend *m_terminal;        ///< Terminal being rendered
+    QSize m_cellSize;                   ///< Size of one cell in pixels
+    int m_fontAscent;                   ///< Font ascent for text baseline
+    QPoint m_lastCursorPosition;        ///< Cursor position at the last repaint
+    QTimer m_resizeTimer;               ///< Fires when the widget size has settled
+    QElapsedTimer m_resizePending;      ///< Time since the first unsent size change
+};
+
+#endif // TERMINALGRIDWIDGET_H
@@ -4,16 +4,27 @@
  */
 
 #include "commandinput.h"
+#include "shellhighlighter.h"
+#include "terminal/directoryindex.h"
 
 #include <QDebug>
 #include <QKeyEvent>
 #include <QApplication>
 #include <QClipboard>
+#include <QCompleter>
+#include <QDir>
+#include <QAbstractItemView>
+#include <QScrollBar>
+#include <QStringListModel>
 #include <QRegularExpression>
 #include <QTimer>
 #include <QTextCursor>
 #include <KConfigGroup>
 #include <KSharedConfig>
+#include <KShell>
+
+// Most directories suggested at once
+static const int MAX_DIRECTORY_SUGGESTIONS = 10;
 
 CommandInput::CommandInput(QWidget *parent)
     : QTextEdit(parent)
@@ -21,6 +32,10 @@ CommandInput::CommandInput(QWidget *parent)
     , m_historyIndex(-1)
     , m_assistantName(QStringLiteral("WarpKate"))
     , m_autocompleteTimer(nullptr)
+    , m_highlighter(nullptr)
+    , m_directoryCompleter(nullptr)
+    , m_directoryModel(nullptr)
+    , m_directoryPrefixStart(0)
 {
     initialize();
 }
@@ -58,6 +73,20 @@ void CommandInput::initialize()
     m_autocompleteTimer->setInterval(300); // 300ms delay before showing suggestions
     connect(m_autocompleteTimer, &QTimer::timeout, this, &CommandInput::showAutocompleteSuggestions);
     
+    // Highlight commands as they are typed
+    m_highlighter = new ShellHighlighter(document());
+    
+    // Suggestions are ranked by the index, so the completer shows them as they are
+    m_directoryModel = new QStringListModel(this);
+    m_directoryCompleter = new QCompleter(m_directoryModel, this);
+    m_directoryCompleter->setWidget(this);
+    m_directoryCompleter->setCompletionMode(QCompleter::PopupCompletion);
+    m_directoryCompleter->setModelSorting(QCompleter::UnsortedModel);
+    connect(m_directoryCompleter, QOverload<const QString &>::of(&QCompleter::activated), this, &CommandInput::insertDirectory);
+    
+    // Directory suggestions are one completion provider like any other
+    connect(this, &CommandInput::completionRequested, this, &CommandInput::showDirectorySuggestions);
+    
     // Initialize placeholder text
     updatePlaceholderText();
 }
@@ -68,6 +97,9 @@ void CommandInput::setInputMode(InputMode mode)
         m_currentMode = mode;
         updatePlaceholderText();
         
+        // AI queries are prose, not shell
+        m_highlighter->setDocument(mode == AIMode ? nullptr : document());
+        
         // Emit signal for mode change
         Q_EMIT inputModeChanged(mode == AIMode);
         
@@ -113,6 +145,14 @@ void CommandInput::setModeIcons(const QIcon &commandIcon, const QIcon &aiIcon)
     m_aiIcon = aiIcon;
 }
 
+ShellCompletionContext CommandInput::completionContext() const
+{
+    if (m_currentMode == AIMode) {
+        return ShellCompletionContext();
+    }
+    return m_highlighter->completionContext(textCursor());
+}
+
 void CommandInput::submitInput()
 {
     QString input = toPlainText().trimmed();
@@ -203,6 +243,14 @@ bool CommandInput::event(QEvent *event)
 {
     // Handle special events
     if (event->type() == QEvent::KeyPress) {
+        // Tab completes in command mode instead of moving the focus
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        if (keyEvent->key() == Qt::Key_Tab && !(keyEvent->modifiers() & (Qt::ControlModifier | Qt::AltModifier))
+            && m_currentMode == CommandMode) {
+            keyPressEvent(keyEvent);
+            return true;
+        }
+        
         // Let keyPressEvent handle it
         return QTextEdit::event(event);
     }
@@ -213,6 +261,20 @@ bool CommandInput::event(QEvent *event)
 
 void CommandInput::keyPressEvent(QKeyEvent *event)
 {
+    // Keys the directory popup handles itself
+    if (m_directoryCompleter->popup()->isVisible()) {
+        switch (event->key()) {
+        case Qt::Key_Enter:
+        case Qt::Key_Return:
+        case Qt::Key_Escape:
+        case Qt::Key_Backtab:
+            event->ignore();
+            return;
+        default:
+            break;
+        }
+    }
+    
     // Handle special key combinations
     if (event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter) {
         // Enter key submits the input (but not Shift+Enter)
@@ -237,6 +299,7 @@ void CommandInput::keyPressEvent(QKeyEvent *event)
             // Request autocomplete suggestions
             QString text = toPlainText();
             int position = textCursor().position();
+            Q_EMIT completionRequested(completionContext());
             Q_EMIT autocompleteRequested(text, position);
             event->accept();
             return;
@@ -299,22 +362,66 @@ void CommandInput::updatePlaceholderText()
 
 void CommandInput::showAutocompleteSuggestions()
 {
-    // Stub implementation
-    // In a real implementation, this would show autocomplete suggestions
-    qDebug() << "CommandInput: Autocomplete suggestions requested";
-    
     QString text = toPlainText();
     int position = textCursor().position();
     
-    // Extract the current word being typed
-    QString currentWord;
-    if (position > 0) {
-        QTextCursor cursor = textCursor();
-        cursor.movePosition(QTextCursor::StartOfWord, QTextCursor::KeepAnchor);
-        currentWord = cursor.selectedText();
+    // The word being typed, as the shell would split it; sent even when
+    // there is nothing to complete, so providers hide their suggestions
+    ShellCompletionContext context = completionContext();
+    Q_EMIT completionRequested(context);
+    if (context.kind == ShellCompletionContext::None) {
+        return;
     }
     
     // Emit signal for autocomplete request
     Q_EMIT autocompleteRequested(text, position);
 }
 
+bool CommandInput::showDirectorySuggestions(const ShellCompletionContext &context)
+{
+    static const QStringList directoryCommands = {QStringLiteral("cd"), QStringLiteral("pushd"), QStringLiteral("z")};
+    
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    bool directoryArgument = (context.kind == ShellCompletionContext::Argument || context.kind == ShellCompletionContext::Path)
+                             && directoryCommands.contains(context.command);
+    QStringList directories;
+    if (directoryArgument && config.readEntry("DirectoryJump", true)) {
+        directories = DirectoryIndex::instance().complete(context.prefix, MAX_DIRECTORY_SUGGESTIONS);
+    }
+    
+    if (directories.isEmpty()) {
+        m_directoryCompleter->popup()->hide();
+        return false;
+    }
+    
+    // Shown with ~ for the home directory, as they would be typed
+    const QString home = QDir::homePath() + QLatin1Char('/');
+    for (QString &directory : directories) {
+        if (directory.startsWith(home)) {
+            directory.replace(0, home.size() - 1, QStringLiteral("~"));
+        }
+    }
+    
+    m_directoryModel->setStringList(directories);
+    m_directoryPrefixStart = context.prefixStart;
+    m_directoryCompleter->setCompletionPrefix(QString());
+    
+    QAbstractItemView *popup = m_directoryCompleter->popup();
+    QRect rect = cursorRect();
+    rect.setWidth(popup->sizeHintForColumn(0) + popup->verticalScrollBar()->sizeHint().width());
+    m_directoryCompleter->complete(rect);
+    return true;
+}
+
+void CommandInput::insertDirectory(const QString &directory)
+{
+    // Quoted as needed, leaving ~/ outside the quotes so it still expands
+    QString argument = directory.startsWith(QStringLiteral("~/"))
+                       ? QStringLiteral("~/") + KShell::quoteArg(directory.mid(2))
+                       : KShell::quoteArg(directory);
+    
+    QTextCursor cursor = textCursor();
+    cursor.setPosition(m_directoryPrefixStart, QTextCursor::KeepAnchor);
+    cursor.insertText(argument);
+    setTextCursor(cursor);
+}
@@ -6,18 +6,26 @@
 #ifndef COMMANDINPUT_H
 #define COMMANDINPUT_H
 
+#include "shelltokenizer.h"
+
 #include <QTextEdit>
 #include <QStringList>
 #include <QIcon>
 #include <QTimer>
 
+class QCompleter;
+class QStringListModel;
+class ShellHighlighter;
+
 /**
  * @brief The CommandInput class
  * 
  * This class manages the command input area in the terminal, handling:
  * - Command input processing
  * - Command history navigation
- * - Autocomplete functionality
+ * - Autocomplete functionality, with the shell context at the cursor
+ * - Live shell syntax highlighting in command mode
+ * - Frecent directory suggestions for cd, pushd and z
  * - Mode switching between terminal commands and AI queries
  */
 class CommandInput : public QTextEdit
@@ -85,6 +93,12 @@ public:
      * @param aiIcon Icon for AI mode
      */
     void setModeIcons(const QIcon &commandIcon, const QIcon &aiIcon);
+    
+    /**
+     * Get what is being completed at the cursor
+     * @return Completion context, kind None in AI mode
+     */
+    ShellCompletionContext completionContext() const;
 
 public Q_SLOTS:
     /**
@@ -130,6 +144,16 @@ Q_SIGNALS:
      * @param position Cursor position
      */
     void autocompleteRequested(const QString &text, int position);
+    
+    /**
+     * Emitted when completion is requested, for providers that want the
+     * shell context; the directory suggestions are connected to it
+     *
+     * Also emitted with kind None, so providers can hide their suggestions.
+     *
+     * @param context What is being completed at the cursor
+     */
+    void completionRequested(const ShellCompletionContext &context);
 
 protected:
     /**
@@ -167,6 +191,19 @@ private:
      */
     void showAutocompleteSuggestions();
     
+    /**
+     * Pop up indexed directories for a cd, pushd or z argument
+     * @param context Completion context at the cursor
+     * @return True if suggestions are shown
+     */
+    bool showDirectorySuggestions(const ShellCompletionContext &context);
+    
+    /**
+     * Replace the argument being completed with a suggested directory
+     * @param directory Directory as shown, ~ for the home directory
+     */
+    void insertDirectory(const QString &directory);
+    
     // Current state
     InputMode m_currentMode;
     QStringList m_commandHistory;
@@ -181,6 +218,14 @@ private:
     
     // Autocomplete timer
     QTimer *m_autocompleteTimer;
+    
+    // Shell highlighting, also tokenizes for completion
+    ShellHighlighter *m_highlighter;
+    
+    // Directory suggestions from the frecency index
+    QCompleter *m_directoryCompleter;
+    QStringListModel *m_directoryModel;
+    int m_directoryPrefixStart;
 };
 
 #endif // COMMANDINPUT_H
@@ -0,0 +1,331 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "conversationmodel.h"
+
+#include <QHash>
+#include <QStringList>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextFragment>
+
+#include <algorithm>
+
+// Output items keep their text uncompressed until unchanged this long (ms)
+static const int COMPRESSION_DELAY = 60 * 1000;
+
+// Command outputs shorter than this (characters, over all their items)
+// are not worth compressing
+static const int MIN_COMPRESSED_TEXT = 4096;
+
+// Number of compressed texts kept expanded after being read, enough for
+// the items on screen
+static const int EXPANDED_CACHE_SIZE = 8;
+
+// Orders links by row, then offset
+static bool linkBefore(const ConversationModel::Link &a, const ConversationModel::Link &b)
+{
+    return a.row < b.row || (a.row == b.row && a.start < b.start);
+}
+
+ConversationModel::ConversationModel(QObject *parent)
+    : QAbstractListModel(parent)
+    , m_compressor(EXPANDED_CACHE_SIZE)
+{
+    m_compressionTimer.setSingleShot(true);
+    m_compressionTimer.setInterval(COMPRESSION_DELAY);
+    connect(&m_compressionTimer, &QTimer::timeout, this, &ConversationModel::compressIdleItems);
+}
+
+int ConversationModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_items.size();
+}
+
+QVariant ConversationModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_items.size()) {
+        return QVariant();
+    }
+
+    const Item &item = m_items.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return textAt(index.row(), true);
+    case KindRole:
+        return item.kind;
+    case TimestampRole:
+        return item.timestamp;
+    default:
+        return QVariant();
+    }
+}
+
+int ConversationModel::appendItem(Kind kind, const QString &text, const QTextCharFormat &format)
+{
+    Item item;
+    item.kind = kind;
+    item.timestamp = QDateTime::currentDateTime();
+    item.modified = item.timestamp;
+    appendFormatted(item, text, format);
+
+    int row = m_items.size();
+    beginInsertRows(QModelIndex(), row, row);
+    m_items.append(item);
+    endInsertRows();
+
+    // The output before a new item is usually complete
+    if (!m_compressionTimer.isActive()) {
+        m_compressionTimer.start();
+    }
+    return row;
+}
+
+void ConversationModel::appendText(int row, const QString &text, const QTextCharFormat &format)
+{
+    if (row < 0 || row >= m_items.size() || text.isEmpty()) {
+        return;
+    }
+    expandForWrite(row);
+    appendFormatted(m_items[row], text, format);
+    emitItemChanged(row);
+}
+
+void ConversationModel::appendLine(int row, const QString &text, const QTextCharFormat &format)
+{
+    if (row < 0 || row >= m_items.size()) {
+        return;
+    }
+    expandForWrite(row);
+    Item &item = m_items[row];
+    if (!item.text.isEmpty()) {
+        appendFormatted(item, QStringLiteral("\n"), QTextCharFormat());
+    }
+    appendFormatted(item, text, format);
+    emitItemChanged(row);
+}
+
+void ConversationModel::appendHtml(int row, const QString &html)
+{
+    if (row < 0 || row >= m_items.size()) {
+        return;
+    }
+
+    // Let QTextDocument parse the markup, then keep its fragments as spans
+    QTextDocument document;
+    document.setHtml(html);
+
+    expandForWrite(row);
+    Item &item = m_items[row];
+    QList<Link> links;
+    for (QTextBlock block = document.begin(); block.isValid(); block = block.next()) {
+        if (block != document.begin()) {
+            appendFormatted(item, QStringLiteral("\n"), QTextCharFormat());
+        }
+        for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it) {
+            QTextFragment fragment = it.fragment();
+            if (!fragment.isValid()) {
+                continue;
+            }
+            QTextCharFormat format = fragment.charFormat();
+            int start = item.text.size();
+            appendFormatted(item, fragment.text(), format);
+            if (format.isAnchor() && !format.anchorHref().isEmpty()) {
+                links.append({row, start, int(fragment.length()), format.anchorHref()});
+            }
+        }
+    }
+
+    // Items are mostly extended at the end, so this is usually an append
+    for (const Link &link : std::as_const(links)) {
+        m_links.insert(std::upper_bound(m_links.begin(), m_links.end(), link, linkBefore), link);
+    }
+    emitItemChanged(row);
+}
+
+void ConversationModel::setText(int row, const QString &text, const QTextCharFormat &format)
+{
+    if (row < 0 || row >= m_items.size()) {
+        return;
+    }
+    expandForWrite(row);
+    Item &item = m_items[row];
+    item.text.clear();
+    item.formats.clear();
+    item.length = 0;
+    item.lineCount = 1;
+    removeLinks(row);
+    appendFormatted(item, text, format);
+    emitItemChanged(row);
+}
+
+ConversationModel::Item ConversationModel::item(int row) const
+{
+    Item item = m_items.at(row);
+    if (!item.compressedText.isEmpty()) {
+        item.text = textAt(row, true);
+        item.compressedText.clear();
+    }
+    return item;
+}
+
+int ConversationModel::textLength(int row) const
+{
+    return m_items.at(row).length;
+}
+
+int ConversationModel::lineCount(int row) const
+{
+    return m_items.at(row).lineCount;
+}
+
+const QList<ConversationModel::Link> &ConversationModel::links() const
+{
+    return m_links;
+}
+
+int ConversationModel::linkAt(int row, int position) const
+{
+    Link key = {row, 0, 0, QString()};
+    auto it = std::lower_bound(m_links.begin(), m_links.end(), key, linkBefore);
+    for (; it != m_links.end() && it->row == row; ++it) {
+        if (position >= it->start && position < it->start + it->length) {
+            return int(it - m_links.begin());
+        }
+    }
+    return -1;
+}
+
+QString ConversationModel::toPlainText() const
+{
+    QStringList texts;
+    texts.reserve(m_items.size());
+    for (int row = 0; row < m_items.size(); ++row) {
+        texts.append(textAt(row, false));
+    }
+    return texts.join(QLatin1Char('\n'));
+}
+
+void ConversationModel::clear()
+{
+    beginResetModel();
+    m_items.clear();
+    m_links.clear();
+    m_compressor.clear();
+    endResetModel();
+}
+
+void ConversationModel::appendFormatted(Item &item, const QString &text, const QTextCharFormat &format)
+{
+    if (text.isEmpty()) {
+        return;
+    }
+
+    // Only the appended text is counted, so growing an item stays linear
+    int start = item.text.size();
+    item.text.append(text);
+    item.length = item.text.size();
+    item.lineCount += text.count(QLatin1Char('\n'));
+    if (format.properties().isEmpty()) {
+        return;
+    }
+
+    // Extend the previous span when the format continues
+    if (!item.formats.isEmpty()) {
+        QTextLayout::FormatRange &last = item.formats.last();
+        if (last.start + last.length == start && last.format == format) {
+            last.length += text.size();
+            return;
+        }
+    }
+
+    QTextLayout::FormatRange range;
+    range.start = start;
+    range.length = text.size();
+    range.format = format;
+    item.formats.append(range);
+}
+
+void ConversationModel::emitItemChanged(int row)
+{
+    m_items[row].modified = QDateTime::currentDateTime();
+    QModelIndex changed = index(row);
+    Q_EMIT dataChanged(changed, changed);
+}
+
+void ConversationModel::removeLinks(int row)
+{
+    m_links.erase(std::remove_if(m_links.begin(), m_links.end(),
+                                 [row](const Link &link) { return link.row == row; }),
+                  m_links.end());
+}
+
+QString ConversationModel::textAt(int row, bool cache) const
+{
+    const Item &item = m_items.at(row);
+    return m_compressor.text(row, item.text, item.compressedText, cache);
+}
+
+void ConversationModel::expandForWrite(int row)
+{
+    Item &item = m_items[row];
+    if (!item.compressedText.isEmpty()) {
+        item.text = textAt(row, false);
+        item.compressedText.clear();
+    }
+    m_compressor.forget(row);
+}
+
+void ConversationModel::compressIdleItems()
+{
+    QDateTime now = QDateTime::currentDateTime();
+    bool waiting = false;
+
+    // Output arrives as one item per read, so the items of a command's
+    // output count together; the last item may still be receiving output
+    QHash<int, QString> texts;
+    int row = 0;
+    while (row < m_items.size()) {
+        if (m_items.at(row).kind != Output) {
+            ++row;
+            continue;
+        }
+
+        int end = row;
+        qsizetype length = 0;
+        for (; end < m_items.size() && m_items.at(end).kind == Output; ++end) {
+            length += m_items.at(end).length;
+        }
+        for (; row < end; ++row) {
+            const Item &item = m_items.at(row);
+            if (length < MIN_COMPRESSED_TEXT || row == m_items.size() - 1 || !item.compressedText.isEmpty()
+                || item.text.isEmpty() || m_compressor.isCompressing(row)) {
+                continue;
+            }
+            if (item.modified.msecsTo(now) < COMPRESSION_DELAY) {
+                waiting = true;
+                continue;
+            }
+            texts.insert(row, item.text);
+        }
+    }
+
+    m_compressor.compress(texts, [this](int row, const QString &text, const QByteArray &compressed) {
+        // Cleared, or changed meanwhile
+        if (row >= m_items.size() || m_items.at(row).text.constData() != text.constData()
+            || m_items.at(row).text.size() != text.size()) {
+            return;
+        }
+        m_items[row].compressedText = compressed;
+        m_items[row].text = QString();
+    });
+
+    // Check again once the remaining items are idle long enough
+    if (waiting) {
+        m_compressionTimer.start();
+    }
+}
+
+#include "moc_conversationmodel.cpp"
@@ -0,0 +1,226 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef CONVERSATIONMODEL_H
+#define CONVERSATIONMODEL_H
+
+#include "util/textcompressor.h"
+
+#include <QAbstractListModel>
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QString>
+#include <QTextCharFormat>
+#include <QTextLayout>
+#include <QTimer>
+
+/**
+ * @brief The ConversationModel class
+ *
+ * Item model behind the conversation timeline. Each command header, chunk
+ * of output, AI query, AI response and notice is one item holding plain
+ * text plus the character formats of its spans, so items can be laid out
+ * one at a time by the view. Items are only ever appended or changed in
+ * place, which keeps row numbers stable until the model is cleared.
+ *
+ * Like the block outputs in BlockModel, and with the same TextCompressor,
+ * the text of output items that have not changed for a while is
+ * compressed in the background (UTF-8, then zlib). A command's output
+ * arrives as one item per read, so whether it is large enough to be
+ * worth it is decided for all its items together. item(), data() and
+ * toPlainText() expand it transparently; a small LRU cache keeps the
+ * most recently read items expanded.
+ */
+class ConversationModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Kind of a conversation item
+     */
+    enum Kind {
+        Command,    ///< Command header
+        Output,     ///< Command output
+        AIQuery,    ///< Query to the AI assistant
+        AIResponse, ///< Response from the AI assistant
+        Notice      ///< Informational or error message
+    };
+
+    /**
+     * Custom data roles, DisplayRole holds the plain text
+     */
+    enum Roles {
+        KindRole = Qt::UserRole + 1, ///< Kind of the item
+        TimestampRole                ///< When the item was added
+    };
+
+    /**
+     * A conversation item
+     */
+    struct Item {
+        Kind kind;                                  ///< Kind of the item
+        QString text;                               ///< Plain text, lines separated by '\n'
+        QByteArray compressedText;                  ///< zlib compressed UTF-8 text, empty unless compressed
+        QList<QTextLayout::FormatRange> formats;    ///< Formatted spans of the text
+        int length = 0;                             ///< Length of the text, also while compressed
+        int lineCount = 1;                          ///< Number of '\n' separated lines of the text
+        QDateTime timestamp;                        ///< When the item was added
+        QDateTime modified;                         ///< When the text last changed
+    };
+
+    /**
+     * A link inside an item
+     */
+    struct Link {
+        int row;            ///< Item row
+        int start;          ///< Start offset in the item text
+        int length;         ///< Length of the link text
+        QString href;       ///< Link target
+    };
+
+    /**
+     * Constructor
+     * @param parent Parent object
+     */
+    explicit ConversationModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    /**
+     * Append an item
+     * @param kind Kind of the item
+     * @param text Initial text
+     * @param format Format of the initial text
+     * @return Row of the new item
+     */
+    int appendItem(Kind kind, const QString &text = QString(), const QTextCharFormat &format = QTextCharFormat());
+
+    /**
+     * Append text to the end of an item
+     * @param row Item row, ignored if out of range
+     * @param text Text to append
+     * @param format Format of the appended text
+     */
+    void appendText(int row, const QString &text, const QTextCharFormat &format = QTextCharFormat());
+
+    /**
+     * Append text on a new line of an item
+     * @param row Item row, ignored if out of range
+     * @param text Text of the line
+     * @param format Format of the line
+     */
+    void appendLine(int row, const QString &text, const QTextCharFormat &format = QTextCharFormat());
+
+    /**
+     * Append rich text to an item, keeping its character formats and links
+     * @param row Item row, ignored if out of range
+     * @param html HTML fragment
+     */
+    void appendHtml(int row, const QString &html);
+
+    /**
+     * Replace the text of an item
+     * @param row Item row, ignored if out of range
+     * @param text New text
+     * @param format Format of the new text
+     */
+    void setText(int row, const QString &text, const QTextCharFormat &format = QTextCharFormat());
+
+    /**
+     * Get an item, expanding its text if it is compressed
+     * @param row Item row, must be valid
+     * @return The item
+     */
+    Item item(int row) const;
+
+    /**
+     * Get the length of an item's text without expanding it
+     * @param row Item row, must be valid
+     * @return Length in characters
+     */
+    int textLength(int row) const;
+
+    /**
+     * Get the number of lines of an item's text without expanding it
+     * @param row Item row, must be valid
+     * @return Number of '\n' separated lines, at least 1
+     */
+    int lineCount(int row) const;
+
+    /**
+     * Get the links of all items
+     * @return Links ordered by row and offset
+     */
+    const QList<Link> &links() const;
+
+    /**
+     * Find the link at a position
+     * @param row Item row
+     * @param position Offset in the item text
+     * @return Index into links(), -1 if there is no link
+     */
+    int linkAt(int row, int position) const;
+
+    /**
+     * Get the whole conversation as plain text
+     * @return Item texts separated by newlines
+     */
+    QString toPlainText() const;
+
+    /**
+     * Remove all items
+     */
+    void clear();
+
+private:
+    /**
+     * Append text with a format to an item without notifying views
+     * @param item Item to change
+     * @param text Text to append
+     * @param format Format of the text
+     */
+    static void appendFormatted(Item &item, const QString &text, const QTextCharFormat &format);
+
+    /**
+     * Notify views that an item changed
+     * @param row Item row
+     */
+    void emitItemChanged(int row);
+
+    /**
+     * Drop the links of an item
+     * @param row Item row
+     */
+    void removeLinks(int row);
+
+    /**
+     * Get the text of an item
+     * @param row Item row
+     * @param cache Whether to keep an expanded text in the LRU cache
+     * @return The text
+     */
+    QString textAt(int row, bool cache) const;
+
+    /**
+     * Drop the compressed form of an item's text before it changes
+     * @param row Item row
+     */
+    void expandForWrite(int row);
+
+    /**
+     * Compress the text of output items that have been idle long enough
+     */
+    void compressIdleItems();
+
+    QList<Item> m_items;                            ///< Items in conversation order
+    QList<Link> m_links;                            ///< Links ordered by row and offset
+    TextCompressor m_compressor;                    ///< Compresses idle items, keeps recently read ones expanded, by row
+    QTimer m_compressionTimer;                      ///< Schedules compressIdleItems()
+};
+
+#endif // CONVERSATIONMODEL_H
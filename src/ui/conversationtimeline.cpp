@@ -0,0 +1,793 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "conversationtimeline.h"
+#include "conversationmodel.h"
+
+#include <KLocalizedString>
+
+#include <QApplication>
+#include <QClipboard>
+#include <QContextMenuEvent>
+#include <QFontMetrics>
+#include <QKeyEvent>
+#include <QMenu>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QStringList>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtMath>
+
+#include <algorithm>
+
+// Horizontal padding between the viewport edge and item text
+static const int MARGIN = 4;
+
+// Layouts kept around; far more than fit in a viewport, so scrolling back
+// and forth does not lay items out again
+static const int MAX_CACHED_LAYOUTS = 256;
+
+// Screens ahead of the scroll direction laid out on worker threads; one
+// screen behind is prefetched as well
+static const int PREFETCH_SCREENS = 3;
+
+// How long an activated link stays highlighted
+static const int FLASH_MSECS = 200;
+
+ConversationTimeline::ConversationTimeline(QWidget *parent)
+    : QAbstractScrollArea(parent)
+    , m_model(nullptr)
+    , m_validTops(0)
+    , m_layouts(MAX_CACHED_LAYOUTS)
+    , m_nextRevision(0)
+    , m_layoutWidth(0)
+    , m_scrollingUp(false)
+    , m_followTail(true)
+    , m_selecting(false)
+    , m_pressedLink(-1)
+    , m_focusedLink(-1)
+    , m_flashedLink(-1)
+{
+    setFocusPolicy(Qt::StrongFocus);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    viewport()->setMouseTracking(true);
+    viewport()->setCursor(Qt::IBeamCursor);
+
+    m_flashTimer.setSingleShot(true);
+    m_flashTimer.setInterval(FLASH_MSECS);
+    connect(&m_flashTimer, &QTimer::timeout, this, [this]() {
+        m_flashedLink = -1;
+        viewport()->update();
+    });
+
+    // Scrolling up stops following new items, scrolling to the end resumes
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [this](int value) {
+        m_followTail = value >= verticalScrollBar()->maximum();
+    });
+
+    // Only user scrolling decides which way to prefetch, not range updates
+    connect(verticalScrollBar(), &QAbstractSlider::actionTriggered, this, [this](int action) {
+        switch (action) {
+        case QAbstractSlider::SliderSingleStepSub:
+        case QAbstractSlider::SliderPageStepSub:
+        case QAbstractSlider::SliderToMinimum:
+            m_scrollingUp = true;
+            break;
+        case QAbstractSlider::SliderSingleStepAdd:
+        case QAbstractSlider::SliderPageStepAdd:
+        case QAbstractSlider::SliderToMaximum:
+            m_scrollingUp = false;
+            break;
+        case QAbstractSlider::SliderMove:
+            m_scrollingUp = verticalScrollBar()->sliderPosition() < verticalScrollBar()->value();
+            break;
+        default:
+            break;
+        }
+    });
+}
+
+ConversationTimeline::~ConversationTimeline()
+{
+    cancelPendingLayouts();
+}
+
+void ConversationTimeline::setModel(ConversationModel *model)
+{
+    if (m_model) {
+        disconnect(m_model, nullptr, this, nullptr);
+    }
+    m_model = model;
+    if (m_model) {
+        connect(m_model, &QAbstractItemModel::rowsInserted, this, &ConversationTimeline::onRowsInserted);
+        connect(m_model, &QAbstractItemModel::dataChanged, this, &ConversationTimeline::onDataChanged);
+        connect(m_model, &QAbstractItemModel::modelReset, this, &ConversationTimeline::onModelReset);
+    }
+    onModelReset();
+}
+
+ConversationModel *ConversationTimeline::model() const
+{
+    return m_model;
+}
+
+QString ConversationTimeline::selectedText() const
+{
+    if (!m_model || m_selectionAnchor.row < 0 || m_selectionAnchor == m_selectionCursor) {
+        return QString();
+    }
+
+    TextPosition start = qMin(m_selectionAnchor, m_selectionCursor);
+    TextPosition end = qMax(m_selectionAnchor, m_selectionCursor);
+    QStringList parts;
+    for (int row = start.row; row <= end.row && row < m_model->rowCount(); ++row) {
+        const QString text = m_model->item(row).text;
+        int from = row == start.row ? qMin(start.offset, int(text.size())) : 0;
+        int to = row == end.row ? qMin(end.offset, int(text.size())) : text.size();
+        parts.append(text.mid(from, to - from));
+    }
+    return parts.join(QLatin1Char('\n'));
+}
+
+void ConversationTimeline::scrollToBottom()
+{
+    m_followTail = true;
+    updateScrollBar();
+    viewport()->update();
+}
+
+void ConversationTimeline::scrollToRow(int row)
+{
+    if (row < 0 || row >= m_rows.size()) {
+        return;
+    }
+
+    layoutFor(row);
+    updateScrollBar();
+
+    QScrollBar *bar = verticalScrollBar();
+    int top = rowTop(row);
+    int bottom = top + m_rows.at(row).height;
+    if (top < bar->value()) {
+        bar->setValue(top);
+    } else if (bottom > bar->value() + viewport()->height()) {
+        bar->setValue(qMin(top, bottom - viewport()->height()));
+    }
+    viewport()->update();
+}
+
+void ConversationTimeline::copy()
+{
+    QString text = selectedText();
+    if (!text.isEmpty()) {
+        QApplication::clipboard()->setText(text);
+    }
+}
+
+void ConversationTimeline::selectAll()
+{
+    if (!m_model || m_model->rowCount() == 0) {
+        return;
+    }
+    int last = m_model->rowCount() - 1;
+    m_selectionAnchor = {0, 0};
+    m_selectionCursor = {last, m_model->textLength(last)};
+    viewport()->update();
+}
+
+void ConversationTimeline::paintEvent(QPaintEvent *event)
+{
+    if (!m_model || m_rows.isEmpty()) {
+        return;
+    }
+
+    layoutVisibleRows();
+
+    QPainter painter(viewport());
+    const int scroll = verticalScrollBar()->value();
+    const QRect clip = event->rect();
+    const QList<ConversationModel::Link> &links = m_model->links();
+
+    bool hasSelection = m_selectionAnchor.row >= 0 && !(m_selectionAnchor == m_selectionCursor);
+    TextPosition selectionStart = qMin(m_selectionAnchor, m_selectionCursor);
+    TextPosition selectionEnd = qMax(m_selectionAnchor, m_selectionCursor);
+
+    for (int row = rowAt(scroll + clip.top()); row >= 0 && row < m_rows.size(); ++row) {
+        int top = rowTop(row) - scroll;
+        if (top > clip.bottom()) {
+            break;
+        }
+
+        QTextLayout *layout = layoutFor(row);
+        QList<QTextLayout::FormatRange> overlays;
+
+        if (hasSelection && row >= selectionStart.row && row <= selectionEnd.row) {
+            QTextLayout::FormatRange range;
+            range.start = row == selectionStart.row ? selectionStart.offset : 0;
+            range.length = (row == selectionEnd.row ? selectionEnd.offset : layout->text().size()) - range.start;
+            range.format.setBackground(palette().highlight());
+            range.format.setForeground(palette().highlightedText());
+            overlays.append(range);
+        }
+
+        // Focused link in blue, a just activated one flashes red
+        for (int index : {m_focusedLink, m_flashedLink}) {
+            if (index < 0 || index >= links.size() || links.at(index).row != row) {
+                continue;
+            }
+            QTextLayout::FormatRange range;
+            range.start = links.at(index).start;
+            range.length = links.at(index).length;
+            if (index == m_flashedLink) {
+                range.format.setForeground(QBrush(QColor(200, 0, 0)));
+                range.format.setBackground(QBrush(QColor(255, 220, 220)));
+            } else {
+                range.format.setForeground(QBrush(QColor(0, 0, 200)));
+                range.format.setBackground(QBrush(QColor(200, 220, 255)));
+            }
+            overlays.append(range);
+        }
+
+        layout->draw(&painter, QPointF(MARGIN, top), overlays);
+    }
+
+    prefetchLayouts();
+}
+
+void ConversationTimeline::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+
+    if (textWidth() == m_layoutWidth) {
+        updateScrollBar();
+        return;
+    }
+
+    // Wrapping changed: drop the layouts and estimate again, keeping the
+    // first visible item in place
+    QScrollBar *bar = verticalScrollBar();
+    int anchorRow = rowAt(bar->value());
+    int anchorOffset = anchorRow >= 0 ? bar->value() - rowTop(anchorRow) : 0;
+
+    m_layoutWidth = textWidth();
+    m_layouts.clear();
+    for (int row = 0; row < m_rows.size(); ++row) {
+        setRowHeight(row, estimatedHeight(m_rows.at(row)), false);
+    }
+
+    updateScrollBar();
+    if (!m_followTail && anchorRow >= 0) {
+        bar->setValue(rowTop(anchorRow) + qMin(anchorOffset, m_rows.at(anchorRow).height));
+    }
+}
+
+void ConversationTimeline::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton || !m_model) {
+        QAbstractScrollArea::mousePressEvent(event);
+        return;
+    }
+
+    QPoint pos = event->position().toPoint();
+    m_pressPos = pos;
+    m_pressedLink = linkAt(pos);
+
+    TextPosition position = hitTest(pos);
+    if ((event->modifiers() & Qt::ShiftModifier) && m_selectionAnchor.row >= 0) {
+        m_selectionCursor = position;
+    } else {
+        m_selectionAnchor = position;
+        m_selectionCursor = position;
+    }
+    m_selecting = true;
+    viewport()->update();
+}
+
+void ConversationTimeline::mouseMoveEvent(QMouseEvent *event)
+{
+    QPoint pos = event->position().toPoint();
+
+    if (m_selecting && (event->buttons() & Qt::LeftButton)) {
+        // Scroll while dragging past the edges
+        if (pos.y() < 0) {
+            verticalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepSub);
+        } else if (pos.y() > viewport()->height()) {
+            verticalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepAdd);
+        }
+        m_selectionCursor = hitTest(pos);
+        viewport()->update();
+        return;
+    }
+
+    viewport()->setCursor(linkAt(pos) >= 0 ? Qt::PointingHandCursor : Qt::IBeamCursor);
+}
+
+void ConversationTimeline::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton || !m_selecting) {
+        QAbstractScrollArea::mouseReleaseEvent(event);
+        return;
+    }
+    m_selecting = false;
+
+    QPoint pos = event->position().toPoint();
+    bool click = (pos - m_pressPos).manhattanLength() < QApplication::startDragDistance();
+    int link = m_pressedLink;
+    m_pressedLink = -1;
+
+    if (click && link >= 0 && linkAt(pos) == link) {
+        m_selectionAnchor = TextPosition();
+        m_selectionCursor = TextPosition();
+        activateLink(link);
+        return;
+    }
+
+    QString text = selectedText();
+    if (!text.isEmpty() && QApplication::clipboard()->supportsSelection()) {
+        QApplication::clipboard()->setText(text, QClipboard::Selection);
+    }
+}
+
+void ConversationTimeline::keyPressEvent(QKeyEvent *event)
+{
+    if (event->matches(QKeySequence::Copy)) {
+        copy();
+    } else if (event->matches(QKeySequence::SelectAll)) {
+        selectAll();
+    } else if ((event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter)
+               && m_model && m_focusedLink >= 0 && m_focusedLink < m_model->links().size()) {
+        activateLink(m_focusedLink);
+    } else if (event->matches(QKeySequence::MoveToStartOfDocument)) {
+        verticalScrollBar()->setValue(0);
+    } else if (event->matches(QKeySequence::MoveToEndOfDocument)) {
+        scrollToBottom();
+    } else {
+        QAbstractScrollArea::keyPressEvent(event);
+    }
+}
+
+void ConversationTimeline::contextMenuEvent(QContextMenuEvent *event)
+{
+    int link = linkAt(event->pos());
+    if (link >= 0) {
+        Q_EMIT linkContextMenuRequested(QUrl(m_model->links().at(link).href), event->globalPos());
+        return;
+    }
+
+    QMenu menu(this);
+    QAction *copyAction = menu.addAction(QIcon::fromTheme(QStringLiteral("edit-copy")), i18n("Copy"),
+                                         this, &ConversationTimeline::copy);
+    copyAction->setEnabled(!selectedText().isEmpty());
+    menu.addAction(QIcon::fromTheme(QStringLiteral("edit-select-all")), i18n("Select All"),
+                   this, &ConversationTimeline::selectAll);
+    menu.exec(event->globalPos());
+}
+
+bool ConversationTimeline::focusNextPrevChild(bool next)
+{
+    // Tab cycles through the links, like it did in the text browser
+    if (focusLink(next)) {
+        return true;
+    }
+    return QAbstractScrollArea::focusNextPrevChild(next);
+}
+
+void ConversationTimeline::changeEvent(QEvent *event)
+{
+    if (event->type() == QEvent::FontChange) {
+        m_layouts.clear();
+        for (int row = 0; row < m_rows.size(); ++row) {
+            measureRow(row);
+        }
+        updateScrollBar();
+        viewport()->update();
+    } else if (event->type() == QEvent::PaletteChange) {
+        viewport()->update();
+    }
+    QAbstractScrollArea::changeEvent(event);
+}
+
+void ConversationTimeline::onRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    if (parent.isValid()) {
+        return;
+    }
+
+    // Rows are cached by number, inserting before the end shifts them
+    if (first < m_rows.size()) {
+        m_layouts.clear();
+    }
+    for (int row = first; row <= last; ++row) {
+        m_rows.insert(row, RowGeometry());
+        measureRow(row);
+    }
+    m_tops.resize(m_rows.size());
+    m_validTops = qMin(m_validTops, first);
+
+    updateScrollBar();
+    viewport()->update();
+}
+
+void ConversationTimeline::onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    for (int row = topLeft.row(); row <= bottomRight.row() && row < m_rows.size(); ++row) {
+        measureRow(row);
+    }
+    updateScrollBar();
+    viewport()->update();
+}
+
+void ConversationTimeline::onModelReset()
+{
+    m_layouts.clear();
+    m_rows.clear();
+    m_selectionAnchor = TextPosition();
+    m_selectionCursor = TextPosition();
+    m_selecting = false;
+    m_pressedLink = -1;
+    m_focusedLink = -1;
+    m_flashedLink = -1;
+
+    int count = m_model ? m_model->rowCount() : 0;
+    m_rows.resize(count);
+    m_tops.resize(count);
+    m_validTops = 0;
+    for (int row = 0; row < count; ++row) {
+        measureRow(row);
+    }
+
+    m_followTail = true;
+    updateScrollBar();
+    viewport()->update();
+}
+
+void ConversationTimeline::measureRow(int row)
+{
+    // A new revision orphans the old layout and any still being made
+    m_layouts.remove(layoutKey(row));
+
+    // The model keeps the counts up to date as text is appended
+    RowGeometry &geometry = m_rows[row];
+    geometry.revision = ++m_nextRevision;
+    geometry.lines = m_model->lineCount(row);
+    geometry.length = m_model->textLength(row);
+    setRowHeight(row, estimatedHeight(geometry), false);
+}
+
+int ConversationTimeline::estimatedHeight(const RowGeometry &geometry) const
+{
+    // Lines, or the wrapped length if that is more; exact for the common
+    // case of short lines, a rough guess for long ones
+    QFontMetrics metrics(font());
+    int charsPerLine = qMax(1, textWidth() / qMax(1, metrics.averageCharWidth()));
+    int wrappedLines = (geometry.length + charsPerLine - 1) / charsPerLine;
+    return metrics.lineSpacing() * qMax(geometry.lines, wrappedLines);
+}
+
+void ConversationTimeline::setRowHeight(int row, int height, bool exact)
+{
+    RowGeometry &geometry = m_rows[row];
+    geometry.exact = exact;
+    if (geometry.height != height) {
+        geometry.height = height;
+        m_validTops = qMin(m_validTops, row + 1);
+    }
+}
+
+QTextLayout *ConversationTimeline::layoutFor(int row)
+{
+    const LayoutKey key = layoutKey(row);
+    if (QTextLayout *layout = m_layouts.object(key)) {
+        return layout;
+    }
+
+    // Already being made on a worker thread: wait for it rather than
+    // doing the work twice
+    if (QFutureWatcher<QTextLayout *> *watcher = m_pendingLayouts.take(key)) {
+        watcher->disconnect(this);
+        watcher->waitForFinished();
+        QTextLayout *layout = watcher->result();
+        watcher->deleteLater();
+        adoptLayout(key, layout);
+        return layout;
+    }
+
+    const ConversationModel::Item item = m_model->item(row);
+    QTextLayout *layout = createLayout(item.text, item.formats, font(), key.width);
+    adoptLayout(key, layout);
+    return layout;
+}
+
+QTextLayout *ConversationTimeline::createLayout(const QString &text, const QList<QTextLayout::FormatRange> &formats,
+                                                const QFont &font, int width)
+{
+    // QTextLayout only breaks at line separators; same length, so the
+    // format ranges still apply
+    QString layoutText = text;
+    layoutText.replace(QLatin1Char('\n'), QChar::LineSeparator);
+
+    // QTextLayout is reentrant: a layout made here is only touched by the
+    // GUI thread once handed over. Keeping the cache enabled keeps the
+    // shaped glyphs, so painting it does not shape again.
+    QTextLayout *layout = new QTextLayout(layoutText, font);
+    QTextOption option;
+    option.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    layout->setTextOption(option);
+    layout->setFormats(formats);
+    layout->setCacheEnabled(true);
+
+    qreal height = 0;
+    layout->beginLayout();
+    for (;;) {
+        QTextLine line = layout->createLine();
+        if (!line.isValid()) {
+            break;
+        }
+        line.setLineWidth(width);
+        line.setPosition(QPointF(0, height));
+        height += line.height();
+    }
+    layout->endLayout();
+    return layout;
+}
+
+ConversationTimeline::LayoutKey ConversationTimeline::layoutKey(int row) const
+{
+    LayoutKey key;
+    key.row = row;
+    key.revision = m_rows.at(row).revision;
+    key.width = textWidth();
+    return key;
+}
+
+void ConversationTimeline::adoptLayout(const LayoutKey &key, QTextLayout *layout)
+{
+    setRowHeight(key.row, qCeil(layout->boundingRect().bottom()), true);
+    m_layouts.insert(key, layout);
+}
+
+void ConversationTimeline::prefetchLayouts()
+{
+    if (!m_model || m_rows.isEmpty()) {
+        return;
+    }
+
+    // One layout per worker keeps the pool busy without queueing work
+    // that a change of direction would make useless
+    const int maxPending = qMax(1, QThread::idealThreadCount());
+    auto request = [this, maxPending](int row) {
+        if (m_pendingLayouts.size() >= maxPending) {
+            return false;
+        }
+        const LayoutKey key = layoutKey(row);
+        if (m_layouts.contains(key) || m_pendingLayouts.contains(key)) {
+            return true;
+        }
+
+        const ConversationModel::Item item = m_model->item(row);
+        auto *watcher = new QFutureWatcher<QTextLayout *>(this);
+        m_pendingLayouts.insert(key, watcher);
+        connect(watcher, &QFutureWatcher<QTextLayout *>::finished, this, [this, watcher, key]() {
+            m_pendingLayouts.remove(key);
+            onLayoutReady(key, watcher->result());
+            watcher->deleteLater();
+            prefetchLayouts();
+        });
+        watcher->setFuture(QtConcurrent::run(&ConversationTimeline::createLayout,
+                                             item.text, item.formats, font(), key.width));
+        return true;
+    };
+
+    // Nearest items first, mostly in the direction of the last scroll
+    const int scroll = verticalScrollBar()->value();
+    const int screen = viewport()->height();
+    const int above = (m_scrollingUp ? PREFETCH_SCREENS : 1) * screen;
+    const int below = (m_scrollingUp ? 1 : PREFETCH_SCREENS) * screen;
+    const int firstVisible = rowAt(scroll);
+    const int lastVisible = rowAt(scroll + screen);
+
+    auto prefetchAbove = [&]() {
+        for (int row = firstVisible - 1; row >= 0 && rowTop(row) + m_rows.at(row).height > scroll - above; --row) {
+            if (!request(row)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto prefetchBelow = [&]() {
+        for (int row = lastVisible + 1; row < m_rows.size() && rowTop(row) < scroll + screen + below; ++row) {
+            if (!request(row)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (m_scrollingUp) {
+        if (prefetchAbove()) {
+            prefetchBelow();
+        }
+    } else if (prefetchBelow()) {
+        prefetchAbove();
+    }
+}
+
+void ConversationTimeline::onLayoutReady(const LayoutKey &key, QTextLayout *layout)
+{
+    if (key.row >= m_rows.size() || !(layoutKey(key.row) == key)) {
+        delete layout;
+        return;
+    }
+
+    QScrollBar *bar = verticalScrollBar();
+    const int oldHeight = m_rows.at(key.row).height;
+    const int top = rowTop(key.row);
+    const bool aboveViewport = top + oldHeight <= bar->value();
+    const bool visible = !aboveViewport && top < bar->value() + viewport()->height();
+
+    adoptLayout(key, layout);
+    const int delta = m_rows.at(key.row).height - oldHeight;
+    if (delta != 0) {
+        updateScrollBar();
+        // An item above the viewport got its real height; move by as much
+        // so what is on screen stays put
+        if (aboveViewport && !m_followTail) {
+            bar->setValue(bar->value() + delta);
+        }
+    }
+    if (visible) {
+        viewport()->update();
+    }
+}
+
+void ConversationTimeline::cancelPendingLayouts()
+{
+    for (QFutureWatcher<QTextLayout *> *watcher : std::as_const(m_pendingLayouts)) {
+        watcher->disconnect(this);
+        watcher->waitForFinished();
+        delete watcher->result();
+        delete watcher;
+    }
+    m_pendingLayouts.clear();
+}
+
+int ConversationTimeline::textWidth() const
+{
+    return qMax(1, viewport()->width() - 2 * MARGIN);
+}
+
+int ConversationTimeline::rowTop(int row)
+{
+    // Tops are prefix sums, brought up to date lazily from the first
+    // height that changed; appends and changes at the end are O(1)
+    if (m_validTops == 0 && !m_tops.isEmpty()) {
+        m_tops[0] = 0;
+        m_validTops = 1;
+    }
+    for (int i = m_validTops; i <= row; ++i) {
+        m_tops[i] = m_tops.at(i - 1) + m_rows.at(i - 1).height;
+    }
+    m_validTops = qMax(m_validTops, row + 1);
+    return m_tops.at(row);
+}
+
+int ConversationTimeline::contentHeight()
+{
+    if (m_rows.isEmpty()) {
+        return 0;
+    }
+    int last = m_rows.size() - 1;
+    return rowTop(last) + m_rows.at(last).height;
+}
+
+int ConversationTimeline::rowAt(int y)
+{
+    if (m_rows.isEmpty()) {
+        return -1;
+    }
+    rowTop(m_rows.size() - 1);
+    auto it = std::upper_bound(m_tops.cbegin(), m_tops.cend(), y);
+    return qMax(0, int(it - m_tops.cbegin()) - 1);
+}
+
+void ConversationTimeline::layoutVisibleRows()
+{
+    // Real heights can differ from the estimates and move other rows into
+    // view, so repeat until everything visible is laid out
+    for (int pass = 0; pass < 3; ++pass) {
+        const int scroll = verticalScrollBar()->value();
+        const int bottom = scroll + viewport()->height();
+        bool changed = false;
+        for (int row = rowAt(scroll); row >= 0 && row < m_rows.size() && rowTop(row) < bottom; ++row) {
+            if (!m_rows.at(row).exact) {
+                layoutFor(row);
+                changed = true;
+            }
+        }
+        updateScrollBar();
+        if (!changed) {
+            break;
+        }
+    }
+}
+
+void ConversationTimeline::updateScrollBar()
+{
+    QScrollBar *bar = verticalScrollBar();
+    const bool follow = m_followTail;
+
+    bar->setPageStep(viewport()->height());
+    bar->setSingleStep(QFontMetrics(font()).lineSpacing());
+    bar->setRange(0, qMax(0, contentHeight() - viewport()->height()));
+    if (follow) {
+        bar->setValue(bar->maximum());
+    }
+    m_followTail = follow;
+}
+
+ConversationTimeline::TextPosition ConversationTimeline::hitTest(const QPoint &pos, QTextLine::CursorPosition mode)
+{
+    TextPosition position;
+    if (!m_model || m_rows.isEmpty()) {
+        return position;
+    }
+
+    int y = qMax(0, pos.y() + verticalScrollBar()->value());
+    position.row = rowAt(y);
+    QTextLayout *layout = layoutFor(position.row);
+
+    if (y >= contentHeight()) {
+        position.offset = layout->text().size();
+        return position;
+    }
+
+    qreal localY = y - rowTop(position.row);
+    for (int i = 0; i < layout->lineCount(); ++i) {
+        QTextLine line = layout->lineAt(i);
+        if (localY < line.y() + line.height() || i == layout->lineCount() - 1) {
+            position.offset = line.xToCursor(pos.x() - MARGIN, mode);
+            break;
+        }
+    }
+    return position;
+}
+
+int ConversationTimeline::linkAt(const QPoint &pos)
+{
+    if (!m_model || m_model->links().isEmpty()) {
+        return -1;
+    }
+    TextPosition position = hitTest(pos, QTextLine::CursorOnCharacter);
+    return position.row >= 0 ? m_model->linkAt(position.row, position.offset) : -1;
+}
+
+bool ConversationTimeline::focusLink(bool forward)
+{
+    if (!m_model || m_model->links().isEmpty()) {
+        return false;
+    }
+
+    int count = m_model->links().size();
+    if (m_focusedLink < 0 || m_focusedLink >= count) {
+        m_focusedLink = forward ? 0 : count - 1;
+    } else {
+        m_focusedLink = (m_focusedLink + (forward ? 1 : -1) + count) % count;
+    }
+    scrollToRow(m_model->links().at(m_focusedLink).row);
+    return true;
+}
+
+void ConversationTimeline::activateLink(int index)
+{
+    QUrl url(m_model->links().at(index).href);
+    m_flashedLink = index;
+    m_flashTimer.start();
+    viewport()->update();
+    Q_EMIT linkActivated(url);
+}
+
+#include "moc_conversationtimeline.cpp"
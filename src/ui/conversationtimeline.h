@@ -0,0 +1,337 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef CONVERSATIONTIMELINE_H
+#define CONVERSATIONTIMELINE_H
+
+#include <QAbstractScrollArea>
+#include <QCache>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QPoint>
+#include <QTextLayout>
+#include <QTimer>
+#include <QUrl>
+
+class ConversationModel;
+
+/**
+ * @brief The ConversationTimeline class
+ *
+ * Virtualized view of a ConversationModel. Each item gets its own
+ * QTextLayout, kept in a bounded cache keyed by the item's content
+ * revision and the wrap width, so only the items near the viewport are
+ * ever laid out. Items not laid out yet use a height estimated from their
+ * line count and length; the estimate is replaced by the real height once
+ * the item has a layout. Appending an item therefore costs the same no
+ * matter how long the conversation is, and the view stays scrolled to the
+ * end if it was there.
+ *
+ * Line breaking and shaping of the items a few screens ahead of the
+ * scroll direction run on the global thread pool, so by the time an item
+ * scrolls into view its layout is usually ready and painting only draws
+ * the shaped glyphs. Items that scroll in before their layout arrives are
+ * laid out on the spot, as before.
+ *
+ * Supports mouse selection across items, copying, clicking links and
+ * cycling through links with Tab and Shift+Tab.
+ */
+class ConversationTimeline : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor
+     * @param parent Parent widget
+     */
+    explicit ConversationTimeline(QWidget *parent = nullptr);
+
+    /**
+     * Destructor, waits for layouts still being made on worker threads
+     */
+    ~ConversationTimeline() override;
+
+    /**
+     * Set the model to show
+     * @param model Conversation model, not owned
+     */
+    void setModel(ConversationModel *model);
+
+    /**
+     * Get the model shown
+     * @return Conversation model
+     */
+    ConversationModel *model() const;
+
+    /**
+     * Get the selected text
+     * @return Selected text, lines separated by '\n'
+     */
+    QString selectedText() const;
+
+    /**
+     * Scroll to the end and follow new items
+     */
+    void scrollToBottom();
+
+    /**
+     * Scroll so that an item is visible
+     * @param row Item row
+     */
+    void scrollToRow(int row);
+
+public Q_SLOTS:
+    /**
+     * Copy the selected text to the clipboard
+     */
+    void copy();
+
+    /**
+     * Select the whole conversation
+     */
+    void selectAll();
+
+Q_SIGNALS:
+    /**
+     * Emitted when a link was clicked or activated with Enter
+     * @param url Link target
+     */
+    void linkActivated(const QUrl &url);
+
+    /**
+     * Emitted when the context menu was requested on a link
+     * @param url Link target
+     * @param globalPos Position for the menu
+     */
+    void linkContextMenuRequested(const QUrl &url, const QPoint &globalPos);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
+    bool focusNextPrevChild(bool next) override;
+    void changeEvent(QEvent *event) override;
+
+private:
+    /**
+     * A position in the conversation
+     */
+    struct TextPosition {
+        int row = -1;       ///< Item row, -1 if none
+        int offset = 0;     ///< Offset in the item text
+
+        bool operator<(const TextPosition &other) const {
+            return row < other.row || (row == other.row && offset < other.offset);
+        }
+        bool operator==(const TextPosition &other) const {
+            return row == other.row && offset == other.offset;
+        }
+    };
+
+    /**
+     * Geometry of an item
+     */
+    struct RowGeometry {
+        int height = 0;         ///< Height in pixels, estimated unless exact
+        int lines = 1;          ///< Number of '\n' separated lines
+        int length = 0;         ///< Length of the text
+        bool exact = false;     ///< Whether height comes from a layout
+        quint64 revision = 0;   ///< Identifies the current content of the item
+    };
+
+    /**
+     * Cache key of a layout: an item's content at a wrap width
+     */
+    struct LayoutKey {
+        int row = -1;           ///< Item row
+        quint64 revision = 0;   ///< Content revision of the item
+        int width = 0;          ///< Width the text is wrapped at
+
+        bool operator==(const LayoutKey &other) const {
+            return row == other.row && revision == other.revision && width == other.width;
+        }
+        friend size_t qHash(const LayoutKey &key, size_t seed = 0) {
+            return qHashMulti(seed, key.row, key.revision, key.width);
+        }
+    };
+
+    /**
+     * Handle items appended to the model
+     */
+    void onRowsInserted(const QModelIndex &parent, int first, int last);
+
+    /**
+     * Handle items changed in place
+     */
+    void onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+
+    /**
+     * Rebuild all geometry after a model reset
+     */
+    void onModelReset();
+
+    /**
+     * Refresh the line count, length and estimated height of an item
+     * @param row Item row
+     */
+    void measureRow(int row);
+
+    /**
+     * Estimate the height of an item without laying it out
+     * @param geometry Item geometry with lines and length set
+     * @return Height in pixels
+     */
+    int estimatedHeight(const RowGeometry &geometry) const;
+
+    /**
+     * Set the height of an item and invalidate the tops below it
+     * @param row Item row
+     * @param height New height
+     * @param exact Whether the height comes from a layout
+     */
+    void setRowHeight(int row, int height, bool exact);
+
+    /**
+     * Get the layout of an item, laying it out if needed
+     * @param row Item row
+     * @return Layout owned by the cache, valid until the next call
+     */
+    QTextLayout *layoutFor(int row);
+
+    /**
+     * Lay out text; safe to call from worker threads
+     * @param text Item text, lines separated by '\n'
+     * @param formats Formatted spans of the text
+     * @param font Font to shape with
+     * @param width Width to wrap at
+     * @return New layout, owned by the caller
+     */
+    static QTextLayout *createLayout(const QString &text, const QList<QTextLayout::FormatRange> &formats,
+                                     const QFont &font, int width);
+
+    /**
+     * Get the cache key of the current content of an item
+     * @param row Item row
+     * @return Key at the current width
+     */
+    LayoutKey layoutKey(int row) const;
+
+    /**
+     * Cache a layout and take its height as the exact height of the item
+     * @param key Key the layout was made for, must be current
+     * @param layout Layout, ownership passes to the cache
+     */
+    void adoptLayout(const LayoutKey &key, QTextLayout *layout);
+
+    /**
+     * Start laying out the items ahead of the scroll position on worker threads
+     */
+    void prefetchLayouts();
+
+    /**
+     * Take a layout made on a worker thread, dropping it if the item or
+     * the width changed meanwhile
+     * @param key Key the layout was made for
+     * @param layout Layout, ownership passes to the view
+     */
+    void onLayoutReady(const LayoutKey &key, QTextLayout *layout);
+
+    /**
+     * Wait for and drop all layouts still being made
+     */
+    void cancelPendingLayouts();
+
+    /**
+     * Get the width available to item text
+     * @return Width in pixels
+     */
+    int textWidth() const;
+
+    /**
+     * Get the top of an item in content coordinates
+     * @param row Item row
+     * @return Y coordinate
+     */
+    int rowTop(int row);
+
+    /**
+     * Get the height of all items
+     * @return Height in pixels
+     */
+    int contentHeight();
+
+    /**
+     * Find the item at a height
+     * @param y Y coordinate in content coordinates
+     * @return Item row, -1 if there are no items
+     */
+    int rowAt(int y);
+
+    /**
+     * Lay out the items in the viewport so their heights are exact
+     */
+    void layoutVisibleRows();
+
+    /**
+     * Update the scroll bar range, keeping the end in view when following
+     */
+    void updateScrollBar();
+
+    /**
+     * Map a viewport position to a position in the conversation
+     * @param pos Viewport position
+     * @param mode Whether to snap to the nearest boundary or the character under pos
+     * @return Position, row -1 if there are no items
+     */
+    TextPosition hitTest(const QPoint &pos, QTextLine::CursorPosition mode = QTextLine::CursorBetweenCharacters);
+
+    /**
+     * Find the link under a viewport position
+     * @param pos Viewport position
+     * @return Index into the model's links, -1 if none
+     */
+    int linkAt(const QPoint &pos);
+
+    /**
+     * Focus the next or previous link
+     * @param forward Direction
+     * @return True if there was a link to focus
+     */
+    bool focusLink(bool forward);
+
+    /**
+     * Activate a link, briefly highlighting it
+     * @param index Index into the model's links
+     */
+    void activateLink(int index);
+
+private:
+    ConversationModel *m_model;                 ///< Model shown, not owned
+    QList<RowGeometry> m_rows;                  ///< Geometry per item
+    QList<int> m_tops;                          ///< Top of each item in content coordinates
+    int m_validTops;                            ///< Number of leading entries of m_tops that are current
+    QCache<LayoutKey, QTextLayout> m_layouts;   ///< Layouts of recently shown and prefetched items
+    QHash<LayoutKey, QFutureWatcher<QTextLayout *> *> m_pendingLayouts; ///< Layouts being made on worker threads
+    quint64 m_nextRevision;                     ///< Next content revision to hand out
+    int m_layoutWidth;                          ///< Width the cached layouts were made for
+    bool m_scrollingUp;                         ///< Direction of the last scroll, for prefetching
+    bool m_followTail;                          ///< Whether to stay scrolled to the end
+    TextPosition m_selectionAnchor;             ///< Where the selection started
+    TextPosition m_selectionCursor;             ///< Where the selection ends
+    bool m_selecting;                           ///< Whether a drag selection is in progress
+    QPoint m_pressPos;                          ///< Where the left button went down
+    int m_pressedLink;                          ///< Link under the press, -1 if none
+    int m_focusedLink;                          ///< Link focused with Tab, -1 if none
+    int m_flashedLink;                          ///< Link shown as just activated, -1 if none
+    QTimer m_flashTimer;                        ///< Ends the activation highlight
+};
+
+#endif // CONVERSATIONTIMELINE_H
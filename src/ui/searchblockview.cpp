@@ -0,0 +1,279 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "searchblockview.h"
+#include "searchresultmodel.h"
+#include "terminal/ripgrepsearch.h"
+
+#include <KLocalizedString>
+#include <KShell>
+
+#include <QFontDatabase>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QListView>
+#include <QLocale>
+#include <QPainter>
+#include <QStyledItemDelegate>
+#include <QToolButton>
+#include <QVBoxLayout>
+
+// Status updates while results stream in are at most this frequent (ms)
+static const int STATUS_INTERVAL = 100;
+
+// Spaces a tab is shown as
+static const int TAB_WIDTH = 4;
+
+// Horizontal padding of a row (px)
+static const int ROW_PADDING = 6;
+
+/**
+ * Paints file headers and result lines of a SearchResultModel
+ */
+class SearchResultDelegate : public QStyledItemDelegate
+{
+public:
+    using QStyledItemDelegate::QStyledItemDelegate;
+
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override
+    {
+        Q_UNUSED(index)
+        // Uniform item sizes: every row is one line of the view's font
+        return QSize(option.rect.width(), option.fontMetrics.height() + 4);
+    }
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override
+    {
+        painter->save();
+
+        const QPalette &palette = option.palette;
+        const bool selected = option.state & QStyle::State_Selected;
+        if (selected) {
+            painter->fillRect(option.rect, palette.highlight());
+        } else if (option.state & QStyle::State_MouseOver) {
+            painter->fillRect(option.rect, palette.alternateBase());
+        }
+
+        const QFontMetrics &metrics = option.fontMetrics;
+        QRect rect = option.rect.adjusted(ROW_PADDING, 0, -ROW_PADDING, 0);
+        const int baseline = rect.top() + (rect.height() - metrics.height()) / 2 + metrics.ascent();
+        const QColor text = selected ? palette.highlightedText().color() : palette.text().color();
+
+        if (index.data(SearchResultModel::IsFileRole).toBool()) {
+            QFont bold = option.font;
+            bold.setBold(true);
+            painter->setFont(bold);
+            painter->setPen(text);
+            const QString path = index.data(Qt::DisplayRole).toString();
+            painter->drawText(rect.left(), baseline, QFontMetrics(bold).elidedText(path, Qt::ElideMiddle, rect.width() * 3 / 4));
+
+            painter->setFont(option.font);
+            painter->setPen(selected ? text : palette.placeholderText().color());
+            const int matches = index.data(SearchResultModel::MatchCountRole).toInt();
+            painter->drawText(rect, Qt::AlignRight | Qt::AlignVCenter, QLocale().toString(matches));
+            painter->restore();
+            return;
+        }
+
+        // Line number gutter, wide enough for six digits
+        const int gutter = metrics.horizontalAdvance(QLatin1Char('0')) * 7;
+        const bool context = index.data(SearchResultModel::ContextRole).toBool();
+        painter->setPen(selected ? text : palette.placeholderText().color());
+        painter->drawText(QRect(rect.left(), rect.top(), gutter - metrics.horizontalAdvance(QLatin1Char(' ')), rect.height()),
+                          Qt::AlignRight | Qt::AlignVCenter,
+                          QString::number(index.data(SearchResultModel::LineNumberRole).toInt()));
+
+        // Tabs are expanded to spaces, so match ranges move with them
+        const QString raw = index.data(Qt::DisplayRole).toString();
+        const QVector<QPair<int, int>> ranges = index.data(SearchResultModel::MatchRangesRole).value<QVector<QPair<int, int>>>();
+        QString line;
+        line.reserve(raw.size());
+        QVector<int> positions(raw.size() + 1);
+        for (int i = 0; i < raw.size(); ++i) {
+            positions[i] = line.size();
+            if (raw.at(i) == QLatin1Char('\t')) {
+                line.append(QString(TAB_WIDTH - line.size() % TAB_WIDTH, QLatin1Char(' ')));
+            } else {
+                line.append(raw.at(i));
+            }
+        }
+        positions[raw.size()] = line.size();
+
+        QColor lineColor = text;
+        if (context && !selected) {
+            lineColor = palette.placeholderText().color();
+        }
+
+        const int left = rect.left() + gutter;
+        const int right = rect.right();
+        painter->setClipRect(QRect(left, rect.top(), right - left, rect.height()));
+
+        int drawn = 0;
+        int x = left;
+        auto drawSpan = [&](int from, int to, bool match) {
+            if (to <= from) {
+                return;
+            }
+            const QString span = line.mid(from, to - from);
+            const int width = metrics.horizontalAdvance(span);
+            if (match) {
+                QColor background = palette.link().color();
+                background.setAlpha(selected ? 160 : 80);
+                painter->fillRect(QRect(x, rect.top() + 1, width, rect.height() - 2), background);
+            }
+            painter->setPen(lineColor);
+            painter->drawText(x, baseline, span);
+            x += width;
+        };
+
+        for (const QPair<int, int> &range : std::as_const(ranges)) {
+            const int start = positions.value(qBound(0, range.first, int(raw.size())));
+            const int end = positions.value(qBound(0, range.first + range.second, int(raw.size())));
+            if (start < drawn || x > right) {
+                continue;
+            }
+            drawSpan(drawn, start, false);
+            drawSpan(start, end, true);
+            drawn = end;
+        }
+        if (x <= right) {
+            drawSpan(drawn, line.size(), false);
+        }
+
+        painter->restore();
+    }
+};
+
+SearchBlockView::SearchBlockView(QWidget *parent)
+    : QWidget(parent)
+    , m_search(new RipgrepSearch(this))
+    , m_model(new SearchResultModel(m_search, this))
+    , m_titleLabel(new QLabel(this))
+    , m_statusLabel(new QLabel(this))
+    , m_stopButton(new QToolButton(this))
+    , m_closeButton(new QToolButton(this))
+    , m_resultView(new QListView(this))
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(2);
+
+    // Header: command, counts, stop and close
+    QHBoxLayout *headerLayout = new QHBoxLayout();
+    QFont titleFont = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    titleFont.setBold(true);
+    m_titleLabel->setFont(titleFont);
+    m_titleLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    headerLayout->addWidget(m_titleLabel, 1);
+    headerLayout->addWidget(m_statusLabel);
+
+    m_stopButton->setIcon(QIcon::fromTheme(QStringLiteral("process-stop")));
+    m_stopButton->setToolTip(i18n("Stop the search"));
+    m_stopButton->setAutoRaise(true);
+    headerLayout->addWidget(m_stopButton);
+
+    m_closeButton->setIcon(QIcon::fromTheme(QStringLiteral("window-close")));
+    m_closeButton->setToolTip(i18n("Close the search results"));
+    m_closeButton->setAutoRaise(true);
+    headerLayout->addWidget(m_closeButton);
+    layout->addLayout(headerLayout);
+
+    // Uniform sizes and batched layout keep the cost per frame independent of the result count
+    m_resultView->setModel(m_model);
+    m_resultView->setItemDelegate(new SearchResultDelegate(m_resultView));
+    m_resultView->setUniformItemSizes(true);
+    m_resultView->setLayoutMode(QListView::Batched);
+    m_resultView->setBatchSize(1000);
+    m_resultView->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    m_resultView->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    m_resultView->setMouseTracking(true);
+    m_resultView->setSelectionMode(QAbstractItemView::SingleSelection);
+    layout->addWidget(m_resultView, 1);
+
+    m_statusTimer.setSingleShot(true);
+    m_statusTimer.setInterval(STATUS_INTERVAL);
+    connect(&m_statusTimer, &QTimer::timeout, this, &SearchBlockView::updateStatus);
+
+    connect(m_search, &RipgrepSearch::resultsAdded, this, [this]() {
+        if (!m_statusTimer.isActive()) {
+            m_statusTimer.start();
+        }
+    });
+    connect(m_search, &RipgrepSearch::finished, this, [this]() {
+        m_statusTimer.stop();
+        updateStatus();
+    });
+    connect(m_stopButton, &QToolButton::clicked, m_search, &RipgrepSearch::cancel);
+    connect(m_closeButton, &QToolButton::clicked, this, [this]() {
+        m_search->cancel();
+        Q_EMIT closeRequested();
+    });
+    connect(m_resultView, &QListView::clicked, this, &SearchBlockView::onActivated);
+    connect(m_resultView, &QListView::activated, this, &SearchBlockView::onActivated);
+}
+
+bool SearchBlockView::start(const QStringList &arguments, const QString &directory)
+{
+    m_titleLabel->setText(QStringLiteral("$ rg ") + KShell::joinArgs(arguments));
+    m_titleLabel->setToolTip(directory);
+
+    bool started = m_search->start(arguments, directory);
+    updateStatus();
+    return started;
+}
+
+RipgrepSearch *SearchBlockView::search() const
+{
+    return m_search;
+}
+
+void SearchBlockView::onActivated(const QModelIndex &index)
+{
+    int file;
+    int line;
+    if (!m_model->locate(index.row(), &file, &line)) {
+        return;
+    }
+
+    // A file header opens at its first result
+    if (line < 0) {
+        if (m_search->file(file).lineCount == 0) {
+            Q_EMIT openRequested(m_search->filePath(file), 1, 0);
+            return;
+        }
+        line = m_search->file(file).firstLine;
+    }
+
+    const SearchLine &result = m_search->line(line);
+    Q_EMIT openRequested(m_search->filePath(file), result.lineNumber, result.column);
+}
+
+void SearchBlockView::updateStatus()
+{
+    const QLocale locale;
+    QString status = i18n("%1 matches in %2 files, %3 s",
+                          locale.toString(m_search->matchCount()),
+                          locale.toString(m_search->fileCount()),
+                          locale.toString(m_search->elapsed() / 1000.0, 'f', 2));
+    QStringList notes;
+    if (m_search->isTextTruncated()) {
+        notes.append(i18n("Too many results to keep all their text; later lines show only their file and line number."));
+        status += i18n(" (results truncated)");
+    }
+    if (!m_search->isRunning() && !m_search->errorOutput().isEmpty()) {
+        notes.append(m_search->errorOutput());
+        status += i18n(" (errors)");
+    }
+    m_statusLabel->setToolTip(notes.join(QLatin1Char('\n')));
+    m_statusLabel->setText(status);
+    m_stopButton->setEnabled(m_search->isRunning());
+
+    // Keep the run time ticking while rg runs
+    if (m_search->isRunning()) {
+        m_statusTimer.start();
+    }
+}
+
+#include "moc_searchblockview.cpp"
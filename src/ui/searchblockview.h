@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef SEARCHBLOCKVIEW_H
+#define SEARCHBLOCKVIEW_H
+
+#include <QStringList>
+#include <QTimer>
+#include <QWidget>
+
+class QLabel;
+class QListView;
+class QModelIndex;
+class QToolButton;
+class RipgrepSearch;
+class SearchResultModel;
+
+/**
+ * @brief The SearchBlockView class
+ *
+ * Shows the results of an rg search as they stream in: one row per file
+ * with its match count, followed by its matching and context lines with
+ * the matches highlighted. The rows are a flat list with uniform item
+ * sizes, so the view only ever touches the rows on screen and keeps up
+ * with millions of results; they are not collapsible, which would need a
+ * tree model and cost that guarantee.
+ *
+ * Clicking a line asks for its file to be opened at the match, clicking a
+ * file opens it at its first result.
+ */
+class SearchBlockView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor
+     * @param parent Parent widget
+     */
+    explicit SearchBlockView(QWidget *parent = nullptr);
+
+    /**
+     * Start a search, replacing the results shown
+     * @param arguments Arguments after "rg"
+     * @param directory Directory to search in
+     * @return True if rg started
+     */
+    bool start(const QStringList &arguments, const QString &directory);
+
+    /**
+     * Get the search whose results are shown
+     * @return The search
+     */
+    RipgrepSearch *search() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted when a result was clicked
+     * @param filePath Absolute path of the file
+     * @param line Line number, 1-based
+     * @param column Column of the first match, 0-based
+     */
+    void openRequested(const QString &filePath, int line, int column);
+
+    /**
+     * Emitted when the close button was clicked
+     */
+    void closeRequested();
+
+private:
+    /**
+     * Open the file and line of a clicked row
+     * @param index Row clicked
+     */
+    void onActivated(const QModelIndex &index);
+
+    /**
+     * Show the counts and run time
+     */
+    void updateStatus();
+
+    RipgrepSearch *m_search;            ///< Search whose results are shown
+    SearchResultModel *m_model;         ///< Rows of the results
+    QLabel *m_titleLabel;               ///< The rg command
+    QLabel *m_statusLabel;              ///< Counts and run time
+    QToolButton *m_stopButton;          ///< Kills rg
+    QToolButton *m_closeButton;         ///< Hides the block
+    QListView *m_resultView;            ///< Virtualized result list
+    QTimer m_statusTimer;               ///< Throttles status updates while results stream in
+};
+
+#endif // SEARCHBLOCKVIEW_H
@@ -0,0 +1,127 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "searchresultmodel.h"
+#include "terminal/ripgrepsearch.h"
+
+SearchResultModel::SearchResultModel(RipgrepSearch *search, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_search(search)
+    , m_rowCount(0)
+{
+    connect(m_search, &RipgrepSearch::resultsAboutToBeCleared, this, &SearchResultModel::onResultsAboutToBeCleared);
+    connect(m_search, &RipgrepSearch::resultsCleared, this, &SearchResultModel::onResultsCleared);
+    connect(m_search, &RipgrepSearch::resultsAdded, this, &SearchResultModel::onResultsAdded);
+}
+
+int SearchResultModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rowCount;
+}
+
+QVariant SearchResultModel::data(const QModelIndex &index, int role) const
+{
+    int file;
+    int line;
+    if (!index.isValid() || !locate(index.row(), &file, &line)) {
+        return QVariant();
+    }
+
+    if (line < 0) {
+        switch (role) {
+        case Qt::DisplayRole:
+            return m_search->file(file).path;
+        case Qt::ToolTipRole:
+        case FilePathRole:
+            return m_search->filePath(file);
+        case IsFileRole:
+            return true;
+        case MatchCountRole:
+            return m_search->file(file).matchCount;
+        default:
+            return QVariant();
+        }
+    }
+
+    const SearchLine &result = m_search->line(line);
+    switch (role) {
+    case Qt::DisplayRole:
+        return m_search->lineText(line);
+    case FilePathRole:
+        return m_search->filePath(file);
+    case IsFileRole:
+        return false;
+    case LineNumberRole:
+        return result.lineNumber;
+    case ColumnRole:
+        return result.column;
+    case MatchRangesRole:
+        return QVariant::fromValue(m_search->matchRanges(line));
+    case ContextRole:
+        return result.context;
+    default:
+        return QVariant();
+    }
+}
+
+void SearchResultModel::onResultsAboutToBeCleared()
+{
+    beginResetModel();
+}
+
+void SearchResultModel::onResultsCleared()
+{
+    m_rowCount = 0;
+    endResetModel();
+}
+
+bool SearchResultModel::locate(int row, int *file, int *line) const
+{
+    if (row < 0 || row >= m_rowCount || m_search->fileCount() == 0) {
+        return false;
+    }
+
+    // Last file whose header is at or before the row
+    int low = 0;
+    int high = m_search->fileCount() - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (headerRow(middle) <= row) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    *file = low;
+    int header = headerRow(low);
+    *line = row == header ? -1 : m_search->file(low).firstLine + row - header - 1;
+    return true;
+}
+
+void SearchResultModel::onResultsAdded(int firstFile, int firstLine)
+{
+    Q_UNUSED(firstLine)
+
+    // The file that was last may have grown, its header shows the match count
+    if (firstFile > 0 && m_rowCount > 0) {
+        QModelIndex header = index(headerRow(firstFile - 1));
+        Q_EMIT dataChanged(header, header, {MatchCountRole});
+    }
+
+    const int rows = m_search->fileCount() + m_search->lineCount();
+    if (rows > m_rowCount) {
+        beginInsertRows(QModelIndex(), m_rowCount, rows - 1);
+        m_rowCount = rows;
+        endInsertRows();
+    }
+}
+
+int SearchResultModel::headerRow(int file) const
+{
+    return file + m_search->file(file).firstLine;
+}
+
+#include "moc_searchresultmodel.cpp"
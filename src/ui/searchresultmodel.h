@@ -0,0 +1,89 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef SEARCHRESULTMODEL_H
+#define SEARCHRESULTMODEL_H
+
+#include <QAbstractListModel>
+
+class RipgrepSearch;
+
+/**
+ * @brief Flat list model over the results of a ripgrep search
+ *
+ * Each file is a header row followed by its result lines. Rows are
+ * computed from the search's index, nothing is copied: the header of file
+ * f is at row f + firstLine(f), so a row is found with a binary search
+ * over the files. As only the last file grows and new files come after
+ * it, results are only ever appended at the end, which a QListView with
+ * uniform item sizes shows without laying out the rows off screen.
+ */
+class SearchResultModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Custom data roles, DisplayRole holds the path or line text
+     */
+    enum Roles {
+        IsFileRole = Qt::UserRole + 1,  ///< Whether the row is a file header
+        FilePathRole,                   ///< Absolute path of the row's file
+        MatchCountRole,                 ///< Matches in the file, for headers
+        LineNumberRole,                 ///< Line number, 1-based
+        ColumnRole,                     ///< Column of the first match, 0-based
+        MatchRangesRole,                ///< QVector<QPair<int, int>> of match start and length in the text
+        ContextRole                     ///< Whether the line is context rather than a match
+    };
+
+    /**
+     * Constructor
+     * @param search Search whose results are shown
+     * @param parent Parent object
+     */
+    explicit SearchResultModel(RipgrepSearch *search, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    /**
+     * Find what a row shows
+     * @param row Row
+     * @param file Receives the file index
+     * @param line Receives the line index, -1 for the file header
+     * @return False if the row is out of range
+     */
+    bool locate(int row, int *file, int *line) const;
+
+private:
+    /**
+     * Start the reset for a restarted search, before its results are dropped
+     */
+    void onResultsAboutToBeCleared();
+
+    /**
+     * Finish the reset once the results are dropped
+     */
+    void onResultsCleared();
+
+    /**
+     * Append the rows of new results
+     * @param firstFile Index of the first new file
+     * @param firstLine Index of the first new line
+     */
+    void onResultsAdded(int firstFile, int firstLine);
+
+    /**
+     * Get the row of a file header
+     * @param file File index
+     * @return Row
+     */
+    int headerRow(int file) const;
+
+    RipgrepSearch *m_search;    ///< Search whose results are shown
+    int m_rowCount;             ///< Rows announced to views
+};
+
+#endif // SEARCHRESULTMODEL_H
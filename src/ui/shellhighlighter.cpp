@@ -0,0 +1,176 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "shellhighlighter.h"
+
+#include <QColor>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+
+ShellHighlighter::ShellHighlighter(QTextDocument *document)
+    : QSyntaxHighlighter(document)
+{
+    // Tango colors, for the black input background
+    QTextCharFormat &command = m_formats[int(ShellTokenKind::Command)];
+    command.setForeground(QColor(QStringLiteral("#8ae234")));
+    command.setFontWeight(QFont::Bold);
+
+    m_formats[int(ShellTokenKind::Keyword)].setForeground(QColor(QStringLiteral("#ad7fa8")));
+    m_formats[int(ShellTokenKind::Keyword)].setFontWeight(QFont::Bold);
+    m_formats[int(ShellTokenKind::Assignment)].setForeground(QColor(QStringLiteral("#fcaf3e")));
+    m_formats[int(ShellTokenKind::Option)].setForeground(QColor(QStringLiteral("#729fcf")));
+    m_formats[int(ShellTokenKind::Path)].setFontUnderline(true);
+    m_formats[int(ShellTokenKind::Operator)].setForeground(QColor(QStringLiteral("#fce94f")));
+    m_formats[int(ShellTokenKind::Redirection)].setForeground(QColor(QStringLiteral("#fce94f")));
+    m_formats[int(ShellTokenKind::HeredocDelimiter)].setForeground(QColor(QStringLiteral("#fce94f")));
+    m_formats[int(ShellTokenKind::HeredocBody)].setForeground(QColor(QStringLiteral("#e9b96e")));
+
+    QTextCharFormat &comment = m_formats[int(ShellTokenKind::Comment)];
+    comment.setForeground(QColor(QStringLiteral("#888a85")));
+    comment.setFontItalic(true);
+
+    m_stringFormat.setForeground(QColor(QStringLiteral("#e9b96e")));
+    m_variableFormat.setForeground(QColor(QStringLiteral("#34e2e2")));
+}
+
+ShellCompletionContext ShellHighlighter::completionContext(const QTextCursor &cursor) const
+{
+    const QTextBlock block = cursor.block();
+    const ShellBlockData *data = static_cast<ShellBlockData *>(block.userData());
+    if (!data) {
+        return ShellCompletionContext();
+    }
+
+    // Normally up to date, as highlighting follows every change
+    ShellLine line = data->line;
+    if (line.text != block.text()) {
+        ShellTokenizer::relex(block.text(), line.startState, &line);
+    }
+
+    ShellCompletionContext context = ShellTokenizer::completionContext(line, cursor.positionInBlock());
+    context.prefixStart += block.position();
+    return context;
+}
+
+void ShellHighlighter::highlightBlock(const QString &text)
+{
+    ShellBlockData *data = static_cast<ShellBlockData *>(currentBlockUserData());
+    if (!data) {
+        data = new ShellBlockData;
+        setCurrentBlockUserData(data);
+    }
+
+    ShellLexState startState;
+    const QTextBlock previous = currentBlock().previous();
+    if (const ShellBlockData *previousData = static_cast<ShellBlockData *>(previous.userData())) {
+        startState = previousData->line.endState;
+    }
+
+    ShellTokenizer::relex(text, startState, &data->line);
+
+    for (const ShellToken &token : std::as_const(data->line.tokens)) {
+        setFormat(token.start, token.length, m_formats[int(token.kind)]);
+
+        switch (token.kind) {
+        case ShellTokenKind::Command:
+        case ShellTokenKind::Assignment:
+        case ShellTokenKind::Option:
+        case ShellTokenKind::Argument:
+        case ShellTokenKind::Path:
+            highlightWord(token, text);
+            break;
+        default:
+            break;
+        }
+    }
+
+    setCurrentBlockState(ShellTokenizer::stateHash(data->line.endState));
+}
+
+void ShellHighlighter::highlightWord(const ShellToken &token, const QString &text)
+{
+    const int end = token.start + token.length;
+    QChar quote = token.quote;
+    int quoteStart = quote.isNull() ? -1 : token.start;
+    QVector<QPair<int, int>> expansions;
+
+    for (int pos = token.start; pos < end; ++pos) {
+        const QChar c = text.at(pos);
+
+        if (c == QLatin1Char('\\') && quote != QLatin1Char('\'')) {
+            ++pos;
+            continue;
+        }
+
+        if (quote.isNull() && (c == QLatin1Char('\'') || c == QLatin1Char('"') || c == QLatin1Char('`'))) {
+            quote = c;
+            quoteStart = pos;
+            continue;
+        }
+        if (quote.isNull() && c == QLatin1Char('$') && pos + 1 < end && text.at(pos + 1) == QLatin1Char('\'')) {
+            quote = QLatin1Char('$');
+            quoteStart = pos++;
+            continue;
+        }
+
+        if (!quote.isNull()) {
+            const QChar closing = quote == QLatin1Char('$') ? QLatin1Char('\'') : quote;
+            if (c == closing) {
+                // Backquotes are command substitution, like $( )
+                if (quote == QLatin1Char('`')) {
+                    expansions.append({quoteStart, pos + 1 - quoteStart});
+                } else {
+                    setFormat(quoteStart, pos + 1 - quoteStart, m_stringFormat);
+                }
+                quote = QChar();
+                quoteStart = -1;
+                continue;
+            }
+            if (quote == QLatin1Char('\'') || quote == QLatin1Char('$') || quote == QLatin1Char('`')) {
+                continue;
+            }
+        }
+
+        // $NAME, $1, $?, ${...} and $( ), also inside double quotes
+        if (c == QLatin1Char('$') && pos + 1 < end) {
+            const QChar next = text.at(pos + 1);
+            int expansionEnd = pos + 1;
+            if (next == QLatin1Char('{') || next == QLatin1Char('(')) {
+                const QChar closing = next == QLatin1Char('{') ? QLatin1Char('}') : QLatin1Char(')');
+                int depth = 0;
+                while (expansionEnd < end) {
+                    const QChar e = text.at(expansionEnd++);
+                    if (e == next) {
+                        ++depth;
+                    } else if (e == closing && --depth == 0) {
+                        break;
+                    }
+                }
+            } else if (next.isLetter() || next == QLatin1Char('_')) {
+                while (expansionEnd < end && (text.at(expansionEnd).isLetterOrNumber() || text.at(expansionEnd) == QLatin1Char('_'))) {
+                    ++expansionEnd;
+                }
+            } else if (next.isDigit() || QStringLiteral("?!#*@$-").contains(next)) {
+                expansionEnd = pos + 2;
+            }
+
+            if (expansionEnd > pos + 1) {
+                expansions.append({pos, expansionEnd - pos});
+                pos = expansionEnd - 1;
+            }
+        }
+    }
+
+    // A quote still open continues on the next line
+    if (quoteStart >= 0) {
+        setFormat(quoteStart, end - quoteStart, quote == QLatin1Char('`') ? m_variableFormat : m_stringFormat);
+    }
+
+    // Over the strings they are in
+    for (const auto &expansion : std::as_const(expansions)) {
+        setFormat(expansion.first, expansion.second, m_variableFormat);
+    }
+}
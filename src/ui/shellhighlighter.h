@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef SHELLHIGHLIGHTER_H
+#define SHELLHIGHLIGHTER_H
+
+#include "shelltokenizer.h"
+
+#include <QSyntaxHighlighter>
+#include <QTextBlockUserData>
+#include <QTextCharFormat>
+
+class QTextCursor;
+
+/**
+ * @brief Tokens of a block, kept for the next edit of the block
+ */
+class ShellBlockData : public QTextBlockUserData
+{
+public:
+    ShellLine line;     ///< Tokens and lexer states of the block
+};
+
+/**
+ * @brief Live syntax highlighting of shell command lines
+ *
+ * Each block keeps its tokens, so an edit re-lexes only from the edited
+ * token. QSyntaxHighlighter moves on to the next block as long as the
+ * block state (a hash of the lexer state) changes, so closing a quote or
+ * a heredoc re-highlights the lines it affects and nothing else.
+ */
+class ShellHighlighter : public QSyntaxHighlighter
+{
+public:
+    /**
+     * Constructor
+     * @param document Document to highlight
+     */
+    explicit ShellHighlighter(QTextDocument *document);
+
+    /**
+     * Get the completion context at a cursor
+     * @param cursor Cursor in the highlighted document
+     * @return Completion context, prefixStart as a document position
+     */
+    ShellCompletionContext completionContext(const QTextCursor &cursor) const;
+
+protected:
+    /**
+     * Highlight one block
+     * @param text Text of the block
+     */
+    void highlightBlock(const QString &text) override;
+
+private:
+    /**
+     * Highlight quoted strings and $ expansions inside a word
+     * @param token The word
+     * @param text Text of the block
+     */
+    void highlightWord(const ShellToken &token, const QString &text);
+
+    QTextCharFormat m_formats[int(ShellTokenKind::Comment) + 1];   ///< Format per token kind
+    QTextCharFormat m_stringFormat;                                ///< Quoted strings
+    QTextCharFormat m_variableFormat;                              ///< $NAME, ${...}, $( )
+};
+
+#endif // SHELLHIGHLIGHTER_H
@@ -0,0 +1,507 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "shelltokenizer.h"
+
+#include <QHash>
+#include <QRegularExpression>
+#include <QSet>
+
+// Reserved words after which a command name follows
+static const QSet<QString> COMMAND_KEYWORDS = {
+    QStringLiteral("if"), QStringLiteral("then"), QStringLiteral("else"), QStringLiteral("elif"),
+    QStringLiteral("while"), QStringLiteral("until"), QStringLiteral("do"), QStringLiteral("time"),
+    QStringLiteral("!"), QStringLiteral("{")
+};
+
+// Reserved words followed by something other than a command name
+static const QSet<QString> OTHER_KEYWORDS = {
+    QStringLiteral("fi"), QStringLiteral("done"), QStringLiteral("esac"), QStringLiteral("}"),
+    QStringLiteral("for"), QStringLiteral("case"), QStringLiteral("select"), QStringLiteral("function"),
+    QStringLiteral("[["), QStringLiteral("]]")
+};
+
+bool ShellLexState::operator==(const ShellLexState &other) const
+{
+    return quote == other.quote
+        && depth == other.depth
+        && commandPosition == other.commandPosition
+        && redirectTarget == other.redirectTarget
+        && expectDelimiter == other.expectDelimiter
+        && stripTabs == other.stripTabs
+        && inWord == other.inWord
+        && continued == other.continued
+        && wordKind == other.wordKind
+        && inHeredoc == other.inHeredoc
+        && heredocs == other.heredocs;
+}
+
+/**
+ * Classify a word in command position
+ * @param word The word
+ * @param commandPosition Updated for the next word
+ * @return Kind of the word
+ */
+static ShellTokenKind classifyCommandWord(const QString &word, bool *commandPosition)
+{
+    if (COMMAND_KEYWORDS.contains(word)) {
+        *commandPosition = true;
+        return ShellTokenKind::Keyword;
+    }
+    if (OTHER_KEYWORDS.contains(word)) {
+        *commandPosition = false;
+        return ShellTokenKind::Keyword;
+    }
+
+    // NAME=value, NAME+=value or NAME[index]=value; the command comes after it
+    int pos = 0;
+    while (pos < word.size() && (word.at(pos).isLetter() || word.at(pos) == QLatin1Char('_')
+                                 || (pos > 0 && word.at(pos).isDigit()))) {
+        ++pos;
+    }
+    if (pos > 0 && pos < word.size()) {
+        int equals = pos;
+        if (word.at(pos) == QLatin1Char('[')) {
+            int close = word.indexOf(QLatin1Char(']'), pos);
+            equals = close < 0 ? -1 : close + 1;
+        }
+        if (equals >= 0 && equals < word.size() && word.at(equals) == QLatin1Char('+')) {
+            ++equals;
+        }
+        if (equals >= 0 && equals < word.size() && word.at(equals) == QLatin1Char('=')) {
+            return ShellTokenKind::Assignment;
+        }
+    }
+
+    *commandPosition = false;
+    return ShellTokenKind::Command;
+}
+
+/**
+ * Check whether an argument looks like a path
+ * @param word The argument
+ * @return True for ~..., ./..., ../... and anything with a slash
+ */
+static bool looksLikePath(const QString &word)
+{
+    return word.startsWith(QLatin1Char('~')) || word.startsWith(QLatin1String("./"))
+        || word.startsWith(QLatin1String("../")) || word.contains(QLatin1Char('/'));
+}
+
+void ShellTokenizer::relex(const QString &text, const ShellLexState &startState, ShellLine *line)
+{
+    int kept = 0;
+    if (line->startState == startState && !startState.inHeredoc) {
+        if (line->text == text && !line->tokens.isEmpty()) {
+            return;
+        }
+
+        // Tokens ending before the first change stay valid; one ending right
+        // at it may grow ("ls" -> "lsb", "|" -> "||")
+        const int limit = qMin(line->text.size(), text.size());
+        int common = 0;
+        while (common < limit && line->text.at(common) == text.at(common)) {
+            ++common;
+        }
+        while (kept < line->tokens.size() && line->tokens.at(kept).start + line->tokens.at(kept).length < common) {
+            ++kept;
+        }
+    }
+
+    line->tokens.resize(kept);
+    line->states.resize(kept);
+    line->text = text;
+    line->startState = startState;
+
+    if (kept > 0) {
+        const ShellToken &last = line->tokens.last();
+        lex(text, last.start + last.length, line->states.last(), line);
+    } else {
+        // A backslash at the end of the previous line only joined the lines
+        ShellLexState state = startState;
+        state.continued = false;
+        lex(text, 0, state, line);
+    }
+}
+
+void ShellTokenizer::lex(const QString &text, int pos, ShellLexState state, ShellLine *line)
+{
+    const int length = text.size();
+
+    auto addToken = [line, &state](ShellTokenKind kind, int start, int end, QChar quote) {
+        line->tokens.append({kind, start, end - start, quote});
+        line->states.append(state);
+    };
+
+    // Heredoc bodies are taken a line at a time, until the delimiter
+    if (state.inHeredoc) {
+        const ShellHeredoc heredoc = state.heredocs.first();
+        int indent = 0;
+        while (heredoc.stripTabs && indent < length && text.at(indent) == QLatin1Char('\t')) {
+            ++indent;
+        }
+
+        if (QStringView(text).mid(indent) == heredoc.delimiter) {
+            state.heredocs.removeFirst();
+            state.inHeredoc = !state.heredocs.isEmpty();
+            addToken(ShellTokenKind::HeredocDelimiter, 0, length, QChar());
+        } else if (length > 0) {
+            addToken(ShellTokenKind::HeredocBody, 0, length, QChar());
+        }
+
+        line->endState = state;
+        return;
+    }
+
+    // The rest of a word from the previous line
+    if (pos == 0 && state.inWord) {
+        const QChar quote = state.quote;
+        bool continued;
+        int end = scanWord(text, 0, &state.quote, &state.depth, &continued);
+        state.inWord = end == length && (continued || !state.quote.isNull() || state.depth > 0);
+        if (end > 0) {
+            addToken(state.wordKind, 0, end, quote);
+        }
+        pos = end;
+    }
+
+    while (pos < length) {
+        const QChar c = text.at(pos);
+        if (c == QLatin1Char(' ') || c == QLatin1Char('\t')) {
+            ++pos;
+            continue;
+        }
+
+        const int start = pos;
+        if (c == QLatin1Char('#')) {
+            addToken(ShellTokenKind::Comment, start, length, QChar());
+            break;
+        }
+
+        if (int operatorSize = operatorLength(text, pos)) {
+            state.commandPosition = c != QLatin1Char(')');
+            state.redirectTarget = false;
+            pos += operatorSize;
+            addToken(ShellTokenKind::Operator, start, pos, QChar());
+            continue;
+        }
+
+        bool heredoc;
+        bool stripTabs;
+        if (int redirectionSize = redirectionLength(text, pos, &heredoc, &stripTabs)) {
+            state.expectDelimiter = heredoc;
+            state.stripTabs = stripTabs;
+            state.redirectTarget = !heredoc;
+            pos += redirectionSize;
+            addToken(ShellTokenKind::Redirection, start, pos, QChar());
+            continue;
+        }
+
+        bool continued;
+        pos = scanWord(text, pos, &state.quote, &state.depth, &continued);
+
+        // A lone backslash at the end joins the next line
+        if (continued && pos - start == 1) {
+            state.continued = true;
+            break;
+        }
+
+        const QString word = text.mid(start, pos - start);
+        ShellTokenKind kind;
+        if (state.expectDelimiter) {
+            kind = ShellTokenKind::HeredocDelimiter;
+            state.heredocs.append({unquote(word), state.stripTabs});
+            state.expectDelimiter = false;
+        } else if (state.redirectTarget) {
+            kind = ShellTokenKind::Path;
+            state.redirectTarget = false;
+        } else if (state.commandPosition) {
+            kind = classifyCommandWord(word, &state.commandPosition);
+        } else if (word.size() > 1 && word.startsWith(QLatin1Char('-'))) {
+            kind = ShellTokenKind::Option;
+        } else if (looksLikePath(word)) {
+            kind = ShellTokenKind::Path;
+        } else {
+            kind = ShellTokenKind::Argument;
+        }
+
+        state.inWord = pos == length && (continued || !state.quote.isNull() || state.depth > 0);
+        if (state.inWord) {
+            state.wordKind = kind;
+        }
+        addToken(kind, start, pos, QChar());
+    }
+
+    // A newline ends the command, unless it is escaped or inside a word
+    if (!state.inWord && !state.continued) {
+        state.commandPosition = true;
+        state.redirectTarget = false;
+        state.expectDelimiter = false;
+        state.inHeredoc = !state.heredocs.isEmpty();
+    }
+    line->endState = state;
+}
+
+int ShellTokenizer::scanWord(const QString &text, int pos, QChar *quote, int *depth, bool *continued)
+{
+    const int length = text.size();
+    *continued = false;
+
+    while (pos < length) {
+        const QChar c = text.at(pos);
+
+        // No escapes in single quotes
+        if (*quote == QLatin1Char('\'')) {
+            if (c == QLatin1Char('\'')) {
+                *quote = QChar();
+            }
+            ++pos;
+            continue;
+        }
+
+        if (c == QLatin1Char('\\')) {
+            if (pos + 1 >= length) {
+                *continued = true;
+                return length;
+            }
+            pos += 2;
+            continue;
+        }
+
+        // ", ` and $'...' end at their closing character
+        if (!quote->isNull()) {
+            const QChar closing = *quote == QLatin1Char('$') ? QLatin1Char('\'') : *quote;
+            if (c == closing) {
+                *quote = QChar();
+            }
+            ++pos;
+            continue;
+        }
+
+        if (c == QLatin1Char('\'') || c == QLatin1Char('"') || c == QLatin1Char('`')) {
+            *quote = c;
+            ++pos;
+            continue;
+        }
+
+        if (c == QLatin1Char('$') && pos + 1 < length) {
+            const QChar next = text.at(pos + 1);
+            if (next == QLatin1Char('\'')) {
+                *quote = QLatin1Char('$');
+                pos += 2;
+                continue;
+            }
+            if (next == QLatin1Char('(')) {
+                ++*depth;
+                pos += 2;
+                continue;
+            }
+            if (next == QLatin1Char('{')) {
+                // ${...} may contain blanks and operators
+                int close = text.indexOf(QLatin1Char('}'), pos + 2);
+                pos = close < 0 ? length : close + 1;
+                continue;
+            }
+        }
+
+        // Inside $( ), blanks and operators belong to the word
+        if (*depth > 0) {
+            if (c == QLatin1Char('(')) {
+                ++*depth;
+            } else if (c == QLatin1Char(')')) {
+                --*depth;
+            }
+            ++pos;
+            continue;
+        }
+
+        if (c == QLatin1Char(' ') || c == QLatin1Char('\t') || c == QLatin1Char('|') || c == QLatin1Char('&')
+            || c == QLatin1Char(';') || c == QLatin1Char('<') || c == QLatin1Char('>')
+            || c == QLatin1Char('(') || c == QLatin1Char(')')) {
+            break;
+        }
+        ++pos;
+    }
+
+    return pos;
+}
+
+int ShellTokenizer::operatorLength(const QString &text, int pos)
+{
+    const QChar c = text.at(pos);
+    const QChar next = pos + 1 < text.size() ? text.at(pos + 1) : QChar();
+
+    if (c == QLatin1Char('|')) {
+        return next == QLatin1Char('|') || next == QLatin1Char('&') ? 2 : 1;
+    }
+    if (c == QLatin1Char('&')) {
+        // &> and &>> are redirections
+        if (next == QLatin1Char('>')) {
+            return 0;
+        }
+        return next == QLatin1Char('&') ? 2 : 1;
+    }
+    if (c == QLatin1Char(';')) {
+        if (next == QLatin1Char(';')) {
+            return pos + 2 < text.size() && text.at(pos + 2) == QLatin1Char('&') ? 3 : 2;
+        }
+        return next == QLatin1Char('&') ? 2 : 1;
+    }
+    if (c == QLatin1Char('(') || c == QLatin1Char(')')) {
+        return 1;
+    }
+    return 0;
+}
+
+int ShellTokenizer::redirectionLength(const QString &text, int pos, bool *heredoc, bool *stripTabs)
+{
+    *heredoc = false;
+    *stripTabs = false;
+
+    // Optional file descriptor right before the operator, or &> for both outputs
+    int opStart = pos;
+    while (opStart < text.size() && text.at(opStart).isDigit()) {
+        ++opStart;
+    }
+    if (opStart == pos && opStart + 1 < text.size() && text.at(opStart) == QLatin1Char('&')
+        && text.at(opStart + 1) == QLatin1Char('>')) {
+        ++opStart;
+    }
+    if (opStart >= text.size()) {
+        return 0;
+    }
+
+    const QStringView rest = QStringView(text).mid(opStart);
+    int opLength = 0;
+    if (rest.startsWith(QLatin1String("<<<"))) {
+        opLength = 3;
+    } else if (rest.startsWith(QLatin1String("<<-"))) {
+        opLength = 3;
+        *heredoc = true;
+        *stripTabs = true;
+    } else if (rest.startsWith(QLatin1String("<<"))) {
+        opLength = 2;
+        *heredoc = true;
+    } else if (rest.startsWith(QLatin1String("<>")) || rest.startsWith(QLatin1String("<&"))
+               || rest.startsWith(QLatin1String(">>")) || rest.startsWith(QLatin1String(">&"))
+               || rest.startsWith(QLatin1String(">|"))) {
+        opLength = 2;
+    } else if (rest.startsWith(QLatin1Char('<')) || rest.startsWith(QLatin1Char('>'))) {
+        opLength = 1;
+    } else {
+        return 0;
+    }
+
+    return opStart - pos + opLength;
+}
+
+QString ShellTokenizer::unquote(const QString &word)
+{
+    QString result;
+    result.reserve(word.size());
+    for (int i = 0; i < word.size(); ++i) {
+        const QChar c = word.at(i);
+        if (c == QLatin1Char('\\') && i + 1 < word.size()) {
+            result.append(word.at(++i));
+        } else if (c != QLatin1Char('\'') && c != QLatin1Char('"')) {
+            result.append(c);
+        }
+    }
+    return result;
+}
+
+int ShellTokenizer::stateHash(const ShellLexState &state)
+{
+    const int flags = (state.depth << 10) | (int(state.wordKind) << 6)
+                    | (state.commandPosition ? 0x01 : 0) | (state.redirectTarget ? 0x02 : 0)
+                    | (state.expectDelimiter ? 0x04 : 0) | (state.stripTabs ? 0x08 : 0)
+                    | (state.inWord ? 0x10 : 0) | (state.continued ? 0x20 : 0)
+                    | (state.inHeredoc ? 0x200 : 0);
+
+    size_t hash = qHashMulti(0, state.quote.unicode(), flags);
+    for (const ShellHeredoc &heredoc : state.heredocs) {
+        hash = qHashMulti(hash, heredoc.delimiter, heredoc.stripTabs ? 1 : 0);
+    }
+    return int(hash & 0x7fffffff);
+}
+
+ShellCompletionContext ShellTokenizer::completionContext(const ShellLine &line, int column)
+{
+    ShellCompletionContext context;
+    context.prefixStart = column;
+    if (line.startState.inHeredoc) {
+        return context;
+    }
+
+    // Last token starting before the cursor
+    int index = -1;
+    while (index + 1 < line.tokens.size() && line.tokens.at(index + 1).start < column) {
+        ++index;
+    }
+
+    const ShellToken *token = index >= 0 ? &line.tokens.at(index) : nullptr;
+    const bool inWord = token && column <= token->start + token->length
+                        && token->kind != ShellTokenKind::Operator && token->kind != ShellTokenKind::Redirection;
+
+    // Command and operator of the simple command the word is in
+    const int wordIndex = inWord ? index : index + 1;
+    for (int i = 0; i < wordIndex; ++i) {
+        const ShellToken &before = line.tokens.at(i);
+        if (before.kind == ShellTokenKind::Operator) {
+            context.precedingOperator = line.text.mid(before.start, before.length);
+            context.command.clear();
+        } else if (before.kind == ShellTokenKind::Command) {
+            context.command = line.text.mid(before.start, before.length);
+        }
+    }
+
+    // A new word: what may come next follows from the state
+    if (!inWord) {
+        const ShellLexState &state = index >= 0 ? line.states.at(index) : line.startState;
+        if (state.expectDelimiter) {
+            return context;
+        }
+        context.kind = state.redirectTarget ? ShellCompletionContext::Path
+                     : state.commandPosition ? ShellCompletionContext::Command
+                                             : ShellCompletionContext::Argument;
+        return context;
+    }
+
+    context.prefixStart = token->start;
+    context.prefix = line.text.mid(token->start, column - token->start);
+
+    QChar quote = token->quote;
+    int depth = 0;
+    bool continued;
+    scanWord(context.prefix, 0, &quote, &depth, &continued);
+    context.quote = quote;
+
+    switch (token->kind) {
+    case ShellTokenKind::Command:
+    case ShellTokenKind::Keyword:
+        context.kind = ShellCompletionContext::Command;
+        break;
+    case ShellTokenKind::Option:
+        context.kind = ShellCompletionContext::Option;
+        break;
+    case ShellTokenKind::Path:
+        context.kind = ShellCompletionContext::Path;
+        break;
+    case ShellTokenKind::Argument:
+    case ShellTokenKind::Assignment:
+        context.kind = ShellCompletionContext::Argument;
+        break;
+    default:
+        return context;
+    }
+
+    // $NAME or ${NAME being typed, where it would be expanded
+    static const QRegularExpression variable(QStringLiteral("\\$\\{?[A-Za-z_0-9]*$"));
+    if (quote != QLatin1Char('\'') && quote != QLatin1Char('$') && variable.match(context.prefix).hasMatch()) {
+        context.kind = ShellCompletionContext::Variable;
+    }
+
+    return context;
+}
@@ -0,0 +1,204 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef SHELLTOKENIZER_H
+#define SHELLTOKENIZER_H
+
+#include <QChar>
+#include <QString>
+#include <QVector>
+
+/**
+ * Kind of a shell token
+ */
+enum class ShellTokenKind : quint8 {
+    Command,            ///< Command name
+    Keyword,            ///< Reserved word like if, then, do
+    Assignment,         ///< NAME=value before the command
+    Option,             ///< Argument starting with a dash
+    Argument,           ///< Other argument
+    Path,               ///< Argument that looks like a path, or a redirection target
+    Operator,           ///< Control operator like |, &&, ;
+    Redirection,        ///< Redirection operator like >, 2>&, <<
+    HeredocDelimiter,   ///< Word after << and the line ending the heredoc
+    HeredocBody,        ///< Line inside a heredoc
+    Comment             ///< From # to the end of the line
+};
+
+/**
+ * A token of one line
+ *
+ * Words are single tokens, quotes and expansions included; a word
+ * spanning lines (open quote, backslash-newline) is one token per line.
+ */
+struct ShellToken {
+    ShellTokenKind kind;    ///< What the token is
+    int start;              ///< Offset in the line
+    int length;             ///< Length in characters
+    QChar quote;            ///< Quote open at the start of the token, null if none
+};
+
+/**
+ * A heredoc whose body follows
+ */
+struct ShellHeredoc {
+    QString delimiter;      ///< Line ending the body, unquoted
+    bool stripTabs;         ///< Whether leading tabs are stripped (<<-)
+
+    bool operator==(const ShellHeredoc &other) const
+    {
+        return delimiter == other.delimiter && stripTabs == other.stripTabs;
+    }
+};
+
+/**
+ * Lexer state between tokens and lines
+ *
+ * Everything the tokenizer needs to resume after a token, so a line can be
+ * re-lexed from any token boundary and the next line from the end state.
+ */
+struct ShellLexState {
+    QChar quote;                                        ///< Open quote: ', ", ` or $ for $'...'; null if none
+    int depth = 0;                                      ///< Open $( in the current word
+    bool commandPosition = true;                        ///< Whether the next word is a command name
+    bool redirectTarget = false;                        ///< Whether the next word is a redirection target
+    bool expectDelimiter = false;                       ///< Whether the next word is a heredoc delimiter
+    bool stripTabs = false;                             ///< Whether that heredoc is <<-
+    bool inWord = false;                                ///< Whether a word continues on the next line
+    bool continued = false;                             ///< Whether the line ended in a backslash between words
+    ShellTokenKind wordKind = ShellTokenKind::Argument; ///< Kind of the continuing word
+    bool inHeredoc = false;                             ///< Whether lines are heredoc bodies
+    QVector<ShellHeredoc> heredocs;                     ///< Heredocs whose bodies follow, current first
+
+    bool operator==(const ShellLexState &other) const;
+    bool operator!=(const ShellLexState &other) const { return !(*this == other); }
+};
+
+/**
+ * Tokens of a line, with the state after each token
+ */
+struct ShellLine {
+    QString text;                       ///< Text the tokens are for
+    ShellLexState startState;           ///< State at the start of the line
+    QVector<ShellToken> tokens;         ///< Tokens in order
+    QVector<ShellLexState> states;      ///< State after each token
+    ShellLexState endState;             ///< State at the start of the next line
+};
+
+/**
+ * What is being completed at a cursor position
+ */
+struct ShellCompletionContext {
+    /**
+     * Kind of word at the cursor
+     */
+    enum Kind {
+        None,           ///< Nothing to complete (comment, heredoc, AI query)
+        Command,        ///< Command name, also after a pipe or ;
+        Option,         ///< Option of the command
+        Argument,       ///< Other argument of the command
+        Path,           ///< File name, e.g. after a redirection
+        Variable        ///< Variable name after $
+    };
+
+    Kind kind = None;               ///< Kind of the word
+    QString command;                ///< Command the word belongs to, empty when completing a command
+    QString prefix;                 ///< The word up to the cursor, quotes included
+    int prefixStart = 0;            ///< Position of the word in the text
+    QChar quote;                    ///< Quote open at the cursor, null if none
+    QString precedingOperator;      ///< Operator before the command, e.g. "|"; empty at the start
+};
+
+/**
+ * Incremental tokenizer for POSIX shell and bash command lines
+ *
+ * Lines are lexed one at a time. The state at the end of a line starts the
+ * next one, so a change only needs its own line re-lexed, plus the
+ * following lines while their start state keeps changing (typing a quote
+ * or a heredoc terminator). Within a line, tokens before the first changed
+ * character are kept and lexing resumes from the state after them.
+ *
+ * This is a highlighter's view of the grammar, not a parser: it knows
+ * words, quotes, $( ) nesting, operators, redirections, reserved words,
+ * comments and heredocs, and what position a word is in.
+ */
+class ShellTokenizer
+{
+public:
+    /**
+     * Bring the tokens of a line up to date
+     * @param text New text of the line
+     * @param startState State at the start of the line
+     * @param line Tokens of the previous text, updated in place
+     */
+    static void relex(const QString &text, const ShellLexState &startState, ShellLine *line);
+
+    /**
+     * Get the completion context at a position in a tokenized line
+     *
+     * Only the line itself is looked at, so the command of a word on a
+     * continuation line is not known.
+     *
+     * @param line Up to date tokens of the line
+     * @param column Cursor position in the line
+     * @return Completion context, prefixStart relative to the line
+     */
+    static ShellCompletionContext completionContext(const ShellLine &line, int column);
+
+    /**
+     * Hash a state, e.g. for QSyntaxHighlighter's block state
+     * @param state Lexer state
+     * @return Non-negative hash
+     */
+    static int stateHash(const ShellLexState &state);
+
+    /**
+     * Advance over (part of) a word
+     * @param text Line text
+     * @param pos Start position
+     * @param quote Open quote, updated
+     * @param depth Open $( count, updated
+     * @param continued Set if the word ends in a backslash-newline
+     * @return End of the word
+     */
+    static int scanWord(const QString &text, int pos, QChar *quote, int *depth, bool *continued);
+
+private:
+    /**
+     * Lex from a position to the end of the line
+     * @param text Line text
+     * @param pos Start position, a token boundary
+     * @param state State at that position
+     * @param line Receives the tokens and the end state
+     */
+    static void lex(const QString &text, int pos, ShellLexState state, ShellLine *line);
+
+    /**
+     * Get the length of a control operator
+     * @param text Line text
+     * @param pos Position to look at
+     * @return Operator length, 0 if there is none
+     */
+    static int operatorLength(const QString &text, int pos);
+
+    /**
+     * Get the length of a redirection operator, with its file descriptor
+     * @param text Line text
+     * @param pos Position to look at
+     * @param heredoc Set for << and <<-
+     * @param stripTabs Set for <<-
+     * @return Operator length, 0 if there is none
+     */
+    static int redirectionLength(const QString &text, int pos, bool *heredoc, bool *stripTabs);
+
+    /**
+     * Remove quotes and backslashes from a heredoc delimiter
+     * @param word Delimiter as written
+     * @return Delimiter as it appears at the end of the body
+     */
+    static QString unquote(const QString &word);
+};
+
+#endif // SHELLTOKENIZER_H
@@ -0,0 +1,105 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "textcompressor.h"
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QtConcurrent/QtConcurrentRun>
+
+/**
+ * Compress texts; runs on the thread pool
+ * @param texts Texts
+ * @return zlib compressed UTF-8 of each text
+ */
+static QList<QByteArray> compressTexts(const QList<QString> &texts)
+{
+    QList<QByteArray> compressed;
+    compressed.reserve(texts.size());
+    for (const QString &text : texts) {
+        compressed.append(qCompress(text.toUtf8()));
+    }
+    return compressed;
+}
+
+TextCompressor::TextCompressor(int cacheSize, QObject *parent)
+    : QObject(parent)
+    , m_expanded(cacheSize)
+{
+}
+
+QString TextCompressor::text(int key, const QString &text, const QByteArray &compressed, bool cache) const
+{
+    if (compressed.isEmpty()) {
+        return text;
+    }
+
+    if (QString *expanded = m_expanded.object(key)) {
+        return *expanded;
+    }
+
+    QString expanded = QString::fromUtf8(qUncompress(compressed));
+    if (cache) {
+        m_expanded.insert(key, new QString(expanded));
+    }
+    return expanded;
+}
+
+void TextCompressor::compress(const QHash<int, QString> &texts, const Apply &apply)
+{
+    QList<int> keys;
+    QList<QString> pending;
+    for (auto it = texts.begin(); it != texts.end(); ++it) {
+        if (!m_compressing.contains(it.key())) {
+            m_compressing.insert(it.key());
+            keys.append(it.key());
+            pending.append(it.value());
+        }
+    }
+    if (keys.isEmpty()) {
+        return;
+    }
+
+    QFutureWatcher<QList<QByteArray>> *watcher = new QFutureWatcher<QList<QByteArray>>(this);
+    connect(watcher, &QFutureWatcher<QList<QByteArray>>::finished, this, [this, watcher, keys, pending, apply]() {
+        watcher->deleteLater();
+        const QList<QByteArray> results = watcher->result();
+        for (int i = 0; i < keys.size(); ++i) {
+            // Forgotten meanwhile, the text changed or is gone
+            if (!m_compressing.contains(keys.at(i))) {
+                continue;
+            }
+
+            // Incompressible text, e.g. already compressed data, stays as
+            // it is and is not tried again
+            const QString &text = pending.at(i);
+            if (results.at(i).size() >= text.size() * qsizetype(sizeof(QChar))) {
+                continue;
+            }
+            m_compressing.remove(keys.at(i));
+            apply(keys.at(i), text, results.at(i));
+        }
+    });
+    watcher->setFuture(QtConcurrent::run(compressTexts, pending));
+}
+
+bool TextCompressor::isCompressing(int key) const
+{
+    return m_compressing.contains(key);
+}
+
+void TextCompressor::forget(int key)
+{
+    m_expanded.remove(key);
+    m_compressing.remove(key);
+}
+
+void TextCompressor::clear()
+{
+    m_expanded.clear();
+    m_compressing.clear();
+}
+
+#include "moc_textcompressor.cpp"
@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef TEXTCOMPRESSOR_H
+#define TEXTCOMPRESSOR_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+#include <functional>
+
+/**
+ * Background compression of idle texts, with an LRU cache of expanded ones
+ *
+ * Shared by BlockModel and ConversationModel, which keep large texts
+ * they rarely read again as UTF-8 compressed with zlib. Texts are known
+ * by a key, a block ID or an item row. The owner decides which texts are
+ * idle and swaps in the compressed form; this class compresses on the
+ * thread pool, skips texts that don't shrink from then on and keeps the
+ * most recently read texts expanded.
+ */
+class TextCompressor : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Called with a compressed text worth keeping
+     * @param key Key of the text
+     * @param text The text as it was given to compress()
+     * @param compressed zlib compressed UTF-8
+     */
+    using Apply = std::function<void(int key, const QString &text, const QByteArray &compressed)>;
+
+    /**
+     * Constructor
+     * @param cacheSize Number of expanded texts kept after being read
+     * @param parent Parent object
+     */
+    explicit TextCompressor(int cacheSize, QObject *parent = nullptr);
+
+    /**
+     * Get a text, expanding it if it is compressed
+     * @param key Key of the text
+     * @param text The text, used if compressed is empty
+     * @param compressed zlib compressed UTF-8, empty unless compressed
+     * @param cache Whether to keep an expanded text in the LRU cache
+     * @return The text
+     */
+    QString text(int key, const QString &text, const QByteArray &compressed, bool cache) const;
+
+    /**
+     * Compress texts on the thread pool, together
+     *
+     * The owner must check in apply that its text is still the one given,
+     * e.g. by comparing constData(): a text that changed meanwhile no
+     * longer shares its data with the copy.
+     *
+     * @param texts Texts by key; keys being compressed or found incompressible are skipped
+     * @param apply Called on this thread for each text that shrank
+     */
+    void compress(const QHash<int, QString> &texts, const Apply &apply);
+
+    /**
+     * Check whether a text is being compressed or was found incompressible
+     * @param key Key of the text
+     * @return True if compress() skips it
+     */
+    bool isCompressing(int key) const;
+
+    /**
+     * Forget a text about to change, so it is expanded no more from the
+     * cache and tried again
+     * @param key Key of the text
+     */
+    void forget(int key);
+
+    /**
+     * Forget all texts
+     */
+    void clear();
+
+private:
+    mutable QCache<int, QString> m_expanded;    ///< Recently read compressed texts, by key
+    QSet<int> m_compressing;                    ///< Texts being compressed, or found incompressible
+};
+
+#endif // TEXTCOMPRESSOR_H
@@ -0,0 +1,188 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// OpenAIProvider against the fake server: real QNetworkAccessManager
+// requests and HTTP parsing, with injected rate limits, server errors and
+// dropped connections. The provider does not stream, so only plain
+// completions are covered.
+
+#include "ai/openai_provider.h"
+
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QTest>
+
+// How long the server gets to start listening (ms)
+static const int SERVER_START_TIMEOUT = 10000;
+
+class OpenAIProviderTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void cleanup();
+
+    void completion();
+    void parametersPerCall();
+    void latency();
+    void rateLimited();
+    void serverError();
+    void droppedConnection();
+    void unreachable();
+
+private:
+    /**
+     * Outcome of one request
+     */
+    struct Result {
+        bool answered = false;  ///< Whether the response callback ran
+        bool failed = false;    ///< Whether the error callback ran
+        QString text;           ///< Answer or error message
+    };
+
+    /**
+     * Start the fake server
+     * @param arguments Options, e.g. --rate-limit 1
+     * @return Chat completions URL, empty if the server didn't start
+     */
+    QString startServer(const QStringList &arguments);
+
+    /**
+     * Send a query through a provider pointed at a URL
+     * @param endpoint Chat completions URL
+     * @param parameters Per-call parameters
+     * @return What the callbacks received
+     */
+    static Result ask(const QString &endpoint, const QVariantMap &parameters = QVariantMap());
+
+    QProcess m_server;  ///< Fake server of the current test
+};
+
+void OpenAIProviderTest::cleanup()
+{
+    if (m_server.state() != QProcess::NotRunning) {
+        m_server.kill();
+        m_server.waitForFinished();
+    }
+}
+
+QString OpenAIProviderTest::startServer(const QStringList &arguments)
+{
+    m_server.setProgram(QStringLiteral(FAKE_OPENAI_SERVER));
+    m_server.setArguments(QStringList{QStringLiteral("--port"), QStringLiteral("0")} + arguments);
+    m_server.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    m_server.start();
+
+    // The server prints its URL once it is listening
+    while (!m_server.canReadLine()) {
+        if (!m_server.waitForReadyRead(SERVER_START_TIMEOUT)) {
+            return QString();
+        }
+    }
+    return QString::fromUtf8(m_server.readLine()).trimmed();
+}
+
+OpenAIProviderTest::Result OpenAIProviderTest::ask(const QString &endpoint, const QVariantMap &parameters)
+{
+    OpenAIProvider provider;
+    provider.setApiKey(QStringLiteral("test-key"));
+    provider.setModelParameters({{QStringLiteral("endpoint"), endpoint}});
+
+    // The provider answers before generateResponse() returns
+    Result result;
+    provider.generateResponse(QStringLiteral("Why did make fail?"), QStringLiteral("$ make"), parameters,
+        [&result](const QString &text, bool) {
+            result.answered = true;
+            result.text = text;
+        },
+        [&result](const QString &message) {
+            result.failed = true;
+            result.text = message;
+        });
+    return result;
+}
+
+void OpenAIProviderTest::completion()
+{
+    QString endpoint = startServer({QStringLiteral("--reply"), QStringLiteral("the file does not exist")});
+    QVERIFY(!endpoint.isEmpty());
+
+    Result result = ask(endpoint);
+    QVERIFY(result.answered);
+    QVERIFY(!result.failed);
+    QCOMPARE(result.text, QStringLiteral("the file does not exist"));
+}
+
+void OpenAIProviderTest::parametersPerCall()
+{
+    QString endpoint = startServer({QStringLiteral("--words"), QStringLiteral("3")});
+    QVERIFY(!endpoint.isEmpty());
+
+    // Overrides go into the request; the server only has to accept them
+    Result result = ask(endpoint, {{QStringLiteral("temperature"), 0.0}, {QStringLiteral("max_tokens"), 5}});
+    QVERIFY(result.answered);
+    QCOMPARE(result.text.split(QLatin1Char(' ')).size(), 3);
+}
+
+void OpenAIProviderTest::latency()
+{
+    QString endpoint = startServer({QStringLiteral("--latency"), QStringLiteral("300")});
+    QVERIFY(!endpoint.isEmpty());
+
+    QElapsedTimer timer;
+    timer.start();
+    Result result = ask(endpoint);
+    QVERIFY(result.answered);
+    QVERIFY(timer.elapsed() >= 300);
+}
+
+void OpenAIProviderTest::rateLimited()
+{
+    QString endpoint = startServer({QStringLiteral("--rate-limit"), QStringLiteral("1")});
+    QVERIFY(!endpoint.isEmpty());
+
+    Result result = ask(endpoint);
+    QVERIFY(result.failed);
+    QVERIFY(!result.answered);
+    QVERIFY2(result.text.contains(QLatin1String("429")), qPrintable(result.text));
+    QVERIFY2(result.text.contains(QLatin1String("rate_limit_error")), qPrintable(result.text));
+}
+
+void OpenAIProviderTest::serverError()
+{
+    QString endpoint = startServer({QStringLiteral("--server-error"), QStringLiteral("1")});
+    QVERIFY(!endpoint.isEmpty());
+
+    Result result = ask(endpoint);
+    QVERIFY(result.failed);
+    QVERIFY2(result.text.contains(QLatin1String("500")), qPrintable(result.text));
+}
+
+void OpenAIProviderTest::droppedConnection()
+{
+    QString endpoint = startServer({QStringLiteral("--drop"), QStringLiteral("1")});
+    QVERIFY(!endpoint.isEmpty());
+
+    // Half a JSON body must not pass as an answer
+    Result result = ask(endpoint);
+    QVERIFY(result.failed);
+    QVERIFY(!result.answered);
+}
+
+void OpenAIProviderTest::unreachable()
+{
+    // Port of a server that is gone
+    QString endpoint = startServer(QStringList());
+    QVERIFY(!endpoint.isEmpty());
+    cleanup();
+
+    Result result = ask(endpoint);
+    QVERIFY(result.failed);
+    QVERIFY(!result.answered);
+}
+
+QTEST_GUILESS_MAIN(OpenAIProviderTest)
+
+#include "openaiprovidertest.moc"
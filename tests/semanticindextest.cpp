@@ -0,0 +1,179 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// SemanticIndex against the fake server's embeddings endpoint: commands
+// are embedded over HTTP, appended to the on-disk index and found again
+// by similarity.
+
+#include "ai/semanticindex.h"
+
+#include <KConfigGroup>
+#include <KSharedConfig>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTest>
+#include <QUuid>
+
+// How long the server gets to start listening (ms)
+static const int SERVER_START_TIMEOUT = 10000;
+
+// How long appends get to reach the index (ms)
+static const int INDEX_TIMEOUT = 10000;
+
+class SemanticIndexTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void findsSimilarCommand();
+    void appendsKeepEntriesApart();
+    void unreachableEndpoint();
+
+private:
+    /**
+     * Search and wait for the result
+     * @param text Query
+     * @param count Number of matches wanted
+     * @return Matches, best first
+     */
+    static QList<SemanticIndex::Match> search(const QString &text, int count);
+
+    /**
+     * Wait until a search finds a number of commands
+     * @param count Commands expected in the index
+     * @return True if they all arrived in time
+     */
+    static bool waitForCommands(int count);
+
+    /**
+     * Use a new, empty index
+     */
+    static void useNewModel();
+
+    QProcess m_server;      ///< Fake server for all tests
+    QString m_endpoint;     ///< Its embeddings URL
+};
+
+void SemanticIndexTest::initTestCase()
+{
+    // Index files and settings go to the test locations
+    QStandardPaths::setTestModeEnabled(true);
+    QDir(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QStringLiteral("/warpkate/history-index"))
+        .removeRecursively();
+
+    m_server.setProgram(QStringLiteral(FAKE_OPENAI_SERVER));
+    m_server.setArguments({QStringLiteral("--port"), QStringLiteral("0"), QStringLiteral("--dimension"), QStringLiteral("1024")});
+    m_server.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    m_server.start();
+    while (!m_server.canReadLine()) {
+        QVERIFY(m_server.waitForReadyRead(SERVER_START_TIMEOUT));
+    }
+    m_endpoint = QString::fromUtf8(m_server.readLine()).trimmed().replace(QStringLiteral("/chat/completions"), QStringLiteral("/embeddings"));
+
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    config.writeEntry("SemanticHistorySearch", true);
+    config.writeEntry("EmbeddingEndpoint", m_endpoint);
+}
+
+void SemanticIndexTest::cleanupTestCase()
+{
+    m_server.kill();
+    m_server.waitForFinished();
+}
+
+QList<SemanticIndex::Match> SemanticIndexTest::search(const QString &text, int count)
+{
+    QList<SemanticIndex::Match> result;
+    QEventLoop loop;
+    SemanticIndex::instance().search(text, count, &loop, [&result, &loop](const QList<SemanticIndex::Match> &matches) {
+        result = matches;
+        loop.quit();
+    });
+    loop.exec();
+    return result;
+}
+
+bool SemanticIndexTest::waitForCommands(int count)
+{
+    // Appends run on the thread pool; a search sees whole records only
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < INDEX_TIMEOUT) {
+        if (search(QStringLiteral("anything"), count + 1).size() == count) {
+            return true;
+        }
+        QTest::qWait(50);
+    }
+    return false;
+}
+
+void SemanticIndexTest::useNewModel()
+{
+    // Each model has its own index
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    config.writeEntry("EmbeddingModel", QUuid::createUuid().toString(QUuid::WithoutBraces));
+}
+
+void SemanticIndexTest::findsSimilarCommand()
+{
+    useNewModel();
+    SemanticIndex &index = SemanticIndex::instance();
+    index.addCommand(QStringLiteral("make install"), QStringLiteral("cp: cannot create /usr/local/bin/tool: Permission denied"),
+                     QStringLiteral("/home/me/tool"), 2);
+    index.addCommand(QStringLiteral("git push origin main"), QStringLiteral("! [rejected] main -> main (non-fast-forward)"),
+                     QStringLiteral("/home/me/tool"), 1);
+    index.addCommand(QStringLiteral("ls -la"), QStringLiteral("total 0"), QStringLiteral("/tmp"), 0);
+    QVERIFY(waitForCommands(3));
+
+    QList<SemanticIndex::Match> matches = search(QStringLiteral("permission denied during make install"), 3);
+    QCOMPARE(matches.size(), 3);
+    QCOMPARE(matches.first().command, QStringLiteral("make install"));
+    QCOMPARE(matches.first().directory, QStringLiteral("/home/me/tool"));
+    QCOMPARE(matches.first().exitCode, 2);
+    QVERIFY(matches.first().excerpt.contains(QLatin1String("Permission denied")));
+    QVERIFY(matches.at(0).score > matches.at(1).score);
+}
+
+void SemanticIndexTest::appendsKeepEntriesApart()
+{
+    // Appends in flight together must each point at their own entry
+    useNewModel();
+    const QStringList words = {QStringLiteral("alpha"), QStringLiteral("bravo"), QStringLiteral("charlie"),
+                               QStringLiteral("delta"), QStringLiteral("echo"), QStringLiteral("foxtrot")};
+    for (const QString &word : words) {
+        SemanticIndex::instance().addCommand(QStringLiteral("echo %1").arg(word), word.repeated(3),
+                                             QDir::tempPath(), 0);
+    }
+    QVERIFY(waitForCommands(int(words.size())));
+
+    for (const QString &word : words) {
+        QList<SemanticIndex::Match> matches = search(word, 1);
+        QCOMPARE(matches.size(), 1);
+        QCOMPARE(matches.first().command, QStringLiteral("echo %1").arg(word));
+        QCOMPARE(matches.first().excerpt, word.repeated(3));
+    }
+}
+
+void SemanticIndexTest::unreachableEndpoint()
+{
+    KConfigGroup config = KSharedConfig::openConfig()->group(QStringLiteral("WarpKate"));
+    config.writeEntry("EmbeddingEndpoint", QStringLiteral("http://127.0.0.1:1/v1/embeddings"));
+
+    // No embedding, no matches; the callback still runs
+    QVERIFY(search(QStringLiteral("make install"), 3).isEmpty());
+
+    config.writeEntry("EmbeddingEndpoint", m_endpoint);
+}
+
+QTEST_GUILESS_MAIN(SemanticIndexTest)
+
+#include "semanticindextest.moc"
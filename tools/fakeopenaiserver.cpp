@@ -0,0 +1,474 @@
+/*
+ * SPDX-FileCopyrightText: 2025 WarpKate Contributors
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Fake OpenAI-compatible chat completions server
+//
+// Serves POST /v1/chat/completions (plain and "stream": true),
+// POST /v1/embeddings and GET /v1/models on localhost so the network path
+// of OpenAIProvider and SemanticIndex can be exercised offline:
+// QNetworkAccessManager, HTTP parsing, keep-alive and server-sent events.
+// Embeddings are hashed bags of words, so texts sharing words are similar. Latency, streaming rate, fragmentation of events,
+// 429/500 responses and dropped connections are configurable; outcomes
+// are drawn from a seeded generator, so a sequential client sees the same
+// sequence on every run.
+//
+//   fakeopenaiserver --port 8089 --latency 300 --stream-rate 40 --fragment 7 \
+//       --rate-limit 0.1 --server-error 0.05 --drop 0.05 --seed 1
+//
+// Then point WarpKate at it with APIEndpoint in the [WarpKate] group of
+// warpkaterc, e.g. APIEndpoint=http://127.0.0.1:8089/v1/chat/completions,
+// and any non-empty API key; semantic history search with
+// EmbeddingEndpoint=http://127.0.0.1:8089/v1/embeddings.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QVector>
+
+#include <cstdio>
+
+// Requests with a bigger body are refused
+static const int MAX_REQUEST_SIZE = 16 * 1024 * 1024;
+
+// Words replies are made of when no reply text is given
+static const char *const REPLY_WORDS[] = {
+    "the", "command", "failed", "because", "the", "file", "does", "not", "exist", "check",
+    "the", "path", "and", "permissions", "then", "run", "it", "again", "with", "sudo",
+};
+
+/**
+ * Behaviour of the server
+ */
+struct Options {
+    int latency = 0;            ///< Delay before a response starts (ms)
+    double streamRate = 50;     ///< Content chunks per second when streaming
+    int fragment = 0;           ///< Split each event into pieces of this many bytes, 0 to keep events whole
+    int fragmentDelay = 2;      ///< Delay between the pieces of an event (ms)
+    double rateLimit = 0;       ///< Probability of answering 429
+    double serverError = 0;     ///< Probability of answering 500
+    double drop = 0;            ///< Probability of dropping the connection mid-response
+    int words = 40;             ///< Words in a generated reply
+    int dimension = 64;         ///< Length of embeddings
+    QString reply;              ///< Fixed reply text, generated when empty
+};
+
+/**
+ * One client connection, answering its requests one after the other
+ *
+ * A response is a list of steps, each written after its delay, so
+ * latency, streaming rate and fragmentation all come from the same
+ * mechanism.
+ */
+class Connection : public QObject
+{
+public:
+    Connection(QTcpSocket *socket, const Options &options, QRandomGenerator *random, QObject *parent)
+        : QObject(parent)
+        , m_socket(socket)
+        , m_options(options)
+        , m_random(random)
+        , m_responding(false)
+    {
+        m_socket->setParent(this);
+        m_timer.setSingleShot(true);
+        connect(&m_timer, &QTimer::timeout, this, &Connection::runStep);
+        connect(m_socket, &QTcpSocket::readyRead, this, &Connection::readRequests);
+        connect(m_socket, &QTcpSocket::disconnected, this, &QObject::deleteLater);
+    }
+
+private:
+    /**
+     * A part of a response
+     */
+    struct Step {
+        int delay;          ///< Delay before this step (ms)
+        QByteArray data;    ///< Bytes to write
+        bool drop;          ///< Abort the connection instead of writing
+    };
+
+    void readRequests()
+    {
+        m_buffer.append(m_socket->readAll());
+
+        // Keep-alive clients send the next request after the response
+        while (!m_responding) {
+            int headerEnd = m_buffer.indexOf("\r\n\r\n");
+            if (headerEnd < 0) {
+                return;
+            }
+
+            QList<QByteArray> lines = m_buffer.left(headerEnd).split('\n');
+            QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+            qint64 contentLength = 0;
+            for (int i = 1; i < lines.size(); ++i) {
+                int colon = lines.at(i).indexOf(':');
+                if (colon > 0 && lines.at(i).left(colon).trimmed().toLower() == "content-length") {
+                    contentLength = lines.at(i).mid(colon + 1).trimmed().toLongLong();
+                }
+            }
+
+            if (contentLength < 0 || contentLength > MAX_REQUEST_SIZE) {
+                send({{0, errorResponse(413, "Request too large", "invalid_request_error"), false}});
+                m_buffer.clear();
+                return;
+            }
+            if (m_buffer.size() < headerEnd + 4 + contentLength) {
+                return;
+            }
+
+            QByteArray body = m_buffer.mid(headerEnd + 4, contentLength);
+            m_buffer.remove(0, headerEnd + 4 + contentLength);
+            respond(requestLine.value(0), requestLine.value(1), body);
+        }
+    }
+
+    void respond(const QByteArray &method, const QByteArray &path, const QByteArray &body)
+    {
+        if (method == "GET" && path.endsWith("/models")) {
+            QJsonArray models;
+            models.append(QJsonObject{{QStringLiteral("id"), QStringLiteral("fake-model")},
+                                      {QStringLiteral("object"), QStringLiteral("model")}});
+            QJsonObject list{{QStringLiteral("object"), QStringLiteral("list")}, {QStringLiteral("data"), models}};
+            log(method, path, 200, QStringLiteral("models"));
+            send({{m_options.latency, jsonResponse(200, QJsonDocument(list).toJson(QJsonDocument::Compact)), false}});
+            return;
+        }
+        bool embeddings = path.endsWith("/embeddings");
+        if (method != "POST" || !(embeddings || path.endsWith("/chat/completions"))) {
+            log(method, path, 404, QString());
+            send({{0, errorResponse(404, "Unknown endpoint", "invalid_request_error"), false}});
+            return;
+        }
+
+        QJsonObject request = QJsonDocument::fromJson(body).object();
+        if (request.isEmpty()) {
+            log(method, path, 400, QString());
+            send({{m_options.latency, errorResponse(400, "Invalid JSON body", "invalid_request_error"), false}});
+            return;
+        }
+
+        // Injected failures come first, like a gateway in front of the model
+        double outcome = m_random->generateDouble();
+        if (outcome < m_options.rateLimit) {
+            log(method, path, 429, QString());
+            send({{m_options.latency, errorResponse(429, "Rate limit reached", "rate_limit_error"), false}});
+            return;
+        }
+        if (outcome < m_options.rateLimit + m_options.serverError) {
+            log(method, path, 500, QString());
+            send({{m_options.latency, errorResponse(500, "The server had an error", "server_error"), false}});
+            return;
+        }
+
+        QString model = request.value(QStringLiteral("model")).toString(QStringLiteral("fake-model"));
+        if (embeddings) {
+            embed(method, path, model, request.value(QStringLiteral("input")));
+            return;
+        }
+
+        QStringList words = replyWords();
+        bool drop = m_random->generateDouble() < m_options.drop;
+        if (request.value(QStringLiteral("stream")).toBool()) {
+            streamCompletion(method, path, model, words, drop);
+        } else {
+            completion(method, path, model, words, drop);
+        }
+    }
+
+    void completion(const QByteArray &method, const QByteArray &path, const QString &model,
+                    const QStringList &words, bool drop)
+    {
+        QJsonObject message{{QStringLiteral("role"), QStringLiteral("assistant")},
+                            {QStringLiteral("content"), words.join(QLatin1Char(' '))}};
+        QJsonObject choice{{QStringLiteral("index"), 0},
+                           {QStringLiteral("message"), message},
+                           {QStringLiteral("finish_reason"), QStringLiteral("stop")}};
+        QJsonObject usage{{QStringLiteral("prompt_tokens"), 0},
+                          {QStringLiteral("completion_tokens"), int(words.size())},
+                          {QStringLiteral("total_tokens"), int(words.size())}};
+        QJsonObject completion = chunkBase(QStringLiteral("chat.completion"), model);
+        completion.insert(QStringLiteral("choices"), QJsonArray{choice});
+        completion.insert(QStringLiteral("usage"), usage);
+
+        QByteArray response = jsonResponse(200, QJsonDocument(completion).toJson(QJsonDocument::Compact));
+        if (drop) {
+            // Headers and half the body, then nothing
+            log(method, path, 200, QStringLiteral("dropped"));
+            int bodyStart = response.indexOf("\r\n\r\n") + 4;
+            send({{m_options.latency, response.left(bodyStart + (response.size() - bodyStart) / 2), false},
+                  {0, QByteArray(), true}});
+            return;
+        }
+        log(method, path, 200, QString());
+        send({{m_options.latency, response, false}});
+    }
+
+    void embed(const QByteArray &method, const QByteArray &path, const QString &model, const QJsonValue &input)
+    {
+        // One text or a list of them
+        QStringList texts;
+        if (input.isArray()) {
+            const QJsonArray inputs = input.toArray();
+            for (const QJsonValue &text : inputs) {
+                texts.append(text.toString());
+            }
+        } else {
+            texts.append(input.toString());
+        }
+
+        QJsonArray data;
+        for (int i = 0; i < texts.size(); ++i) {
+            data.append(QJsonObject{{QStringLiteral("object"), QStringLiteral("embedding")},
+                                    {QStringLiteral("index"), i},
+                                    {QStringLiteral("embedding"), embedding(texts.at(i))}});
+        }
+        QJsonObject response{{QStringLiteral("object"), QStringLiteral("list")},
+                             {QStringLiteral("data"), data},
+                             {QStringLiteral("model"), model},
+                             {QStringLiteral("usage"), QJsonObject{{QStringLiteral("prompt_tokens"), 0},
+                                                                   {QStringLiteral("total_tokens"), 0}}}};
+        log(method, path, 200, QStringLiteral("%1 embeddings").arg(texts.size()));
+        send({{m_options.latency, jsonResponse(200, QJsonDocument(response).toJson(QJsonDocument::Compact)), false}});
+    }
+
+    // Count of each word's hash bucket, not normalized; the client does that
+    QJsonArray embedding(const QString &text) const
+    {
+        QVector<double> values(m_options.dimension, 0.0);
+        static const QRegularExpression separators(QStringLiteral("[^\\w]+"));
+        const QStringList words = text.toLower().split(separators, Qt::SkipEmptyParts);
+        for (const QString &word : words) {
+            values[int(qHash(word, 0) % uint(m_options.dimension))] += 1.0;
+        }
+
+        QJsonArray array;
+        for (double value : std::as_const(values)) {
+            array.append(value);
+        }
+        return array;
+    }
+
+    void streamCompletion(const QByteArray &method, const QByteArray &path, const QString &model,
+                          const QStringList &words, bool drop)
+    {
+        QList<Step> steps;
+        steps.append({m_options.latency,
+                      "HTTP/1.1 200 OK\r\n"
+                      "Content-Type: text/event-stream\r\n"
+                      "Cache-Control: no-cache\r\n"
+                      "Transfer-Encoding: chunked\r\n"
+                      "\r\n",
+                      false});
+
+        const int interval = m_options.streamRate > 0 ? qRound(1000.0 / m_options.streamRate) : 0;
+        const int dropAt = drop ? m_random->bounded(int(words.size()) + 1) : -1;
+
+        for (int i = 0; i <= words.size(); ++i) {
+            if (i == dropAt) {
+                steps.append({interval, QByteArray(), true});
+                break;
+            }
+
+            QJsonObject delta;
+            QJsonValue finishReason = QJsonValue::Null;
+            if (i == 0) {
+                delta.insert(QStringLiteral("role"), QStringLiteral("assistant"));
+            }
+            if (i < words.size()) {
+                QString content = words.at(i);
+                if (i > 0) {
+                    content.prepend(QLatin1Char(' '));
+                }
+                delta.insert(QStringLiteral("content"), content);
+            } else {
+                finishReason = QStringLiteral("stop");
+            }
+            QJsonObject choice{{QStringLiteral("index"), 0},
+                               {QStringLiteral("delta"), delta},
+                               {QStringLiteral("finish_reason"), finishReason}};
+            QJsonObject chunk = chunkBase(QStringLiteral("chat.completion.chunk"), model);
+            chunk.insert(QStringLiteral("choices"), QJsonArray{choice});
+
+            QByteArray event = "data: " + QJsonDocument(chunk).toJson(QJsonDocument::Compact) + "\n\n";
+            if (i == words.size()) {
+                event += "data: [DONE]\n\n";
+            }
+            appendEvent(&steps, i == 0 ? 0 : interval, event);
+        }
+
+        if (dropAt < 0) {
+            steps.append({0, "0\r\n\r\n", false});
+        }
+        log(method, path, 200, dropAt < 0 ? QStringLiteral("stream, %1 chunks").arg(words.size())
+                                          : QStringLiteral("stream, dropped after %1 chunks").arg(dropAt));
+        send(steps);
+    }
+
+    // Add an event as HTTP chunks, in pieces if fragmenting, so the client
+    // sees it split across reads
+    void appendEvent(QList<Step> *steps, int delay, const QByteArray &event)
+    {
+        int pieceSize = m_options.fragment > 0 ? m_options.fragment : event.size();
+        for (int offset = 0; offset < event.size(); offset += pieceSize) {
+            QByteArray piece = event.mid(offset, pieceSize);
+            QByteArray chunk = QByteArray::number(piece.size(), 16) + "\r\n" + piece + "\r\n";
+            steps->append({offset == 0 ? delay : m_options.fragmentDelay, chunk, false});
+        }
+    }
+
+    QStringList replyWords() const
+    {
+        if (!m_options.reply.isEmpty()) {
+            return m_options.reply.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+        }
+        QStringList words;
+        const int count = int(sizeof(REPLY_WORDS) / sizeof(REPLY_WORDS[0]));
+        for (int i = 0; i < m_options.words; ++i) {
+            words.append(QString::fromLatin1(REPLY_WORDS[i % count]));
+        }
+        return words;
+    }
+
+    static QJsonObject chunkBase(const QString &object, const QString &model)
+    {
+        static int nextId = 1;
+        return QJsonObject{{QStringLiteral("id"), QStringLiteral("chatcmpl-fake%1").arg(nextId++)},
+                           {QStringLiteral("object"), object},
+                           {QStringLiteral("created"), QDateTime::currentSecsSinceEpoch()},
+                           {QStringLiteral("model"), model}};
+    }
+
+    static QByteArray reasonPhrase(int status)
+    {
+        switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 413: return "Payload Too Large";
+        case 429: return "Too Many Requests";
+        default: return "Internal Server Error";
+        }
+    }
+
+    static QByteArray jsonResponse(int status, const QByteArray &body, const QByteArray &extraHeaders = QByteArray())
+    {
+        return "HTTP/1.1 " + QByteArray::number(status) + ' ' + reasonPhrase(status) + "\r\n"
+               "Content-Type: application/json\r\n"
+               "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+               + extraHeaders
+               + "\r\n" + body;
+    }
+
+    static QByteArray errorResponse(int status, const char *message, const char *type)
+    {
+        QJsonObject error{{QStringLiteral("message"), QString::fromLatin1(message)},
+                          {QStringLiteral("type"), QString::fromLatin1(type)}};
+        QByteArray body = QJsonDocument(QJsonObject{{QStringLiteral("error"), error}}).toJson(QJsonDocument::Compact);
+        return jsonResponse(status, body, status == 429 ? QByteArray("Retry-After: 1\r\n") : QByteArray());
+    }
+
+    void send(const QList<Step> &steps)
+    {
+        m_steps = steps;
+        m_responding = true;
+        m_timer.start(m_steps.first().delay);
+    }
+
+    void runStep()
+    {
+        Step step = m_steps.takeFirst();
+        if (step.drop) {
+            m_socket->abort();
+            return;
+        }
+        m_socket->write(step.data);
+        m_socket->flush();
+
+        if (!m_steps.isEmpty()) {
+            m_timer.start(m_steps.first().delay);
+            return;
+        }
+        m_responding = false;
+        readRequests();
+    }
+
+    static void log(const QByteArray &method, const QByteArray &path, int status, const QString &detail)
+    {
+        std::fprintf(stderr, "%s %s -> %d%s%s\n", method.constData(), path.constData(), status,
+                     detail.isEmpty() ? "" : ", ", qPrintable(detail));
+    }
+
+    QTcpSocket *m_socket;           ///< Client socket, owned
+    const Options &m_options;       ///< Server behaviour
+    QRandomGenerator *m_random;     ///< Shared seeded generator
+    QByteArray m_buffer;            ///< Received bytes not yet handled
+    QList<Step> m_steps;            ///< Remaining steps of the current response
+    QTimer m_timer;                 ///< Runs the next step
+    bool m_responding;              ///< Whether a response is being sent
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("fakeopenaiserver"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Fake OpenAI-compatible chat completions server for offline testing"));
+    parser.addHelpOption();
+    QCommandLineOption portOption(QStringLiteral("port"), QStringLiteral("Port to listen on, 0 for any."), QStringLiteral("port"), QStringLiteral("8089"));
+    QCommandLineOption latencyOption(QStringLiteral("latency"), QStringLiteral("Delay before each response starts (ms)."), QStringLiteral("ms"), QStringLiteral("0"));
+    QCommandLineOption rateOption(QStringLiteral("stream-rate"), QStringLiteral("Chunks per second when streaming, 0 for no delay."), QStringLiteral("rate"), QStringLiteral("50"));
+    QCommandLineOption fragmentOption(QStringLiteral("fragment"), QStringLiteral("Split each event into pieces of this many bytes."), QStringLiteral("bytes"), QStringLiteral("0"));
+    QCommandLineOption fragmentDelayOption(QStringLiteral("fragment-delay"), QStringLiteral("Delay between the pieces of an event (ms)."), QStringLiteral("ms"), QStringLiteral("2"));
+    QCommandLineOption rateLimitOption(QStringLiteral("rate-limit"), QStringLiteral("Probability of answering 429."), QStringLiteral("p"), QStringLiteral("0"));
+    QCommandLineOption serverErrorOption(QStringLiteral("server-error"), QStringLiteral("Probability of answering 500."), QStringLiteral("p"), QStringLiteral("0"));
+    QCommandLineOption dropOption(QStringLiteral("drop"), QStringLiteral("Probability of dropping the connection mid-response."), QStringLiteral("p"), QStringLiteral("0"));
+    QCommandLineOption wordsOption(QStringLiteral("words"), QStringLiteral("Words in a generated reply."), QStringLiteral("count"), QStringLiteral("40"));
+    QCommandLineOption dimensionOption(QStringLiteral("dimension"), QStringLiteral("Length of embeddings."), QStringLiteral("count"), QStringLiteral("64"));
+    QCommandLineOption replyOption(QStringLiteral("reply"), QStringLiteral("Fixed reply text."), QStringLiteral("text"));
+    QCommandLineOption seedOption(QStringLiteral("seed"), QStringLiteral("Seed for injected failures."), QStringLiteral("seed"), QStringLiteral("1"));
+    parser.addOptions({portOption, latencyOption, rateOption, fragmentOption, fragmentDelayOption,
+                       rateLimitOption, serverErrorOption, dropOption, wordsOption, dimensionOption, replyOption, seedOption});
+    parser.process(app);
+
+    Options options;
+    options.latency = parser.value(latencyOption).toInt();
+    options.streamRate = parser.value(rateOption).toDouble();
+    options.fragment = parser.value(fragmentOption).toInt();
+    options.fragmentDelay = parser.value(fragmentDelayOption).toInt();
+    options.rateLimit = parser.value(rateLimitOption).toDouble();
+    options.serverError = parser.value(serverErrorOption).toDouble();
+    options.drop = parser.value(dropOption).toDouble();
+    options.words = qMax(1, parser.value(wordsOption).toInt());
+    options.dimension = qMax(1, parser.value(dimensionOption).toInt());
+    options.reply = parser.value(replyOption);
+
+    QRandomGenerator random(parser.value(seedOption).toUInt());
+
+    QTcpServer server;
+    if (!server.listen(QHostAddress::LocalHost, quint16(parser.value(portOption).toUInt()))) {
+        std::fprintf(stderr, "Cannot listen: %s\n", qPrintable(server.errorString()));
+        return 1;
+    }
+    QObject::connect(&server, &QTcpServer::newConnection, &server, [&]() {
+        while (QTcpSocket *socket = server.nextPendingConnection()) {
+            new Connection(socket, options, &random, &server);
+        }
+    });
+
+    std::printf("http://127.0.0.1:%d/v1/chat/completions\n", int(server.serverPort()));
+    std::fflush(stdout);
+    return app.exec();
+}